@@ -0,0 +1,74 @@
+# Headless batch processing of audio files without any user interface.
+# Build with batchbase.pro to build the libraries as well.
+
+TEMPLATE = app
+TARGET = sawebatch
+QT += opengl widgets
+
+CONFIG += c++11 console
+macx:CONFIG -= app_bundle
+
+PWD = $$_PRO_FILE_PWD_
+SAWEROOT = $$_PRO_FILE_PWD_/../..
+
+SOURCES += $$PWD/src/*.cpp
+HEADERS += $$PWD/src/*.h
+
+# Chunk export is shared with sonicawe
+SOURCES += \
+    $$SAWEROOT/src/adapters/chunkexport.cpp \
+    $$SAWEROOT/src/adapters/hdf5adapter.cpp \
+
+HEADERS += \
+    $$SAWEROOT/src/adapters/chunkexport.h \
+    $$SAWEROOT/src/adapters/hdf5adapter.h \
+
+DEFINES += SAWE_NODLL
+
+CONFIG += tmpdir buildflags
+
+INCLUDEPATH += \
+    $$SAWEROOT/lib/gpumisc \
+    $$SAWEROOT/lib/backtrace \
+    $$SAWEROOT/lib/justmisc \
+    $$SAWEROOT/lib/signal \
+    $$SAWEROOT/lib/tfr \
+    $$SAWEROOT/lib/filters \
+    $$SAWEROOT/src \
+
+LIBS += \
+    -L../../lib/justmisc -ljustmisc \
+    -L../../lib/backtrace -lbacktrace \
+    -L../../lib/gpumisc -lgpumisc \
+    -L../../lib/signal -lsignal \
+    -L../../lib/tfr -ltfr \
+    -L../../lib/filters -lfilters \
+
+unix {
+LIBS += \
+    -lsndfile \
+    -lhdf5 -lhdf5_hl \
+    -lboost_chrono \
+    -lboost_serialization \
+    -lboost_system \
+    -lboost_thread \
+
+}
+
+macx:exists(/opt/local/include/): INCLUDEPATH += /opt/local/include/ # macports
+macx:exists(/opt/local/lib): LIBS += -L/opt/local/lib
+macx:exists(/usr/local/include/): INCLUDEPATH += /usr/local/include/ # homebrew
+macx:exists(/usr/local/lib): LIBS += -L/usr/local/lib
+
+win32 {
+INCLUDEPATH += \
+        $$SAWEROOT/lib/sonicawe-winlib/libsndfile/include \
+        $$SAWEROOT/lib/sonicawe-winlib/hdf5lib/include \
+        $$SAWEROOT/lib/sonicawe-winlib
+LIBS += \
+        -l$$SAWEROOT/lib/sonicawe-winlib/libsndfile/libsndfile-1 \
+        -l$$SAWEROOT/lib/sonicawe-winlib/hdf5lib/dll/hdf5dll \
+        -l$$SAWEROOT/lib/sonicawe-winlib/hdf5lib/dll/hdf5_hldll \
+        -L$$SAWEROOT/lib/sonicawe-winlib/boostlib \
+        -lpsapi
+}
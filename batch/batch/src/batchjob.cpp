@@ -0,0 +1,168 @@
+#include "batchjob.h"
+#include "sndfilesource.h"
+
+#include "adapters/chunkexport.h"
+#include "signal/processing/purge.h"
+#include "signal/processing/step.h"
+#include "tfr/cwt.h"
+#include "tfr/transformoperation.h"
+#include "datastorage.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <boost/format.hpp>
+
+#include <algorithm>
+
+using namespace Signal;
+using namespace Signal::Processing;
+
+/**
+ * @brief peak_memory_usage returns the maximum resident set size of this
+ * process so far, in bytes.
+ */
+static unsigned long long peak_memory_usage()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo (GetCurrentProcess (), &pmc, sizeof(pmc)))
+        return pmc.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage r;
+    if (0 != getrusage (RUSAGE_SELF, &r))
+        return 0;
+#ifdef __APPLE__
+    return r.ru_maxrss;
+#else
+    return r.ru_maxrss * 1024ull;
+#endif
+#endif
+}
+
+
+BatchJob::
+        BatchJob(Chain::ptr chain,
+                 std::string input,
+                 std::string output,
+                 const ChainDescription& description,
+                 int compression,
+                 IntervalType segment)
+    :
+      chain_(chain),
+      input_(input),
+      output_(output),
+      segment_(std::max<IntervalType>(1, segment)),
+      elapsed_(0),
+      peak_cache_size_(0),
+      done_(false)
+{
+    OperationDesc::ptr source(new SndfileSource(input));
+    OperationDesc::Extent x = source.read ()->extent ();
+    extent_ = x.interval.get ();
+    sample_rate_ = x.sample_rate.get ();
+    int channels = x.number_of_channels.get ();
+
+    OperationDesc::ptr target;
+    if (description.spectrogram ())
+    {
+        export_.reset (new Adapters::ChunkExport(
+                Adapters::ChunkExport::formatFromFilename (output, compression),
+                extent_, sample_rate_, channels));
+
+        Tfr::ChunkFilterDesc::ptr cfd(new Adapters::ChunkExportDesc(export_));
+        if (0 < description.scales_per_octave ())
+            cfd.write ()->transformDesc (Tfr::pTransformDesc(new Tfr::Cwt(description.scales_per_octave ())));
+
+        target = OperationDesc::ptr(new Tfr::TransformOperationDesc(cfd));
+    }
+    else
+    {
+        sink_ = OperationDesc::ptr(new SndfileSink(output, extent_.last, channels, sample_rate_));
+        target = sink_;
+    }
+
+    // addOperationAt inserts each operation right before the target
+    marker_ = chain_->addTarget (target);
+    chain_->addOperationAt (source, marker_);
+    for (OperationDesc::ptr o : description.operations (sample_rate_))
+        chain_->addOperationAt (o, marker_);
+
+    current_ = Interval(extent_.first, std::min(extent_.last, extent_.first + segment_));
+    updateNeeds ();
+}
+
+
+BatchJob::
+        ~BatchJob()
+{
+    // Removes the branch of this job from the chain
+    marker_.reset ();
+
+    if (sink_)
+        dynamic_cast<SndfileSink&>(*sink_.write ()).close ();
+}
+
+
+bool BatchJob::
+        work(int sleep_ms)
+{
+    if (done_)
+        return true;
+
+    TargetNeeds::ptr needs = marker_->target_needs ();
+    peak_cache_size_ = std::max(peak_cache_size_, Purge(marker_->dag ()).cache_size ());
+
+    if (!needs->sleep (sleep_ms))
+        return false;
+
+    if (current_.last < extent_.last)
+    {
+        current_ = Interval(current_.last, std::min(extent_.last, current_.last + segment_));
+        updateNeeds ();
+
+        // The previous segment is written to the output, release everything
+        // that isn't needed for the next one
+        if (Step::ptr step = needs->step ().lock ())
+            step.write ()->purge (current_, true);
+        Purge(marker_->dag ()).purge (needs, true);
+        return false;
+    }
+
+    if (export_)
+        export_->finish ();
+    if (sink_)
+        dynamic_cast<SndfileSink&>(*sink_.write ()).close ();
+
+    elapsed_ = timer_.elapsed ();
+    done_ = true;
+    return true;
+}
+
+
+std::string BatchJob::
+        report() const
+{
+    double duration = extent_.count () / sample_rate_;
+    double elapsed = done_ ? elapsed_ : timer_.elapsed ();
+
+    return (boost::format("%s -> %s: %.1f s audio in %.1f s (%.1fx realtime, %.2f Msamples/s), "
+                          "peak cache %s, peak memory %s")
+            % input_ % output_ % duration % elapsed
+            % (duration / elapsed)
+            % (extent_.count () / elapsed * 1e-6)
+            % DataStorageVoid::getMemorySizeText (peak_cache_size_)
+            % DataStorageVoid::getMemorySizeText (peak_memory_usage ())).str ();
+}
+
+
+void BatchJob::
+        updateNeeds()
+{
+    marker_->target_needs ()->updateNeeds (current_, current_.first);
+}
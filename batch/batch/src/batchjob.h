@@ -0,0 +1,79 @@
+#ifndef BATCHJOB_H
+#define BATCHJOB_H
+
+#include "chaindescription.h"
+#include "signal/processing/chain.h"
+#include "timer.h"
+
+#include <memory>
+#include <string>
+
+namespace Adapters { class ChunkExport; }
+
+/**
+ * @brief The BatchJob class should process one file through a chain of
+ * operations and write the result to an output file.
+ *
+ * The file is processed in segments of 'segment' samples. Cache blocks of
+ * previous segments are purged when a segment is finished so that the memory
+ * usage doesn't grow with the length of the file.
+ *
+ * All jobs share the workers of the same Signal::Processing::Chain.
+ */
+class BatchJob
+{
+public:
+    /**
+     * @brief BatchJob adds a branch for 'input' to 'chain'. The output is a
+     * 32-bit float WAV file unless 'description' ends with cwt, in which case
+     * the spectrogram is written with Adapters::ChunkExport.
+     *
+     * Throws std::runtime_error if 'input' can't be read or 'output' can't be
+     * created.
+     */
+    BatchJob(Signal::Processing::Chain::ptr chain,
+             std::string input,
+             std::string output,
+             const ChainDescription& description,
+             int compression,
+             Signal::IntervalType segment);
+    ~BatchJob();
+
+    /**
+     * @brief work waits at most 'sleep_ms' for the current segment and
+     * continues with the next segment when it's done.
+     * @return true when the output is complete.
+     *
+     * Throws if a worker has failed computing the output.
+     */
+    bool work(int sleep_ms);
+
+    /**
+     * @brief report describes the throughput and memory usage of the job.
+     */
+    std::string report() const;
+
+    std::string input() const { return input_; }
+
+private:
+    Signal::Processing::Chain::ptr chain_;
+    std::string input_;
+    std::string output_;
+    Signal::Interval extent_;
+    float sample_rate_;
+    Signal::IntervalType segment_;
+    Signal::Interval current_;
+
+    Signal::Processing::TargetMarker::ptr marker_;
+    std::shared_ptr<Adapters::ChunkExport> export_;
+    Signal::OperationDesc::ptr sink_;
+
+    Timer timer_;
+    double elapsed_;
+    size_t peak_cache_size_;
+    bool done_;
+
+    void updateNeeds();
+};
+
+#endif // BATCHJOB_H
@@ -0,0 +1,107 @@
+#include "chaindescription.h"
+
+#include "filters/absolutevalue.h"
+#include "filters/bandpass.h"
+#include "filters/envelope.h"
+#include "filters/normalize.h"
+#include "tfr/transformoperation.h"
+
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+static vector<string> split(const string& s, char delimiter)
+{
+    vector<string> v;
+    stringstream ss(s);
+    string item;
+    while (getline (ss, item, delimiter))
+        v.push_back (item);
+    return v;
+}
+
+
+ChainDescription::
+        ChainDescription(string description)
+    :
+      description_(description),
+      spectrogram_(false),
+      scales_per_octave_(0)
+{
+    for (const string& s : split (description, ','))
+    {
+        if (s.empty ())
+            continue;
+
+        if (spectrogram_)
+            throw invalid_argument("'cwt' must be the last step in '" + description + "'");
+
+        vector<string> v = split (s, ':');
+        Step step;
+        step.name = v[0];
+        for (size_t i=1; i<v.size (); i++)
+        {
+            char* end = 0;
+            step.args.push_back (strtof (v[i].c_str (), &end));
+            if (v[i].empty () || *end)
+                throw invalid_argument("Invalid argument '" + v[i] + "' to '" + step.name + "'");
+        }
+
+        size_t args;
+        if (step.name == "absolute" || step.name == "envelope")
+            args = 0;
+        else if (step.name == "bandpass")
+            args = 2;
+        else if (step.name == "normalize")
+            args = 1;
+        else if (step.name == "cwt")
+        {
+            if (1 < step.args.size ())
+                throw invalid_argument("'cwt' takes at most 1 argument");
+
+            spectrogram_ = true;
+            scales_per_octave_ = step.args.empty () ? 0 : step.args[0];
+            continue;
+        }
+        else
+            throw invalid_argument("Unknown step '" + step.name + "'");
+
+        if (step.args.size () != args)
+        {
+            stringstream ss;
+            ss << "'" << step.name << "' takes " << args << " arguments";
+            throw invalid_argument(ss.str ());
+        }
+
+        steps_.push_back (step);
+    }
+}
+
+
+vector<Signal::OperationDesc::ptr> ChainDescription::
+        operations(float sample_rate) const
+{
+    vector<Signal::OperationDesc::ptr> operations;
+
+    for (const Step& step : steps_)
+    {
+        Signal::OperationDesc::ptr o;
+
+        if (step.name == "absolute")
+            o = Signal::OperationDesc::ptr(new Filters::AbsoluteValueDesc);
+        else if (step.name == "envelope")
+            o = Signal::OperationDesc::ptr(new Tfr::TransformOperationDesc(
+                    Tfr::ChunkFilterDesc::ptr(new Filters::EnvelopeDesc)));
+        else if (step.name == "bandpass")
+            o = Signal::OperationDesc::ptr(new Tfr::TransformOperationDesc(
+                    Tfr::ChunkFilterDesc::ptr(new Filters::Bandpass(step.args[0], step.args[1]))));
+        else if (step.name == "normalize")
+            o = Signal::OperationDesc::ptr(new Filters::Normalize(step.args[0]*sample_rate));
+
+        operations.push_back (o);
+    }
+
+    return operations;
+}
@@ -0,0 +1,57 @@
+#ifndef CHAINDESCRIPTION_H
+#define CHAINDESCRIPTION_H
+
+#include "signal/operation.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief The ChainDescription class should describe a chain of operations as
+ * text and create the operations for an input file.
+ *
+ * Steps are separated by ',' and arguments by ':', for example
+ * "bandpass:300:3000,absolute,cwt:40". Valid steps are
+ *
+ *   absolute            absolute value
+ *   envelope            envelope
+ *   bandpass:f1:f2      keeps frequencies between f1 and f2 Hz
+ *   normalize:seconds   normalizes the signal strength over a radius in seconds
+ *   cwt[:scales]        the spectrogram with the given number of scales per
+ *                       octave, must be the last step
+ *
+ * Throws std::invalid_argument for invalid descriptions.
+ */
+class ChainDescription
+{
+public:
+    ChainDescription(std::string description);
+
+    /**
+     * @brief operations creates the operations of all steps except cwt, in
+     * order from the source.
+     */
+    std::vector<Signal::OperationDesc::ptr> operations(float sample_rate) const;
+
+    /**
+     * @brief spectrogram is true if the chain ends with a cwt.
+     */
+    bool spectrogram() const { return spectrogram_; }
+    float scales_per_octave() const { return scales_per_octave_; }
+
+    std::string toString() const { return description_; }
+
+private:
+    struct Step
+    {
+        std::string name;
+        std::vector<float> args;
+    };
+
+    std::string description_;
+    std::vector<Step> steps_;
+    bool spectrogram_;
+    float scales_per_octave_;
+};
+
+#endif // CHAINDESCRIPTION_H
@@ -0,0 +1,224 @@
+#include "batchjob.h"
+#include "chaindescription.h"
+
+#include "signal/computingengine.h"
+#include "signal/numatopology.h"
+#include "signal/processing/workers.h"
+#include "prettifysegfault.h"
+#include "log.h"
+
+#include <boost/exception/all.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace Signal;
+using namespace Signal::Processing;
+
+static const char usage[] =
+        "sawebatch [--chain=description] [--output=directory] [--format=wav|npy|h5]\n"
+        "          [--compression=level] [--jobs=n] [--segment=samples]\n"
+        "          [--numa[=nodes]] file...\n"
+        "\n"
+        "Processes each file through a chain of operations and writes the result to\n"
+        "the output directory with the same base name. The chain is a comma separated\n"
+        "list of steps where arguments are separated by ':', for instance\n"
+        "\n"
+        "    sawebatch --chain=bandpass:300:3000,envelope *.wav\n"
+        "    sawebatch --chain=normalize:2,cwt:40 --format=npy *.wav\n"
+        "\n"
+        "Valid steps are absolute, envelope, bandpass:f1:f2, normalize:seconds and\n"
+        "cwt[:scales_per_octave]. If the chain ends with cwt the spectrogram is\n"
+        "written in HDF5 (default) or .npy format, otherwise the processed signal is\n"
+        "written as a 32-bit float WAV file.\n"
+        "\n"
+        "    --compression  deflate level for HDF5 spectrograms, 0 to 9 (default 0)\n"
+        "    --jobs         number of files to process at the same time (default 2)\n"
+        "    --segment      number of samples processed before releasing caches\n"
+        "                   (default 4194304)\n"
+        "    --numa         pin workers to the cores of each NUMA node and keep\n"
+        "                   their memory on the node, '--numa=nodes' simulates\n"
+        "                   a number of nodes on a machine with one node\n";
+
+
+static bool readarg(const string& arg, const string& name, string& value)
+{
+    string prefix = "--" + name + "=";
+    if (0 != arg.compare (0, prefix.size (), prefix))
+        return false;
+    value = arg.substr (prefix.size ());
+    return true;
+}
+
+
+static string outputFilename(string input, string directory, string suffix)
+{
+    size_t slash = input.find_last_of ("/\\");
+    string name = slash == string::npos ? input : input.substr (slash+1);
+    size_t dot = name.find_last_of ('.');
+    if (dot != string::npos && dot != 0)
+        name = name.substr (0, dot);
+
+    if (directory.empty ())
+        return name + suffix;
+    if (directory.back () != '/' && directory.back () != '\\')
+        directory += '/';
+    return directory + name + suffix;
+}
+
+
+/**
+ * @brief restart_dead_workers replaces workers that have crashed so that one
+ * failing task doesn't stop the other files. The failed task is retried by
+ * the new worker.
+ */
+static void restart_dead_workers(Chain::ptr chain)
+{
+    Workers::DeadEngines dead = chain->workers ().write ()->clean_dead_workers ();
+    if (dead.empty ())
+        return;
+
+    Workers::print (dead);
+
+    for (const auto& d : dead)
+    {
+        ComputingEngine::ptr ce;
+        if (dynamic_cast<DiscAccessThread*>(d.first.get ()))
+            ce.reset (new DiscAccessThread);
+        else if (ComputingCpu* cpu = dynamic_cast<ComputingCpu*>(d.first.get ()))
+            ce.reset (new ComputingCpu(cpu->placement ()));
+        else
+            ce.reset (new ComputingCpu);
+        chain->workers ().write ()->addComputingEngine (ce);
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    PrettifySegfault::setup ();
+
+    string chain_description, directory, format, value;
+    int compression = 0;
+    size_t jobs = 2;
+    IntervalType segment = 1 << 22;
+    int numa_nodes = -1;
+    list<string> inputs;
+
+    for (int i=1; i<argc; i++)
+    {
+        string arg = argv[i];
+        if (readarg (arg, "chain", value))              chain_description = value;
+        else if (readarg (arg, "output", value))        directory = value;
+        else if (readarg (arg, "format", value))        format = value;
+        else if (readarg (arg, "compression", value))   compression = atoi (value.c_str ());
+        else if (readarg (arg, "jobs", value))          jobs = max(1, atoi (value.c_str ()));
+        else if (readarg (arg, "segment", value))       segment = max(1, atoi (value.c_str ()));
+        else if (readarg (arg, "numa", value))          numa_nodes = max(1, atoi (value.c_str ()));
+        else if (arg == "--numa")                       numa_nodes = 0;
+        else if (arg == "--help" || arg == "-h")        { cout << usage; return 0; }
+        else if (0 == arg.compare (0, 2, "--"))         { cerr << "Unknown argument " << arg << endl << usage; return 1; }
+        else                                            inputs.push_back (arg);
+    }
+
+    if (inputs.empty ())
+    {
+        cerr << usage;
+        return 1;
+    }
+
+    size_t total = inputs.size ();
+
+    unique_ptr<ChainDescription> description;
+    try {
+        description.reset (new ChainDescription(chain_description));
+    } catch (const exception& x) {
+        cerr << x.what () << endl;
+        return 1;
+    }
+
+    string suffix = ".wav";
+    if (description->spectrogram ())
+    {
+        suffix = format == "npy" ? ".npy" : ".h5";
+        if (!format.empty () && format != "npy" && format != "h5")
+        {
+            cerr << "A spectrogram can't be written as " << format << endl;
+            return 1;
+        }
+    }
+    else if (!format.empty () && format != "wav")
+    {
+        cerr << "Only spectrograms (--chain=...,cwt) can be written as " << format << endl;
+        return 1;
+    }
+
+    // All files share the workers of one chain, which has one worker per
+    // core and the disc access thread that reads the files
+    unique_ptr<NumaTopology> placement;
+    if (0 == numa_nodes)
+        placement.reset (new NumaTopology);
+    else if (0 < numa_nodes)
+        placement.reset (new NumaTopology(NumaTopology::simulated (numa_nodes)));
+
+    Chain::ptr chain = Chain::createDefaultChain (placement.get ());
+    chain->workers ().write ()->addComputingEngine (ComputingEngine::ptr(new DiscAccessThread));
+
+    int failed = 0;
+    list<unique_ptr<BatchJob>> active;
+
+    while (!inputs.empty () || !active.empty ())
+    {
+        while (active.size () < jobs && !inputs.empty ())
+        {
+            string input = inputs.front ();
+            inputs.pop_front ();
+
+            try {
+                string output = outputFilename (input, directory, suffix);
+                active.emplace_back (new BatchJob(chain, input, output, *description, compression, segment));
+                Log("sawebatch: processing %s -> %s") % input % output;
+            } catch (...) {
+                Log("sawebatch: failed %s\n%s") % input % boost::current_exception_diagnostic_information ();
+                failed++;
+            }
+        }
+
+        for (auto i = active.begin (); i != active.end ();)
+        {
+            try {
+                if (!(*i)->work (10))
+                {
+                    ++i;
+                    continue;
+                }
+
+                Log("sawebatch: %s") % (*i)->report ();
+            } catch (...) {
+                Log("sawebatch: failed %s\n%s") % (*i)->input () % boost::current_exception_diagnostic_information ();
+                failed++;
+            }
+
+            i = active.erase (i);
+        }
+
+        restart_dead_workers (chain);
+    }
+
+    chain->close ();
+
+    vector<NumaTopology::NodeStatistics> nodes = NumaTopology::statistics ();
+    for (size_t i=0; i<nodes.size (); i++)
+        Log("sawebatch: node %d computed %g samples in %d tasks, %g s busy")
+                % i % nodes[i].samples % nodes[i].tasks % nodes[i].seconds;
+
+    if (failed)
+        Log("sawebatch: %d of %d files failed") % failed % total;
+
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,271 @@
+#include "sndfilesource.h"
+
+#include "signal/computingengine.h"
+#include "signal/transpose.h"
+#include "cpumemorystorage.h"
+#include "log.h"
+
+#include <sndfile.hh>
+
+#include <functional>
+#include <map>
+#include <stdexcept>
+
+using namespace Signal;
+
+/**
+ * @brief The FunctionOperation class should process buffers with a function.
+ */
+class FunctionOperation: public Operation
+{
+public:
+    FunctionOperation(std::function<pBuffer(pBuffer)> f) : f_(f) {}
+
+    pBuffer process(pBuffer b) override { return f_(b); }
+
+private:
+    std::function<pBuffer(pBuffer)> f_;
+};
+
+
+SndfileSource::
+        SndfileSource(std::string filename)
+    :
+      filename_(filename),
+      file_(new File)
+{
+    file_->sndfile.reset (new SndfileHandle(filename));
+    if (!*file_->sndfile || 0 == file_->sndfile->frames ())
+        throw std::runtime_error("Could not read '" + filename + "': " + file_->sndfile->strError ());
+
+    file_->frames = file_->sndfile->frames ();
+    file_->channels = file_->sndfile->channels ();
+    file_->sample_rate = file_->sndfile->samplerate ();
+}
+
+
+Interval SndfileSource::
+        requiredInterval( const Interval& I, Interval* expectedOutput ) const
+{
+    if (expectedOutput)
+        *expectedOutput = I;
+    return I;
+}
+
+
+Interval SndfileSource::
+        affectedInterval( const Interval& I ) const
+{
+    return I;
+}
+
+
+OperationDesc::ptr SndfileSource::
+        copy() const
+{
+    return OperationDesc::ptr(new SndfileSource(filename_));
+}
+
+
+Operation::ptr SndfileSource::
+        createOperation(ComputingEngine* engine) const
+{
+    if (!dynamic_cast<DiscAccessThread*>(engine))
+        return Operation::ptr();
+
+    std::shared_ptr<File> file = file_;
+    return Operation::ptr(new FunctionOperation([file](pBuffer b)
+    {
+        Interval I = b->getInterval ();
+        Interval J = I & Interval(0, file->frames);
+        int C = file->channels;
+
+        // Samples outside of the file are zeros
+        for (const Interval& K : Intervals(I) - J)
+            *b |= Buffer(K, b->sample_rate (), C);
+
+        if (!J)
+            return b;
+
+        pBuffer r(new Buffer(J.first, J.count (), file->sample_rate, C));
+        std::vector<float*> channels(C);
+        for (int c=0; c<C; c++)
+            channels[c] = CpuMemoryStorage::WriteAll<1>( r->getChannel (c)->waveform_data () ).ptr();
+
+        std::vector<float> data(C*J.count ());
+        sf_count_t frames = 0;
+        {
+            std::lock_guard<std::mutex> l(file->lock);
+            if (J.first == file->sndfile->seek (J.first, SEEK_SET))
+                frames = file->sndfile->readf (&data[0], J.count ());
+        }
+
+        if (frames < (sf_count_t)J.count ())
+            Log("sndfilesource: could only read %d of %s") % frames % J;
+
+        Signal::deinterleave (&channels[0], &data[0], C, frames);
+        *b |= *r;
+        return b;
+    }));
+}
+
+
+OperationDesc::Extent SndfileSource::
+        extent() const
+{
+    Extent x;
+    x.interval = Interval(0, file_->frames);
+    x.number_of_channels = file_->channels;
+    x.sample_rate = file_->sample_rate;
+    return x;
+}
+
+
+QString SndfileSource::
+        toString() const
+{
+    return QString("SndfileSource %1").arg(QString::fromStdString (filename_));
+}
+
+
+bool SndfileSource::
+        operator==(const OperationDesc& d) const
+{
+    const SndfileSource* b = dynamic_cast<const SndfileSource*>(&d);
+    return b && b->filename_ == filename_;
+}
+
+
+class SndfileSink::Writer
+{
+public:
+    Writer(std::string filename, IntervalType length, int channels, float sample_rate)
+        :
+          sndfile_(filename, SFM_WRITE, SF_FORMAT_WAV | SF_FORMAT_FLOAT, channels, sample_rate),
+          length_(length),
+          written_(0)
+    {
+        if (!sndfile_)
+            throw std::runtime_error("Could not create '" + filename + "': " + sndfile_.strError ());
+    }
+
+    void put(pBuffer b)
+    {
+        std::lock_guard<std::mutex> l(lock_);
+
+        pending_[b->getInterval ().first] = b;
+
+        // Write everything that is contiguous with what has been written
+        while (!pending_.empty () && pending_.begin ()->first <= written_)
+        {
+            pBuffer p = pending_.begin ()->second;
+            pending_.erase (pending_.begin ());
+
+            Interval I = p->getInterval () & Interval(written_, length_);
+            if (I)
+                write (*p, I);
+        }
+    }
+
+    IntervalType written() const
+    {
+        std::lock_guard<std::mutex> l(lock_);
+        return written_;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> l(lock_);
+        pending_.clear ();
+        sndfile_ = SndfileHandle();
+    }
+
+private:
+    void write(const Buffer& b, Interval I)
+    {
+        int C = b.number_of_channels ();
+        std::vector<const float*> channels(C);
+        for (int c=0; c<C; c++)
+            channels[c] = CpuMemoryStorage::ReadOnly<1>( b.getChannel (c)->waveform_data () ).ptr() + (I.first - b.getInterval ().first);
+
+        std::vector<float> data(C*I.count ());
+        Signal::interleave (&data[0], &channels[0], C, I.count ());
+        sndfile_.writef (&data[0], I.count ());
+        written_ = I.last;
+    }
+
+    mutable std::mutex lock_;
+    SndfileHandle sndfile_;
+    IntervalType length_;
+    IntervalType written_;
+    std::map<IntervalType, pBuffer> pending_;
+};
+
+
+SndfileSink::
+        SndfileSink(std::string filename, IntervalType length, int channels, float sample_rate)
+    :
+      filename_(filename),
+      writer_(new Writer(filename, length, channels, sample_rate))
+{
+}
+
+
+Interval SndfileSink::
+        requiredInterval( const Interval& I, Interval* expectedOutput ) const
+{
+    if (expectedOutput)
+        *expectedOutput = I;
+    return I;
+}
+
+
+Interval SndfileSink::
+        affectedInterval( const Interval& I ) const
+{
+    return I;
+}
+
+
+OperationDesc::ptr SndfileSink::
+        copy() const
+{
+    // The same file can't be written twice
+    return OperationDesc::ptr();
+}
+
+
+Operation::ptr SndfileSink::
+        createOperation(ComputingEngine* engine) const
+{
+    if (engine && !dynamic_cast<ComputingCpu*>(engine))
+        return Operation::ptr();
+
+    std::shared_ptr<Writer> writer = writer_;
+    return Operation::ptr(new FunctionOperation([writer](pBuffer b)
+    {
+        writer->put (b);
+        return b;
+    }));
+}
+
+
+QString SndfileSink::
+        toString() const
+{
+    return QString("SndfileSink %1").arg(QString::fromStdString (filename_));
+}
+
+
+IntervalType SndfileSink::
+        written() const
+{
+    return writer_->written ();
+}
+
+
+void SndfileSink::
+        close()
+{
+    writer_->close ();
+}
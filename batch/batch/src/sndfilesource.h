@@ -0,0 +1,85 @@
+#ifndef SNDFILESOURCE_H
+#define SNDFILESOURCE_H
+
+#include "signal/operation.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+class SndfileHandle;
+
+/**
+ * @brief The SndfileSource class should read audio files with libsndfile.
+ *
+ * The file is only read by a Signal::DiscAccessThread. Samples outside of the
+ * file are zeros.
+ *
+ * Throws std::runtime_error if the file can't be opened.
+ */
+class SndfileSource: public Signal::OperationDesc
+{
+public:
+    SndfileSource(std::string filename);
+
+    Signal::Interval requiredInterval( const Signal::Interval& I, Signal::Interval* expectedOutput ) const override;
+    Signal::Interval affectedInterval( const Signal::Interval& I ) const override;
+    Signal::OperationDesc::ptr copy() const override;
+    Signal::Operation::ptr createOperation(Signal::ComputingEngine* engine=0) const override;
+    Extent extent() const override;
+    QString toString() const override;
+    bool operator==(const OperationDesc& d) const override;
+
+private:
+    struct File
+    {
+        std::mutex lock;
+        std::unique_ptr<SndfileHandle> sndfile;
+        Signal::IntervalType frames;
+        int channels;
+        float sample_rate;
+    };
+
+    std::string filename_;
+    std::shared_ptr<File> file_;
+};
+
+
+/**
+ * @brief The SndfileSink class should write the signal to a 32-bit float WAV
+ * file as a target operation.
+ *
+ * Buffers may be computed in any order, they are kept until all samples
+ * before them have been written. The file is complete when all samples in
+ * 'length' have been written, or when close is called.
+ */
+class SndfileSink: public Signal::OperationDesc
+{
+public:
+    SndfileSink(std::string filename, Signal::IntervalType length, int channels, float sample_rate);
+
+    Signal::Interval requiredInterval( const Signal::Interval& I, Signal::Interval* expectedOutput ) const override;
+    Signal::Interval affectedInterval( const Signal::Interval& I ) const override;
+    Signal::OperationDesc::ptr copy() const override;
+    Signal::Operation::ptr createOperation(Signal::ComputingEngine* engine=0) const override;
+    QString toString() const override;
+
+    /**
+     * @brief written returns the number of samples written so far.
+     */
+    Signal::IntervalType written() const;
+
+    /**
+     * @brief close closes the file. Samples that haven't been computed yet
+     * are discarded.
+     */
+    void close();
+
+    class Writer;
+
+private:
+    std::string filename_;
+    std::shared_ptr<Writer> writer_;
+};
+
+#endif // SNDFILESOURCE_H
@@ -0,0 +1,13 @@
+TEMPLATE = subdirs
+CONFIG += ordered
+
+SUBDIRS = \
+    ../lib/justmisc \
+    ../lib/backtrace \
+    ../lib/gpumisc \
+    ../lib/signal \
+    ../lib/tfr \
+    ../lib/filters \
+    batch \
+
+cache()
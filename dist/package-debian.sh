@@ -105,6 +105,9 @@ cp matlab/sawe_compute_cwt.m $share
 cp matlab/sawe_extract_cwt.m $share
 cp matlab/sawe_extract_cwt_time.m $share
 cp matlab/sawe_filewatcher.m $share
+cp matlab/sawe_shmwatcher.m $share
+cp matlab/sawe_shm.cc $share
+which mkoctfile >/dev/null && mkoctfile -o $share/sawe_shm.oct matlab/sawe_shm.cc
 cp matlab/sawe_getdatainfo.m $share
 cp matlab/sawe_datestr.m $share
 cp plugins/exampleplugin.m $share/examples
@@ -1,5 +1,6 @@
 /**
- * Include: shared_state.h, shared_state_mutex.h, shared_timed_mutex_polyfill.h
+ * Include: shared_state.h, shared_state_mutex.h, shared_timed_mutex_polyfill.h,
+ *          shared_state_rcu.h, shared_state_profiler.h, trace_scope.h
  * Library: C++11 only
  *
  * The shared_state class is a smart pointer that guarantees thread-safe access
@@ -13,6 +14,12 @@
  *   - backtraces on deadlocks from all participating threads,
  *   - warnings on locks that are held too long.
  *
+ * shared_state_profiler can measure lock contention of all shared_state
+ * instances, per type and call site.
+ *
+ * Read-mostly types can use shared_state_rcu instead of a mutex to let
+ * readers access an immutable snapshot without locking.
+ *
  *
  * In a nutshell
  * -------------
@@ -113,6 +120,8 @@ template<class T>
 class shared_state;
 
 #include "shared_state_mutex.h"
+#include "shared_state_rcu.h"
+#include "shared_state_profiler.h"
 
 class lock_failed: public virtual std::exception {};
 
@@ -157,10 +166,19 @@ struct shared_state_traits_default {
      * read access but exclusive write access. Depending on your usage pattern
      * it might be better to use a simpler type.
      *
-     * See shared_state_mutex.h for possible implementations.
+     * See shared_state_mutex.h for possible implementations, and
+     * shared_state_rcu.h for lock-free reads of read-mostly types.
      */
     typedef ::shared_state_mutex shared_state_mutex;
 
+    /**
+     'copy' creates the version that a write_ptr modifies when
+     shared_state_mutex is shared_state_rcu. Override it for polymorphic
+     types.
+     */
+    template<class T>
+    T* copy (const T& t) { return new T(t); }
+
     /**
      * @brief enable_implicit_lock defines if the -> operator is enough to
      * obtain a lock. Otherwise, explicit .write() and .read() are needed.
@@ -198,7 +216,9 @@ struct shared_state_details: public shared_state_details_helper<T>::type {
     typedef typename shared_state_details_helper<T>::type::shared_state_mutex shared_state_mutex;
     mutable shared_state_mutex lock;
 
-    T* const p;
+    // With shared_state_rcu each write_ptr publishes a new version in 'p'
+    typedef std::is_base_of<shared_state_rcu, shared_state_mutex> snapshots;
+    typename std::conditional<snapshots::value, std::atomic<T*>, T* const>::type p;
 };
 
 
@@ -274,7 +294,7 @@ public:
      */
     class read_ptr {
     public:
-        read_ptr() : l(0), p(0) {}
+        read_ptr() : l(0), p(0), token(0) {}
 
         read_ptr(read_ptr&& b)
             :   read_ptr()
@@ -300,30 +320,79 @@ public:
         explicit operator bool() const { return (bool)p; }
 
         void lock() {
+            lock (typename details::snapshots ());
+        }
+
+        void unlock() {
+            if (p)
+                unlock (typename details::snapshots ());
+        }
+
+        void swap(read_ptr& b) {
+            std::swap(l, b.l);
+            std::swap(d, b.d);
+            std::swap(p, b.p);
+            std::swap(token, b.token);
+            std::swap(profile, b.profile);
+        }
+
+    private:
+        friend class shared_state;
+
+        explicit read_ptr (const shared_state& vp)
+            :   l (&vp.d->lock),
+                d (vp.d),
+                p (0),
+                token (0)
+        {
+            lock ();
+        }
+
+        read_ptr (const shared_state& vp, bool)
+            :   l (&vp.d->lock),
+                d (vp.d),
+                p (0),
+                token (0)
+        {
+            try_lock (typename details::snapshots ());
+        }
+
+        void lock(std::false_type) {
             // l is not locked, but timeout is required to be reentrant
             double timeout = d->timeout();
 
+            // Only measured if the lock is contended and profiling is enabled
+            unsigned long long wait_begin = 0;
+
             // try_lock_shared_for and lock_shared are unnecessarily complex if
             // the lock is available right away
             if (l->try_lock_shared ())
             {
                 // Got lock
             }
-            else if (timeout < 0)
-            {
-                l->lock_shared ();
-                // Got lock
-            }
-            else if (l->try_lock_shared_for (shared_state_chrono::duration<double>{timeout}))
-            {
-                // Got lock
-            }
             else
             {
-                d->template timeout_failed<T> (d->p);
-                // timeout_failed is expected to throw. But if it doesn't,
-                // make this behave as a null pointer
-                return;
+                wait_begin = shared_state_profiler::wait_begin ();
+
+                if (timeout < 0)
+                {
+                    l->lock_shared ();
+                    // Got lock
+                }
+                else if (l->try_lock_shared_for (shared_state_chrono::duration<double>{timeout}))
+                {
+                    // Got lock
+                }
+                else
+                {
+                    if (wait_begin)
+                        shared_state_profiler::timed_out (typeid(element_type), wait_begin);
+
+                    d->template timeout_failed<T> (d->p);
+                    // timeout_failed is expected to throw. But if it doesn't,
+                    // make this behave as a null pointer
+                    return;
+                }
             }
 
             p = d->p;
@@ -335,49 +404,72 @@ public:
                 l->unlock_shared ();
                 throw;
             }
+
+            if (shared_state_profiler::is_enabled ())
+                profile = shared_state_profiler::acquired (typeid(element_type), wait_begin);
         }
 
-        void unlock() {
-            if (p)
-            {
-                const T* q = p;
-                p = 0;
-                l->unlock_shared ();
-                d->unlocked (q);
+        void try_lock(std::false_type) {
+            if (l->try_lock_shared ()) {
+                p = d->p;
+                d->locked (p);
+
+                if (shared_state_profiler::is_enabled ())
+                    profile = shared_state_profiler::acquired (typeid(element_type), 0);
             }
         }
 
-        void swap(read_ptr& b) {
-            std::swap(l, b.l);
-            std::swap(d, b.d);
-            std::swap(p, b.p);
+        void unlock(std::false_type) {
+            const T* q = p;
+            p = 0;
+            l->unlock_shared ();
+            if (profile.c)
+            {
+                shared_state_profiler::released (profile);
+                profile.c = 0;
+            }
+            d->unlocked (q);
         }
 
-    private:
-        friend class shared_state;
+        // shared_state_rcu readers never wait, see shared_state_rcu.h
+        void lock(std::true_type) {
+            token = l->read_lock ();
+            p = d->p;
 
-        explicit read_ptr (const shared_state& vp)
-            :   l (&vp.d->lock),
-                d (vp.d),
-                p (0)
-        {
-            lock ();
+            try {
+                d->locked (p);
+            } catch (...) {
+                p = 0;
+                l->read_unlock (token);
+                throw;
+            }
+
+            if (shared_state_profiler::is_enabled ())
+                profile = shared_state_profiler::acquired (typeid(element_type), 0);
         }
 
-        read_ptr (const shared_state& vp, bool)
-            :   l (&vp.d->lock),
-                d (vp.d),
-                p (0)
-        {
-            if (l->try_lock_shared ()) {
-                p = d->p;
-                d->locked (p);
+        void try_lock(std::true_type) {
+            lock (std::true_type ());
+        }
+
+        void unlock(std::true_type) {
+            const T* q = p;
+            p = 0;
+            if (profile.c)
+            {
+                shared_state_profiler::released (profile);
+                profile.c = 0;
             }
+            // 'q' may be deleted as soon as the read is unlocked
+            d->unlocked (q);
+            l->read_unlock (token);
         }
 
         typename details::shared_state_mutex* l;
         std::shared_ptr<details> d;
         const element_type* p;
+        unsigned token;
+        shared_state_profiler::sample profile;
     };
 
 
@@ -419,48 +511,58 @@ public:
         // See read_ptr::lock
         void lock() {
             double timeout = d->timeout();
+            unsigned long long wait_begin = 0;
 
             if (l->try_lock())
             {
             }
-            else if (timeout < 0)
-            {
-                l->lock ();
-            }
-            else if (l->try_lock_for (shared_state_chrono::duration<double>{timeout}))
-            {
-            }
             else
             {
-                d->timeout_failed(d->p);
-                return;
+                wait_begin = shared_state_profiler::wait_begin ();
+
+                if (timeout < 0)
+                {
+                    l->lock ();
+                }
+                else if (l->try_lock_for (shared_state_chrono::duration<double>{timeout}))
+                {
+                }
+                else
+                {
+                    if (wait_begin)
+                        shared_state_profiler::timed_out (typeid(element_type), wait_begin);
+
+                    d->template timeout_failed<T> (d->p);
+                    return;
+                }
             }
 
-            p = d->p;
-
             try {
+                p = begin_write (typename details::snapshots ());
                 d->locked (p);
             } catch (...) {
+                // Discard the copy made for shared_state_rcu
+                if (details::snapshots::value)
+                    delete p;
                 p = 0;
                 l->unlock ();
                 throw;
             }
+
+            if (shared_state_profiler::is_enabled ())
+                profile = shared_state_profiler::acquired (typeid(element_type), wait_begin);
         }
 
         void unlock() {
             if (p)
-            {
-                T* q = p;
-                p = 0;
-                l->unlock ();
-                d->unlocked (q);
-            }
+                unlock (typename details::snapshots ());
         }
 
         void swap(write_ptr& b) {
             std::swap(l, b.l);
             std::swap(d, b.d);
             std::swap(p, b.p);
+            std::swap(profile, b.profile);
         }
 
     private:
@@ -482,14 +584,56 @@ public:
                 p (0)
         {
             if (l->try_lock ()) {
-                p = d->p;
+                p = begin_write (typename details::snapshots ());
                 d->locked (p);
+
+                if (shared_state_profiler::is_enabled ())
+                    profile = shared_state_profiler::acquired (typeid(element_type), 0);
+            }
+        }
+
+        T* begin_write(std::false_type) {
+            return d->p;
+        }
+
+        void unlock(std::false_type) {
+            T* q = p;
+            p = 0;
+            l->unlock ();
+            if (profile.c)
+            {
+                shared_state_profiler::released (profile);
+                profile.c = 0;
+            }
+            d->unlocked (q);
+        }
+
+        // A shared_state_rcu writer modifies a copy that is published when
+        // unlocked, see shared_state_rcu.h
+        T* begin_write(std::true_type) {
+            return d->copy (*d->p.load ());
+        }
+
+        void unlock(std::true_type) {
+            T* q = p;
+            p = 0;
+            T* previous = d->p.exchange (q);
+            l->retire (previous, [](void* v) { delete static_cast<T*>(v); }, d->timeout ());
+
+            // 'q' may be replaced and deleted by the next writer
+            d->unlocked (q);
+            l->unlock ();
+            if (profile.c)
+            {
+                shared_state_profiler::released (profile);
+                profile.c = 0;
             }
         }
 
         typename details::shared_state_mutex* l;
         std::shared_ptr<details> d;
         T* p;
+        shared_state_profiler::sample profile;
     };
 
 
@@ -528,7 +672,7 @@ public:
      * responsible for using other synchornization mechanisms, consider using
      * read() or write() instead.
      */
-    T* raw() const { return d ? d->p : nullptr; }
+    T* raw() const { if (!d) return nullptr; return d->p; }
 
     /**
      * @brief traits provides unprotected access to the instance of
@@ -0,0 +1,445 @@
+#include "shared_state_profiler.h"
+#include "demangle.h"
+#include "tasktimer.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <boost/format.hpp>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#pragma intrinsic(_ReturnAddress)
+#define SHARED_STATE_RETURN_ADDRESS() _ReturnAddress()
+#define SHARED_STATE_NOINLINE __declspec(noinline)
+#elif defined(__GNUC__) || defined(__clang__)
+#include <execinfo.h>
+#include <stdlib.h>
+#define SHARED_STATE_RETURN_ADDRESS() __builtin_return_address(0)
+#define SHARED_STATE_NOINLINE __attribute__((noinline))
+#else
+#define SHARED_STATE_RETURN_ADDRESS() ((void*)0)
+#define SHARED_STATE_NOINLINE
+#endif
+
+using namespace std;
+
+namespace {
+
+/**
+ * Counters are kept in a fixed size open addressing hash table keyed on type
+ * and call site. A slot is claimed with a compare-and-swap on 'state' and
+ * never released, so lookups and updates don't need locks.
+ */
+struct site_entry
+{
+    enum { empty, claimed, ready };
+
+    std::atomic<int> state;
+    const std::type_info* type;
+    const void* site;
+    shared_state_profiler::counters c;
+};
+
+const unsigned site_table_size = 1<<12;
+const unsigned site_table_mask = site_table_size-1;
+
+// Zero initialized as it has static storage duration
+site_entry site_table[site_table_size];
+
+// Used when the table is full
+shared_state_profiler::counters site_overflow;
+
+
+shared_state_profiler::counters* find_counters(const std::type_info& type, const void* site)
+{
+    size_t h = type.hash_code () ^ ((size_t)site * 2654435761u);
+
+    for (unsigned i=0; i<site_table_size; i++)
+    {
+        site_entry& e = site_table[(h + i) & site_table_mask];
+        int s = e.state.load (memory_order_acquire);
+
+        if (s == site_entry::empty)
+        {
+            if (e.state.compare_exchange_strong (s, site_entry::claimed, memory_order_acq_rel))
+            {
+                e.type = &type;
+                e.site = site;
+                e.state.store (site_entry::ready, memory_order_release);
+                return &e.c;
+            }
+        }
+
+        // Another thread is writing the key of this slot
+        while (s == site_entry::claimed)
+            s = e.state.load (memory_order_acquire);
+
+        if (e.site == site && *e.type == type)
+            return &e.c;
+    }
+
+    return &site_overflow;
+}
+
+
+string site_name(const void* site)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    void* frames[1] = {const_cast<void*>(site)};
+    char** msg = backtrace_symbols(frames, 1);
+    if (msg)
+    {
+        string s = msg[0];
+        free(msg);
+
+#ifdef __APPLE__
+        // "0   binary   0x0000000100001234 _ZN3FooC1Ev + 26"
+        istringstream ss(s);
+        string index, binary, address, name;
+        ss >> index >> binary >> address >> name;
+#else
+        // "binary(_ZN3FooC1Ev+0x1a) [0x4005f4]"
+        size_t n1 = s.find_last_of ('(');
+        size_t n2 = s.find_last_of ('+');
+        string name = n1 != string::npos && n2 != string::npos && n1 < n2
+                ? s.substr (n1+1, n2-n1-1) : "";
+#endif
+        if (!name.empty ())
+            return demangle (name.c_str ());
+        return s;
+    }
+#endif
+
+    return str(boost::format("%p") % site);
+}
+
+
+void add(shared_state_profiler::profile& p, const shared_state_profiler::counters& c, double seconds_per_tick)
+{
+    p.acquisitions += c.acquisitions.load (memory_order_relaxed);
+    p.contended += c.contended.load (memory_order_relaxed);
+    p.timeouts += c.timeouts.load (memory_order_relaxed);
+    p.wait += c.wait_ticks.load (memory_order_relaxed) * seconds_per_tick;
+    p.hold += c.hold_ticks.load (memory_order_relaxed) * seconds_per_tick;
+    p.max_wait = max(p.max_wait, c.max_wait_ticks.load (memory_order_relaxed) * seconds_per_tick);
+    p.max_hold = max(p.max_hold, c.max_hold_ticks.load (memory_order_relaxed) * seconds_per_tick);
+}
+
+
+void clear(shared_state_profiler::counters& c)
+{
+    c.acquisitions.store (0, memory_order_relaxed);
+    c.contended.store (0, memory_order_relaxed);
+    c.timeouts.store (0, memory_order_relaxed);
+    c.wait_ticks.store (0, memory_order_relaxed);
+    c.hold_ticks.store (0, memory_order_relaxed);
+    c.max_wait_ticks.store (0, memory_order_relaxed);
+    c.max_hold_ticks.store (0, memory_order_relaxed);
+}
+
+
+class periodic_report
+{
+public:
+    ~periodic_report()
+    {
+        set_period (0);
+    }
+
+    void set_period(double period)
+    {
+        {
+            unique_lock<mutex> l(m_);
+            generation_++;
+        }
+        cv_.notify_all ();
+
+        if (t_.joinable ())
+            t_.join ();
+
+        if (period > 0)
+            t_ = thread([this, period]() { run (period); });
+    }
+
+private:
+    void run(double period)
+    {
+        unique_lock<mutex> l(m_);
+        int generation = generation_;
+
+        while (true)
+        {
+            auto stopped = [&]() { return generation != generation_; };
+            if (cv_.wait_for (l, chrono::duration<double>(period), stopped))
+                return;
+
+            l.unlock ();
+            stringstream ss;
+            shared_state_profiler::report (ss);
+            TaskInfo(boost::format("%s") % ss.str ());
+            l.lock ();
+        }
+    }
+
+    mutex m_;
+    condition_variable cv_;
+    int generation_ = 0;
+    thread t_;
+};
+
+} // namespace
+
+
+std::atomic<bool> shared_state_profiler::enabled_ {false};
+
+
+SHARED_STATE_NOINLINE
+shared_state_profiler::sample shared_state_profiler::
+        acquired(const std::type_info& type, unsigned long long wait_begin)
+{
+    sample s;
+    s.locked = trace_scope::ticks ();
+    s.c = find_counters (type, SHARED_STATE_RETURN_ADDRESS());
+
+    s.c->acquisitions.fetch_add (1, memory_order_relaxed);
+    if (wait_begin)
+    {
+        unsigned long long d = s.locked - wait_begin;
+        s.c->contended.fetch_add (1, memory_order_relaxed);
+        s.c->wait_ticks.fetch_add (d, memory_order_relaxed);
+        update_max (s.c->max_wait_ticks, d);
+    }
+
+    return s;
+}
+
+
+SHARED_STATE_NOINLINE
+void shared_state_profiler::
+        timed_out(const std::type_info& type, unsigned long long wait_begin)
+{
+    counters* c = find_counters (type, SHARED_STATE_RETURN_ADDRESS());
+    unsigned long long d = trace_scope::ticks () - wait_begin;
+
+    c->timeouts.fetch_add (1, memory_order_relaxed);
+    c->contended.fetch_add (1, memory_order_relaxed);
+    c->wait_ticks.fetch_add (d, memory_order_relaxed);
+    update_max (c->max_wait_ticks, d);
+}
+
+
+std::vector<shared_state_profiler::profile> shared_state_profiler::
+        snapshot(bool per_site)
+{
+    double seconds_per_tick = trace_scope::seconds_per_tick ();
+    map<pair<string,string>, profile> profiles;
+
+    for (site_entry& e : site_table)
+    {
+        if (e.state.load (memory_order_acquire) != site_entry::ready)
+            continue;
+
+        string type = demangle (*e.type);
+        string site = per_site ? site_name (e.site) : "";
+        profile& p = profiles[make_pair(type, site)];
+        p.type = type;
+        p.site = site;
+        add (p, e.c, seconds_per_tick);
+    }
+
+    if (site_overflow.acquisitions.load (memory_order_relaxed))
+    {
+        profile& p = profiles[make_pair(string("(overflow)"), string())];
+        p.type = "(overflow)";
+        add (p, site_overflow, seconds_per_tick);
+    }
+
+    vector<profile> r;
+    for (auto& v : profiles)
+        if (v.second.acquisitions || v.second.timeouts)
+            r.push_back (v.second);
+
+    sort(r.begin (), r.end (), [](const profile& a, const profile& b) { return a.wait > b.wait; });
+    return r;
+}
+
+
+void shared_state_profiler::
+        report(std::ostream& o, int max_sites)
+{
+    vector<profile> types = snapshot (false);
+    vector<profile> sites = snapshot (true);
+
+    o << "shared_state lock contention" << endl;
+    o << setw(12) << "acquired" << setw(12) << "contended" << setw(10) << "timeouts"
+      << setw(12) << "wait" << setw(12) << "max wait"
+      << setw(12) << "hold" << setw(12) << "max hold" << "  type" << endl;
+
+    auto row = [&o](const profile& p, const string& name)
+    {
+        o << setw(12) << p.acquisitions << setw(12) << p.contended << setw(10) << p.timeouts
+          << setw(12) << TaskTimer::timeToString (p.wait)
+          << setw(12) << TaskTimer::timeToString (p.max_wait)
+          << setw(12) << TaskTimer::timeToString (p.hold)
+          << setw(12) << TaskTimer::timeToString (p.max_hold)
+          << "  " << name << endl;
+    };
+
+    for (const profile& p : types)
+        row (p, p.type);
+
+    if (max_sites > 0 && !sites.empty ())
+    {
+        o << "Call sites with the longest wait" << endl;
+        for (int i=0; i<max_sites && i<(int)sites.size (); i++)
+            row (sites[i], sites[i].type + " in " + sites[i].site);
+    }
+}
+
+
+void shared_state_profiler::
+        report_every(double period)
+{
+    static periodic_report r;
+    r.set_period (period);
+}
+
+
+void shared_state_profiler::
+        reset()
+{
+    for (site_entry& e : site_table)
+        clear (e.c);
+    clear (site_overflow);
+}
+
+
+#include "shared_state.h"
+#include "exceptionassert.h"
+#include "trace_perf.h"
+#include "barrier.h"
+
+#include <future>
+
+namespace shared_state_profiler_test {
+
+class A {
+public:
+    int a = 0;
+};
+
+class B {
+public:
+    int b = 0;
+};
+
+} // namespace shared_state_profiler_test
+
+using namespace shared_state_profiler_test;
+
+void shared_state_profiler::
+        test()
+{
+    bool was_enabled = is_enabled ();
+
+    auto find = [](const vector<profile>& v, string type) -> profile {
+        for (const profile& p : v)
+            if (p.type == type)
+                return p;
+        return profile{type, "", 0, 0, 0, 0, 0, 0, 0};
+    };
+
+    // It should not record anything while disabled.
+    {
+        enable (false);
+        reset ();
+        shared_state<A> a{new A};
+        a.write ()->a++;
+        a.read ();
+        EXCEPTION_ASSERT_EQUALS(find(snapshot (), "shared_state_profiler_test::A").acquisitions, 0u);
+    }
+
+    // It should count acquisitions, contention, wait time and hold time per type.
+    {
+        enable (true);
+        reset ();
+        shared_state<A> a{new A};
+        shared_state<B> b{new B};
+        spinning_barrier barrier(2);
+
+        future<void> f = async(launch::async, [&]() {
+            auto w = a.write ();
+            barrier.wait ();
+            this_thread::sleep_for (chrono::milliseconds(10));
+        });
+
+        barrier.wait ();
+        a.write ()->a++;
+        f.get ();
+        b.read ();
+
+        profile pa = find(snapshot (), "shared_state_profiler_test::A");
+        EXCEPTION_ASSERT_EQUALS(pa.acquisitions, 2u);
+        EXCEPTION_ASSERT_EQUALS(pa.contended, 1u);
+        EXCEPTION_ASSERT_EQUALS(pa.timeouts, 0u);
+        EXCEPTION_ASSERT_LESS(0.005, pa.wait);
+        EXCEPTION_ASSERT_LESS(0.005, pa.hold);
+        EXCEPTION_ASSERT_LESS_OR_EQUAL(pa.max_wait, pa.wait);
+
+        vector<profile> types = snapshot ();
+        profile pb = find(types, "shared_state_profiler_test::B");
+        EXCEPTION_ASSERT_EQUALS(pb.acquisitions, 1u);
+        EXCEPTION_ASSERT_EQUALS(pb.contended, 0u);
+
+        // The type with the longest wait comes first
+        EXCEPTION_ASSERT_EQUALS(types.front ().type, "shared_state_profiler_test::A");
+    }
+
+    // It should separate call sites of the same type.
+    {
+        vector<profile> sites = snapshot (true);
+        unsigned long long n = 0;
+        for (const profile& p : sites)
+            if (p.type == "shared_state_profiler_test::A")
+            {
+                EXCEPTION_ASSERT(!p.site.empty ());
+                n += p.acquisitions;
+            }
+        EXCEPTION_ASSERT_EQUALS(n, 2u);
+
+        stringstream ss;
+        report (ss);
+        EXCEPTION_ASSERT(string::npos != ss.str ().find ("shared_state_profiler_test::A"));
+    }
+
+    // It should cause a low overhead.
+    {
+        shared_state<A> a{new A};
+        int N = 10000;
+
+        enable (true);
+        TRACE_PERF("it should cause a low overhead when enabled 10000");
+        for (int i=0; i<N; i++)
+        {
+            a.write ();
+            a.read ();
+        }
+
+        enable (false);
+        trace_perf_.reset ("it should cause a lower overhead when disabled 10000");
+        for (int i=0; i<N; i++)
+        {
+            a.write ();
+            a.read ();
+        }
+    }
+
+    reset ();
+    enable (was_enabled);
+}
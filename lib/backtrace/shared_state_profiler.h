@@ -0,0 +1,135 @@
+#ifndef SHARED_STATE_PROFILER_H
+#define SHARED_STATE_PROFILER_H
+
+#include "trace_scope.h"
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+/**
+ * @brief The shared_state_profiler class should find the shared_state
+ * instances that throttle throughput by measuring lock contention per type
+ * and per call site.
+ *
+ * Example:
+ *    shared_state_profiler::enable (true);
+ *    shared_state_profiler::report_every (10); // log the worst locks every 10 s
+ *    ...
+ *    for (auto& p : shared_state_profiler::snapshot ())
+ *        if (p.wait > 1) ...
+ *
+ * Profiling is disabled by default. A disabled profiler costs a relaxed
+ * atomic load per lock and unlock.
+ *
+ * While enabled, read_ptr and write_ptr record the number of acquisitions,
+ * how many of them had to wait, the time spent waiting, the time the lock
+ * was held and the number of timeouts. Samples are added to atomic counters,
+ * no locks are taken to record a sample.
+ *
+ * A call site is identified by the return address of the lock attempt, which
+ * is in the function that called read() or write() in optimized builds where
+ * shared_state is inlined. In unoptimized builds all call sites of a type may
+ * resolve to shared_state itself. Call sites are resolved to symbol names
+ * when a snapshot is taken.
+ */
+class shared_state_profiler
+{
+public:
+    struct counters
+    {
+        std::atomic<unsigned long long> acquisitions;
+        std::atomic<unsigned long long> contended;
+        std::atomic<unsigned long long> timeouts;
+        std::atomic<unsigned long long> wait_ticks;
+        std::atomic<unsigned long long> hold_ticks;
+        std::atomic<unsigned long long> max_wait_ticks;
+        std::atomic<unsigned long long> max_hold_ticks;
+    };
+
+    /**
+     * @brief The sample struct is kept by a read_ptr or write_ptr while the
+     * lock is held.
+     */
+    struct sample
+    {
+        sample() : c(0), locked(0) {}
+
+        counters* c;
+        unsigned long long locked;
+    };
+
+    /**
+     * @brief The profile struct is a snapshot of the counters of a type, or of
+     * a type at a call site. Times are in seconds.
+     */
+    struct profile
+    {
+        std::string type;
+        std::string site; // empty if aggregated per type
+        unsigned long long acquisitions;
+        unsigned long long contended;
+        unsigned long long timeouts;
+        double wait;
+        double hold;
+        double max_wait;
+        double max_hold;
+    };
+
+    static void enable(bool v) { enabled_.store (v, std::memory_order_relaxed); }
+    static bool is_enabled() { return enabled_.load (std::memory_order_relaxed); }
+
+    /**
+     * @brief snapshot returns profiles sorted by the total time spent waiting,
+     * largest first. Counters are read without blocking the threads that
+     * update them.
+     */
+    static std::vector<profile> snapshot(bool per_site=false);
+
+    /**
+     * @brief report writes the profiles per type followed by the 'max_sites'
+     * call sites with the longest total wait.
+     */
+    static void report(std::ostream& o, int max_sites=10);
+
+    /**
+     * @brief report_every logs a report with TaskInfo every 'period' seconds
+     * from a background thread. A period <= 0 stops the reports.
+     */
+    static void report_every(double period);
+
+    /**
+     * @brief reset sets all counters to zero.
+     */
+    static void reset();
+
+    // Used by shared_state. 'wait_begin' is 0 if the lock was readily
+    // available.
+    static unsigned long long wait_begin() { return is_enabled () ? trace_scope::ticks () : 0; }
+    static sample acquired(const std::type_info& type, unsigned long long wait_begin);
+    static void timed_out(const std::type_info& type, unsigned long long wait_begin);
+
+    static void released(const sample& s)
+    {
+        unsigned long long d = trace_scope::ticks () - s.locked;
+        s.c->hold_ticks.fetch_add (d, std::memory_order_relaxed);
+        update_max (s.c->max_hold_ticks, d);
+    }
+
+    static void update_max(std::atomic<unsigned long long>& m, unsigned long long v)
+    {
+        unsigned long long prev = m.load (std::memory_order_relaxed);
+        while (prev < v && !m.compare_exchange_weak (prev, v, std::memory_order_relaxed))
+        {}
+    }
+
+private:
+    static std::atomic<bool> enabled_;
+
+public:
+    static void test();
+};
+
+#endif // SHARED_STATE_PROFILER_H
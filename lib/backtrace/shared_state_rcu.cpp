@@ -0,0 +1,258 @@
+#include "shared_state_rcu.h"
+
+#include <chrono>
+#include <thread>
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define SHARED_STATE_RCU_THREAD_LOCAL __declspec(thread)
+#else
+#define SHARED_STATE_RCU_THREAD_LOCAL thread_local
+#endif
+
+using namespace std;
+
+shared_state_rcu::
+        shared_state_rcu()
+    :
+      epoch_(0)
+{
+    for (counter& c : readers_)
+        c.n.store (0, memory_order_relaxed);
+}
+
+
+shared_state_rcu::
+        ~shared_state_rcu()
+{
+    // There are no readers left when the shared_state is destroyed
+    for (auto& r : retired_)
+        r.second (r.first);
+}
+
+
+unsigned shared_state_rcu::
+        stripe()
+{
+    static atomic<unsigned> next_stripe {0};
+    static SHARED_STATE_RCU_THREAD_LOCAL unsigned this_thread_stripe = ~0u;
+
+    if (this_thread_stripe == ~0u)
+        this_thread_stripe = next_stripe++ % stripes;
+    return this_thread_stripe;
+}
+
+
+void shared_state_rcu::
+        retire(void* old, void (*del)(void*), double timeout)
+{
+    retired_.push_back (make_pair(old, del));
+
+    if (!synchronize (timeout))
+        return;
+
+    for (auto& r : retired_)
+        r.second (r.first);
+    retired_.clear ();
+}
+
+
+bool shared_state_rcu::
+        synchronize(double timeout)
+{
+    auto deadline = chrono::steady_clock::now () + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>{timeout});
+
+    // A reader may have read the epoch before a flip and incremented the
+    // counter of the old parity after the writer found it to be zero. Such a
+    // reader got the new version, but it must not be mistaken for a reader of
+    // the current parity at the next write. Waiting for both parities, one at
+    // a time, covers it while new readers move on to the other parity.
+    for (int i=0; i<2; i++)
+    {
+        unsigned parity = epoch_.fetch_add (1) & 1;
+
+        while (has_readers (parity))
+        {
+            if (0 <= timeout && deadline < chrono::steady_clock::now ())
+                return false;
+
+            this_thread::yield ();
+        }
+    }
+
+    return true;
+}
+
+
+bool shared_state_rcu::
+        has_readers(unsigned parity) const
+{
+    for (unsigned s=0; s<stripes; s++)
+        if (0 != readers_[2*s + parity].n.load ())
+            return true;
+    return false;
+}
+
+
+#include "shared_state.h"
+#include "exceptionassert.h"
+#include "trace_perf.h"
+
+#include <future>
+
+namespace shared_state_rcu_test {
+
+struct Version
+{
+    static atomic<int> instances;
+
+    Version() : a(0), b(0) { instances++; }
+    Version(const Version& v) : a(v.a), b(v.b) { instances++; }
+    ~Version() { instances--; }
+
+    int a, b;
+};
+
+atomic<int> Version::instances {0};
+
+
+struct Settings
+{
+    struct shared_state_traits: shared_state_traits_default {
+        double timeout() { return 0.010; }
+        typedef shared_state_rcu shared_state_mutex;
+    };
+
+    int a = 0, b = 0;
+};
+
+
+struct SettingsMutex
+{
+    int a = 0, b = 0;
+};
+
+} // namespace shared_state_rcu_test
+
+using namespace shared_state_rcu_test;
+
+template<>
+struct shared_state_traits<Version>: shared_state_traits_default {
+    double timeout() { return 0.010; }
+    typedef shared_state_rcu shared_state_mutex;
+};
+
+
+/**
+ * Returns the number of inconsistent versions seen by 'n' readers that each
+ * read 'reads' times while another thread keeps writing.
+ */
+template<class T>
+static int read_while_writing(shared_state<T> s, int n, int reads)
+{
+    atomic<bool> done {false};
+    atomic<int> inconsistent {0};
+
+    future<void> writer = async(launch::async, [&]()
+    {
+        for (int i=1; !done; i++)
+        {
+            {
+                auto w = s.write ();
+                w->a = i;
+                w->b = i;
+            }
+            this_thread::yield ();
+        }
+    });
+
+    vector<future<void>> readers(n);
+    for (auto& r : readers)
+        r = async(launch::async, [&]()
+        {
+            for (int j=0; j<reads; j++)
+            {
+                auto v = s.read ();
+                if (v->a != v->b)
+                    inconsistent++;
+            }
+        });
+
+    for (auto& r : readers)
+        r.get ();
+
+    done = true;
+    writer.get ();
+
+    return inconsistent;
+}
+
+
+void shared_state_rcu::
+        test()
+{
+    // It should let readers keep their version while a new version is published.
+    {
+        shared_state<Version> s {new Version};
+        EXCEPTION_ASSERT_EQUALS(Version::instances.load (), 1);
+
+        auto r = s.read ();
+        {
+            auto w = s.write ();
+            w->a = 1;
+
+            // A writer gets a copy of the current version
+            EXCEPTION_ASSERT_EQUALS(Version::instances.load (), 2);
+            EXCEPTION_ASSERT_EQUALS(r->a, 0);
+            EXCEPTION_ASSERT_EQUALS(s.read ()->a, 0);
+            EXCEPTION_ASSERT(s.try_read ());
+        }
+
+        EXCEPTION_ASSERT_EQUALS(r->a, 0);
+        EXCEPTION_ASSERT_EQUALS(s.read ()->a, 1);
+
+        // 'r' is still alive so the previous version is kept after the
+        // grace period timed out
+        EXCEPTION_ASSERT_EQUALS(Version::instances.load (), 2);
+
+        r.unlock ();
+        s.write ()->a = 2;
+
+        // Both previous versions are deleted after the next grace period
+        EXCEPTION_ASSERT_EQUALS(Version::instances.load (), 1);
+        EXCEPTION_ASSERT_EQUALS(s.read ()->a, 2);
+    }
+
+    // It should delete all versions with the shared_state.
+    EXCEPTION_ASSERT_EQUALS(Version::instances.load (), 0);
+
+    // It should never let a reader see a partially written state.
+    {
+        shared_state<Settings> s {new Settings};
+        EXCEPTION_ASSERT_EQUALS(read_while_writing (s, 4, 20000), 0);
+    }
+
+    // It should give readers a higher throughput than a shared mutex while
+    // another thread is writing.
+    {
+        shared_state<Settings> rcu {new Settings};
+        shared_state<SettingsMutex> mutex {new SettingsMutex};
+
+        TRACE_PERF("shared_state_rcu should read 4x100000 times with a concurrent writer");
+        read_while_writing (rcu, 4, 100000);
+
+        trace_perf_.reset ("shared_state_mutex should read 4x100000 times with a concurrent writer");
+        read_while_writing (mutex, 4, 100000);
+    }
+
+    // It should cause a low overhead for uncontended reads.
+    {
+        shared_state<Settings> s {new Settings};
+        int sum = 0;
+
+        TRACE_PERF("shared_state_rcu should cause a low read overhead 100000");
+        for (int i=0; i<100000; i++)
+            sum += s.read ()->a;
+
+        EXCEPTION_ASSERT_EQUALS(sum, 0);
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef SHARED_STATE_RCU_H
+#define SHARED_STATE_RCU_H
+
+#include "shared_state_mutex.h"
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The shared_state_rcu class can be used as shared_state_mutex for
+ * read-mostly types. Readers get an immutable snapshot without taking any
+ * lock and writers copy, modify and publish a new version (read-copy-update).
+ *
+ * Example:
+ *    struct shared_state_traits: shared_state_traits_default {
+ *        typedef shared_state_rcu shared_state_mutex;
+ *    };
+ *
+ * read() and try_read() never wait, not even for a writer. They return the
+ * most recently published version and the version remains valid for as long
+ * as the read_ptr is alive.
+ *
+ * write() is mutually exclusive with other writers and returns a copy of the
+ * current version. The copy is published when the write_ptr is released.
+ * Readers never observe a partially written state. A thread that reads while
+ * it holds a write_ptr sees the previous version. Copies are made with
+ * shared_state_traits::copy, override it for polymorphic types.
+ *
+ * Releasing a write_ptr waits for the readers of the previous version to
+ * finish before the previous version is deleted (a grace period). If they
+ * don't finish within timeout() the previous version is kept and deleted
+ * after a later write instead.
+ *
+ * Note that the implicit -> operator is a write(), use read() explicitly to
+ * avoid a copy.
+ *
+ * A read costs two atomic additions on a counter that is shared with few
+ * other threads. A write costs a copy of the state and two grace periods.
+ */
+class shared_state_rcu
+{
+public:
+    shared_state_rcu();
+    ~shared_state_rcu();
+
+    shared_state_rcu(const shared_state_rcu&) = delete;
+    shared_state_rcu& operator=(const shared_state_rcu&) = delete;
+
+    // Writers are mutually exclusive
+    void lock() { writer_.lock (); }
+    bool try_lock() { return writer_.try_lock (); }
+    void unlock() { writer_.unlock (); }
+
+    template <class Rep, class Period>
+    bool try_lock_for(const shared_state_chrono::duration<Rep, Period>& rel_time) { return writer_.try_lock_for (rel_time); }
+
+    /**
+     * @brief read_lock marks the beginning of a read. The returned token is
+     * passed to read_unlock.
+     */
+    unsigned read_lock()
+    {
+        unsigned token = 2*stripe () + (epoch_.load () & 1);
+        readers_[token].n.fetch_add (1);
+        return token;
+    }
+
+    void read_unlock(unsigned token)
+    {
+        readers_[token].n.fetch_sub (1, std::memory_order_release);
+    }
+
+    /**
+     * @brief retire deletes 'old' with 'del' when no reader can refer to it
+     * anymore. The previous version must already have been replaced and the
+     * caller must hold the writer lock. Waits at most 'timeout' seconds, or
+     * indefinitely if 'timeout < 0', before the deletion is postponed to the
+     * next call.
+     */
+    void retire(void* old, void (*del)(void*), double timeout);
+
+private:
+    static const unsigned stripes = 8;
+
+    // Readers are spread over stripes by thread to reduce cache line sharing
+    static unsigned stripe();
+
+    bool synchronize(double timeout);
+    bool has_readers(unsigned parity) const;
+
+    struct counter
+    {
+        std::atomic<int> n;
+        char padding[64 - sizeof(std::atomic<int>)];
+    };
+
+    shared_state_mutex_noshared writer_;
+    std::atomic<unsigned> epoch_;
+    counter readers_[2*stripes];
+    std::vector<std::pair<void*, void (*)(void*)>> retired_;
+
+public:
+    static void test();
+};
+
+#endif // SHARED_STATE_RCU_H
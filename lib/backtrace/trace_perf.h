@@ -21,6 +21,10 @@
  *
  * The results stored in a complementary database file regardless of failure
  * or success when the process quits.
+ *
+ * trace_perf/benchmark_history.py runs a unit test repeatedly, records the
+ * median and 95th percentile of each scope per commit and reports
+ * statistically significant regressions.
  */
 class trace_perf
 {
@@ -0,0 +1,235 @@
+#!/usr/bin/env python
+"""
+Runs a unit test binary repeatedly and records the median and 95th
+percentile of each TRACE_PERF scope in a history file, one record per commit
+and host. The samples are compared against the most recent record from
+another commit on the same host and significant regressions are reported.
+
+A scope is considered to have regressed if a one-sided Mann-Whitney U test
+rejects that the new samples are not slower at level --alpha, and the median
+increased by more than --min-change. Single runs are too noisy to compare
+against a fixed threshold, the trace_perf/*.db thresholds remain as a coarse
+sanity check.
+
+Run from the directory where the unit test writes trace_perf/dump, e.g:
+
+  cd src && ../lib/backtrace/trace_perf/benchmark_history.py -n 20 ./sonicawe --test
+
+Or summarize dumps from previous runs without running anything:
+
+  ../lib/backtrace/trace_perf/benchmark_history.py
+
+Exits with status 1 if a regression was detected.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import math
+import os
+import shutil
+import socket
+import subprocess
+import sys
+import time
+
+
+def read_dump_file(dumpfile):
+    """ Dump files have three lines per entry: info, elapsed and an empty line """
+    with open(dumpfile, 'r') as f:
+        lines = [line.rstrip('\n') for line in f]
+
+    db = {}
+    for i in range(0, len(lines) - 1, 3):
+        try:
+            db[lines[i]] = float(lines[i+1])
+        except ValueError:
+            pass
+    return db
+
+
+def read_dumps(path):
+    """ Returns {'source.cpp: info': [elapsed, ...]} from all dumps in 'path' """
+    samples = {}
+    if not os.path.isdir(path):
+        return samples
+
+    for f in sorted(os.listdir(path)):
+        i = f.find('.db')
+        if i < 0:
+            continue
+
+        source = f[0:i]
+        for info, elapsed in read_dump_file(os.path.join(path, f)).items():
+            samples.setdefault('%s: %s' % (source, info), []).append(elapsed)
+
+    return samples
+
+
+def percentile(v, p):
+    """ Linear interpolation between closest ranks """
+    v = sorted(v)
+    if not v:
+        return float('nan')
+    k = (len(v) - 1) * p
+    f = int(math.floor(k))
+    c = min(f + 1, len(v) - 1)
+    return v[f] + (v[c] - v[f]) * (k - f)
+
+
+def mann_whitney_greater(a, b):
+    """
+    One-sided Mann-Whitney U test using the normal approximation with tie and
+    continuity correction. Returns the p-value for the hypothesis that
+    samples in 'a' tend to be larger than samples in 'b'.
+    """
+    n1, n2 = len(a), len(b)
+    if n1 == 0 or n2 == 0:
+        return 1.0
+
+    values = sorted([(x, 0) for x in a] + [(x, 1) for x in b])
+    ranks = [0.0] * len(values)
+    ties = 0.0
+    i = 0
+    while i < len(values):
+        j = i
+        while j + 1 < len(values) and values[j + 1][0] == values[i][0]:
+            j += 1
+        for k in range(i, j + 1):
+            ranks[k] = (i + j) / 2.0 + 1
+        t = j - i + 1
+        ties += t**3 - t
+        i = j + 1
+
+    r1 = sum(r for r, (x, g) in zip(ranks, values) if g == 0)
+    u1 = r1 - n1 * (n1 + 1) / 2.0
+
+    n = n1 + n2
+    mu = n1 * n2 / 2.0
+    sigma2 = n1 * n2 / 12.0 * ((n + 1) - ties / (n * (n - 1))) if n > 1 else 0
+    if sigma2 <= 0:
+        return 1.0
+
+    z = (u1 - mu - 0.5) / math.sqrt(sigma2)
+    return 0.5 * math.erfc(z / math.sqrt(2))
+
+
+def git_commit():
+    with open(os.devnull, 'w') as devnull:
+        try:
+            commit = subprocess.check_output(['git', 'rev-parse', 'HEAD'], stderr=devnull).decode().strip()
+        except (OSError, subprocess.CalledProcessError):
+            return 'unknown'
+
+        if subprocess.call(['git', 'diff', '--quiet', 'HEAD'], stderr=devnull) != 0:
+            commit += '-dirty'
+    return commit
+
+
+def read_history(filename):
+    history = []
+    if not os.path.exists(filename):
+        return history
+
+    with open(filename, 'r') as f:
+        for line in f:
+            line = line.strip()
+            if line:
+                history.append(json.loads(line))
+    return history
+
+
+def run(command, runs, dumppath):
+    if os.path.isdir(dumppath):
+        shutil.rmtree(dumppath)
+
+    for i in range(runs):
+        print('Run %d/%d: %s' % (i + 1, runs, ' '.join(command)), file=sys.stderr)
+        with open(os.devnull, 'w') as devnull:
+            r = subprocess.call(command, stdout=devnull)
+        if r != 0:
+            print('%s failed with exit code %d' % (command[0], r), file=sys.stderr)
+            sys.exit(r)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().split('\n\n')[0],
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('-n', '--runs', type=int, default=20,
+                        help='number of times to run the command (default: 20)')
+    parser.add_argument('--dump', default=os.path.join('trace_perf', 'dump'),
+                        help='folder with trace_perf dumps (default: trace_perf/dump)')
+    parser.add_argument('--history', default=os.path.join('trace_perf', 'history.jsonl'),
+                        help='history file (default: trace_perf/history.jsonl)')
+    parser.add_argument('--alpha', type=float, default=0.01,
+                        help='significance level (default: 0.01)')
+    parser.add_argument('--min-change', type=float, default=0.05,
+                        help='smallest relative change of the median to report (default: 0.05)')
+    parser.add_argument('--no-record', action='store_true',
+                        help='compare without appending to the history file')
+    parser.add_argument('command', nargs=argparse.REMAINDER,
+                        help='unit test command, omit to only read existing dumps')
+    args = parser.parse_args()
+
+    if args.command:
+        run(args.command, args.runs, args.dump)
+
+    samples = read_dumps(args.dump)
+    if not samples:
+        print('No trace_perf dumps found in %s' % args.dump, file=sys.stderr)
+        return 2
+
+    record = {
+        'commit': git_commit(),
+        'host': socket.gethostname(),
+        'time': int(time.time()),
+        'scopes': dict((name, {'median': percentile(v, 0.5),
+                               'p95': percentile(v, 0.95),
+                               'samples': v})
+                       for name, v in samples.items()),
+    }
+
+    history = read_history(args.history)
+    previous = None
+    for h in reversed(history):
+        if h['host'] == record['host'] and h['commit'] != record['commit']:
+            previous = h
+            break
+
+    regressions = 0
+    print('%-80s %10s %10s %9s %8s' % ('scope', 'median', 'p95', 'change', 'p'))
+    for name in sorted(record['scopes']):
+        s = record['scopes'][name]
+        change, p, flag = '', '', ''
+        if previous and name in previous['scopes']:
+            prev = previous['scopes'][name]
+            ratio = s['median'] / prev['median'] if prev['median'] > 0 else float('inf')
+            pvalue = mann_whitney_greater(s['samples'], prev['samples'])
+            change = '%+8.1f%%' % ((ratio - 1) * 100)
+            p = '%8.4f' % pvalue
+            if pvalue < args.alpha and ratio > 1 + args.min_change:
+                flag = '  REGRESSION'
+                regressions += 1
+        print('%-80s %10.3g %10.3g %9s %8s%s' % (name[:80], s['median'], s['p95'], change, p, flag))
+
+    if previous:
+        print('\nCompared %s against %s' % (record['commit'], previous['commit']))
+    else:
+        print('\nNo previous commit from %s in %s' % (record['host'], args.history))
+
+    if not args.no_record:
+        folder = os.path.dirname(args.history)
+        if folder and not os.path.isdir(folder):
+            os.makedirs(folder)
+        with open(args.history, 'a') as f:
+            f.write(json.dumps(record, sort_keys=True) + '\n')
+
+    if regressions:
+        print('%d scope(s) regressed' % regressions, file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
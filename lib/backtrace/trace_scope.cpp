@@ -0,0 +1,285 @@
+#include "trace_scope.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define TRACE_SCOPE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_SCOPE_THREAD_LOCAL thread_local
+#endif
+
+using namespace std;
+
+namespace {
+
+struct trace_event
+{
+    const char* id;
+    unsigned long long begin;
+    unsigned long long end;
+};
+
+
+/**
+ * Single producer ring buffer. Only the owning thread writes events, 'head'
+ * is published with release semantics so that a reader sees complete events
+ * up to 'head'. A reader that is overtaken by the writer detects it by
+ * reading 'head' again and discards the overwritten events.
+ */
+struct trace_ring
+{
+    static const unsigned capacity = 1<<14;
+    static const unsigned mask = capacity-1;
+
+    explicit trace_ring(int tid) : tid(tid), head(0), tail(0) {}
+
+    const int tid;
+    std::atomic<unsigned long long> head;
+    // Events before 'tail' have been cleared
+    std::atomic<unsigned long long> tail;
+    trace_event events[capacity];
+};
+
+
+class trace_rings
+{
+public:
+    trace_ring* add()
+    {
+        lock_guard<mutex> l(m_);
+        rings_.push_back (unique_ptr<trace_ring>(new trace_ring((int)rings_.size ())));
+        return rings_.back ().get ();
+    }
+
+    template<class F>
+    void for_each(F f)
+    {
+        lock_guard<mutex> l(m_);
+        for (auto& r : rings_)
+            f(*r);
+    }
+
+private:
+    mutex m_;
+    // Rings are never removed, events from finished threads remain available
+    vector<unique_ptr<trace_ring>> rings_;
+};
+
+
+trace_rings& rings()
+{
+    static trace_rings r;
+    return r;
+}
+
+
+TRACE_SCOPE_THREAD_LOCAL trace_ring* this_thread_ring = 0;
+
+
+void write_json_string(ostream& o, const char* s)
+{
+    o << '"';
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            o << '\\';
+        o << *s;
+    }
+    o << '"';
+}
+
+} // namespace
+
+
+std::atomic<bool> trace_scope::enabled_ {false};
+
+
+/**
+ * Relates ticks to the system clock. The first sample is taken at static
+ * initialization and the second when events are dumped.
+ */
+struct tick_calibration
+{
+    tick_calibration()
+        :
+          ticks(trace_scope::ticks ()),
+          time(chrono::steady_clock::now ())
+    {}
+
+    unsigned long long ticks;
+    chrono::steady_clock::time_point time;
+};
+
+static tick_calibration tick_origin;
+
+
+void trace_scope::
+        record(const char* id, unsigned long long begin, unsigned long long end)
+{
+    trace_ring* r = this_thread_ring;
+    if (!r)
+        r = this_thread_ring = rings().add ();
+
+    unsigned long long h = r->head.load (memory_order_relaxed);
+    trace_event& e = r->events[h & trace_ring::mask];
+    e.id = id;
+    e.begin = begin;
+    e.end = end;
+    r->head.store (h+1, memory_order_release);
+}
+
+
+void trace_scope::
+        dump_chrome_json(std::ostream& o)
+{
+    o << "{\"traceEvents\":[";
+    bool first = true;
+
+    double us_per_tick = 1e6 * seconds_per_tick ();
+
+    rings().for_each ([&](trace_ring& r)
+    {
+        unsigned long long h = r.head.load (memory_order_acquire);
+        unsigned long long n = h < trace_ring::capacity ? h : trace_ring::capacity;
+
+        vector<trace_event> events(r.events, r.events + trace_ring::capacity);
+
+        // Discard events that were overwritten while copying
+        unsigned long long h2 = r.head.load (memory_order_acquire);
+        unsigned long long oldest = h2 > trace_ring::capacity ? h2 - trace_ring::capacity + 1 : 0;
+        oldest = std::max(oldest, r.tail.load (memory_order_acquire));
+
+        for (unsigned long long i=h-n; i<h; i++)
+        {
+            if (i < oldest)
+                continue;
+
+            const trace_event& e = events[i & trace_ring::mask];
+            if (!first)
+                o << ",\n";
+            first = false;
+
+            // Chrome trace-event timestamps are in microseconds
+            o << "{\"name\":";
+            write_json_string (o, e.id);
+            o << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << r.tid
+              << ",\"ts\":" << (long long)(e.begin - tick_origin.ticks) * us_per_tick
+              << ",\"dur\":" << (e.end - e.begin) * us_per_tick
+              << "}";
+        }
+    });
+
+    o << "]}" << endl;
+}
+
+
+bool trace_scope::
+        dump_chrome_json(const std::string& filename)
+{
+    ofstream o(filename);
+    if (!o)
+        return false;
+
+    dump_chrome_json (o);
+    return (bool)o;
+}
+
+
+double trace_scope::
+        seconds_per_tick()
+{
+#ifdef TRACE_SCOPE_RDTSC
+    tick_calibration t;
+    return chrono::duration<double>(t.time - tick_origin.time).count ()
+            / max(1.0, double(t.ticks - tick_origin.ticks));
+#else
+    return 1e-9;
+#endif
+}
+
+
+void trace_scope::
+        clear()
+{
+    rings().for_each ([](trace_ring& r)
+    {
+        r.tail.store (r.head.load (memory_order_acquire), memory_order_release);
+    });
+}
+
+
+#include "trace_perf.h"
+#include "exceptionassert.h"
+
+#include <sstream>
+#include <thread>
+
+void trace_scope::
+        test()
+{
+    bool was_enabled = is_enabled ();
+
+    // It should not record anything while disabled.
+    {
+        enable (false);
+        {
+            TRACE_SCOPE("trace_scope::test disabled");
+        }
+        stringstream ss;
+        dump_chrome_json (ss);
+        EXCEPTION_ASSERT(string::npos == ss.str ().find ("trace_scope::test disabled"));
+    }
+
+    // It should record scopes from multiple threads as Chrome trace-event JSON.
+    {
+        enable (true);
+        {
+            TRACE_SCOPE("trace_scope::test main");
+        }
+        thread t([]() { TRACE_SCOPE("trace_scope::test \"thread\""); });
+        t.join ();
+
+        stringstream ss;
+        dump_chrome_json (ss);
+        string s = ss.str ();
+        EXCEPTION_ASSERT(0 == s.find ("{\"traceEvents\":["));
+        EXCEPTION_ASSERT(string::npos != s.find ("\"name\":\"trace_scope::test main\",\"ph\":\"X\""));
+        EXCEPTION_ASSERT(string::npos != s.find ("\"name\":\"trace_scope::test \\\"thread\\\"\""));
+    }
+
+    // It should keep the most recent events when a ring buffer is full.
+    {
+        for (unsigned i=0; i<3*trace_ring::capacity; i++)
+        {
+            TRACE_SCOPE("trace_scope::test wrap");
+        }
+
+        stringstream ss;
+        dump_chrome_json (ss);
+        EXCEPTION_ASSERT(string::npos != ss.str ().find ("trace_scope::test wrap"));
+    }
+
+    // It should have an overhead less than 50 ns per scope when enabled.
+    {
+        TRACE_PERF("it should have a low overhead 10000");
+
+        for (int i=0;i<10000;i++) {
+            TRACE_SCOPE("trace_scope::test overhead");
+        }
+
+        enable (false);
+        trace_perf_.reset ("it should have a lower overhead when disabled 10000");
+
+        for (int i=0;i<10000;i++) {
+            TRACE_SCOPE("trace_scope::test overhead");
+        }
+    }
+
+    clear ();
+    enable (was_enabled);
+}
@@ -0,0 +1,111 @@
+#ifndef TRACE_SCOPE_H
+#define TRACE_SCOPE_H
+
+#include <atomic>
+#include <string>
+#include <ostream>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define TRACE_SCOPE_RDTSC
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define TRACE_SCOPE_RDTSC
+#else
+#include <chrono>
+#endif
+
+/**
+ * @brief The trace_scope class should record when a scope is entered and left
+ * with an overhead low enough to be left in production code.
+ *
+ * Example:
+ *    {
+ *      TRACE_SCOPE("Task::run");
+ *      run_thingy();
+ *    }
+ *
+ * The scope is identified by a string literal. The literal is never copied
+ * or formatted, only its address is stored. Use TaskTimer for formatted
+ * logging.
+ *
+ * Events are stored in a fixed size ring buffer per thread. Writing to the
+ * ring buffer takes no locks. When a ring buffer is full the oldest events
+ * are overwritten.
+ *
+ * Recording is disabled by default, enable it at runtime with
+ * trace_scope::enable (true). A disabled trace_scope costs a relaxed atomic
+ * load. An enabled trace_scope should cause an overhead of less than 50 ns.
+ *
+ * Recorded events can be written as Chrome trace-event JSON, open the file
+ * in chrome://tracing to browse it.
+ */
+class trace_scope
+{
+public:
+    explicit trace_scope(const char* id)
+        :
+          id_(enabled_.load (std::memory_order_relaxed) ? id : 0),
+          begin_(id_ ? ticks () : 0)
+    {}
+
+    trace_scope(const trace_scope&) = delete;
+    trace_scope& operator=(const trace_scope&) = delete;
+
+    ~trace_scope()
+    {
+        if (id_)
+            record (id_, begin_, ticks ());
+    }
+
+    static void enable(bool v) { enabled_.store (v, std::memory_order_relaxed); }
+    static bool is_enabled() { return enabled_.load (std::memory_order_relaxed); }
+
+    /**
+     * @brief dump_chrome_json writes all events currently in the ring
+     * buffers. Threads may keep recording while the dump is written.
+     */
+    static void dump_chrome_json(std::ostream& o);
+    static bool dump_chrome_json(const std::string& filename);
+
+    /**
+     * @brief clear discards all recorded events.
+     */
+    static void clear();
+
+    /**
+     * @brief ticks returns a timestamp in unspecified units from an arbitrary
+     * but fixed point in time. Uses the time stamp counter where available,
+     * which is cheaper than the system clock. Timestamps are converted to
+     * microseconds when dumped.
+     */
+    static unsigned long long ticks()
+    {
+#ifdef TRACE_SCOPE_RDTSC
+        return __rdtsc ();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+#endif
+    }
+
+    /**
+     * @brief seconds_per_tick converts differences of ticks() to seconds.
+     */
+    static double seconds_per_tick();
+
+private:
+    static void record(const char* id, unsigned long long begin, unsigned long long end);
+    static std::atomic<bool> enabled_;
+
+    const char* id_;
+    unsigned long long begin_;
+
+public:
+    static void test();
+};
+
+// Concatenating with "" only compiles if 'id' is a string literal
+#define TRACE_SCOPE(id) trace_scope trace_scope_{"" id}
+
+#endif // TRACE_SCOPE_H
@@ -10,6 +10,9 @@
 #include "demangle.h"
 #include "barrier.h"
 #include "shared_state_traits_backtrace.h"
+#include "trace_scope.h"
+#include "shared_state_profiler.h"
+#include "shared_state_rcu.h"
 
 #include <stdio.h>
 #include <exception>
@@ -44,6 +47,9 @@ int UnitTest::
         RUNTEST(spinning_barrier);
         RUNTEST(locking_barrier);
         RUNTEST(shared_state_traits_backtrace);
+        RUNTEST(trace_scope);
+        RUNTEST(shared_state_profiler);
+        RUNTEST(shared_state_rcu);
 
     } catch (const ExceptionAssert& x) {
         if (rethrow_exceptions)
@@ -1,4 +1,5 @@
 #include "bandpass.h"
+#include "rectangle.h"
 #include <sstream>
 
 #include "tfr/chunk.h"
@@ -6,6 +7,8 @@
 
 #include "tasktimer.h"
 
+#include <float.h> // FLT_MAX
+
 #define TIME_BANDPASS
 //#define TIME_BANDPASS if(0)
 
@@ -108,6 +111,27 @@ Tfr::pChunkFilter Bandpass::
 }
 
 
+Signal::Region Bandpass::
+        affectedRegion(const Signal::Region& R) const
+{
+    // Each element is kept or removed depending only on its frequency
+    return R;
+}
+
+
+Signal::Region Bandpass::
+        changedRegion(const Bandpass& previous, float FS) const
+{
+    // Same as a rectangle covering all samples
+    Signal::Region r = Rectangle(0, _f1, FLT_MAX, _f2, _save_inside).changedRegion (
+                Rectangle(0, previous._f1, FLT_MAX, previous._f2, previous._save_inside), FS);
+
+    if (r.empty ())
+        return r;
+    return Signal::Region(Signal::Intervals::Intervals_ALL, r.f1 (), r.f2 ());
+}
+
+
 Tfr::ChunkFilterDesc::ptr Bandpass::
         copy() const
 {
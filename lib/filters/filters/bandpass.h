@@ -9,7 +9,7 @@
 
 namespace Filters {
 
-class BandpassKernel: public Tfr::ChunkFilter
+class BandpassKernel: public Tfr::ChunkFilter, public Tfr::ChunkFilter::ParallelChannelsTag
 {
 public:
     BandpassKernel(float f1, float f2, bool save_inside=false);
@@ -33,6 +33,7 @@ public:
 
     // ChunkFilterDesc
     Tfr::pChunkFilter    createChunkFilter(Signal::ComputingEngine* engine) const;
+    Signal::Region       affectedRegion(const Signal::Region& R) const;
     ChunkFilterDesc::ptr copy() const;
 
     // Filters::Selection
@@ -42,6 +43,13 @@ public:
     float _f1, _f2;
     bool _save_inside;
 
+    /**
+     * @brief changedRegion is where the output of this filter differs from
+     * the output of 'previous' for a signal with sample rate 'FS'. Unused
+     * outside of tests, see Rectangle::changedRegion.
+     */
+    Signal::Region changedRegion(const Bandpass& previous, float FS) const;
+
 private:
     Bandpass(); // for deserialization
 
@@ -75,6 +75,14 @@ Tfr::pChunkFilter Ellipse::
 }
 
 
+Signal::Region Ellipse::
+        affectedRegion(const Signal::Region& R) const
+{
+    // Each element is kept or removed depending only on where it is
+    return R;
+}
+
+
 ChunkFilterDesc::ptr Ellipse::
         copy() const
 {
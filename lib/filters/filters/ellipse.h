@@ -8,7 +8,7 @@
 
 namespace Filters {
 
-class EllipseKernel: public Tfr::ChunkFilter
+class EllipseKernel: public Tfr::ChunkFilter, public Tfr::ChunkFilter::ParallelChannelsTag
 {
 public:
     EllipseKernel(float t1, float f1, float t2, float f2, bool save_inside=false);
@@ -31,6 +31,7 @@ public:
 
     // ChunkFilterDesc
     Tfr::pChunkFilter       createChunkFilter(Signal::ComputingEngine* engine=0) const;
+    Signal::Region          affectedRegion(const Signal::Region& R) const;
     ChunkFilterDesc::ptr    copy() const;
 
     float _centre_t, _centre_f, _centre_plus_radius_t, _centre_plus_radius_f;
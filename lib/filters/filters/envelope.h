@@ -14,7 +14,7 @@ namespace Filters {
  * than 256 samples. Or a frequency lower than FS/256 (i.e 44100/256=172 Hz).
  * Note that a lower modulation frequency is still detected.
  */
-class Envelope: public Tfr::ChunkFilter
+class Envelope: public Tfr::ChunkFilter, public Tfr::ChunkFilter::ParallelChannelsTag, public Tfr::ChunkFilter::OwnInverseTag
 {
 public:
     void operator()( Tfr::ChunkAndInverse& chunk );
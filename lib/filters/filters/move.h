@@ -5,7 +5,7 @@
 
 namespace Filters {
 
-class Move: public Tfr::ChunkFilter
+class Move: public Tfr::ChunkFilter, public Tfr::ChunkFilter::ParallelChannelsTag
 {
 public:
     Move(float df);
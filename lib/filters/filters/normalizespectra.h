@@ -5,7 +5,7 @@
 
 namespace Filters {
 
-class NormalizeSpectra : public Tfr::ChunkFilter, public Tfr::ChunkFilter::NoInverseTag
+class NormalizeSpectra : public Tfr::ChunkFilter, public Tfr::ChunkFilter::NoInverseTag, public Tfr::ChunkFilter::ParallelChannelsTag
 {
 public:
     // negative values set a fraction rather than an absolute number of Hz
@@ -5,7 +5,7 @@
 
 namespace Filters
 {
-    class Reassign: public Tfr::ChunkFilter
+    class Reassign: public Tfr::ChunkFilter, public Tfr::ChunkFilter::ParallelChannelsTag
     {
     public:
         void operator()( Tfr::ChunkAndInverse& chunk );
@@ -16,7 +16,7 @@ namespace Filters
     };
 
 
-    class Tonalize: public Tfr::ChunkFilter
+    class Tonalize: public Tfr::ChunkFilter, public Tfr::ChunkFilter::ParallelChannelsTag
     {
     public:
         void operator()( Tfr::ChunkAndInverse& chunk );
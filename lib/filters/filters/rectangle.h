@@ -35,6 +35,7 @@ public:
     // ChunkFilterDesc
     Tfr::pChunkFilter               createChunkFilter(Signal::ComputingEngine* engine) const;
     Signal::OperationDesc::Extent   extent() const;
+    Signal::Region                  affectedRegion(const Signal::Region& R) const;
     ChunkFilterDesc::ptr            copy() const;
 
     // Filters::Selection
@@ -48,8 +49,20 @@ public:
     Signal::Intervals zeroed_samples();
     Signal::Intervals affected_samples();
 
+    /**
+     * @brief changedRegion is where the output of this filter differs from
+     * the output of 'previous' for a signal with sample rate 'FS'. Pass it to
+     * IInvalidator::deprecateRegion after moving a corner of the rectangle.
+     *
+     * Nothing moves a corner of a Rectangle in the processing chain yet. A
+     * selection is a copy that is added with Chain::addOperationAt when it
+     * is applied, which deprecates all of it.
+     */
+    Signal::Region changedRegion(const Rectangle& previous, float FS) const;
+
 private:
     Signal::Intervals outside_samples();
+    Signal::Interval span() const;
 
     Rectangle() {} // for deserialization
 
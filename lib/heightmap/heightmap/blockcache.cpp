@@ -4,6 +4,8 @@
 
 #include "tasktimer.h"
 
+#include <algorithm>
+
 using namespace std;
 
 namespace Heightmap {
@@ -48,6 +50,9 @@ void BlockCache::
     cache_t::iterator i = cache_.find(ref);
     if (i != cache_.end())
         cache_.erase(i);
+
+    unchanged_.erase (ref);
+    pending_.erase (ref);
 }
 
 
@@ -58,6 +63,8 @@ BlockCache::cache_t BlockCache::
 
     BlockCache::cache_t c;
     c.swap(cache_);
+    unchanged_.clear ();
+    pending_.clear ();
     return c;
 }
 
@@ -90,6 +97,86 @@ BlockCache::cache_t BlockCache::
     return C;
 }
 
+
+/**
+ * @brief intersectsBlock checks if the band of 'R' intersects the
+ * frequencies of 'block'.
+ */
+static bool intersectsBlock( const Signal::Region& R, const Block& block )
+{
+    VisualizationParams::const_ptr vp = block.visualization_params ();
+    if (R.allFrequencies () || !vp)
+        return true;
+
+    Region r = block.getOverlappingRegion ();
+    FreqAxis fa = vp->display_scale ();
+    float fs = block.block_layout ().targetSampleRate ();
+    float f1 = fa.getFrequency (r.a.scale);
+    float f2 = fa.getFrequency (r.b.scale);
+    return R.intersectsFrequencies (std::min(f1,f2) / fs, std::max(f1,f2) / fs);
+}
+
+
+void BlockCache::
+        deprecateRegion( const Signal::Region& R )
+{
+    lock_guard<mutex> l(mutex_);
+
+    for (const cache_t::value_type& v : cache_)
+      {
+        Signal::Intervals I = R.samples () & v.second->getInterval ();
+        if (!I)
+            continue;
+
+        if (intersectsBlock (R, *v.second))
+          {
+            pending_[v.first] |= I;
+
+            auto i = unchanged_.find (v.first);
+            if (i != unchanged_.end () && !(i->second -= I))
+                unchanged_.erase (i);
+          }
+        else
+          {
+            // Samples that an earlier change still has to update are not
+            // unchanged
+            auto p = pending_.find (v.first);
+            if (p != pending_.end ())
+                I -= p->second;
+
+            if (I)
+                unchanged_[v.first] |= I;
+          }
+      }
+}
+
+
+void BlockCache::
+        updated( const Reference& ref, const Signal::Intervals& I )
+{
+    lock_guard<mutex> l(mutex_);
+
+    auto p = pending_.find (ref);
+    if (p != pending_.end () && !(p->second -= I))
+        pending_.erase (p);
+}
+
+
+Signal::Intervals BlockCache::
+        unchangedSamples( const Reference& ref ) const
+{
+    lock_guard<mutex> l(mutex_);
+
+    auto i = unchanged_.find (ref);
+    if (i == unchanged_.end ())
+        return Signal::Intervals();
+
+    auto p = pending_.find (ref);
+    if (p != pending_.end ())
+        return i->second - p->second;
+    return i->second;
+}
+
 } // namespace Heightmap
 
 #include <QtWidgets> // QApplication
@@ -132,6 +219,58 @@ void BlockCache::
         EXCEPTION_ASSERT( b1 == b5 );
         EXCEPTION_ASSERT( b6 == pBlock() );
     }
+
+    // It should keep track of samples that are unchanged in a block when
+    // only other frequencies have changed
+    {
+        Reference r1;
+        Reference r2 = r1.right ();
+        BlockLayout bl(2,2,1000);
+        Render::BlockTextures::Scoped bt_raii(bl.texels_per_row (),bl.texels_per_column ());
+        VisualizationParams::ptr vp(new VisualizationParams);
+        FreqAxis fa;
+        fa.setLinear (bl.targetSampleRate ());
+        vp->display_scale (fa);
+        pBlock b1(new Block(r1, bl, vp, 0));
+        pBlock b2(new Block(r2, bl, vp, 0));
+        Signal::Interval i1 = b1->getInterval ();
+
+        BlockCache c;
+        c.insert (b1);
+        c.insert (b2);
+
+        // Blocks that cover the entire frequency range are always affected
+        c.deprecateRegion (Signal::Region(i1, 0.1, 0.2));
+        EXCEPTION_ASSERT( !c.unchangedSamples (r1) );
+
+        // A block above the changed band doesn't need to be updated
+        Reference top = r1.top ().top ();
+        pBlock b3(new Block(top, bl, vp, 0));
+        c.insert (b3);
+        Signal::Interval i3 = b3->getInterval ();
+        c.deprecateRegion (Signal::Region(i3, 0.01, 0.02));
+        EXCEPTION_ASSERT_EQUALS( c.unchangedSamples (top), i3 );
+        EXCEPTION_ASSERT( !c.unchangedSamples (r1) );
+
+        // Until the frequencies of the block are changed
+        c.deprecateRegion (Signal::Region(i3));
+        EXCEPTION_ASSERT( !c.unchangedSamples (top) );
+
+        // And stay changed until the block has been updated
+        c.deprecateRegion (Signal::Region(i3, 0.01, 0.02));
+        EXCEPTION_ASSERT( !c.unchangedSamples (top) );
+
+        Signal::Interval first_half(i3.first, i3.first + i3.count ()/2);
+        c.updated (top, first_half);
+        c.deprecateRegion (Signal::Region(i3, 0.01, 0.02));
+        EXCEPTION_ASSERT_EQUALS( c.unchangedSamples (top), first_half );
+
+        c.updated (top, i3);
+        c.deprecateRegion (Signal::Region(i3, 0.01, 0.02));
+        EXCEPTION_ASSERT_EQUALS( c.unchangedSamples (top), i3 );
+        c.erase (top);
+        EXCEPTION_ASSERT( !c.unchangedSamples (top) );
+    }
 }
 
 } // namespace Heightmap
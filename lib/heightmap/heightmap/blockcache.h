@@ -3,6 +3,7 @@
 
 #include "block.h"
 #include "reference_hash.h"
+#include "signal/region.h"
 
 #include <unordered_map>
 #include <thread>
@@ -53,6 +54,29 @@ public:
 
     cache_t     clone() const;
 
+    /**
+     * @brief deprecateRegion describes that the signal has changed within
+     * 'R', in samples of the heightmap. Blocks whose frequencies don't
+     * intersect the band of 'R' keep the samples of 'R' as unchanged.
+     * Blocks that do intersect it, or blocks without visualization
+     * parameters, forget any unchanged samples within 'R' and keep them as
+     * pending until they are updated.
+     */
+    void        deprecateRegion( const Signal::Region& R );
+
+    /**
+     * @brief updated tells that samples 'I' of block 'ref' have been
+     * recomputed and are no longer pending, see UpdateProducer.
+     */
+    void        updated( const Reference& ref, const Signal::Intervals& I );
+
+    /**
+     * @brief unchangedSamples are the samples of block 'ref' that don't need
+     * to be updated when they are computed again, see deprecateRegion.
+     * Samples that are pending from an earlier change are never unchanged.
+     */
+    Signal::Intervals unchangedSamples( const Reference& ref ) const;
+
 private:
 
 
@@ -66,6 +90,8 @@ private:
 
     mutable std::mutex  mutex_;
     cache_t             cache_;
+    std::unordered_map<Reference, Signal::Intervals> unchanged_;
+    std::unordered_map<Reference, Signal::Intervals> pending_; // changed but not yet updated
 
 public:
     static void test();
@@ -18,6 +18,7 @@
 #include <boost/unordered_set.hpp>
 
 // std
+#include <limits>
 #include <string>
 
 // MSVC-GCC-compatibility workarounds
@@ -472,6 +473,13 @@ void Collection::
 
 Intervals Collection::
         needed_samples() const
+{
+    return needed_samples(std::numeric_limits<float>::max ());
+}
+
+
+Signal::Intervals Collection::
+        needed_samples(float max_sample_rate) const
 {
     Intervals r;
 
@@ -483,7 +491,8 @@ Intervals Collection::
         Block const& b = *a.second;
         unsigned framediff = _frame_counter - b.frame_number_last_used;
         if (1 == framediff || 0 == framediff) // this block was used last frame or this frame
-            r |= b.getInterval();
+            if (b.sample_rate () <= max_sample_rate)
+                r |= b.getInterval();
     }
 
     return r;
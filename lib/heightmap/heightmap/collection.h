@@ -65,6 +65,10 @@ octave for instance.
 To compute other blocks, higher resolution blocks are downsampled and stored in
 subdivisions of a block with the requested resolution.
 
+Coarse blocks may also be computed directly from a decimated signal, for the
+frequencies below its nyquist frequency. See Signal::DecimateDesc and
+Heightmap::Update::UpdateProducer.
+
 Whenever a new block size is requested, it is first approximated by an
 interpolation from any available lower resolution block. If no such block is
 available it is sufficient to first render it black, then compute a STFT
@@ -118,6 +122,12 @@ public:
 
 
     Signal::Intervals needed_samples() const;
+
+    /**
+     * @brief needed_samples of blocks with at most 'max_sample_rate' texels
+     * per second.
+     */
+    Signal::Intervals needed_samples(float max_sample_rate) const;
     Signal::Intervals recently_created();
     Signal::Intervals missing_data();
 
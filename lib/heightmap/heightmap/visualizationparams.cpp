@@ -57,7 +57,7 @@ void VisualizationParams::
 FreqAxis VisualizationParams::
         display_scale() const
 {
-    return details_->display_scale_;
+    return details_.read ()->display_scale_;
 }
 
 
@@ -71,7 +71,7 @@ void VisualizationParams::
 AmplitudeAxis VisualizationParams::
         amplitude_axis() const
 {
-    return details_->amplitude_axis_;
+    return details_.read ()->amplitude_axis_;
 }
 
 
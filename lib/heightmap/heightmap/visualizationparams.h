@@ -75,8 +75,9 @@ public:
 private:
     struct details {
         struct shared_state_traits: shared_state_traits_default {
-            // Has only simple accessors, a simple mutex is faster than a more complex one
-            typedef shared_state_mutex_notimeout_noshared shared_state_mutex;
+            // Read by every block update but rarely changed, readers
+            // shouldn't have to wait for each other or for a writer
+            typedef shared_state_rcu shared_state_mutex;
         };
 
         FreqAxis display_scale_;
@@ -2,12 +2,18 @@
 #include "heightmap/collection.h"
 #include "signal/processing/step.h"
 #include "signal/processing/purge.h"
+#include "tfr/chunksizetuner.h"
 
 #include "tasktimer.h"
 #include "log.h"
 #include "largememorypool.h"
 #include "GlException.h"
 
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <cmath>
+#include <limits>
+
 //#define TIME_PAINTGL_DETAILS
 #define TIME_PAINTGL_DETAILS if(0)
 
@@ -17,9 +23,38 @@
 using namespace Signal;
 using namespace Processing;
 
+// Frames per second to schedule rendering for, see TargetNeeds::updateDeadline
+static const int frame_rate = 30;
+
 namespace Tools {
 namespace Support {
 
+/**
+ * @brief decimate converts 'I' to samples of a signal decimated by 2^levels,
+ * rounded outwards.
+ */
+static Interval decimate(Interval I, int levels)
+{
+    if (I.first != Interval::IntervalType_MIN)
+        I.first = I.first >> levels;
+    if (I.last != Interval::IntervalType_MAX)
+        I.last = -((-I.last) >> levels);
+    return I;
+}
+
+
+static Intervals decimate(const Intervals& I, int levels)
+{
+    if (0 == levels)
+        return I;
+
+    Intervals r;
+    for (const Interval& i : I)
+        r |= decimate(i, levels);
+    return r;
+}
+
+
 HeightmapProcessingPublisher::HeightmapProcessingPublisher(
           TargetMarker::ptr target_marker,
           Heightmap::TfrMapping::const_ptr tfrmapping,
@@ -56,13 +91,20 @@ void HeightmapProcessingPublisher::
     float fs;
     IntervalType Ls;
     Heightmap::TfrMapping::Collections C;
+    Tfr::TransformDesc::ptr td;
     {
         auto tm = tfrmapping_.read ();
         fs = tm->targetSampleRate();
         Ls = tm->lengthSamples();
         C = tm->collections();
+        td = tm->transform_desc();
     }
 
+    // Blocks with at most one texel per decimated sample
+    float max_block_fs = decimation_ ? std::ldexp(fs, -decimation_) : std::numeric_limits<float>::max ();
+    fs = std::ldexp(fs, -decimation_);
+    Ls = decimate(Interval(0, Ls), decimation_).last;
+
     float t_center = camera_.read ()->q[0];
     IntervalType center = std::round(t_center * fs);
 
@@ -70,9 +112,9 @@ void HeightmapProcessingPublisher::
     for ( auto cp : C )
     {
         auto c = cp.write ();
-        missing_data |= c->missing_data();
-        recently_created |= c->recently_created();
-        needed_samples |= c->needed_samples();
+        missing_data |= decimate(c->missing_data(), decimation_);
+        recently_created |= decimate(c->recently_created(), decimation_);
+        needed_samples |= decimate(c->needed_samples(max_block_fs), decimation_);
     }
 
     // new blocks based on invalid data contain invalid data
@@ -119,13 +161,19 @@ void HeightmapProcessingPublisher::
     for ( auto c : C ) for ( auto a : Heightmap::Collection::cache (c)->clone () )
     {
         const Heightmap::Block& b = *a.second;
-        Interval i = b.getInterval();
+        Interval i = decimate(b.getInterval(), decimation_);
 
         // If this block overlaps data to be computed and is a currently visible block
-        if (i & to_compute && b.frame_number_last_used == c.read()->frame_number())
+        if (b.sample_rate () <= max_block_fs && i & to_compute && b.frame_number_last_used == c.read()->frame_number())
             update_size = std::min(update_size, i.count ());
     }
 
+    // Sections smaller than the measured best chunk size for this transform
+    // take longer per sample to compute, see Tfr::ChunkSizeTuner.
+    if (Tfr::ChunkSizeTuner::ptr tuner = Tfr::ChunkSizeTuner::global ())
+        if (td)
+            update_size = std::max(update_size, (UnsignedIntervalType)tuner->size (*td, fs));
+
     // If the last invalidated interval is smaller than the suggested
     // update_size use the size of the invalidated interval instead.
     // But only if the last invalidated interval is visible and still invalid.
@@ -147,6 +195,11 @@ void HeightmapProcessingPublisher::
                 prio_
             );
 
+    // The visible blocks are needed for the next frame
+    TargetNeeds::State::Deadline deadline;
+    deadline.time = boost::posix_time::microsec_clock::local_time () + boost::posix_time::milliseconds(1000/frame_rate);
+    target_needs_->updateDeadline (deadline);
+
     failed_allocation_ = false;
     for ( auto c : C )
         failed_allocation_ |= c.write ()->failed_allocation ();
@@ -324,6 +377,38 @@ void HeightmapProcessingPublisher::
 
         EXCEPTION_ASSERT(!hpp.isHeightmapDone ());
     }
+
+    // It should publish coarse blocks in samples of a decimated signal
+    {
+        OperationDesc::ptr operation_desc;
+        Step::ptr step(new Step(operation_desc));
+        Bedroom::ptr bedroom(new Bedroom);
+        BedroomNotifier::ptr notifier(new BedroomNotifier(bedroom));
+        TargetNeeds::ptr target_needs(new TargetNeeds(step, notifier));
+        Dag::ptr dag(new Dag); dag->appendStep(step);
+        TargetMarker::ptr target_marker(new TargetMarker(target_needs, dag));
+
+        Heightmap::BlockLayout block_layout(10,10,1);
+        Heightmap::TfrMapping::ptr tfrmapping(new Heightmap::TfrMapping(block_layout,1));
+        shared_state<Tools::Support::RenderCamera> camera(new Tools::Support::RenderCamera);
+        HeightmapProcessingPublisher hpp(target_marker, tfrmapping, camera, 0);
+        hpp.setDecimation (1);
+
+        Heightmap::Collection::ptr collection = tfrmapping->collections()[0];
+        tfrmapping->lengthSamples(30 * block_layout.sample_rate ());
+
+        // The entire heightmap of 30 s spans at least 32 s with 10 texels,
+        // so its sample rate is well below the decimated signal of 0.5 Hz
+        Heightmap::pBlock block = collection->getBlock(collection.read ()->entireHeightmap());
+        EXCEPTION_ASSERT_LESS_OR_EQUAL(block->sample_rate (), block_layout.sample_rate ()/2);
+        block->frame_number_last_used = collection.read ()->frame_number();
+        hpp.update();
+
+        Signal::Intervals needed = target_needs->needed ();
+        EXCEPTION_ASSERT(!hpp.isHeightmapDone ());
+        EXCEPTION_ASSERT_EQUALS(needed.spannedInterval ().first, 0);
+        EXCEPTION_ASSERT_LESS_OR_EQUAL(needed.spannedInterval ().last, 15);
+    }
 }
 
 } // namespace Support
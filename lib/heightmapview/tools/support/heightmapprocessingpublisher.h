@@ -19,6 +19,10 @@ namespace Support {
  * publishes work prioritization to a target and assumes that there is a worker
  * somewhere that will detect this. That worker may fetch the required data
  * through some signal processing chain but this publisher doesn't care.
+ *
+ * With setDecimation the target reads a signal decimated by 2^levels, see
+ * Signal::DecimateDesc. Then only blocks that are at least as coarse as the
+ * decimated signal are published, in samples of the decimated signal.
  */
 class HeightmapProcessingPublisher: public QObject
 {
@@ -38,6 +42,8 @@ public:
             double prio,
             QObject* parent=0);
 
+    void setDecimation( int levels ) { decimation_ = levels; }
+
 public slots:
     void setLastUpdatedInterval( Signal::Interval last_update );
     void update();
@@ -56,6 +62,7 @@ private:
     bool                                    failed_allocation_;
     Signal::Intervals                       last_valid_;
     int                                     aggressive_purge_timer_ = 0;
+    int                                     decimation_ = 0;
 
     bool isHeightmapDone() const;
     bool failedAllocation() const;
@@ -2,7 +2,9 @@
 #include "exceptionassert.h"
 #include "tasktimer.h"
 
+#include <atomic>
 #include <future>
+#include <thread>
 
 using namespace std;
 
@@ -86,6 +88,50 @@ void blocking_queue_test::
         EXCEPTION_ASSERT(q.empty ());
         EXCEPTION_ASSERT_EQUALS(q2.size (), 2u);
     }
+
+    // It should block producers while a queue with a capacity is full.
+    {
+        typedef blocking_queue<int> queue;
+        queue q(2);
+        atomic<int> pushed {0};
+
+        auto producer = async(launch::async, [&q, &pushed]() {
+            for (int i=1; i<=5; i++)
+            {
+                q.push (i);
+                pushed++;
+            }
+        });
+
+        // Wait for the queue to fill up, the producer then stays blocked
+        auto deadline = chrono::steady_clock::now () + chrono::seconds(1);
+        while (pushed.load () < 2 && chrono::steady_clock::now () < deadline)
+            this_thread::sleep_for (chrono::milliseconds(1));
+
+        EXCEPTION_ASSERT_EQUALS(pushed.load (), 2);
+        this_thread::sleep_for (chrono::milliseconds(2));
+        EXCEPTION_ASSERT_EQUALS(pushed.load (), 2);
+
+        int S = 0;
+        for (int i=0; i<5; i++)
+            S += q.pop ();
+
+        producer.get ();
+        EXCEPTION_ASSERT_EQUALS(S, 15);
+        EXCEPTION_ASSERT(q.empty ());
+    }
+
+    // It should release blocked producers when closed.
+    {
+        blocking_queue<int> q(1);
+        q.push (1);
+
+        auto producer = async(launch::async, [&q]() { q.push (2); });
+        this_thread::sleep_for (chrono::milliseconds(1));
+        q.close ();
+        producer.get ();
+        EXCEPTION_ASSERT(q.empty ());
+    }
 }
 
 } // namespace JustMisc
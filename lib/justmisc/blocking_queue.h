@@ -1,6 +1,7 @@
 #ifndef JUSTMISC_BLOCKING_QUEUE_H
 #define JUSTMISC_BLOCKING_QUEUE_H
 
+#include <condition_variable>
 #include <mutex>
 #include <queue>
 
@@ -9,6 +10,9 @@ namespace JustMisc {
 /**
  * @brief The blocking_queue class should provide a thread safe solution to the
  * multiple consumer-multiple producer pattern.
+ *
+ * A queue created with a capacity blocks producers in push until consumers
+ * have made room, which bounds the memory held by the queue.
  */
 template<class T>
 class blocking_queue
@@ -18,6 +22,7 @@ public:
     typedef std::queue<T> queue;
 
     blocking_queue(){}
+    explicit blocking_queue(size_t capacity) : capacity_(capacity) {}
     blocking_queue(const blocking_queue&)=delete;
     blocking_queue& operator=(const blocking_queue&)=delete;
     blocking_queue(blocking_queue&&)=default;
@@ -34,6 +39,8 @@ public:
         std::unique_lock<std::mutex> l(m);
         queue p;
         p.swap (q);
+        l.unlock ();
+        not_full.notify_all ();
         return p;
     }
 
@@ -46,6 +53,7 @@ public:
         queue().swap (q);
         l.unlock ();
         c.notify_all ();
+        not_full.notify_all ();
     }
 
     bool empty() {
@@ -63,6 +71,8 @@ public:
 
         T t( std::move(q.front()) );
         q.pop ();
+        l.unlock ();
+        not_full.notify_one ();
         return t;
     }
 
@@ -81,6 +91,8 @@ public:
 
         T t( std::move(q.front()) );
         q.pop ();
+        l.unlock ();
+        not_full.notify_one ();
         return t;
     }
 
@@ -96,11 +108,14 @@ public:
 
         T t( std::move(q.front()) );
         q.pop ();
+        l.unlock ();
+        not_full.notify_one ();
         return t;
     }
 
     void push(const T& t) {
         std::unique_lock<std::mutex> l(m);
+        wait_for_room (l);
         if (!abort_)
             q.push (t);
         l.unlock ();
@@ -109,6 +124,7 @@ public:
 
     void push(T&& t) {
         std::unique_lock<std::mutex> l(m);
+        wait_for_room (l);
         if (!abort_)
             q.push (std::move(t));
         l.unlock ();
@@ -138,10 +154,17 @@ public:
         return q.size ();
     }
 private:
+    void wait_for_room(std::unique_lock<std::mutex>& l) {
+        if (0 < capacity_)
+            not_full.wait (l, [this](){return q.size () < capacity_ || abort_;});
+    }
+
     bool abort_ = false;
+    size_t capacity_ = 0;
     std::queue<T> q;
     std::mutex m;
     std::condition_variable c;
+    std::condition_variable not_full;
 };
 
 class blocking_queue_test {
@@ -1,6 +1,7 @@
 #include "justmisc-unittest.h"
 
 #include "blocking_queue.h"
+#include "spsc_ring.h"
 #include "thread_pool.h"
 
 #include "timer.h"
@@ -33,6 +34,7 @@ int UnitTest::
         TaskTimer tt("Running tests");
 
         RUNTEST(blocking_queue_test);
+        RUNTEST(spsc_ring_test);
         RUNTEST(thread_pool);
 
     } catch (const ExceptionAssert& x) {
@@ -0,0 +1,92 @@
+#include "spsc_ring.h"
+#include "exceptionassert.h"
+
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace JustMisc {
+
+void spsc_ring_test::
+        test ()
+{
+    // It should pass values from one producer thread to one consumer thread
+    // without locks or allocations.
+    {
+        spsc_ring<int> r(100);
+        const int N = 200000;
+
+        auto producer = async(launch::async, [&r]() {
+            int buffer[37];
+            int i = 0;
+            while (i < N)
+            {
+                int n = min(N - i, 1 + i % 37);
+                for (int j=0; j<n; j++)
+                    buffer[j] = i + j;
+
+                int written = 0;
+                while (written < n)
+                {
+                    written += r.write (buffer + written, n - written);
+                    this_thread::yield ();
+                }
+                i += n;
+            }
+        });
+
+        int buffer[53];
+        int expected = 0;
+        bool in_order = true;
+        while (expected < N)
+        {
+            size_t n = r.read (buffer, 1 + expected % 53);
+            for (size_t j=0; j<n; j++)
+                in_order &= buffer[j] == expected++;
+            if (0 == n)
+                this_thread::yield ();
+        }
+
+        producer.get ();
+        EXCEPTION_ASSERT(in_order);
+        EXCEPTION_ASSERT_EQUALS(r.read_available (), 0u);
+    }
+
+    // It should not write more than its capacity or read more than has been
+    // written.
+    {
+        spsc_ring<float> r(4);
+        float in[6] = {1,2,3,4,5,6}, out[6] = {0};
+
+        EXCEPTION_ASSERT_EQUALS(r.capacity (), 4u);
+        EXCEPTION_ASSERT_EQUALS(r.write (in, 6), 4u);
+        EXCEPTION_ASSERT_EQUALS(r.write_available (), 0u);
+        EXCEPTION_ASSERT_EQUALS(r.read (out, 3), 3u);
+        EXCEPTION_ASSERT_EQUALS(out[2], 3.f);
+
+        // Wrap around the end of the buffer
+        EXCEPTION_ASSERT_EQUALS(r.write (in + 4, 2), 2u);
+        EXCEPTION_ASSERT_EQUALS(r.discard (1), 1u);
+        EXCEPTION_ASSERT_EQUALS(r.read (out, 6), 2u);
+        EXCEPTION_ASSERT_EQUALS(out[0], 5.f);
+        EXCEPTION_ASSERT_EQUALS(out[1], 6.f);
+        EXCEPTION_ASSERT_EQUALS(r.read (out, 6), 0u);
+        EXCEPTION_ASSERT_EQUALS(r.discard (1), 0u);
+    }
+
+    // It should transfer nothing without a capacity.
+    {
+        spsc_ring<float> r;
+        float v = 1;
+        EXCEPTION_ASSERT_EQUALS(r.write (&v, 1), 0u);
+        EXCEPTION_ASSERT_EQUALS(r.read (&v, 1), 0u);
+        r.reset (1);
+        EXCEPTION_ASSERT_EQUALS(r.write (&v, 1), 1u);
+        r.clear ();
+        EXCEPTION_ASSERT_EQUALS(r.read_available (), 0u);
+    }
+}
+
+} // namespace JustMisc
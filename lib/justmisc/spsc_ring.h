@@ -0,0 +1,126 @@
+#ifndef JUSTMISC_SPSC_RING_H
+#define JUSTMISC_SPSC_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace JustMisc {
+
+/**
+ * @brief The spsc_ring class should pass values from one producer thread to
+ * one consumer thread without locks or allocations.
+ *
+ * write and read never block and may transfer fewer values than requested.
+ * This makes read safe to call from real-time threads, such as an audio
+ * callback.
+ *
+ * reset and clear are not thread safe and may only be called while neither
+ * the producer nor the consumer are using the ring.
+ */
+template<class T>
+class spsc_ring
+{
+public:
+    typedef T value_type;
+
+    spsc_ring() {}
+    explicit spsc_ring(size_t capacity) { reset (capacity); }
+    spsc_ring(const spsc_ring&)=delete;
+    spsc_ring& operator=(const spsc_ring&)=delete;
+
+    /**
+     * @brief reset allocates room for 'capacity' values and clears the ring.
+     */
+    void reset(size_t capacity) {
+        data_.reset (capacity ? new T[capacity+1] : 0);
+        size_ = capacity ? capacity+1 : 0;
+        clear ();
+    }
+
+    void clear() {
+        head_.store (0);
+        tail_.store (0);
+    }
+
+    size_t capacity() const { return size_ ? size_-1 : 0; }
+
+    size_t read_available() const {
+        if (!size_)
+            return 0;
+        size_t h = head_.load (std::memory_order_acquire);
+        size_t t = tail_.load (std::memory_order_relaxed);
+        return (h + size_ - t) % size_;
+    }
+
+    size_t write_available() const {
+        if (!size_)
+            return 0;
+        size_t h = head_.load (std::memory_order_relaxed);
+        size_t t = tail_.load (std::memory_order_acquire);
+        return (t + size_ - h - 1) % size_;
+    }
+
+    /**
+     * @brief write copies at most 'n' values to the ring. Only the producer
+     * may call write.
+     * @return the number of values written.
+     */
+    size_t write(const T* src, size_t n) {
+        n = std::min(n, write_available ());
+        if (!n)
+            return 0;
+
+        size_t h = head_.load (std::memory_order_relaxed);
+        size_t first = std::min(n, size_ - h);
+        std::copy (src, src + first, &data_[h]);
+        std::copy (src + first, src + n, &data_[0]);
+        head_.store ((h + n) % size_, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * @brief read copies at most 'n' values from the ring. Only the consumer
+     * may call read.
+     * @return the number of values read.
+     */
+    size_t read(T* dst, size_t n) {
+        n = std::min(n, read_available ());
+        if (!n)
+            return 0;
+
+        size_t t = tail_.load (std::memory_order_relaxed);
+        size_t first = std::min(n, size_ - t);
+        std::copy (&data_[t], &data_[t] + first, dst);
+        std::copy (&data_[0], &data_[0] + (n - first), dst + first);
+        tail_.store ((t + n) % size_, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * @brief discard drops at most 'n' values from the ring. Only the consumer
+     * may call discard.
+     * @return the number of values dropped.
+     */
+    size_t discard(size_t n) {
+        n = std::min(n, read_available ());
+        if (n)
+            tail_.store ((tail_.load (std::memory_order_relaxed) + n) % size_, std::memory_order_release);
+        return n;
+    }
+
+private:
+    std::unique_ptr<T[]> data_;
+    size_t size_ = 0;
+    std::atomic<size_t> head_ {0}; // written by the producer
+    std::atomic<size_t> tail_ {0}; // written by the consumer
+};
+
+class spsc_ring_test {
+public:
+    static void test();
+};
+
+} // namespace JustMisc
+
+#endif // JUSTMISC_SPSC_RING_H
@@ -1,4 +1,5 @@
 #include "buffer.h"
+#include "transpose.h"
 
 #include <string.h> //memcpy
 
@@ -236,11 +237,7 @@ MonoBuffer& MonoBuffer::
     float* write = time_series_->getCpuMemory();
     float const* read = b.time_series_->getCpuMemory();
 
-    write += offs_write;
-    read += offs_read;
-
-    for (UnsignedIntervalType n=0; n<length; n++)
-        write[n] += read[n];
+    accumulate(write + offs_write, read + offs_read, length);
 
     return *this;
 }
@@ -1,4 +1,5 @@
 #include "cache.h"
+#include "numatopology.h"
 
 #include "tasktimer.h"
 #include "log.h"
@@ -74,9 +75,19 @@ void Cache::
     Timer t;
     for( std::vector<pBuffer>::iterator itr = findBuffer(b.getInterval().first); itr!=_cache.end(); itr++ )
     {
-        Buffer& c = **itr;
-        if (c.getInterval ().first >= b.getInterval ().last)
+        if ((*itr)->getInterval ().first >= b.getInterval ().last)
             break;
+
+        if (!itr->unique ())
+        {
+            // Copy on write, the chunk is shared with chunks()
+            pBuffer n(new Buffer((*itr)->getInterval (), (*itr)->sample_rate (), (*itr)->number_of_channels ()));
+            if ((_valid_samples & n->getInterval ()) - b.getInterval ())
+                *n |= **itr;
+            *itr = n;
+        }
+
+        Buffer& c = **itr;
         c |= b;
     }
 
@@ -122,10 +133,18 @@ void Cache::
         }
 
         pBuffer n;
-        if (!_discarded.empty ())
+        // A discarded chunk may live on another NUMA node than this worker,
+        // see NumaTopology. A new chunk is allocated when it is first written.
+        if (!_discarded.empty () && NumaTopology::currentNode () < 0)
         {
             n = _discarded.back ();
             _discarded.pop_back ();
+            if (!n.unique ())
+                n.reset (); // shared with chunks()
+        }
+
+        if (n)
+        {
             // Log("Cache: Reusing previously discarded %s as %s for %s") % n->getInterval () % Interval(I.first, I.first+chunkSize) % J;
             n->set_sample_offset (I.first);
             n->set_sample_rate (fs);
@@ -154,6 +173,22 @@ void Cache::
 }
 
 
+std::vector<pBuffer> Cache::
+        chunks() const
+{
+    return _cache;
+}
+
+
+void Cache::
+        assign(const std::vector<pBuffer>& chunks, const Intervals& valid_samples)
+{
+    _cache = chunks;
+    _discarded.clear ();
+    _valid_samples = valid_samples;
+}
+
+
 void Cache::
         invalidate_samples(const Intervals& I)
 {
@@ -387,6 +422,7 @@ std::vector<pBuffer>::const_iterator Cache::
 } // namespace Signal
 
 #include "test/printbuffer.h"
+#include "trace_perf.h"
 
 namespace Signal {
 
@@ -459,6 +495,45 @@ void Cache::
         cache.put (pBuffer(new Buffer(Interval(14, 25), 5.1, 6)));
         EXCEPTION_ASSERTX( false, "expected an exception to be thrown when supplying a non-consistent number of channels" );
     } catch (const InvalidBufferDimensions&) {}
+
+
+    // It should share its chunks and copy a shared chunk before writing to it
+    {
+        Cache cache;
+        cache.put (pBuffer(new Buffer(Interval(0, 10), 5.1, 2)));
+        std::vector<pBuffer> chunks = cache.chunks ();
+        EXCEPTION_ASSERT_EQUALS (chunks.size (), 1u);
+
+        pBuffer w(new Buffer(Interval(5, 20), 5.1, 2));
+        *w->getChannel (0)->waveform_data ()->getCpuMemory () = 1;
+        cache.put (w);
+
+        EXCEPTION_ASSERT (chunks[0] != cache.chunks ()[0]);
+        EXCEPTION_ASSERT_EQUALS (chunks[0]->getChannel (0)->waveform_data ()->getCpuMemory ()[5], 0.f);
+        EXCEPTION_ASSERT_EQUALS (cache.read (Interval(5, 6))->getChannel (0)->waveform_data ()->getCpuMemory ()[0], 1.f);
+
+        Cache restored;
+        restored.assign (chunks, Interval(0, 10));
+        EXCEPTION_ASSERT_EQUALS (restored.samplesDesc (), Interval(0, 10));
+        EXCEPTION_ASSERT (*restored.read (Interval(0, 10)) == Buffer(Interval(0, 10), 5.1, 2));
+    }
+
+    // It should read intervals spanning several cached buffers quickly.
+    {
+        Cache cache;
+        for (int i=0; i<64; i++)
+            cache.put (pBuffer(new Buffer(Interval(i*4096, (i+1)*4096), 44100, 2)));
+
+        TRACE_PERF("Cache::read should read 1000 intervals of 8192 samples");
+
+        for (int i=0; i<1000; i++)
+        {
+            IntervalType first = (i*997) % (62*4096);
+            r = cache.read (Interval(first, first + 8192));
+        }
+
+        EXCEPTION_ASSERT_EQUALS (r->number_of_samples (), 8192);
+    }
 }
 
 } // namespace Signal
@@ -82,6 +82,20 @@ public:
     bool contains(const Signal::Intervals& I) const;
     bool empty() const;
 
+    /**
+     * @brief chunks shares the buffers of the cache without copying them.
+     * The cache makes a private copy of a shared chunk before it writes to
+     * that chunk again, so the returned buffers keep their content.
+     */
+    std::vector<pBuffer> chunks() const;
+
+    /**
+     * @brief assign replaces the content of the cache with 'chunks' from
+     * another cache, shared as by chunks(). Only 'valid_samples' are read
+     * from 'chunks'.
+     */
+    void assign(const std::vector<pBuffer>& chunks, const Intervals& valid_samples);
+
     void invalidate_samples(const Intervals& I);
     Signal::Intervals purge(Signal::Intervals still_needed, bool aggressive);
     size_t cache_size() const;
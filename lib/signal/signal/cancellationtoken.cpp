@@ -0,0 +1,152 @@
+#include "cancellationtoken.h"
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define CANCELLATIONTOKEN_THREAD_LOCAL __declspec(thread)
+#else
+#define CANCELLATIONTOKEN_THREAD_LOCAL thread_local
+#endif
+
+namespace Signal {
+
+static CANCELLATIONTOKEN_THREAD_LOCAL CancellationToken* current_token = 0;
+
+
+CancellationToken::Scope::
+        Scope(CancellationToken* token)
+    :
+      previous_(current_token)
+{
+    current_token = token;
+}
+
+
+CancellationToken::Scope::
+        ~Scope()
+{
+    current_token = previous_;
+}
+
+
+CancellationToken::
+        CancellationToken(std::function<bool()> still_needed, double poll_interval)
+    :
+      still_needed_(still_needed),
+      poll_interval_(poll_interval),
+      cancelled_(false)
+{
+}
+
+
+void CancellationToken::
+        cancel()
+{
+    cancelled_ = true;
+}
+
+
+bool CancellationToken::
+        cancelled()
+{
+    if (cancelled_ || !still_needed_)
+        return cancelled_;
+
+    // Only one thread polls at a time, the others use the previous result
+    std::unique_lock<std::mutex> l(poll_lock_, std::try_to_lock);
+    if (l && poll_interval_ <= since_poll_.elapsed ())
+    {
+        if (!still_needed_ ())
+            cancelled_ = true;
+        since_poll_.restart ();
+    }
+
+    return cancelled_;
+}
+
+
+bool CancellationToken::
+        poll()
+{
+    if (!cancelled_ && still_needed_)
+    {
+        std::lock_guard<std::mutex> l(poll_lock_);
+        if (!still_needed_ ())
+            cancelled_ = true;
+        since_poll_.restart ();
+    }
+
+    return !cancelled_;
+}
+
+
+CancellationToken* CancellationToken::
+        current()
+{
+    return current_token;
+}
+
+
+void CancellationToken::
+        checkpoint()
+{
+    if (current_token && current_token->cancelled ())
+        throw Cancelled();
+}
+
+} // namespace Signal
+
+#include "exceptionassert.h"
+#include "expectexception.h"
+
+#include <thread>
+
+namespace Signal {
+
+void CancellationToken::
+        test()
+{
+    // It should tell a long running computation that its result is no
+    // longer needed.
+    {
+        CancellationToken::checkpoint (); // no current token
+        EXCEPTION_ASSERT(!CancellationToken::current ());
+
+        ptr token(new CancellationToken);
+        {
+            Scope s(token.get ());
+            EXCEPTION_ASSERT_EQUALS(CancellationToken::current (), token.get ());
+            CancellationToken::checkpoint ();
+
+            token->cancel ();
+            EXPECT_EXCEPTION(Cancelled, CancellationToken::checkpoint ());
+        }
+        EXCEPTION_ASSERT(!CancellationToken::current ());
+    }
+
+    // It should poll 'still_needed' at most once every 'poll_interval'
+    {
+        std::atomic<bool> needed(true);
+        std::atomic<int> polls(0);
+        ptr token(new CancellationToken([&](){ polls++; return (bool)needed; }, 0.01));
+
+        EXCEPTION_ASSERT(!token->cancelled ());
+        needed = false;
+        EXCEPTION_ASSERT(!token->cancelled ());
+        EXCEPTION_ASSERT_EQUALS(polls, 0);
+
+        std::this_thread::sleep_for (std::chrono::milliseconds(11));
+        EXCEPTION_ASSERT(token->cancelled ());
+        EXCEPTION_ASSERT_EQUALS(polls, 1);
+
+        needed = true;
+        std::this_thread::sleep_for (std::chrono::milliseconds(11));
+        EXCEPTION_ASSERT(token->cancelled ());
+        EXCEPTION_ASSERT(!token->poll ());
+        EXCEPTION_ASSERT_EQUALS(polls, 1);
+
+        ptr token2(new CancellationToken([&](){ polls++; return (bool)needed; }, 1));
+        EXCEPTION_ASSERT(token2->poll ());
+        EXCEPTION_ASSERT_EQUALS(polls, 2);
+    }
+}
+
+} // namespace Signal
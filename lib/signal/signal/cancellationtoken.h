@@ -0,0 +1,94 @@
+#ifndef SIGNAL_CANCELLATIONTOKEN_H
+#define SIGNAL_CANCELLATIONTOKEN_H
+
+#include "timer.h"
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace Signal {
+
+/**
+ * @brief The CancellationToken class should tell a long running computation
+ * that its result is no longer needed.
+ *
+ * Processing::Task::run makes the token of a task current for the thread
+ * that runs Operation::process. Operations and transforms call checkpoint()
+ * between parts of their work, which throws Cancelled if the current token
+ * has been cancelled. Task::run catches Cancelled and discards the task.
+ *
+ * A token is cancelled explicitly with cancel() or when 'still_needed'
+ * returns false. 'still_needed' is polled by cancelled() at most once every
+ * 'poll_interval' seconds, so checkpoints are cheap to call often.
+ *
+ * Threads started by an operation share the token of the calling thread
+ * with Scope(CancellationToken::current ()).
+ */
+class CancellationToken
+{
+public:
+    typedef std::shared_ptr<CancellationToken> ptr;
+
+    class Cancelled: public std::exception {
+    public:
+        const char* what() const noexcept override { return "Signal::CancellationToken::Cancelled"; }
+    };
+
+    /**
+     * @brief The Scope class makes a token current for this thread during
+     * the lifetime of Scope. The caller keeps the token alive, 'token' may be
+     * null.
+     */
+    class Scope {
+    public:
+        Scope(CancellationToken* token);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        CancellationToken* previous_;
+    };
+
+    CancellationToken(std::function<bool()> still_needed=std::function<bool()>(), double poll_interval=0.005);
+    CancellationToken(const CancellationToken&) = delete;
+    CancellationToken& operator=(const CancellationToken&) = delete;
+
+    void cancel();
+    bool cancelled();
+
+    /**
+     * @brief poll checks 'still_needed' right away and cancels this token if
+     * it returns false.
+     * @return !cancelled()
+     */
+    bool poll();
+
+    /**
+     * @brief current is the token of this thread, or null.
+     */
+    static CancellationToken* current();
+
+    /**
+     * @brief checkpoint throws Cancelled if the current token of this thread
+     * has been cancelled. Does nothing if there is no current token.
+     */
+    static void checkpoint();
+
+private:
+    std::function<bool()> still_needed_;
+    const double poll_interval_;
+    std::atomic<bool> cancelled_;
+    std::mutex poll_lock_;
+    Timer since_poll_;
+
+public:
+    static void test();
+};
+
+} // namespace Signal
+
+#endif // SIGNAL_CANCELLATIONTOKEN_H
@@ -14,7 +14,32 @@ public:
 };
 
 
-class ComputingCpu: public ComputingEngine {};
+/**
+ * @brief The ComputingCpu class should compute on the cpu.
+ *
+ * A ComputingCpu with a Placement has its worker thread pinned to 'core' on
+ * NUMA node 'node' and prefers tasks from partition 'partition' out of
+ * 'partitions' equal parts of each target, see NumaTopology and
+ * TargetSchedule.
+ */
+class ComputingCpu: public ComputingEngine {
+public:
+    struct Placement {
+        int core;
+        int node;
+        int partition;
+        int partitions;
+    };
+
+    ComputingCpu() : placement_{-1, -1, 0, 1} {}
+    explicit ComputingCpu(const Placement& placement) : placement_(placement) {}
+
+    const Placement& placement() const { return placement_; }
+
+private:
+    Placement placement_;
+};
+
 class ComputingCuda: public ComputingEngine {};
 class ComputingOpenCL: public ComputingEngine {};
 class DiscAccessThread: public ComputingEngine {};
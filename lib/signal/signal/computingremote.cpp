@@ -0,0 +1,662 @@
+#include "computingremote.h"
+#include "buffer.h"
+
+#include "exceptionassert.h"
+#include "log.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+
+#ifndef _WIN32
+    #include <errno.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <sys/socket.h>
+    #include <sys/types.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+    #define MSG_NOSIGNAL 0
+#endif
+
+namespace Signal {
+
+#ifndef _WIN32
+
+static bool write_all(int fd, const void* p, size_t n)
+{
+    const char* c = (const char*)p;
+    while (n > 0)
+    {
+        ssize_t r = ::send (fd, c, n, MSG_NOSIGNAL);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return false;
+        c += r;
+        n -= r;
+    }
+    return true;
+}
+
+
+static bool read_all(int fd, void* p, size_t n)
+{
+    char* c = (char*)p;
+    while (n > 0)
+    {
+        ssize_t r = ::recv (fd, c, n, 0);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return false;
+        c += r;
+        n -= r;
+    }
+    return true;
+}
+
+
+static void throw_remote(const std::string& message)
+{
+    BOOST_THROW_EXCEPTION(RemoteError() << remote_message(message) << Backtrace::make ());
+}
+
+
+/**
+ * Both ends run on the same kind of machine, so values are sent in host byte
+ * order.
+ *
+ * A string is a uint32_t length followed by its characters.
+ *
+ * A buffer is the first sample as an int64_t, the number of channels as an
+ * int32_t, the number of samples as an int64_t, the sample rate as a float
+ * and then the samples of each channel.
+ *
+ * A request is a description string followed by a buffer. A reply is a
+ * uint8_t status, 0 means a buffer follows and 1 means an error string
+ * follows.
+ *
+ * Sizes are checked before anything is allocated, a peer that sends a
+ * larger string or buffer than below is treated as a lost connection.
+ */
+static const uint32_t max_string_length = 1 << 16;
+static const int32_t max_channels = 1 << 10;
+static const int64_t max_buffer_samples = 1 << 27; // times channels, 512 MB
+
+static bool write_string(int fd, const std::string& s)
+{
+    uint32_t n = s.size ();
+    return write_all (fd, &n, sizeof(n)) && write_all (fd, s.data (), n);
+}
+
+
+static bool read_string(int fd, std::string& s)
+{
+    uint32_t n;
+    if (!read_all (fd, &n, sizeof(n)) || n > max_string_length)
+        return false;
+    s.resize (n);
+    return 0 == n || read_all (fd, &s[0], n);
+}
+
+
+static bool write_buffer(int fd, const Buffer& b)
+{
+    int64_t first = b.getInterval ().first;
+    int32_t channels = b.number_of_channels ();
+    int64_t samples = b.number_of_samples ();
+    float fs = b.sample_rate ();
+
+    if (!write_all (fd, &first, sizeof(first)) ||
+        !write_all (fd, &channels, sizeof(channels)) ||
+        !write_all (fd, &samples, sizeof(samples)) ||
+        !write_all (fd, &fs, sizeof(fs)))
+        return false;
+
+    for (int c=0; c<channels; c++)
+    {
+        const float* p = b.getChannel (c)->waveform_data ()->getCpuMemory ();
+        if (!write_all (fd, p, samples*sizeof(float)))
+            return false;
+    }
+
+    return true;
+}
+
+
+static pBuffer read_buffer(int fd)
+{
+    int64_t first;
+    int32_t channels;
+    int64_t samples;
+    float fs;
+
+    if (!read_all (fd, &first, sizeof(first)) ||
+        !read_all (fd, &channels, sizeof(channels)) ||
+        !read_all (fd, &samples, sizeof(samples)) ||
+        !read_all (fd, &fs, sizeof(fs)))
+        return pBuffer();
+
+    if (channels < 1 || channels > max_channels ||
+        samples < 1 || samples > max_buffer_samples / channels ||
+        !(fs > 0) || first < Interval::IntervalType_MIN || first > Interval::IntervalType_MAX - samples)
+        return pBuffer();
+
+    pBuffer b(new Buffer(Interval(first, first + samples), fs, channels));
+    for (int c=0; c<channels; c++)
+    {
+        float* p = b->getChannel (c)->waveform_data ()->getCpuMemory ();
+        if (!read_all (fd, p, samples*sizeof(float)))
+            return pBuffer();
+    }
+
+    return b;
+}
+
+#endif
+
+
+class RemoteOperation: public Operation
+{
+public:
+    RemoteOperation(ComputingRemote* engine, const std::string& description)
+        :
+          engine_(engine),
+          description_(description)
+    {}
+
+    pBuffer process(pBuffer b) override
+    {
+        return engine_->process (description_, b);
+    }
+
+private:
+    ComputingRemote* engine_;
+    std::string description_;
+};
+
+
+ComputingRemote::
+        ComputingRemote(int fd)
+    :
+      fd_(fd)
+{
+}
+
+
+ComputingRemote::
+        ~ComputingRemote()
+{
+#ifndef _WIN32
+    ::close (fd_);
+#endif
+}
+
+
+ComputingEngine::ptr ComputingRemote::
+        connect(const std::string& host, int port)
+{
+#ifndef _WIN32
+    addrinfo hints, *res = 0;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    std::string service = std::to_string (port);
+    int r = getaddrinfo (host.c_str (), service.c_str (), &hints, &res);
+    EXCEPTION_ASSERTX(0 == r, std::string("Can't resolve ") + host + ": " + gai_strerror (r));
+
+    int fd = -1;
+    for (addrinfo* a = res; a && fd < 0; a = a->ai_next)
+    {
+        fd = ::socket (a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && 0 != ::connect (fd, a->ai_addr, a->ai_addrlen))
+        {
+            ::close (fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo (res);
+
+    EXCEPTION_ASSERTX(fd >= 0, std::string("Can't connect to ") + host + ":" + service);
+
+    // Requests are written in several pieces
+    int one = 1;
+    setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    return ComputingEngine::ptr(new ComputingRemote(fd));
+#else
+    EXCEPTION_ASSERTX(false, "ComputingRemote is not supported on this platform");
+    return ComputingEngine::ptr();
+#endif
+}
+
+
+pBuffer ComputingRemote::
+        process(const std::string& description, pBuffer b)
+{
+#ifndef _WIN32
+    std::lock_guard<std::mutex> l(mutex_);
+
+    if (!write_string (fd_, description) || !write_buffer (fd_, *b))
+        throw_remote ("Lost connection to helper process");
+
+    uint8_t status;
+    if (!read_all (fd_, &status, sizeof(status)))
+        throw_remote ("Lost connection to helper process");
+
+    if (0 != status)
+    {
+        std::string message;
+        if (!read_string (fd_, message))
+            message = "Lost connection to helper process";
+        throw_remote (message);
+    }
+
+    pBuffer r = read_buffer (fd_);
+    if (!r)
+        throw_remote ("Lost connection to helper process");
+
+    return r;
+#else
+    EXCEPTION_ASSERTX(false, "ComputingRemote is not supported on this platform");
+    return b;
+#endif
+}
+
+
+void ComputingRemote::
+        serve(int fd, Factory factory)
+{
+#ifndef _WIN32
+    ComputingCpu cpu;
+    std::string description;
+
+    while (read_string (fd, description))
+    {
+        pBuffer b = read_buffer (fd);
+        if (!b)
+            break;
+
+        pBuffer r;
+        std::string error;
+        try
+        {
+            OperationDesc::ptr od = factory (description);
+            if (!od)
+                error = "Unknown operation '" + description + "'";
+            else
+            {
+                Operation::ptr o = od.read ()->createOperation (&cpu);
+                if (!o)
+                    error = "Operation '" + description + "' is not supported by ComputingCpu";
+                else
+                    r = o->process (b);
+
+                if (error.empty () && !r)
+                    error = "Operation '" + description + "' returned no data";
+            }
+        }
+        catch (const std::exception& x)
+        {
+            error = x.what ();
+            if (error.empty ())
+                error = "Operation '" + description + "' failed";
+        }
+
+        uint8_t status = error.empty () ? 0 : 1;
+        bool ok = write_all (fd, &status, sizeof(status));
+        if (ok)
+            ok = status ? write_string (fd, error) : write_buffer (fd, *r);
+        if (!ok)
+            break;
+    }
+
+    ::close (fd);
+#else
+    (void)fd;
+    (void)factory;
+    EXCEPTION_ASSERTX(false, "ComputingRemote is not supported on this platform");
+#endif
+}
+
+
+void ComputingRemote::
+        listen(int port, Factory factory, const std::string& bind_address)
+{
+#ifndef _WIN32
+    addrinfo hints, *res = 0;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    std::string service = std::to_string (port);
+    int r = getaddrinfo (bind_address.c_str (), service.c_str (), &hints, &res);
+    EXCEPTION_ASSERTX(0 == r, std::string("Can't resolve ") + bind_address + ": " + gai_strerror (r));
+
+    int one = 1;
+    int s = -1;
+    for (addrinfo* a = res; a && s < 0; a = a->ai_next)
+    {
+        s = ::socket (a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (s < 0)
+            continue;
+
+        setsockopt (s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (0 != ::bind (s, a->ai_addr, a->ai_addrlen))
+        {
+            ::close (s);
+            s = -1;
+        }
+    }
+    freeaddrinfo (res);
+
+    EXCEPTION_ASSERTX(s >= 0, "Can't bind to " + bind_address + ":" + service);
+    EXCEPTION_ASSERTX(0 == ::listen (s, 16), "Can't listen on " + bind_address + ":" + service);
+
+    Log("ComputingRemote: serving on %s:%d") % bind_address % port;
+
+    for (;;)
+    {
+        int fd = ::accept (s, 0, 0);
+        if (fd < 0 && errno == EINTR)
+            continue;
+        if (fd < 0)
+            break;
+
+        setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::thread(&ComputingRemote::serve, fd, factory).detach ();
+    }
+
+    ::close (s);
+#else
+    (void)port;
+    (void)factory;
+    (void)bind_address;
+    EXCEPTION_ASSERTX(false, "ComputingRemote is not supported on this platform");
+#endif
+}
+
+
+ComputingRemote::Launcher::
+        Launcher(int helpers, Factory factory)
+{
+#ifndef _WIN32
+    std::vector<int> fds;
+    for (int i=0; i<helpers; i++)
+    {
+        int sv[2];
+        EXCEPTION_ASSERTX(0 == socketpair (AF_UNIX, SOCK_STREAM, 0, sv), "Can't create socket pair");
+
+        pid_t pid = fork ();
+        EXCEPTION_ASSERTX(pid >= 0, "Can't fork helper process");
+
+        if (0 == pid)
+        {
+            // Don't keep the sockets of previous helpers open, they should
+            // see the connection close when the Launcher is destroyed.
+            for (int fd: fds)
+                ::close (fd);
+            ::close (sv[0]);
+
+            serve (sv[1], factory);
+            _exit (0);
+        }
+
+        ::close (sv[1]);
+        fds.push_back (sv[0]);
+        pids_.push_back (pid);
+        engines_.push_back (ComputingEngine::ptr(new ComputingRemote(sv[0])));
+    }
+#else
+    (void)helpers;
+    (void)factory;
+    EXCEPTION_ASSERTX(false, "ComputingRemote is not supported on this platform");
+#endif
+}
+
+
+ComputingRemote::Launcher::
+        ~Launcher()
+{
+    // Closes the sockets, which makes the helpers exit
+    engines_.clear ();
+
+#ifndef _WIN32
+    for (int pid: pids_)
+        waitpid (pid, 0, 0);
+#endif
+}
+
+
+RemoteOperationDesc::
+        RemoteOperationDesc(OperationDesc::ptr wrap, const std::string& description)
+    :
+      OperationDescWrapper(wrap),
+      description_(description)
+{
+}
+
+
+OperationDesc::ptr RemoteOperationDesc::
+        copy() const
+{
+    return OperationDesc::ptr(new RemoteOperationDesc(getWrappedOperationDesc (), description_));
+}
+
+
+Operation::ptr RemoteOperationDesc::
+        createOperation(ComputingEngine* engine) const
+{
+    if (ComputingRemote* remote = dynamic_cast<ComputingRemote*>(engine))
+        return Operation::ptr(new RemoteOperation(remote, description_));
+
+    return OperationDescWrapper::createOperation (engine);
+}
+
+
+QString RemoteOperationDesc::
+        toString() const
+{
+    return OperationDescWrapper::toString ();
+}
+
+} // namespace Signal
+
+#include "test/randombuffer.h"
+#include "decimate.h"
+#include "tasktimer.h"
+#include "timer.h"
+#include "trace_perf.h"
+
+#include <cmath>
+
+namespace Signal {
+
+/**
+ * @brief The BusyDesc class is a cpu bound operation that costs the same for
+ * every sample.
+ */
+class BusyDesc: public OperationDesc
+{
+public:
+    class Operation: public Signal::Operation
+    {
+    public:
+        pBuffer process(pBuffer b) override
+        {
+            for (int c=0; c<b->number_of_channels (); c++)
+            {
+                float* p = b->getChannel (c)->waveform_data ()->getCpuMemory ();
+                for (IntervalType i=0; i<(IntervalType)b->number_of_samples (); i++)
+                {
+                    float v = p[i];
+                    for (int k=0; k<64; k++)
+                        v = std::sin(v + 1.f);
+                    p[i] = v;
+                }
+            }
+            return b;
+        }
+    };
+
+    Interval requiredInterval( const Interval& I, Interval* expectedOutput ) const override
+    {
+        if (expectedOutput)
+            *expectedOutput = I;
+        return I;
+    }
+    Interval affectedInterval( const Interval& I ) const override { return I; }
+    OperationDesc::ptr copy() const override { return OperationDesc::ptr(new BusyDesc); }
+    Signal::Operation::ptr createOperation(ComputingEngine*) const override
+    {
+        return Signal::Operation::ptr(new Operation);
+    }
+};
+
+
+static OperationDesc::ptr testFactory(const std::string& description)
+{
+    if ("busy" == description)
+        return OperationDesc::ptr(new BusyDesc);
+    if ("decimate" == description)
+        return OperationDesc::ptr(new DecimateDesc(1));
+    if ("throw" == description)
+        EXCEPTION_ASSERTX(false, "It should fail");
+    return OperationDesc::ptr();
+}
+
+
+/**
+ * @brief processRemote processes 'chunks' buffers of 'samples' samples each
+ * with one thread per helper and returns the elapsed time.
+ */
+static double processRemote(const ComputingRemote::Launcher& launcher, int chunks, int samples)
+{
+    std::vector<pBuffer> input;
+    for (int i=0; i<chunks; i++)
+        input.push_back (Test::RandomBuffer::randomBuffer (Interval(i*samples, (i+1)*samples), 44100, 1));
+
+    Timer t;
+    std::vector<std::thread> threads;
+    int helpers = launcher.engines ().size ();
+    for (int h=0; h<helpers; h++)
+        threads.push_back (std::thread([&input, &launcher, h, helpers]()
+        {
+            ComputingRemote* remote = dynamic_cast<ComputingRemote*>(launcher.engines ()[h].get ());
+            for (size_t i=h; i<input.size (); i+=helpers)
+                input[i] = remote->process ("busy", input[i]);
+        }));
+
+    for (std::thread& th : threads)
+        th.join ();
+
+    return t.elapsed ();
+}
+
+
+void ComputingRemote::
+        test()
+{
+#ifndef _WIN32
+    // It should process a buffer in a helper process
+    {
+        Launcher launcher(1, testFactory);
+        EXCEPTION_ASSERT_EQUALS(launcher.engines ().size (), 1u);
+
+        OperationDesc::ptr od(new DecimateDesc(1));
+        RemoteOperationDesc rod(od, "decimate");
+        Interval expected;
+        Interval I = rod.requiredInterval (Interval(0,100), &expected);
+        EXCEPTION_ASSERT_EQUALS(expected, Interval(0,100));
+
+        pBuffer b = Test::RandomBuffer::randomBuffer (I, 1000, 2);
+        pBuffer local = od.read ()->createOperation (0)->process (b);
+
+        Operation::ptr o = rod.createOperation (launcher.engines ()[0].get ());
+        EXCEPTION_ASSERT(dynamic_cast<RemoteOperation*>(o.get ()));
+        pBuffer remote = o->process (b);
+        EXCEPTION_ASSERT(*local == *remote);
+        EXCEPTION_ASSERT_EQUALS(remote->sample_rate (), 500.f);
+
+        // It should behave as the wrapped operation for other engines
+        ComputingCpu cpu;
+        o = rod.createOperation (&cpu);
+        EXCEPTION_ASSERT(!dynamic_cast<RemoteOperation*>(o.get ()));
+        EXCEPTION_ASSERT(*local == *o->process (b));
+    }
+
+    // It should rethrow errors from the helper process
+    {
+        Launcher launcher(1, testFactory);
+        ComputingRemote* remote = dynamic_cast<ComputingRemote*>(launcher.engines ()[0].get ());
+        pBuffer b = Test::RandomBuffer::randomBuffer (Interval(0,10), 1000, 1);
+
+        for (std::string description : {"throw", "unknown"})
+        {
+            bool thrown = false;
+            try {
+                remote->process (description, b);
+            } catch (const RemoteError& x) {
+                thrown = true;
+                EXCEPTION_ASSERT(boost::get_error_info<remote_message>(x));
+            }
+            EXCEPTION_ASSERT(thrown);
+        }
+
+        // And the connection should still be usable afterwards
+        pBuffer r = remote->process ("busy", b);
+        EXCEPTION_ASSERT_EQUALS(r->getInterval (), b->getInterval ());
+    }
+
+    // It should reject strings and buffers larger than the protocol allows
+    {
+        int sv[2];
+        EXCEPTION_ASSERT_EQUALS(0, socketpair (AF_UNIX, SOCK_STREAM, 0, sv));
+
+        uint32_t n = max_string_length + 1;
+        std::string str;
+        EXCEPTION_ASSERT(write_all (sv[0], &n, sizeof(n)));
+        EXCEPTION_ASSERT(!read_string (sv[1], str));
+        EXCEPTION_ASSERT(str.empty ());
+
+        int64_t first = 0, samples = max_buffer_samples;
+        int32_t channels = 2;
+        float fs = 1;
+        EXCEPTION_ASSERT(write_all (sv[0], &first, sizeof(first)));
+        EXCEPTION_ASSERT(write_all (sv[0], &channels, sizeof(channels)));
+        EXCEPTION_ASSERT(write_all (sv[0], &samples, sizeof(samples)));
+        EXCEPTION_ASSERT(write_all (sv[0], &fs, sizeof(fs)));
+        EXCEPTION_ASSERT(!read_buffer (sv[1]));
+
+        ::close (sv[0]);
+        ::close (sv[1]);
+    }
+
+    // It should scale throughput with the number of helper processes. The
+    // speedup depends on the machine and is only logged, see TRACE_PERF.
+    {
+        const int chunks = 32, samples = 1<<13;
+        double T[3];
+        int helpers[3] = {1, 2, 4};
+        for (int i=0; i<3; i++)
+        {
+            Launcher launcher(helpers[i], testFactory);
+            processRemote (launcher, helpers[i], 16); // warm up
+
+            TRACE_PERF("ComputingRemote should process 32 chunks with " + std::to_string (helpers[i]) + " helpers");
+            T[i] = processRemote (launcher, chunks, samples);
+            TaskInfo("%d helper processes: %g samples/s, %.2fx the speed of one helper",
+                     helpers[i], chunks*samples/T[i], T[0]/T[i]);
+        }
+    }
+#endif
+}
+
+} // namespace Signal
@@ -0,0 +1,140 @@
+#ifndef SIGNAL_COMPUTINGREMOTE_H
+#define SIGNAL_COMPUTINGREMOTE_H
+
+#include "computingengine.h"
+#include "operationwrapper.h"
+
+#include <boost/exception/exception.hpp>
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Signal {
+
+class RemoteError: public virtual boost::exception, public virtual std::exception {};
+typedef boost::error_info<struct remote_message_tag, std::string> remote_message;
+
+
+/**
+ * @brief The ComputingRemote class should run operations in a helper process.
+ *
+ * A worker thread for a ComputingRemote engine sends a description of the
+ * operation together with its input buffer to the helper process over a
+ * socket. The helper creates the operation for a ComputingCpu engine,
+ * processes the buffer and sends back the result. The result is then written
+ * to the cache of the Step like any other result.
+ *
+ * An OperationDesc can't be serialized in general. The helper instead gets a
+ * description string that its Factory turns into an OperationDesc, see
+ * RemoteOperationDesc. It is up to the application to use the same
+ * descriptions in both processes.
+ *
+ * Exceptions thrown by the helper are rethrown locally as RemoteError.
+ *
+ * Only available on posix systems.
+ */
+class ComputingRemote: public ComputingEngine
+{
+public:
+    typedef std::function<OperationDesc::ptr(const std::string& description)> Factory;
+
+    /**
+     * @brief ComputingRemote takes ownership of a connected socket 'fd'.
+     */
+    explicit ComputingRemote(int fd);
+    ~ComputingRemote();
+
+    /**
+     * @brief connect opens a TCP connection to a helper started with listen.
+     */
+    static ComputingEngine::ptr connect(const std::string& host, int port);
+
+    /**
+     * @brief process sends 'b' to the helper and blocks until it has been
+     * processed by the operation described by 'description'.
+     */
+    pBuffer process(const std::string& description, pBuffer b);
+
+    /**
+     * @brief serve processes requests from 'fd' until the other end is
+     * closed. Runs in the helper process.
+     */
+    static void serve(int fd, Factory factory);
+
+    /**
+     * @brief listen accepts TCP connections on 'port' and serves each of them
+     * from a thread of its own. Never returns unless the socket fails.
+     *
+     * Connections are not authenticated, anyone who can connect can run the
+     * operations of 'factory'. So only the local machine can connect unless
+     * 'bind_address' says otherwise.
+     */
+    static void listen(int port, Factory factory, const std::string& bind_address = "127.0.0.1");
+
+    /**
+     * @brief The Launcher class should spawn helper processes on the local
+     * machine.
+     *
+     * Each helper is a fork of this process connected through a socket
+     * pair. The factory is called in the helper. The helpers exit when the
+     * Launcher is destroyed.
+     *
+     * Create the Launcher before the process starts any other threads, i.e
+     * early in main. Only the forking thread exists in a helper, so any lock
+     * that another thread held at the fork, such as one in malloc, is never
+     * released in the helper.
+     */
+    class Launcher
+    {
+    public:
+        Launcher(int helpers, Factory factory);
+        ~Launcher();
+
+        Launcher(const Launcher&) = delete;
+        Launcher& operator=(const Launcher&) = delete;
+
+        const std::vector<ComputingEngine::ptr>& engines() const { return engines_; }
+
+    private:
+        std::vector<ComputingEngine::ptr> engines_;
+        std::vector<int> pids_;
+    };
+
+private:
+    std::mutex mutex_;
+    int fd_;
+
+public:
+    static void test();
+};
+
+
+/**
+ * @brief The RemoteOperationDesc class should make an OperationDesc
+ * computable by a ComputingRemote engine.
+ *
+ * It behaves as the wrapped OperationDesc for any other engine. The
+ * description is what the helper process gets to recreate the wrapped
+ * OperationDesc.
+ */
+class RemoteOperationDesc: public OperationDescWrapper
+{
+public:
+    RemoteOperationDesc(OperationDesc::ptr wrap, const std::string& description);
+
+    const std::string& description() const { return description_; }
+
+    // OperationDesc
+    OperationDesc::ptr copy() const override;
+    Operation::ptr createOperation(ComputingEngine* engine=0) const override;
+    QString toString() const override;
+
+private:
+    std::string description_;
+};
+
+} // namespace Signal
+
+#endif // SIGNAL_COMPUTINGREMOTE_H
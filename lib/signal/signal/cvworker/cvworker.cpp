@@ -1,6 +1,7 @@
 #include "cvworker.h"
 #include "log.h"
 #include "demangle.h"
+#include "signal/numatopology.h"
 #include "signal/processing/task.h"
 #include "tasktimer.h"
 #include "logtickfrequency.h"
@@ -45,6 +46,8 @@ CvWorker::CvWorker(
         }
 #endif
 
+        Signal::NumaTopology::pinCurrentThread (computing_engine.get ());
+
         LogTickFrequency ltf_wakeups;
         LogTickFrequency ltf_tasks;
         Timer last_wakeup;
@@ -67,7 +70,9 @@ CvWorker::CvWorker(
                 {
                     DEBUGINFO TaskTimer tt(boost::format("cvworker: running task %s") % task.expected_output());
                     task.run();
-                    active_time_since_start_ += work_timer.elapsed ();
+                    double T = work_timer.elapsed ();
+                    active_time_since_start_ += T;
+                    Signal::NumaTopology::record (computing_engine.get (), task.expected_output().count (), T);
                     bedroom->wakeup (); // make idle workers wakeup to check if they can do something, won't affect busy workers
 
                     INFO {
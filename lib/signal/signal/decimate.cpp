@@ -0,0 +1,319 @@
+#include "decimate.h"
+#include "cancellationtoken.h"
+
+#include "exceptionassert.h"
+#include "neat_math.h"
+
+#include <cmath>
+#include <sstream>
+
+namespace Signal {
+
+// Half the length of the halfband filter, 47 taps in total
+static const int halfband_support = 23;
+
+
+static IntervalType floor_div2(IntervalType x)
+{
+    return x/2 - (x < 0 && x%2);
+}
+
+
+static IntervalType ceil_div2(IntervalType x)
+{
+    return x/2 + (x > 0 && x%2);
+}
+
+
+/**
+ * @brief halfbandCoefficients is a Blackman windowed sinc with its cutoff at
+ * a quarter of the sample rate. Every other coefficient except the center
+ * one is zero.
+ */
+static const std::vector<float>& halfbandCoefficients()
+{
+    static const std::vector<float> c = []()
+    {
+        const int h = halfband_support;
+        std::vector<double> d(2*h + 1);
+        double sum = 0;
+        for (int k=-h; k<=h; k++)
+        {
+            double x = M_PI*k/2;
+            double sinc = k ? std::sin(x)/x : 1;
+            double w = 0.42 + 0.5*std::cos(M_PI*k/(h+1)) + 0.08*std::cos(2*M_PI*k/(h+1));
+            d[k+h] = 0 == k || k%2 ? sinc*w : 0;
+            sum += d[k+h];
+        }
+
+        std::vector<float> f(d.size ());
+        for (size_t i=0; i<d.size (); i++)
+            f[i] = d[i]/sum;
+        return f;
+    }();
+
+    return c;
+}
+
+
+DecimateDesc::Operation::
+        Operation(int levels)
+    :
+      levels_(levels)
+{
+}
+
+
+pBuffer DecimateDesc::Operation::
+        process(pBuffer b)
+{
+    for (int l=0; l<levels_; l++)
+    {
+        CancellationToken::checkpoint ();
+        b = DecimateDesc::halve (*b);
+    }
+
+    return b;
+}
+
+
+DecimateDesc::
+        DecimateDesc(int levels)
+    :
+      levels_(levels)
+{
+    EXCEPTION_ASSERT_LESS_OR_EQUAL(0, levels);
+}
+
+
+Interval DecimateDesc::
+        requiredInterval( const Interval& I, Interval* expectedOutput ) const
+{
+    if (expectedOutput)
+        *expectedOutput = I;
+
+    // Unbounded ends stay unbounded and the rest saturates, like
+    // Intervals::enlarge
+    const IntervalType h = halfband_support;
+    IntervalType first = I.first, last = I.last;
+    for (int l=0; l<levels_; l++)
+    {
+        // 2*first - h and 2*(last - 1) + h + 1
+        if (first != Interval::IntervalType_MIN)
+            first = clamped_add(clamped_add(first, first), -h);
+        if (last != Interval::IntervalType_MAX)
+            last = clamped_add(clamped_add(last, last), h - 1);
+    }
+
+    return Interval(first, last);
+}
+
+
+Interval DecimateDesc::
+        affectedInterval( const Interval& I ) const
+{
+    // Unbounded ends stay unbounded, see requiredInterval
+    const IntervalType h = halfband_support;
+    IntervalType first = I.first, last = I.last;
+    for (int l=0; l<levels_; l++)
+    {
+        // ceil((first - h)/2) and floor((last - 1 + h)/2) + 1
+        if (first != Interval::IntervalType_MIN)
+            first = ceil_div2(clamped_add(first, -h));
+        if (last != Interval::IntervalType_MAX)
+            last = floor_div2(clamped_add(last, h - 1)) + 1;
+    }
+
+    return Interval(first, last);
+}
+
+
+Region DecimateDesc::
+        affectedRegion( const Region& R ) const
+{
+    Region A = OperationDesc::affectedRegion (R);
+
+    // Frequencies near the cutoff alias, see halfbandCoefficients
+    float f1 = std::ldexp(R.f1 (), levels_);
+    float f2 = std::ldexp(R.f2 (), levels_);
+    if (f2 >= Region::nyquist/2)
+        return A;
+
+    return Region(A.samples (), f1, f2);
+}
+
+
+OperationDesc::ptr DecimateDesc::
+        copy() const
+{
+    return OperationDesc::ptr(new DecimateDesc(levels_));
+}
+
+
+Signal::Operation::ptr DecimateDesc::
+        createOperation(ComputingEngine*) const
+{
+    return Signal::Operation::ptr(new DecimateDesc::Operation(levels_));
+}
+
+
+QString DecimateDesc::
+        toString() const
+{
+    std::stringstream ss;
+    ss << "Decimate by " << factor ();
+    return QString::fromStdString (ss.str());
+}
+
+
+pBuffer DecimateDesc::
+        halve(const Buffer& b)
+{
+    const int h = halfband_support;
+    const std::vector<float>& c = halfbandCoefficients ();
+
+    // y[n] = sum_k c[k] x[2n - k] for k in [-h, h]
+    Interval I = b.getInterval ();
+    Interval J(ceil_div2(I.first + h), floor_div2(I.last - 1 - h) + 1);
+    EXCEPTION_ASSERT_LESS(J.first, J.last);
+
+    pBuffer r(new Buffer(J, b.sample_rate ()/2, b.number_of_channels ()));
+    for (int ch=0; ch<b.number_of_channels (); ch++)
+    {
+        const float* x = b.getChannel (ch)->waveform_data ()->getCpuMemory ();
+        float* y = r->getChannel (ch)->waveform_data ()->getCpuMemory ();
+
+        // x[i] is input sample I.first + i, start at the center of y[0]
+        const float* center = x + (2*J.first - I.first);
+        for (IntervalType n=0; n<(IntervalType)J.count (); n++)
+        {
+            const float* p = center + 2*n;
+            float v = c[h] * p[0];
+            for (int k=1; k<=h; k+=2)
+                v += c[h+k] * (p[-k] + p[k]);
+            y[n] = v;
+        }
+    }
+
+    return r;
+}
+
+
+int DecimateDesc::
+        support()
+{
+    return halfband_support;
+}
+
+} // namespace Signal
+
+#include "test/randombuffer.h"
+
+namespace Signal {
+
+static pBuffer sine(Interval I, float fs, float hz)
+{
+    pBuffer b(new Buffer(I, fs, 1));
+    float* p = b->getChannel (0)->waveform_data ()->getCpuMemory ();
+    for (IntervalType i=0; i<(IntervalType)I.count (); i++)
+        p[i] = std::sin(2*M_PI*hz*(I.first + i)/fs);
+    return b;
+}
+
+
+static float maxabs(const Buffer& b)
+{
+    float m = 0;
+    const float* p = b.getChannel (0)->waveform_data ()->getCpuMemory ();
+    for (IntervalType i=0; i<(IntervalType)b.number_of_samples (); i++)
+        m = std::max(m, std::fabs(p[i]));
+    return m;
+}
+
+
+void DecimateDesc::
+        test()
+{
+    // It should lower the sample rate of a signal by a power of two
+    {
+        DecimateDesc d(2);
+        EXCEPTION_ASSERT_EQUALS(d.factor (), 4);
+
+        Interval I(-10, 90), expected;
+        Interval J = d.requiredInterval (I, &expected);
+        EXCEPTION_ASSERT_EQUALS(expected, I);
+        EXCEPTION_ASSERT_EQUALS(J, Interval(4*I.first - 3*support (), 4*(I.last-1) + 3*support () + 1));
+
+        pBuffer b = Test::RandomBuffer::randomBuffer (J, 1000, 2);
+        pBuffer r = d.createOperation ()->process (b);
+        EXCEPTION_ASSERT_EQUALS(r->getInterval (), I);
+        EXCEPTION_ASSERT_EQUALS(r->sample_rate (), 250.f);
+        EXCEPTION_ASSERT_EQUALS(r->number_of_channels (), 2);
+
+        // affectedInterval should be exactly the output samples that read a
+        // given input sample
+        Interval x(400, 401);
+        Interval A = d.affectedInterval (x);
+        EXCEPTION_ASSERT(d.requiredInterval (Interval(A.first, A.first+1), 0) & x);
+        EXCEPTION_ASSERT(d.requiredInterval (Interval(A.last-1, A.last), 0) & x);
+        EXCEPTION_ASSERT(!(d.requiredInterval (Interval(A.first-1, A.first), 0) & x));
+        EXCEPTION_ASSERT(!(d.requiredInterval (Interval(A.last, A.last+1), 0) & x));
+
+        // The frequencies of the input are higher relative to the lower
+        // sample rate
+        Region R = d.affectedRegion (Region(x, 0.01, 0.02));
+        EXCEPTION_ASSERT_EQUALS(R, Region(A, 0.04, 0.08));
+        EXCEPTION_ASSERT(d.affectedRegion (Region(x, 0.05, 0.1)).allFrequencies ());
+    }
+
+    // It should keep unbounded ends of intervals unbounded, see
+    // Intervals::enlarge
+    {
+        DecimateDesc d(2);
+        const IntervalType MIN = Interval::IntervalType_MIN, MAX = Interval::IntervalType_MAX;
+
+        EXCEPTION_ASSERT_EQUALS(d.requiredInterval (Interval::Interval_ALL, 0), Interval::Interval_ALL);
+        EXCEPTION_ASSERT_EQUALS(d.affectedInterval (Interval::Interval_ALL), Interval::Interval_ALL);
+        EXCEPTION_ASSERT(d.affectedRegion (Region(Interval::Interval_ALL)).samples () == Intervals::Intervals_ALL);
+
+        Interval R = d.requiredInterval (Interval(-10, 90), 0);
+        EXCEPTION_ASSERT_EQUALS(d.requiredInterval (Interval(MIN, 90), 0), Interval(MIN, R.last));
+        EXCEPTION_ASSERT_EQUALS(d.requiredInterval (Interval(-10, MAX), 0), Interval(R.first, MAX));
+
+        Interval A = d.affectedInterval (Interval(-10, 90));
+        EXCEPTION_ASSERT_EQUALS(d.affectedInterval (Interval(MIN, 90)), Interval(MIN, A.last));
+        EXCEPTION_ASSERT_EQUALS(d.affectedInterval (Interval(-10, MAX)), Interval(A.first, MAX));
+
+        // Bounded ends saturate instead of overflowing
+        EXCEPTION_ASSERT_EQUALS(d.requiredInterval (Interval(MIN+1, MAX-1), 0), Interval::Interval_ALL);
+        Interval B = d.affectedInterval (Interval(MIN+1, MAX-1));
+        EXCEPTION_ASSERT_LESS(B.first, 0);
+        EXCEPTION_ASSERT_LESS(0, B.last);
+    }
+
+    // It should not alias frequencies above the new nyquist frequency
+    {
+        DecimateDesc d(1);
+        float fs = 1000;
+        Interval I(0, 200);
+        Interval J = d.requiredInterval (I, 0);
+
+        pBuffer low = d.createOperation ()->process (sine(J, fs, fs/16));
+        pBuffer high = d.createOperation ()->process (sine(J, fs, 0.42f*fs));
+        EXCEPTION_ASSERT_LESS(0.999f, maxabs(*low));
+        EXCEPTION_ASSERT_LESS(maxabs(*low), 1.001f);
+        EXCEPTION_ASSERT_LESS(maxabs(*high), 0.001f);
+
+        // A pyramid of two levels gives the same result as a single
+        // decimation by four
+        DecimateDesc d2(2);
+        J = d2.requiredInterval (I, 0);
+        pBuffer b = sine(J, fs, fs/32);
+        pBuffer r2 = d2.createOperation ()->process (b);
+        pBuffer r11 = d.createOperation ()->process (d.createOperation ()->process (b));
+        EXCEPTION_ASSERT(*r2 == *r11);
+        EXCEPTION_ASSERT_LESS(0.999f, maxabs(*r2));
+    }
+}
+
+} // namespace Signal
@@ -0,0 +1,76 @@
+#ifndef SIGNAL_DECIMATE_H
+#define SIGNAL_DECIMATE_H
+
+#include "signal/operation.h"
+
+#include <vector>
+
+namespace Signal {
+
+/**
+ * @brief The DecimateDesc class should lower the sample rate of a signal by
+ * a power of two without aliasing.
+ *
+ * Each level applies a halfband lowpass filter and drops every other sample.
+ * The output keeps frequencies up to 0.2 times the input sample rate per
+ * level, frequencies above 0.3 times the input sample rate are attenuated by
+ * more than 50 dB.
+ *
+ * Intervals in the output are in units of the decimated sample rate, i.e
+ * output sample 'n' is centered on input sample 'n*factor()'. Steps that read
+ * from a DecimateDesc use those units as well.
+ *
+ * A decimated signal is cached like any other Step. Chaining several
+ * DecimateDesc(1) gives a signal pyramid where each level is computed from the
+ * previous one.
+ */
+class DecimateDesc: public Signal::OperationDesc
+{
+public:
+    class Operation: public Signal::Operation
+    {
+    public:
+        Operation(int levels);
+
+        Signal::pBuffer process(Signal::pBuffer b) override;
+
+    private:
+        int levels_;
+    };
+
+    DecimateDesc(int levels=1);
+
+    int levels() const { return levels_; }
+    int factor() const { return 1 << levels_; }
+
+    // OperationDesc
+    Interval requiredInterval( const Interval& I, Interval* expectedOutput ) const override;
+    Interval affectedInterval( const Interval& I ) const override;
+    Region affectedRegion( const Region& R ) const override;
+    OperationDesc::ptr copy() const override;
+    Signal::Operation::ptr createOperation(ComputingEngine* engine=0) const override;
+    QString toString() const override;
+
+    /**
+     * @brief halve applies one level of decimation to 'b'.
+     * @return a buffer at half the sample rate. It is shorter than half of 'b'
+     * by the support of the filter in each end.
+     */
+    static pBuffer halve(const Buffer& b);
+
+    /**
+     * @brief support is the number of input samples in each direction needed
+     * to compute one output sample of one level.
+     */
+    static int support();
+
+private:
+    int levels_;
+
+public:
+    static void test();
+};
+
+} // namespace Signal
+
+#endif // SIGNAL_DECIMATE_H
@@ -0,0 +1,304 @@
+#include "numatopology.h"
+
+#include "exceptionassert.h"
+
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define NUMATOPOLOGY_THREAD_LOCAL __declspec(thread)
+#else
+#define NUMATOPOLOGY_THREAD_LOCAL thread_local
+#endif
+
+namespace Signal {
+
+static NUMATOPOLOGY_THREAD_LOCAL int current_node = -1;
+static std::mutex statistics_lock;
+static std::vector<NumaTopology::NodeStatistics> node_statistics;
+
+
+/**
+ * @brief parseList parses a list like "0-3,8-11" from /sys.
+ */
+static std::vector<int> parseList(const std::string& list)
+{
+    std::vector<int> r;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline (ss, range, ','))
+    {
+        int a, b;
+        char dash;
+        std::stringstream rs(range);
+        if (!(rs >> a))
+            continue;
+        if (!(rs >> dash >> b))
+            b = a;
+        for (int i=a; i<=b; i++)
+            r.push_back (i);
+    }
+    return r;
+}
+
+
+static std::string readLine(const std::string& path)
+{
+    std::ifstream f(path);
+    std::string line;
+    std::getline (f, line);
+    return line;
+}
+
+
+NumaTopology::
+        NumaTopology()
+{
+#ifdef __linux__
+    // Only use the cores this process is allowed to run on
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (0 != sched_getaffinity (0, sizeof(allowed), &allowed))
+        for (int i=0; i<CPU_SETSIZE; i++)
+            CPU_SET(i, &allowed);
+
+    for (int node : parseList (readLine ("/sys/devices/system/node/online")))
+    {
+        std::stringstream path;
+        path << "/sys/devices/system/node/node" << node << "/cpulist";
+        std::vector<int> cores;
+        for (int core : parseList (readLine (path.str ())))
+            if (core < CPU_SETSIZE && CPU_ISSET(core, &allowed))
+                cores.push_back (core);
+        if (!cores.empty ())
+            nodes_.push_back (cores);
+    }
+#endif
+
+    if (nodes_.empty ())
+    {
+        int n = std::max(1u, std::thread::hardware_concurrency ());
+        nodes_.push_back (std::vector<int>());
+        for (int i=0; i<n; i++)
+            nodes_.back ().push_back (i);
+    }
+}
+
+
+NumaTopology::
+        NumaTopology(const Nodes& nodes)
+    :
+      nodes_(nodes)
+{
+    EXCEPTION_ASSERT(!nodes_.empty ());
+    for (const std::vector<int>& cores : nodes_)
+        EXCEPTION_ASSERT(!cores.empty ());
+}
+
+
+NumaTopology NumaTopology::
+        simulated(int nodes)
+{
+    EXCEPTION_ASSERT_LESS(0, nodes);
+
+    std::vector<int> cores;
+    for (const std::vector<int>& n : NumaTopology().nodes ())
+        cores.insert (cores.end (), n.begin (), n.end ());
+
+    // Split the cores in contiguous groups, a core is shared by several
+    // nodes if there are more nodes than cores
+    Nodes r(nodes);
+    int per_node = std::max(1, (int)cores.size () / nodes);
+    for (int i=0; i<nodes; i++)
+        for (int j=0; j<per_node; j++)
+            r[i].push_back (cores[(i*per_node + j) % cores.size ()]);
+
+    return NumaTopology(r);
+}
+
+
+int NumaTopology::
+        cores() const
+{
+    int n = 0;
+    for (const std::vector<int>& cores : nodes_)
+        n += cores.size ();
+    return n;
+}
+
+
+std::vector<ComputingEngine::ptr> NumaTopology::
+        engines(int count) const
+{
+    std::vector<ComputingEngine::ptr> r;
+    int N = nodes_.size ();
+    for (int i=0; i<count; i++)
+    {
+        // Consecutive partitions are placed on the same node
+        int node = i*N / count;
+        int index_on_node = i - (node*count + N - 1) / N;
+        const std::vector<int>& cores = nodes_[node];
+
+        ComputingCpu::Placement p;
+        p.core = cores[index_on_node % cores.size ()];
+        p.node = node;
+        p.partition = i;
+        p.partitions = count;
+        r.push_back (ComputingEngine::ptr(new ComputingCpu(p)));
+    }
+
+    return r;
+}
+
+
+bool NumaTopology::
+        pinCurrentThread(const ComputingEngine* engine)
+{
+    const ComputingCpu* cpu = dynamic_cast<const ComputingCpu*>(engine);
+    if (!cpu || cpu->placement ().core < 0)
+        return false;
+
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu->placement ().core, &set);
+    if (0 != pthread_setaffinity_np (pthread_self (), sizeof(set), &set))
+        return false;
+
+    current_node = cpu->placement ().node;
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+int NumaTopology::
+        currentNode()
+{
+    return current_node;
+}
+
+
+void NumaTopology::
+        record(const ComputingEngine* engine, UnsignedIntervalType samples, double seconds)
+{
+    const ComputingCpu* cpu = dynamic_cast<const ComputingCpu*>(engine);
+    if (!cpu || cpu->placement ().node < 0)
+        return;
+
+    std::lock_guard<std::mutex> l(statistics_lock);
+    size_t node = cpu->placement ().node;
+    if (node_statistics.size () <= node)
+        node_statistics.resize (node + 1);
+
+    NodeStatistics& s = node_statistics[node];
+    s.tasks++;
+    s.samples += samples;
+    s.seconds += seconds;
+}
+
+
+std::vector<NumaTopology::NodeStatistics> NumaTopology::
+        statistics()
+{
+    std::lock_guard<std::mutex> l(statistics_lock);
+    return node_statistics;
+}
+
+
+void NumaTopology::
+        reset_statistics()
+{
+    std::lock_guard<std::mutex> l(statistics_lock);
+    node_statistics.clear ();
+}
+
+
+void NumaTopology::
+        test()
+{
+    // It should find at least one node with at least one core
+    {
+        NumaTopology t;
+        EXCEPTION_ASSERT_LESS(0u, t.nodes ().size ());
+        EXCEPTION_ASSERT_LESS(0, t.cores ());
+
+        EXCEPTION_ASSERT(parseList ("0-3,8,10-11") == std::vector<int>({0,1,2,3,8,10,11}));
+    }
+
+    // It should place consecutive partitions on the same node
+    {
+        NumaTopology t(Nodes{{0,1,2,3},{4,5,6,7}});
+        std::vector<ComputingEngine::ptr> e = t.engines (6);
+        EXCEPTION_ASSERT_EQUALS(e.size (), 6u);
+
+        int nodes[6] = {0,0,0,1,1,1};
+        int cores[6] = {0,1,2,4,5,6};
+        for (int i=0; i<6; i++)
+        {
+            const ComputingCpu::Placement& p = dynamic_cast<ComputingCpu*>(e[i].get ())->placement ();
+            EXCEPTION_ASSERT_EQUALS(p.node, nodes[i]);
+            EXCEPTION_ASSERT_EQUALS(p.core, cores[i]);
+            EXCEPTION_ASSERT_EQUALS(p.partition, i);
+            EXCEPTION_ASSERT_EQUALS(p.partitions, 6);
+        }
+
+        // More engines than cores share cores on the node
+        e = t.engines (10);
+        EXCEPTION_ASSERT_EQUALS(dynamic_cast<ComputingCpu*>(e[4].get ())->placement ().core, 0);
+        EXCEPTION_ASSERT_EQUALS(dynamic_cast<ComputingCpu*>(e[9].get ())->placement ().core, 4);
+    }
+
+    // It should split the cores of a machine into simulated nodes
+    {
+        NumaTopology t = NumaTopology::simulated (2);
+        EXCEPTION_ASSERT_EQUALS(t.nodes ().size (), 2u);
+        EXCEPTION_ASSERT_EQUALS(t.nodes ()[0].size (), t.nodes ()[1].size ());
+    }
+
+    // It should pin the worker thread of a placed engine and collect
+    // statistics per node
+    {
+        NumaTopology t = NumaTopology::simulated (2);
+        std::vector<ComputingEngine::ptr> e = t.engines (2);
+        ComputingCpu unplaced;
+
+        int node = -2;
+        bool pinned = false;
+        std::thread([&]() {
+            pinned = pinCurrentThread (e[1].get ());
+            node = currentNode ();
+        }).join ();
+
+        EXCEPTION_ASSERT(!pinCurrentThread (&unplaced));
+        EXCEPTION_ASSERT_EQUALS(currentNode (), -1);
+#ifdef __linux__
+        EXCEPTION_ASSERT(pinned);
+        EXCEPTION_ASSERT_EQUALS(node, 1);
+#endif
+
+        reset_statistics ();
+        record (e[0].get (), 100, 0.5);
+        record (e[1].get (), 10, 0.25);
+        record (e[1].get (), 20, 0.25);
+        record (&unplaced, 1000, 1);
+
+        std::vector<NodeStatistics> s = statistics ();
+        EXCEPTION_ASSERT_EQUALS(s.size (), 2u);
+        EXCEPTION_ASSERT_EQUALS(s[0].tasks, 1);
+        EXCEPTION_ASSERT_EQUALS(s[1].tasks, 2);
+        EXCEPTION_ASSERT_EQUALS(s[1].samples, 30);
+        EXCEPTION_ASSERT_EQUALS(s[1].seconds, 0.5);
+        reset_statistics ();
+    }
+}
+
+} // namespace Signal
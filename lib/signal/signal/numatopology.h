@@ -0,0 +1,83 @@
+#ifndef SIGNAL_NUMATOPOLOGY_H
+#define SIGNAL_NUMATOPOLOGY_H
+
+#include "computingengine.h"
+#include "intervals.h"
+
+#include <vector>
+
+namespace Signal {
+
+/**
+ * @brief The NumaTopology class should place workers on the cores of each
+ * NUMA node so that the memory they use is local to the node.
+ *
+ * Linux allocates a page on the node of the thread that first touches it.
+ * Cache chunks are written by the worker that computed them, and operations
+ * allocate their scratch buffers in the worker thread, so a pinned worker
+ * gets node local memory without a NUMA library. Each worker is given a
+ * partition of each target so that it keeps working on adjacent time ranges,
+ * and workers on the same node get adjacent partitions.
+ *
+ * The topology is read from /sys/devices/system/node on Linux. Other
+ * platforms, or a machine with a single node, have one node with all cores.
+ * NumaTopology::simulated splits the cores into several nodes to test the
+ * placement on a machine with a single node.
+ */
+class NumaTopology
+{
+public:
+    // The cores of each node
+    typedef std::vector<std::vector<int>> Nodes;
+
+    struct NodeStatistics {
+        int tasks = 0;
+        double samples = 0;
+        double seconds = 0;
+    };
+
+    NumaTopology();
+    explicit NumaTopology(const Nodes& nodes);
+
+    static NumaTopology simulated(int nodes);
+
+    const Nodes& nodes() const { return nodes_; }
+    int cores() const;
+
+    /**
+     * @brief engines creates 'count' ComputingCpu engines spread evenly over
+     * the nodes.
+     */
+    std::vector<ComputingEngine::ptr> engines(int count) const;
+
+    /**
+     * @brief pinCurrentThread pins the calling thread to the core of
+     * 'engine' if it is a ComputingCpu with a placement.
+     * @return false if the thread wasn't pinned.
+     */
+    static bool pinCurrentThread(const ComputingEngine* engine);
+
+    /**
+     * @brief currentNode is the node the calling thread was pinned to by
+     * pinCurrentThread, or -1.
+     */
+    static int currentNode();
+
+    /**
+     * @brief record adds a finished task to the statistics of the node of
+     * 'engine'. Does nothing for engines without a placement.
+     */
+    static void record(const ComputingEngine* engine, UnsignedIntervalType samples, double seconds);
+    static std::vector<NodeStatistics> statistics();
+    static void reset_statistics();
+
+private:
+    Nodes nodes_;
+
+public:
+    static void test();
+};
+
+} // namespace Signal
+
+#endif // SIGNAL_NUMATOPOLOGY_H
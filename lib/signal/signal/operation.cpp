@@ -4,6 +4,8 @@
 
 #include <boost/foreach.hpp>
 
+#include <future>
+
 
 //#define TIME_OPERATION
 #define TIME_OPERATION if(0)
@@ -14,6 +16,8 @@
 
 namespace Signal {
 
+static std::atomic<unsigned long long> content_id_counter(0);
+
 
 void Operation::
         test(ptr o, OperationDesc* desc)
@@ -27,6 +31,67 @@ void Operation::
 }
 
 
+Signal::pBuffer AsyncOperation::
+        process(Signal::pBuffer b)
+{
+    std::promise<Signal::pBuffer> p;
+    std::future<Signal::pBuffer> f = p.get_future ();
+
+    processAsync (b, [&p](Signal::pBuffer r, std::exception_ptr x)
+    {
+        if (x)
+            p.set_exception (x);
+        else
+            p.set_value (r);
+    });
+
+    return f.get ();
+}
+
+
+OperationDesc::
+        OperationDesc()
+    :
+      content_id_(++content_id_counter)
+{
+}
+
+
+OperationDesc::
+        OperationDesc(const OperationDesc& b)
+    :
+      invalidator_(b.invalidator_),
+      content_id_(++content_id_counter)
+{
+}
+
+
+OperationDesc& OperationDesc::
+        operator=(const OperationDesc& b)
+{
+    invalidator_ = b.invalidator_;
+    renew_content_id ();
+    return *this;
+}
+
+
+Region OperationDesc::
+        affectedRegion( const Region& R ) const
+{
+    Intervals A;
+    for (const Interval& i : R.samples ())
+        A |= affectedInterval (i);
+
+    return Region(A);
+}
+
+
+void OperationDesc::
+        deprecatedInput( const Region& ) const
+{
+}
+
+
 OperationDesc::Extent OperationDesc::
         extent() const
 {
@@ -34,6 +99,13 @@ OperationDesc::Extent OperationDesc::
 }
 
 
+OperationDesc::ptr OperationDesc::
+        fuse(const OperationDesc&) const
+{
+    return OperationDesc::ptr();
+}
+
+
 QString OperationDesc::
         toString() const
 {
@@ -55,6 +127,20 @@ Signal::Processing::IInvalidator::ptr OperationDesc::
 }
 
 
+unsigned long long OperationDesc::
+        content_id() const
+{
+    return content_id_;
+}
+
+
+void OperationDesc::
+        renew_content_id()
+{
+    content_id_ = ++content_id_counter;
+}
+
+
 bool OperationDesc::
         operator==(const OperationDesc& d) const
 {
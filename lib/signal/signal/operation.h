@@ -4,6 +4,7 @@
 //signal
 #include "buffer.h"
 #include "intervals.h"
+#include "region.h"
 #include "processing/iinvalidator.h"
 
 // gpumisc
@@ -13,6 +14,10 @@
 // QString
 #include <QtCore> // QString
 
+#include <atomic>
+#include <exception>
+#include <functional>
+
 namespace Signal {
 
 namespace Processing { class Step; }
@@ -54,6 +59,10 @@ public:
      *       an empty buffer if it isn't. This may typically happen if settings
      *       are changed after the call to requiredInterval but before the call
      *       to process()
+     *
+     * Long running operations should call Signal::CancellationToken::checkpoint()
+     * between parts of their work to stop early when the result isn't needed
+     * anymore.
      */
     virtual Signal::pBuffer process(Signal::pBuffer b) = 0;
 
@@ -62,6 +71,37 @@ public:
 };
 
 
+/**
+ * @brief The AsyncOperation class should process data without occupying the
+ * calling thread while it waits, for instance on a disc read or on another
+ * process.
+ *
+ * Processing::Task starts an AsyncOperation and returns, the worker is then
+ * free to pick another task. The task is finished when 'done' is called.
+ */
+class SignalDll AsyncOperation: public Operation
+{
+public:
+    /**
+     * @brief Done receives the processed data, or the exception that was
+     * thrown while processing.
+     */
+    typedef std::function<void(Signal::pBuffer, std::exception_ptr)> Done;
+
+    /**
+     * @brief processAsync starts processing 'b' and returns without waiting
+     * for the result. 'done' must be called exactly once, from any thread,
+     * unless processAsync throws.
+     */
+    virtual void processAsync(Signal::pBuffer b, Done done) = 0;
+
+    /**
+     * @brief process blocks until processAsync is done.
+     */
+    Signal::pBuffer process(Signal::pBuffer b) override;
+};
+
+
 /**
  * @brief The OperationDesc class should describe the interface for creating instances of the Operation interface.
  *
@@ -76,6 +116,10 @@ public:
     typedef shared_state<const OperationDesc> const_ptr;
     typedef shared_state_traits_backtrace shared_state_traits;
 
+    OperationDesc();
+    OperationDesc(const OperationDesc&);
+    OperationDesc& operator=(const OperationDesc&);
+
     /**
       Virtual housekeeping.
       */
@@ -106,6 +150,28 @@ public:
     virtual Interval affectedInterval( const Interval& I ) const = 0;
 
 
+    /**
+     * @brief affectedRegion is the part of the output that needs to be
+     * recomputed if the input changes within 'R'.
+     *
+     * The default is the samples given by affectedInterval for all
+     * frequencies. Operations that only change the signal within a frequency
+     * band, or that know where the frequencies of their input end up, can do
+     * better so that targets may skip updating parts that didn't change.
+     */
+    virtual Region affectedRegion( const Region& R ) const;
+
+
+    /**
+     * @brief deprecatedInput is called by GraphInvalidator after the input
+     * of this operation has changed within 'R', when no Step is locked. An
+     * operation that keeps results outside of the Step cache can use it to
+     * forget them. Does nothing by default, affectedRegion should not have
+     * side effects.
+     */
+    virtual void deprecatedInput( const Region& R ) const;
+
+
     /**
      * @brief copy creates a copy of 'this'.
      * @return a copy.
@@ -152,6 +218,17 @@ public:
     virtual Extent extent() const;
 
 
+    /**
+     * @brief fuse describes an operation that computes the output of 'this'
+     * directly from the input of 'previous' in one pass, as if 'previous' was
+     * applied first. FirstMissAlgorithm uses this to skip a step with a
+     * missing cache when it is only read by the next step.
+     * @return a new description, or null if 'this' can't be fused with
+     * 'previous'. The default is to not fuse anything.
+     */
+    virtual OperationDesc::ptr fuse(const OperationDesc& previous) const;
+
+
     /**
      * Returns a string representation of this operation. Mainly used for debugging.
      */
@@ -169,6 +246,19 @@ public:
     Signal::Processing::IInvalidator::ptr getInvalidator() const;
 
 
+    /**
+     * @brief content_id identifies the results of this instance. It is unique
+     * for each instance, copies get a new id, and is renewed by
+     * renew_content_id when the parameters or the data of this instance
+     * changes. Used by Processing::ResultStore to recognize results of a
+     * previous chain.
+     *
+     * Thread-safe, doesn't need a lock of 'this'.
+     */
+    unsigned long long content_id() const;
+    void renew_content_id();
+
+
     /**
      * @brief operator == checks if two instances of OperationDesc would generate
      * identical instances of Operation. The default behaviour is to just check
@@ -198,6 +288,8 @@ private:
      * at multiple locations in the Dag.
      */
     Signal::Processing::IInvalidator::ptr invalidator_;
+
+    std::atomic<unsigned long long> content_id_;
 };
 
 } // namespace Signal
@@ -64,6 +64,28 @@ Interval OperationDescWrapper::
 }
 
 
+Region OperationDescWrapper::
+        affectedRegion( const Region& R ) const
+{
+    // The samples from affectedInterval of this, which may be overridden,
+    // but the frequencies from the wrapped operation
+    Region A = OperationDesc::affectedRegion (R);
+    if (!wrap_)
+        return Region(A.samples (), R.f1 (), R.f2 ());
+
+    Region W = wrap_.read ()->affectedRegion (R);
+    return Region(A.samples (), W.f1 (), W.f2 ());
+}
+
+
+void OperationDescWrapper::
+        deprecatedInput( const Region& R ) const
+{
+    if (wrap_)
+        wrap_.read ()->deprecatedInput (R);
+}
+
+
 OperationDesc::ptr OperationDescWrapper::
         copy() const
 {
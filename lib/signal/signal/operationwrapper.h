@@ -29,6 +29,8 @@ public:
 
     virtual Signal::Interval requiredInterval( const Signal::Interval& I, Signal::Interval* expectedOutput ) const;
     virtual Interval affectedInterval( const Interval& I ) const;
+    virtual Region affectedRegion( const Region& R ) const;
+    virtual void deprecatedInput( const Region& R ) const;
     virtual OperationDesc::ptr copy() const;
     virtual Operation::ptr createOperation(ComputingEngine* engine) const;
     virtual Extent extent() const;
@@ -5,6 +5,7 @@
 #include "reversegraph.h"
 #include "graphinvalidator.h"
 #include "bedroomnotifier.h"
+#include "signal/numatopology.h"
 #include "signal/qteventworker/qteventworkerfactory.h"
 #include "signal/cvworker/cvworkerfactory.h"
 
@@ -12,6 +13,7 @@
 #include "demangle.h"
 #include "timer.h"
 #include "tasktimer.h"
+#include "datastorage.h"
 
 #include <boost/foreach.hpp>
 #include <boost/graph/breadth_first_search.hpp>
@@ -24,7 +26,7 @@ namespace Processing {
 
 
 Chain::ptr Chain::
-        createDefaultChain()
+        createDefaultChain(const NumaTopology* placement)
 {
     Dag::ptr dag(new Dag);
     Bedroom::ptr bedroom(new Bedroom);
@@ -40,17 +42,32 @@ Chain::ptr Chain::
     int reserved_threads = 0;
     reserved_threads++; // OpenGL rendering
     reserved_threads++; // 1 ComputingCpu
-    workers.write ()->addComputingEngine(Signal::ComputingEngine::ptr(new Signal::ComputingCpu));
-    for (int i=0; i<QThread::idealThreadCount ()-reserved_threads; i++) {
-        workers.write ()->addComputingEngine(Signal::ComputingEngine::ptr(new Signal::ComputingCpu));
-    }
 
     Chain::ptr chain(new Chain(dag, targets, workers, bedroom, notifier));
+    if (placement)
+        chain->placement_.reset (new NumaTopology(*placement));
+
+    chain->addCpuWorkers (*workers.write (), 1 + std::max(0, QThread::idealThreadCount ()-reserved_threads));
 
     return chain;
 }
 
 
+void Chain::
+        addCpuWorkers(Workers& workers, int count) const
+{
+    if (placement_)
+    {
+        for (Signal::ComputingEngine::ptr e : placement_->engines (count))
+            workers.addComputingEngine(e);
+        return;
+    }
+
+    for (int i=0; i<count; i++)
+        workers.addComputingEngine(Signal::ComputingEngine::ptr(new Signal::ComputingCpu));
+}
+
+
 Chain::
         ~Chain()
 {
@@ -141,13 +158,25 @@ IInvalidator::ptr Chain::
 {
     EXCEPTION_ASSERT (at);
 
-    Step::ptr::weak_ptr step = insertStep(*dag_.get (), desc, at);
+    if (Step::ptr target_step = at->step().lock())
+        results_->stash (*dag_.read (), target_step);
+
+    Step::ptr::weak_ptr step = insertStep(*dag_.write (), desc, at);
 
     IInvalidator::ptr graph_invalidator( new GraphInvalidator {dag_, notifier_, step});
 
     desc.write ()->setInvalidator( graph_invalidator );
 
-    graph_invalidator->deprecateCache (Signal::Interval::Interval_ALL);
+    {
+        // Invalidate without renewing desc::content_id, the operation itself
+        // hasn't changed and may have results in results_ from before.
+        auto dag = dag_.write ();
+        if (Step::ptr s = step.lock ())
+            GraphInvalidator::deprecateCache (*dag, s, Signal::Interval::Interval_ALL);
+        restoreResults (*dag);
+    }
+
+    bedroom_->wakeup();
 
     return graph_invalidator;
 }
@@ -162,26 +191,37 @@ void Chain::
     if (!step)
         return;
 
-    auto dag = dag_.write ();
+    std::vector<Step::ptr> steps_to_remove;
+    {
+        auto dag = dag_.read ();
 
-    GraphVertex v = dag->getVertex (step);
-    if (!v)
-        return;
+        GraphVertex v = dag->getVertex (step);
+        if (!v)
+            return;
 
-    const Graph& g = dag->g ();
+        const Graph& g = dag->g ();
 
-    std::vector<Step::ptr> steps_to_remove;
-    BOOST_FOREACH(GraphEdge e, in_edges(v, g)) {
-        Step::ptr s = g[source(e, g)];
-        steps_to_remove.push_back (s);
+        BOOST_FOREACH(GraphEdge e, in_edges(v, g)) {
+            Step::ptr s = g[source(e, g)];
+            steps_to_remove.push_back (s);
+        }
+
+        BOOST_FOREACH(Step::ptr s, steps_to_remove)
+            results_->stash (*dag, s);
     }
 
+    auto dag = dag_.write ();
+
     BOOST_FOREACH(Step::ptr s, steps_to_remove) {
-        GraphInvalidator::deprecateCache (*dag, s, Signal::Interval::Interval_ALL);
+        if (!dag->getVertex (s))
+            continue;
+
         TaskInfo("chain: removing %s", Step::operation_desc (s)->toString().toStdString().c_str());
-        dag->removeStep (s);
+        removeStep (*dag, s);
     }
 
+    restoreResults (*dag);
+
     bedroom_->wakeup();
 }
 
@@ -189,20 +229,31 @@ void Chain::
 void Chain::
         removeOperation(Signal::OperationDesc::ptr operation)
 {
-    auto dag = dag_.write ();
-
-    const Graph& g = dag->g();
     std::set<Step::ptr> S;
-    BOOST_FOREACH(GraphVertex u, vertices(g)) {
-        if (Step::operation_desc(g[u]) == operation)
-            S.insert (g[u]);
+    {
+        auto dag = dag_.read ();
+
+        const Graph& g = dag->g();
+        BOOST_FOREACH(GraphVertex u, vertices(g)) {
+            if (Step::operation_desc(g[u]) == operation)
+                S.insert (g[u]);
+        }
+
+        for(Step::ptr step:S)
+            results_->stash (*dag, step);
     }
 
+    auto dag = dag_.write ();
+
     for(Step::ptr step:S)
     {
-        GraphInvalidator::deprecateCache(*dag, step, Signal::Interval::Interval_ALL);
-        dag->removeStep(step);
+        if (!dag->getVertex (step))
+            continue;
+
+        removeStep (*dag, step);
     }
+
+    restoreResults (*dag);
 }
 
 
@@ -246,7 +297,7 @@ Signal::OperationDesc::Extent Chain::
     if (!step)
         return E;
 
-    Graph rev; ReverseGraph::reverse_graph (dag_.read ()->g (), rev);
+    Graph rev; ReverseGraph::reverse_graph (Dag::snapshot (dag_)->g (), rev);
     GraphVertex at_vertex = ReverseGraph::find_first_vertex (rev, step);
 
     if (at_vertex)
@@ -284,6 +335,13 @@ Bedroom::ptr Chain::
 }
 
 
+ResultStore::ptr Chain::
+        results() const
+{
+    return results_;
+}
+
+
 void Chain::
         resetDefaultWorkers()
 {
@@ -314,8 +372,7 @@ void Chain::
             cpu_workers++;
 
     // Add worker threads to occupy all kernels
-    for (int i=cpu_workers; i<QThread::idealThreadCount (); i++)
-        workers->addComputingEngine(Signal::ComputingEngine::ptr(new Signal::ComputingCpu));
+    addCpuWorkers (*workers, QThread::idealThreadCount () - cpu_workers);
 
     auto dag = dag_.write ();
     BOOST_FOREACH (GraphVertex v, vertices(dag->g()))
@@ -333,8 +390,19 @@ Chain::
       targets_(targets),
       workers_(workers),
       bedroom_(bedroom),
-      notifier_(notifier)
+      notifier_(notifier),
+      results_(new ResultStore)
+{
+}
+
+
+void Chain::
+        restoreResults(const Dag& dag)
 {
+    if (size_t n = results_->restore (dag))
+        TaskInfo(boost::format("chain: restored %s from earlier results, %s restored in total")
+                 % DataStorageVoid::getMemorySizeText (n * sizeof(Signal::TimeSeriesData::element_type))
+                 % DataStorageVoid::getMemorySizeText (results_->restored_samples () * sizeof(Signal::TimeSeriesData::element_type)));
 }
 
 
@@ -382,6 +450,20 @@ Step::ptr::weak_ptr Chain::
     return step;
 }
 
+
+void Chain::
+        removeStep(Dag& dag, Step::ptr step)
+{
+    std::vector<Step::ptr> targets = dag.targetSteps (step);
+    dag.removeStep (step);
+
+    // Invalidate the targets after the edit has been published so that
+    // tasks scheduled from a snapshot with 'step' in it are discarded, see
+    // Step::finishTask
+    for (Step::ptr t : targets)
+        GraphInvalidator::deprecateCache (dag, t, Signal::Interval::Interval_ALL);
+}
+
 } // namespace Processing
 } // namespace Signal
 
@@ -389,6 +471,7 @@ Step::ptr::weak_ptr Chain::
 #include "test/operationmockups.h"
 #include "test/randombuffer.h"
 #include "signal/buffersource.h"
+#include "signal/operation-basic.h"
 #include <QtWidgets> // QApplication
 
 namespace Signal {
@@ -474,6 +557,89 @@ void Chain::
         chain = Chain::ptr ();
         EXCEPTION_ASSERT_LESS(t.elapsed (), 0.03);
     }
+
+    // It should not recompute the results of an operation that is removed
+    // and added again
+    {
+        Chain::ptr chain = Chain::createDefaultChain ();
+        Signal::OperationDesc::ptr target_desc(new OperationDescChainMock);
+        Signal::OperationDesc::ptr source_desc(new Signal::BufferSource(Test::RandomBuffer::smallBuffer ()));
+        Signal::OperationDesc::ptr filter_desc(new Test::TransparentOperationDesc);
+
+        TargetMarker::ptr target = chain->addTarget(target_desc);
+        chain->addOperationAt(source_desc, target);
+        chain->addOperationAt(filter_desc, target);
+
+        auto filter_step = [&]() {
+            auto dag = chain->dag_.read ();
+            return dag->sourceSteps (target->step ().lock ()).at (0);
+        };
+
+        pBuffer b = Test::RandomBuffer::smallBuffer ();
+        Step::ptr filter = filter_step();
+        int taskid = Step::registerTask (filter.write (), b->getInterval ());
+        Step::finishTask (filter, taskid, b);
+
+        chain->removeOperationsAt(target);
+        EXCEPTION_ASSERT(Step::operation_desc (filter_step()) == source_desc);
+
+        chain->addOperationAt(filter_desc, target);
+        EXCEPTION_ASSERT(filter_step() != filter);
+        EXCEPTION_ASSERT_EQUALS(Step::cache (filter_step())->samplesDesc (), Signal::Intervals(b->getInterval ()));
+        EXCEPTION_ASSERT_EQUALS(chain->results ()->restored_samples (), size_t(b->number_of_samples () * b->number_of_channels ()));
+
+        chain->workers()->rethrow_any_worker_exception();
+    }
+
+    // It should let workers process while the chain is edited continuously,
+    // see Dag::snapshot. Results computed from an edited snapshot should be
+    // discarded, see Step::finishTask.
+    {
+        Chain::ptr chain = Chain::createDefaultChain ();
+        {
+            auto workers = chain->workers ().write ();
+            chain->addCpuWorkers (*workers, std::max(0, 16 - (int)workers->n_workers ()));
+            EXCEPTION_ASSERT_LESS_OR_EQUAL(size_t(16), workers->n_workers ());
+        }
+
+        pBuffer b = Test::RandomBuffer::randomBuffer (Signal::Interval(0,1<<16), 44100, 1);
+        Signal::OperationDesc::ptr target_desc(new Test::TransparentOperationDesc);
+        Signal::OperationDesc::ptr source_desc(new Signal::BufferSource(b));
+
+        TargetMarker::ptr target = chain->addTarget(target_desc);
+        chain->addOperationAt(source_desc, target);
+        TargetNeeds::ptr needs = target->target_needs();
+
+        int edits = 100;
+        unsigned long version = Dag::snapshot (chain->dag_)->version ();
+        for (int i=0; i<edits; i++)
+        {
+            // Silence the whole signal while the filter is in the chain
+            Signal::OperationDesc::ptr filter_desc(new Signal::OperationSetSilent(b->getInterval ()));
+            IInvalidator::ptr invalidator = chain->addOperationAt(filter_desc, target);
+            needs->updateNeeds (b->getInterval (), Signal::Interval::IntervalType_MIN, 1<<10);
+            usleep(2000);
+            invalidator->deprecateCache (b->getInterval ());
+            chain->removeOperationsAt(target);
+        }
+
+        // Each edit published a snapshot
+        EXCEPTION_ASSERT_EQUALS(Dag::snapshot (chain->dag_)->version (), version + 2*edits);
+        EXCEPTION_ASSERT_EQUALS(Dag::snapshot (chain->dag_)->g ().num_vertices (), 2u);
+
+        // Without invalidating anything more the target should have caught
+        // up with the unfiltered source
+        needs->updateNeeds (b->getInterval (), Signal::Interval::IntervalType_MIN, 1<<10);
+        EXCEPTION_ASSERT(needs->sleep (1000));
+        EXCEPTION_ASSERT(!needs->out_of_date ());
+
+        Step::ptr target_step = target->step ().lock ();
+        EXCEPTION_ASSERT(target_step);
+        EXCEPTION_ASSERT_EQUALS(Step::cache (target_step)->samplesDesc (), Signal::Intervals(b->getInterval ()));
+        EXCEPTION_ASSERT(*b == *Step::cache (target_step)->read (b->getInterval ()));
+
+        chain->workers()->rethrow_any_worker_exception();
+    }
 }
 
 } // namespace Processing
@@ -8,8 +8,12 @@
 #include "iinvalidator.h"
 #include "inotifier.h"
 #include "bedroom.h"
+#include "resultstore.h"
 
 namespace Signal {
+
+class NumaTopology;
+
 namespace Processing {
 
 class Workers;
@@ -23,6 +27,12 @@ class Workers;
  *
  * It should provide means to deprecate caches when the an added operation
  * changes (such as settings or contained data).
+ *
+ * It should keep the results of removed steps in a ResultStore and restore
+ * them when an edit, like undo/redo, recreates a step with the same content.
+ *
+ * It should optionally pin the cpu workers to the cores of each NUMA node,
+ * see NumaTopology.
  */
 class Chain
 {
@@ -30,7 +40,11 @@ public:
     typedef std::shared_ptr<Chain> ptr;
     typedef std::shared_ptr<const Chain> const_ptr;
 
-    static Chain::ptr createDefaultChain();
+    /**
+     * @brief createDefaultChain creates a chain with one cpu worker per core.
+     * @param placement places the cpu workers on its nodes if given.
+     */
+    static Chain::ptr createDefaultChain(const NumaTopology* placement=0);
 
     ~Chain();
 
@@ -72,6 +86,7 @@ public:
     Targets::ptr targets() const;
     shared_state<const Dag> dag() const;
     Bedroom::ptr bedroom() const;
+    ResultStore::ptr results() const;
 
     void resetDefaultWorkers();
     // Add jumping around with targets later.
@@ -82,11 +97,17 @@ private:
     shared_state<Workers> workers_;
     Bedroom::ptr bedroom_;
     INotifier::ptr notifier_;
+    ResultStore::ptr results_;
+    std::shared_ptr<const NumaTopology> placement_;
+
+    void addCpuWorkers(Workers& workers, int count) const;
 
     Chain(Dag::ptr, Targets::ptr targets, shared_state<Workers> workers, Bedroom::ptr bedroom, INotifier::ptr notifier);
 
     Step::ptr::weak_ptr createBranchStep (Dag& dag, Signal::OperationDesc::ptr desc, TargetMarker::ptr at, bool addbefore);
     Step::ptr::weak_ptr insertStep (Dag& dag, Signal::OperationDesc::ptr desc, TargetMarker::ptr at);
+    void removeStep (Dag& dag, Step::ptr step);
+    void restoreResults (const Dag& dag);
 
 public:
     static void test();
@@ -21,6 +21,38 @@ GraphVertex
 Dag::
         Dag()
 {
+    publish ();
+}
+
+
+Dag::
+        Dag(const Graph& g, unsigned long version)
+    :
+      g_(g),
+      version_(version)
+{
+    // The copy has new vertex descriptors
+    BOOST_FOREACH(GraphVertex v, vertices(g_))
+        map[g_[v]] = v;
+}
+
+
+Dag::Snapshot Dag::
+        snapshot(const Dag::ptr& dag)
+{
+    Dag* d = dag.raw ();
+    if (!d)
+        return Snapshot();
+
+    return std::atomic_load (&d->snapshot_);
+}
+
+
+void Dag::
+        publish()
+{
+    Snapshot s(new Dag(g_, ++version_));
+    std::atomic_store (&snapshot_, s);
 }
 
 
@@ -51,6 +83,7 @@ GraphVertex Dag::
         g_.add_edge (v, new_vertex);
     }
 
+    publish ();
     return new_vertex;
 }
 
@@ -83,6 +116,7 @@ GraphVertex Dag::
         g_.add_edge (new_vertex, v);
     }
 
+    publish ();
     return new_vertex;
 }
 
@@ -136,6 +170,7 @@ void Dag::
     g_.remove_vertex (v);
     g_.renumber_indices ();
     map.erase (step);
+    publish ();
 }
 
 
@@ -236,6 +271,39 @@ void Dag::
         EXCEPTION_ASSERT( dag.getVertex (step) == NullVertex() );
         EXCEPTION_ASSERT_EQUALS (dag.g ().num_vertices (), 1u );
     }
+
+    // It should publish an immutable snapshot of itself on each edit
+    {
+        Dag::ptr dag(new Dag);
+
+        Step::ptr step1(new Step(Signal::OperationDesc::ptr()));
+        Step::ptr step2(new Step(Signal::OperationDesc::ptr()));
+
+        Dag::Snapshot s0 = Dag::snapshot (dag);
+        EXCEPTION_ASSERT( s0 );
+        EXCEPTION_ASSERT_EQUALS( s0->g ().num_vertices (), 0u );
+
+        dag.write ()->appendStep (step1);
+        dag.write ()->appendStep (step2, dag.read ()->getVertex (step1));
+        Dag::Snapshot s2 = Dag::snapshot (dag);
+
+        EXCEPTION_ASSERT_EQUALS( s0->g ().num_vertices (), 0u );
+        EXCEPTION_ASSERT_EQUALS( s2->g ().num_vertices (), 2u );
+        EXCEPTION_ASSERT_EQUALS( s2->version (), s0->version () + 2 );
+        EXCEPTION_ASSERT_EQUALS( s2->version (), dag.read ()->version () );
+        EXCEPTION_ASSERT( s2->targetSteps (step1) == std::vector<Step::ptr>(1, step2) );
+        EXCEPTION_ASSERT( s2->getVertex (step1) != dag.read ()->getVertex (step1) );
+
+        // The snapshot can be read while the Dag is locked for writing
+        {
+            auto w = dag.write ();
+            w->removeStep (step1);
+            EXCEPTION_ASSERT( Dag::snapshot (dag)->sourceSteps (step2).empty () );
+            EXCEPTION_ASSERT( s2->sourceSteps (step2) == std::vector<Step::ptr>(1, step1) );
+        }
+
+        EXCEPTION_ASSERT( !Dag::snapshot (Dag::ptr()) );
+    }
 }
 
 
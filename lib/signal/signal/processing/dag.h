@@ -7,6 +7,8 @@
 
 #include <boost/graph/directed_graph.hpp>
 
+#include <memory>
+
 namespace Signal {
 namespace Processing {
 
@@ -20,14 +22,32 @@ GraphVertex NullVertex();
  * @brief The Dag class should manage the connections between the steps in the signal processing chain.
  *
  * It should treat Step's that aren't a part of the Dag as lonely islands.
+ *
+ * It should publish an immutable snapshot of itself on each edit so that
+ * the graph can be walked without locking the Dag, see Dag::snapshot.
  */
 class Dag
 {
 public:
     typedef shared_state<Dag> ptr;
+    typedef std::shared_ptr<const Dag> Snapshot;
 
     Dag();
 
+    /**
+     * @brief snapshot is a copy of 'dag' as of its latest edit. It is read
+     * without locking 'dag' and is never changed, an edit publishes a new
+     * snapshot instead. Schedulers and invalidators walk a snapshot so that
+     * editing the chain doesn't stall the workers.
+     * @return null if 'dag' is null.
+     */
+    static Snapshot snapshot(const Dag::ptr& dag);
+
+    /**
+     * @brief version is increased by each edit of the Dag.
+     */
+    unsigned long version() const { return version_; }
+
     const Graph& g() const { return g_; }
 
     /**
@@ -49,11 +69,18 @@ public:
     std::vector<Step::ptr> targetSteps(Step::ptr step) const;
 
 private:
+    Dag(const Graph& g, unsigned long version);
+
+    void publish();
+
     Graph g_;
 
     typedef std::map<Step::ptr, GraphVertex> StepVertexMap;
     StepVertexMap map;
 
+    unsigned long version_ = 0;
+    Snapshot snapshot_;
+
 public:
     static void test();
 };
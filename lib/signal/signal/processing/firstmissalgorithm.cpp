@@ -7,6 +7,7 @@
 #include "expectexception.h"
 #include "neat_math.h"
 #include "log.h"
+#include "trace_perf.h"
 
 #include <boost/foreach.hpp>
 #include <boost/graph/breadth_first_search.hpp>
@@ -47,20 +48,19 @@ public:
         if (*task)
             return;
 
+        std::vector<GraphVertex> sources;
+        Signal::OperationDesc::ptr o = fuse_sources(u, g, sources);
+
         // Compute what the sources have available
         Intervals missing_input;
-        BOOST_FOREACH(GraphEdge e, out_edges(u, g))
-          {
-            GraphVertex v = target(e,g);
+        for (GraphVertex v : sources)
             missing_input |= ~Step::cache (g[v])->samplesDesc();
-          }
 
-        Intervals required_input = try_create_task(u, g, missing_input);
+        Intervals required_input = try_create_task(u, g, o, sources, missing_input);
 
         // Update sources with needed samples
-        BOOST_FOREACH(GraphEdge e, out_edges(u, g))
+        for (GraphVertex v : sources)
           {
-            GraphVertex v = target(e,g);
             DEBUGINFO
             {
                 Intervals not_started = g[v].read ()->not_started ();
@@ -76,7 +76,65 @@ public:
       }
 
 
-    Signal::Intervals try_create_task(GraphVertex u, const Graph & g, const Signal::Intervals& all_missing_input)
+    /**
+     * @brief fuse_sources fuses 'u' with its source if the source is missing
+     * samples needed by 'u', the source has exactly one source of its own and
+     * 'u' is the only step that reads from it. Repeats for the source of the
+     * source and so on while OperationDesc::fuse succeeds.
+     *
+     * The skipped steps are not scheduled and their caches stay invalid.
+     *
+     * @param sources is set to the sources of the last fused step.
+     * @return the operation to compute 'u' from 'sources'.
+     */
+    Signal::OperationDesc::ptr fuse_sources(GraphVertex u, const Graph & g, std::vector<GraphVertex>& sources)
+      {
+        Signal::OperationDesc::ptr o = Step::operation_desc (g[u]);
+        Signal::Intervals I = needed[u] & g[u].read ()->not_started ();
+
+        for (GraphVertex w = u;;)
+          {
+            sources.clear ();
+            BOOST_FOREACH(GraphEdge e, out_edges(w, g))
+                sources.push_back (target(e,g));
+
+            if (!o || !I || 1 != sources.size ())
+                return o;
+
+            GraphVertex v = sources[0];
+            if (1 != in_degree(v, g) || 1 != out_degree(v, g))
+                return o;
+
+            Signal::Intervals required_input;
+            {
+                auto r = o.read ();
+                for (auto i : I)
+                    required_input |= r->requiredInterval (i, 0);
+            }
+
+            if (!(required_input & ~Step::cache (g[v])->samplesDesc()))
+                return o;
+
+            Signal::OperationDesc::ptr p = Step::operation_desc (g[v]);
+            if (!p)
+                return o;
+
+            Signal::OperationDesc::ptr f = o.read ()->fuse (*p.read ());
+            if (!f)
+                return o;
+
+            DEBUGINFO Log("firstmissing: fused %s with %s")
+                    % p->toString ().toStdString () % o->toString ().toStdString ();
+
+            o = f;
+            I = required_input;
+            w = v;
+          }
+      }
+
+
+    Signal::Intervals try_create_task(GraphVertex u, const Graph & g, Signal::OperationDesc::const_ptr o,
+                                      const std::vector<GraphVertex>& sources, const Signal::Intervals& all_missing_input)
     {
         // TODO could be more greedy, example: change parameters during recording
 
@@ -89,7 +147,9 @@ public:
 
         try
         {
-            Signal::OperationDesc::const_ptr o = Step::operation_desc (step_ptr);
+            if (!o)
+                return Signal::Intervals();
+
             Signal::Intervals I = needed[u] & step->not_started ();
             DEBUGINFO TaskInfo ti(format("firstmissing: %s, I: %s, all_missing_input: %s")
                                   % Step::operation_desc (step_ptr)->toString ().toStdString ()
@@ -152,7 +212,7 @@ public:
                 if( !missing_input )
                 {
                     // If there are no sources
-                    if( 0==out_degree(u, g) )
+                    if( sources.empty () )
                     {
                         // Then this operation must specify sample rate and number of
                         // samples for this to be a valid read. Otherwise the signal is
@@ -172,12 +232,8 @@ public:
                     {
                         // Create a task
                         std::vector<Step::const_ptr> children;
-
-                        BOOST_FOREACH(GraphEdge e, out_edges(u, g))
-                        {
-                            GraphVertex v = target(e,g);
+                        for (GraphVertex v : sources)
                             children.push_back (g[v]);
-                        }
 
                         *task = Task(step, g[u], children, operation, expected_output, required_input);
                         return Signal::Intervals(); // no need to compute further, we've got a task
@@ -252,6 +308,25 @@ Task FirstMissAlgorithm::
 }
 
 
+} // namespace Processing
+} // namespace Signal
+
+#include "test/operationmockups.h"
+
+namespace Signal {
+namespace Processing {
+
+class FusableOperationDescMock : public Test::TransparentOperationDesc
+{
+public:
+    OperationDesc::ptr fuse(const OperationDesc& previous) const override {
+        if (!dynamic_cast<const FusableOperationDescMock*>(&previous))
+            return OperationDesc::ptr();
+        return OperationDesc::ptr(new FusableOperationDescMock);
+    }
+};
+
+
 void FirstMissAlgorithm::
         test()
 {
@@ -290,6 +365,68 @@ void FirstMissAlgorithm::
         EXCEPTION_ASSERT_EQUALS(Step::cache (step)->samplesDesc(), Signal::Intervals(10,30));
     }
 
+    // It should fuse a step with its source if the source is missing samples
+    // and only read by this step, and compute it from the source of the source.
+    {
+        Signal::pBuffer b(new Buffer(Interval(0,100), 40, 1));
+        Step::ptr source(new Step(Signal::OperationDesc::ptr(new BufferSource(b))));
+        Step::ptr a(new Step(Signal::OperationDesc::ptr(new FusableOperationDescMock)));
+        Step::ptr c(new Step(Signal::OperationDesc::ptr(new FusableOperationDescMock)));
+        Step::ptr d(new Step(Signal::OperationDesc::ptr(new Test::TransparentOperationDesc)));
+
+        Graph g;
+        GraphVertex vsource = g.add_vertex (source);
+        GraphVertex va = g.add_vertex (a);
+        GraphVertex vc = g.add_vertex (c);
+        GraphVertex vd = g.add_vertex (d);
+        g.add_edge (vsource, va);
+        g.add_edge (va, vc);
+        g.add_edge (vc, vd);
+
+        FirstMissAlgorithm schedule;
+        Signal::ComputingEngine::ptr e(new Signal::ComputingCpu);
+
+        // The source isn't fusable, fill it first
+        Task t1 = schedule.getTask(g, vsource, Signal::Interval(0,10), 0, Interval::IntervalType_MAX, e);
+        t1.run ();
+        EXCEPTION_ASSERT_EQUALS(Step::cache (source)->samplesDesc(), Signal::Intervals(0,10));
+
+        Task t2 = schedule.getTask(g, vc, Signal::Interval(0,10), 0, Interval::IntervalType_MAX, e);
+        EXCEPTION_ASSERT(t2);
+        t2.run ();
+        EXCEPTION_ASSERT_EQUALS(Step::cache (c)->samplesDesc(), Signal::Intervals(0,10));
+        EXCEPTION_ASSERT_EQUALS(Step::cache (a)->samplesDesc(), Signal::Intervals());
+
+        // A step that can't be fused reads from the cache of its source
+        Task t3 = schedule.getTask(g, vd, Signal::Interval(0,10), 0, Interval::IntervalType_MAX, e);
+        EXCEPTION_ASSERT(t3);
+        t3.run ();
+        EXCEPTION_ASSERT_EQUALS(Step::cache (d)->samplesDesc(), Signal::Intervals(0,10));
+        EXCEPTION_ASSERT_EQUALS(Step::cache (a)->samplesDesc(), Signal::Intervals());
+    }
+
+    // It should schedule tasks with a low overhead.
+    {
+        Signal::pBuffer b(new Buffer(Interval(0,1<<16), 44100, 2));
+        Signal::OperationDesc::ptr od(new BufferSource(b));
+        Step::ptr step(new Step(od));
+        Graph g;
+        GraphVertex v = g.add_vertex (step);
+
+        FirstMissAlgorithm schedule;
+        Signal::ComputingEngine::ptr c(new Signal::ComputingCpu);
+
+        TRACE_PERF("FirstMissAlgorithm::getTask should schedule 1000 tasks");
+
+        for (int i=0; i<1000; i++)
+        {
+            // The task is cancelled when it goes out of scope
+            Signal::IntervalType first = i*61 % (1<<15);
+            Task t = schedule.getTask(g, v, Signal::Interval(first, first + 4096), first, 1024, c);
+            EXCEPTION_ASSERT(t);
+        }
+    }
+
     // It should let missing_in_target override out_of_date in the given vertex
 }
 
@@ -16,17 +16,31 @@ GraphInvalidator::
 
 void GraphInvalidator::
         deprecateCache(Signal::Intervals what) const
+{
+    deprecateRegion (Signal::Region(what));
+}
+
+
+void GraphInvalidator::
+        deprecateRegion(const Signal::Region& what) const
 {
     Dag::ptr dagp = dag_.lock ();
     if (!dagp)
         return;
 
-    auto dag = dagp.read ();
+    Dag::Snapshot dag = Dag::snapshot (dagp);
     INotifier::ptr notifier = notifier_.lock ();
     Step::ptr step = step_.lock ();
 
     if (step)
+    {
+        // The results of this step have changed, don't restore any earlier
+        // results for it or its targets from a ResultStore
+        if (Signal::OperationDesc::ptr o = Step::operation_desc (step))
+            o.raw ()->renew_content_id ();
+
         deprecateCache(*dag, step, what);
+    }
 
     if (notifier)
         notifier->wakeup();
@@ -35,9 +49,22 @@ void GraphInvalidator::
 
 void GraphInvalidator::
         deprecateCache(const Dag& dag, Step::ptr step, Signal::Intervals what)
+{
+    deprecateCache(dag, step, Signal::Region(what));
+}
+
+
+void GraphInvalidator::
+        deprecateCache(const Dag& dag, Step::ptr step, Signal::Region what)
 {
     // Invalidate the source first
-    what = step.write ()->deprecateCache(what);
+    Signal::Region input = what;
+    what = step.write ()->deprecateCache(what, dag.version ());
+
+    // Let the operation know, without holding the step
+    Signal::OperationDesc::ptr o = Step::operation_desc (step);
+    if (o && !input.empty ())
+        o.read ()->deprecatedInput (input);
 
     // Invalidate the targets afterwards
     // Otherwise the scheduler might start working on data that isn't ready yet
@@ -50,10 +77,19 @@ void GraphInvalidator::
 
 
 #include "bedroomnotifier.h"
+#include "test/operationmockups.h"
 
 namespace Signal {
 namespace Processing {
 
+class DeprecatedInputMock: public Test::TransparentOperationDesc {
+public:
+    Signal::Region affectedRegion( const Signal::Region& R ) const override { return R; }
+    void deprecatedInput( const Signal::Region& R ) const override { deprecated |= R; }
+
+    mutable Signal::Region deprecated;
+};
+
 class WaitForWakeupMock: public QThread {
 public:
     WaitForWakeupMock(Bedroom::ptr bedroom) : bedroom_(bedroom) {}
@@ -100,6 +136,25 @@ void GraphInvalidator::
         EXCEPTION_ASSERT_EQUALS(bedroom->sleepers (), 0);
         EXCEPTION_ASSERT(sleeper.isFinished ());
     }
+
+    // It should tell each operation what changed in its input
+    {
+        Dag::ptr dag(new Dag);
+        INotifier::ptr notifier(new BedroomNotifier(Bedroom::ptr(new Bedroom)));
+        DeprecatedInputMock* source_mock, * target_mock;
+        Signal::OperationDesc::ptr source_desc(source_mock = new DeprecatedInputMock);
+        Signal::OperationDesc::ptr target_desc(target_mock = new DeprecatedInputMock);
+        Step::ptr source(new Step(source_desc));
+        Step::ptr target(new Step(target_desc));
+        dag.write ()->appendStep(source);
+        dag.write ()->appendStep(target, dag.read ()->getVertex (source));
+
+        Signal::Region R(Signal::Intervals(10,20), 0.1, 0.2);
+        GraphInvalidator(dag, notifier, source).deprecateRegion (R);
+
+        EXCEPTION_ASSERT_EQUALS(source_mock->deprecated, R);
+        EXCEPTION_ASSERT_EQUALS(target_mock->deprecated, R);
+    }
 }
 
 
@@ -12,6 +12,11 @@ namespace Processing {
  * @brief The GraphInvalidator class should invalidate caches and wakeup workers.
  *
  * It will silently stop doing anything if any of it's dependencies are deleted.
+ *
+ * With deprecateRegion the frequencies that have changed are passed on to
+ * the targets through OperationDesc::affectedRegion of each step. Each
+ * operation is then told what changed in its input through
+ * OperationDesc::deprecatedInput, after its step has been unlocked.
  */
 class GraphInvalidator: public IInvalidator
 {
@@ -19,7 +24,9 @@ public:
     GraphInvalidator(Dag::ptr::weak_ptr dag, INotifier::weak_ptr notifier, Step::ptr::weak_ptr step);
 
     void deprecateCache(Signal::Intervals what) const override;
+    void deprecateRegion(const Signal::Region& what) const override;
     static void deprecateCache(const Dag& dag, Step::ptr s, Signal::Intervals what);
+    static void deprecateCache(const Dag& dag, Step::ptr s, Signal::Region what);
 
 private:
 
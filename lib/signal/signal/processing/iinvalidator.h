@@ -2,6 +2,7 @@
 #define SIGNAL_PROCESSING_IINVALIDATOR_H
 
 #include "signal/intervals.h"
+#include "signal/region.h"
 #include <memory>
 
 namespace Signal {
@@ -20,6 +21,14 @@ public:
     virtual ~IInvalidator() {}
 
     virtual void deprecateCache(Signal::Intervals what) const=0;
+
+    /**
+     * @brief deprecateRegion invalidates the samples in 'what' but lets
+     * targets know that only the frequencies in 'what' have changed, see
+     * Signal::OperationDesc::affectedRegion. Defaults to invalidating the
+     * samples for all frequencies.
+     */
+    virtual void deprecateRegion(const Signal::Region& what) const { deprecateCache(what.samples ()); }
 };
 
 } // namespace Processing
@@ -58,8 +58,12 @@ size_t Purge::
     if (!dag || !step || !out_of_date)
         return 0;
 
-    auto rdag = dag.read ();
-    return recursive_purge(rdag->g(), rdag->getVertex(step), out_of_date, aggressive);
+    Dag::Snapshot rdag = Dag::snapshot (dag);
+    GraphVertex v = rdag->getVertex(step);
+    if (!v)
+        return 0;
+
+    return recursive_purge(rdag->g(), v, out_of_date, aggressive);
 }
 
 
@@ -70,7 +74,7 @@ size_t Purge::
     if (!dag)
         return 0;
 
-    auto rdag = dag.read ();
+    Dag::Snapshot rdag = Dag::snapshot (dag);
     const Signal::Processing::Graph& g = rdag->g();
 
     size_t sz = 0;
@@ -0,0 +1,292 @@
+#include "resultstore.h"
+
+#include "log.h"
+
+#include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
+
+//#define DEBUGINFO
+#define DEBUGINFO if(0)
+
+namespace Signal {
+namespace Processing {
+
+ResultStore::
+        ResultStore(size_t max_bytes)
+    :
+      max_bytes_(max_bytes)
+{
+}
+
+
+void ResultStore::
+        stash(const Dag& dag, Step::ptr step)
+{
+    KeyMap keys;
+    stash(dag, step, keys);
+}
+
+
+void ResultStore::
+        stash(const Dag& dag, Step::ptr step, KeyMap& keys)
+{
+    std::vector<Step::ptr> targets = dag.targetSteps (step);
+
+    if (!targets.empty () && !Step::get_crashed (step))
+      {
+        Snapshot s;
+        {
+            auto cache = Step::cache (step).read ();
+            s.samples = cache->samplesDesc ();
+            s.chunks = cache->chunks ();
+        }
+
+        s.bytes = 0;
+        for (const pBuffer& b : s.chunks)
+            s.bytes += b->number_of_samples () * b->number_of_channels () * sizeof(Signal::TimeSeriesData::element_type);
+
+        if (s.samples && s.bytes <= max_bytes_)
+          {
+            s.key = key(dag, step, keys);
+
+            std::lock_guard<std::mutex> l(lock_);
+            auto i = index_.find (s.key);
+            if (i != index_.end () && i->second->samples.contains (s.samples))
+              {
+                // Already stashed, just mark as recently used
+                snapshots_.splice (snapshots_.begin (), snapshots_, i->second);
+              }
+            else
+              {
+                DEBUGINFO Log("resultstore: stashing %s from %s")
+                          % s.samples % Step::operation_desc (step).raw ()->toString ().toStdString ();
+
+                insert(std::move(s));
+              }
+          }
+      }
+
+    for (Step::ptr t : targets)
+        stash(dag, t, keys);
+}
+
+
+size_t ResultStore::
+        restore(const Dag& dag)
+{
+    KeyMap keys;
+    size_t restored = 0;
+    const Graph& g = dag.g ();
+
+    BOOST_FOREACH(GraphVertex v, vertices(g))
+      {
+        Step::ptr step = g[v];
+        if (dag.targetSteps (step).empty () || Step::get_crashed (step))
+            continue;
+
+        if (!Step::cache (step).read ()->empty ())
+            continue;
+
+        Key k = key(dag, step, keys);
+
+        std::vector<pBuffer> chunks;
+        Signal::Intervals samples;
+        {
+            std::lock_guard<std::mutex> l(lock_);
+            auto i = index_.find (k);
+            if (i == index_.end ())
+                continue;
+
+            snapshots_.splice (snapshots_.begin (), snapshots_, i->second);
+            chunks = i->second->chunks;
+            samples = i->second->samples;
+        }
+
+        if (!step->restoreCache (chunks, samples))
+            continue;
+
+        DEBUGINFO Log("resultstore: restoring %s into %s")
+                  % samples % Step::operation_desc (step).raw ()->toString ().toStdString ();
+
+        restored += samples.count () * chunks.front ()->number_of_channels ();
+      }
+
+    std::lock_guard<std::mutex> l(lock_);
+    restored_samples_ += restored;
+    return restored;
+}
+
+
+ResultStore::Key ResultStore::
+        key(const Dag& dag, Step::ptr step)
+{
+    KeyMap keys;
+    return key(dag, step, keys);
+}
+
+
+ResultStore::Key ResultStore::
+        key(const Dag& dag, Step::ptr step, KeyMap& keys)
+{
+    auto i = keys.find (step);
+    if (i != keys.end ())
+        return i->second;
+
+    Signal::OperationDesc::ptr o = Step::operation_desc (step);
+    Key k = 0;
+    boost::hash_combine(k, o ? o.raw ()->content_id () : 0ull);
+
+    for (Step::ptr s : dag.sourceSteps (step))
+        boost::hash_combine(k, key(dag, s, keys));
+
+    return keys[step] = k;
+}
+
+
+size_t ResultStore::
+        restored_samples() const
+{
+    std::lock_guard<std::mutex> l(lock_);
+    return restored_samples_;
+}
+
+
+size_t ResultStore::
+        size() const
+{
+    std::lock_guard<std::mutex> l(lock_);
+    return bytes_;
+}
+
+
+void ResultStore::
+        insert(Snapshot&& s)
+{
+    auto i = index_.find (s.key);
+    if (i != index_.end ())
+      {
+        bytes_ -= i->second->bytes;
+        snapshots_.erase (i->second);
+        index_.erase (i);
+      }
+
+    if (s.bytes > max_bytes_)
+        return;
+
+    bytes_ += s.bytes;
+    snapshots_.push_front (std::move(s));
+    index_[snapshots_.front ().key] = snapshots_.begin ();
+
+    while (bytes_ > max_bytes_)
+      {
+        const Snapshot& last = snapshots_.back ();
+        bytes_ -= last.bytes;
+        index_.erase (last.key);
+        snapshots_.pop_back ();
+      }
+}
+
+} // namespace Processing
+} // namespace Signal
+
+#include "test/operationmockups.h"
+#include "test/randombuffer.h"
+
+namespace Signal {
+namespace Processing {
+
+void ResultStore::
+        test()
+{
+    // It should restore the results of a step that is removed and added again
+    {
+        Dag dag;
+        ResultStore store;
+
+        Step::ptr source(new Step(Signal::OperationDesc::ptr(new Test::TransparentOperationDesc)));
+        Step::ptr target(new Step(Signal::OperationDesc::ptr(new Test::TransparentOperationDesc)));
+        Signal::OperationDesc::ptr filter_desc(new Test::TransparentOperationDesc);
+        Step::ptr filter(new Step(filter_desc));
+
+        dag.appendStep (source);
+        dag.appendStep (target, dag.getVertex (source));
+        ResultStore::Key without_filter = key(dag, target);
+
+        dag.insertStep (filter, dag.getVertex (target));
+        EXCEPTION_ASSERT_NOTEQUALS(key(dag, target), without_filter);
+
+        pBuffer b = Test::RandomBuffer::smallBuffer ();
+        int taskid = Step::registerTask (filter.write (), b->getInterval ());
+        Step::finishTask (filter, taskid, b);
+
+        // Toggle the filter off
+        store.stash (dag, filter);
+        dag.removeStep (filter);
+        EXCEPTION_ASSERT_EQUALS(key(dag, target), without_filter);
+        size_t chunk_bytes = Signal::Cache::chunkSize * b->number_of_channels () * sizeof(float);
+        EXCEPTION_ASSERT_EQUALS(store.size (), chunk_bytes);
+
+        // Snapshots share the cache and keep their content when it's written
+        pBuffer b2 = Test::RandomBuffer::smallBuffer (2);
+        taskid = Step::registerTask (filter.write (), b2->getInterval ());
+        Step::finishTask (filter, taskid, b2);
+        EXCEPTION_ASSERT(*b2 == *Step::cache (filter).read ()->read (b->getInterval ()));
+
+        // And on again
+        Step::ptr filter2(new Step(filter_desc));
+        dag.insertStep (filter2, dag.getVertex (target));
+        EXCEPTION_ASSERT_EQUALS(store.restore (dag), size_t(b->number_of_samples () * b->number_of_channels ()));
+        EXCEPTION_ASSERT_EQUALS(store.restored_samples (), size_t(b->number_of_samples () * b->number_of_channels ()));
+        EXCEPTION_ASSERT_EQUALS(Step::cache (filter2).read ()->samplesDesc (), Signal::Intervals(b->getInterval ()));
+        EXCEPTION_ASSERT(*b == *Step::cache (filter2).read ()->read (b->getInterval ()));
+
+        // Steps that already have results are left as is
+        EXCEPTION_ASSERT_EQUALS(store.restore (dag), 0u);
+
+        // Results from a step with changed parameters are not restored
+        store.stash (dag, filter2);
+        dag.removeStep (filter2);
+        filter_desc.raw ()->renew_content_id ();
+        Step::ptr filter3(new Step(filter_desc));
+        dag.insertStep (filter3, dag.getVertex (target));
+        EXCEPTION_ASSERT_EQUALS(store.restore (dag), 0u);
+        EXCEPTION_ASSERT(Step::cache (filter3).read ()->empty ());
+
+        // Copies of an OperationDesc may have different parameters
+        EXCEPTION_ASSERT_NOTEQUALS(filter_desc.read ()->copy ().raw ()->content_id (), filter_desc.raw ()->content_id ());
+    }
+
+    // It should discard the least recently used results when full
+    {
+        pBuffer b = Test::RandomBuffer::smallBuffer ();
+        size_t bytes = Signal::Cache::chunkSize * b->number_of_channels () * sizeof(float);
+
+        Dag dag;
+        ResultStore store(bytes + bytes/2);
+        ResultStore small(bytes - 1);
+
+        Step::ptr target(new Step(Signal::OperationDesc::ptr(new Test::TransparentOperationDesc)));
+        dag.appendStep (target);
+
+        Step::ptr steps[2];
+        for (Step::ptr& s : steps)
+          {
+            s = Step::ptr(new Step(Signal::OperationDesc::ptr(new Test::TransparentOperationDesc)));
+            dag.insertStep (s, dag.getVertex (target));
+            int taskid = Step::registerTask (s.write (), b->getInterval ());
+            Step::finishTask (s, taskid, b);
+            store.stash (dag, s);
+            // Results larger than max_bytes are not stashed at all
+            small.stash (dag, s);
+            EXCEPTION_ASSERT_EQUALS(small.size (), 0u);
+            dag.removeStep (s);
+            EXCEPTION_ASSERT_EQUALS(store.size (), bytes);
+          }
+
+        dag.insertStep (Step::ptr(new Step(Step::operation_desc (steps[0]))), dag.getVertex (target));
+        EXCEPTION_ASSERT_EQUALS(store.restore (dag), 0u);
+    }
+}
+
+} // namespace Processing
+} // namespace Signal
@@ -0,0 +1,98 @@
+#ifndef SIGNAL_PROCESSING_RESULTSTORE_H
+#define SIGNAL_PROCESSING_RESULTSTORE_H
+
+#include "dag.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace Signal {
+namespace Processing {
+
+/**
+ * @brief The ResultStore class should keep the results of steps that are
+ * invalidated by an edit of the Dag so that they can be restored if a later
+ * edit recreates a step with the same content, i.e undo/redo or toggling a
+ * filter on and off.
+ *
+ * The content of a step is identified by key(), a hash of
+ * OperationDesc::content_id and the keys of its sources. So a step has the
+ * same key as an earlier step if it has the same OperationDesc instance, with
+ * unchanged parameters, applied to the same sources.
+ *
+ * Chain calls stash before an edit invalidates a step and its targets, and
+ * restore after the edit. Only steps that are read by other steps, i.e have
+ * targetSteps, are stashed and restored. Steps without targets are rendered
+ * by their TargetNeeds and must be recomputed anyway.
+ *
+ * Snapshots share the cache chunks of a step, see Cache::chunks, so stash
+ * doesn't copy any samples and doesn't need to lock the Dag for writing. The
+ * least recently used snapshots are discarded when their chunks take more
+ * than 'max_bytes' in total.
+ */
+class ResultStore
+{
+public:
+    typedef std::shared_ptr<ResultStore> ptr;
+    typedef size_t Key;
+
+    ResultStore(size_t max_bytes = 256 << 20);
+    ResultStore(const ResultStore&) = delete;
+    ResultStore& operator=(const ResultStore&) = delete;
+
+    /**
+     * @brief stash makes snapshots of 'step' and of all steps that reads from
+     * 'step'. Call before 'step' is invalidated, a read lock of the Dag is
+     * enough.
+     */
+    void stash(const Dag& dag, Step::ptr step);
+
+    /**
+     * @brief restore puts snapshots back into steps with an empty cache and
+     * a matching key. Call after the Dag has been edited.
+     * @return the number of samples (times channels) that were restored.
+     */
+    size_t restore(const Dag& dag);
+
+    static Key key(const Dag& dag, Step::ptr step);
+
+    /**
+     * @brief restored_samples is the total number of samples (times channels)
+     * that didn't have to be recomputed because they were restored.
+     */
+    size_t restored_samples() const;
+    size_t size() const; // bytes
+    size_t max_bytes() const { return max_bytes_; }
+
+private:
+    struct Snapshot {
+        Key key;
+        std::vector<pBuffer> chunks;
+        Signal::Intervals samples;
+        size_t bytes;
+    };
+
+    typedef std::list<Snapshot> Snapshots; // most recently used first
+    typedef std::map<Step::ptr, Key> KeyMap;
+
+    static Key key(const Dag& dag, Step::ptr step, KeyMap& keys);
+    void stash(const Dag& dag, Step::ptr step, KeyMap& keys);
+    void insert(Snapshot&& s);
+
+    const size_t max_bytes_;
+    mutable std::mutex lock_;
+    Snapshots snapshots_;
+    std::map<Key, Snapshots::iterator> index_;
+    size_t bytes_ = 0;
+    size_t restored_samples_ = 0;
+
+public:
+    static void test();
+};
+
+} // namespace Processing
+} // namespace Signal
+
+#endif // SIGNAL_PROCESSING_RESULTSTORE_H
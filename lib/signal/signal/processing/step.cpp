@@ -2,6 +2,7 @@
 #include "test/operationmockups.h"
 
 #include "tasktimer.h"
+#include "trace_scope.h"
 #include "log.h"
 
 #include <boost/foreach.hpp>
@@ -93,19 +94,22 @@ Intervals Step::
 
 Intervals Step::
         deprecateCache(Intervals deprecated)
+{
+    return deprecateCache(Region(deprecated)).samples ();
+}
+
+
+Region Step::
+        deprecateCache(const Region& deprecated_input)
 {
     // Could remove all allocated cache memory here if the entire interval is deprecated.
     // But it is highly likely that it will be required again very soon, so don't bother.
 
-    if (operation_desc_ && deprecated) {
-        auto o = operation_desc_.read ();
+    Region affected = deprecated_input;
+    if (operation_desc_ && !deprecated_input.empty ())
+        affected = operation_desc_.read ()->affectedRegion(deprecated_input);
 
-        Intervals A;
-        for (const Interval& i : deprecated) {
-            A |= o->affectedInterval(i);
-        }
-        deprecated = A;
-    }
+    const Intervals& deprecated = affected.samples ();
 
     DEBUGINFO Log("Step: deprecateCache %2% | %3% on %1%")
               % operation_name()
@@ -118,7 +122,15 @@ Intervals Step::
     for (auto& v : running_tasks)
         v.valid_output &= not_deprecated;
 
-    return deprecated;
+    return affected;
+}
+
+
+Region Step::
+        deprecateCache(const Region& deprecated_input, unsigned long dag_version)
+{
+    deprecated_version_ = std::max(deprecated_version_, dag_version);
+    return deprecateCache(deprecated_input);
 }
 
 
@@ -134,6 +146,18 @@ size_t Step::
 }
 
 
+bool Step::
+        restoreCache(const std::vector<pBuffer>& chunks, const Intervals& samples)
+{
+    auto cache = cache_.write ();
+    if (!cache->empty ())
+        return false;
+
+    cache->assign (chunks, samples);
+    return true;
+}
+
+
 Intervals Step::
         not_started() const
 {
@@ -190,8 +214,10 @@ int Step::
 
 
 void Step::
-        finishTask(Step::ptr step, int taskid, pBuffer result)
+        finishTask(Step::ptr step, int taskid, pBuffer result, unsigned long dag_version)
 {
+    TRACE_SCOPE("Step::finishTask");
+
     FINISHTASKINFO Log("Step finishTask %2% on %1%")
               % step.raw ()->operation_name()
               % (result ? result->getInterval () : Signal::Interval());
@@ -207,6 +233,10 @@ void Step::
             break;
         }
 
+    // The task was scheduled from a snapshot that has been edited since
+    if (dag_version && dag_version < self->deprecated_version_)
+        valid_output = Intervals();
+
     self.unlock ();
 
     if (!valid_output)
@@ -311,6 +341,28 @@ void Step::
         EXCEPTION_ASSERT( *b == *Step::cache (s)->read(b->getInterval ()) );
     }
 
+    // It should discard results of tasks that were scheduled from an older
+    // version of the Dag than the latest invalidation.
+    {
+        pBuffer b(new Buffer(Interval(60,70), 40, 1));
+        Step::ptr s( new Step(OperationDesc::ptr()));
+
+        s->deprecateCache (Region(Intervals::Intervals_ALL), 5);
+        int taskid = Step::registerTask(s.write (), b->getInterval ());
+        Step::finishTask(s, taskid, b, 4);
+        EXCEPTION_ASSERT_EQUALS(Step::cache (s)->samplesDesc(), Intervals());
+
+        taskid = Step::registerTask(s.write (), b->getInterval ());
+        Step::finishTask(s, taskid, b, 5);
+        EXCEPTION_ASSERT_EQUALS(Step::cache (s)->samplesDesc(), Intervals(b->getInterval ()));
+
+        // Tasks of unknown version are kept
+        s->deprecateCache (Region(Intervals::Intervals_ALL), 6);
+        taskid = Step::registerTask(s.write (), b->getInterval ());
+        Step::finishTask(s, taskid, b);
+        EXCEPTION_ASSERT_EQUALS(Step::cache (s)->samplesDesc(), Intervals(b->getInterval ()));
+    }
+
     // A crashed signal processing step should behave as a transparent operation.
     {
         OperationDesc::ptr silence(new Signal::OperationSetSilent(Signal::Interval(2,3)));
@@ -56,6 +56,20 @@ public:
      */
     Signal::Intervals           deprecateCache(Signal::Intervals deprecated_input);
 
+    /**
+     * @brief deprecateCache is the same as above but also returns which
+     * frequencies that may have changed in the output, see
+     * OperationDesc::affectedRegion.
+     */
+    Signal::Region              deprecateCache(const Signal::Region& deprecated_input);
+
+    /**
+     * @brief deprecateCache is the same as above for an invalidation that
+     * walked 'dag_version' of the Dag. Tasks scheduled from an older snapshot
+     * of the Dag are not stored by finishTask after this, see Dag::version.
+     */
+    Signal::Region              deprecateCache(const Signal::Region& deprecated_input, unsigned long dag_version);
+
     /**
      * @brief purge discards samples from the cache, freeing up memory
      * @param still_needed describes which samples to keep
@@ -63,6 +77,14 @@ public:
      */
     size_t                      purge(Signal::Intervals still_needed, bool aggressive);
 
+    /**
+     * @brief restoreCache shares results that were computed by an earlier
+     * step with the same content into an empty cache, see ResultStore and
+     * Cache::chunks.
+     * @return false if the cache wasn't empty and nothing was restored.
+     */
+    bool                        restoreCache(const std::vector<Signal::pBuffer>& chunks, const Signal::Intervals& samples);
+
     /**
      * @brief not_started describes which samples stuff might be in the cache or in the middle of being processed
      * The cache isn't updated until a new interval is finished. When deprecateCache is called
@@ -82,7 +104,15 @@ public:
      */
     static int                  registerTask(Step::ptr::write_ptr&, Signal::Interval expected_output);
     static int                  registerTask(Step::ptr::write_ptr&&, Signal::Interval expected_output);
-    static void                 finishTask(Step::ptr, int taskid, Signal::pBuffer result);
+
+    /**
+     * @brief finishTask stores the valid part of 'result' in the cache.
+     * @param dag_version is the Dag::version of the snapshot the task was
+     * scheduled from, or 0 if unknown. 'result' is discarded if the step has
+     * been invalidated from a later version since, as the task may have read
+     * from steps that aren't its sources anymore.
+     */
+    static void                 finishTask(Step::ptr, int taskid, Signal::pBuffer result, unsigned long dag_version=0);
 
     /**
      * @brief sleepWhileTasks wait until all created tasks for this step has been finished.
@@ -114,6 +144,7 @@ private:
     Signal::OperationDesc::ptr  died_;
     shared_state<Signal::Cache> cache_;
     int                         task_counter_ = 0;
+    unsigned long               deprecated_version_ = 0;
 
     RunningTaskList             running_tasks;
 
@@ -5,6 +5,8 @@
 #include "tasktimer.h"
 #include "log.h"
 
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
 //#define DEBUG_INFO
 #define DEBUG_INFO if(0)
 
@@ -21,6 +23,7 @@ TargetNeeds::
     auto state = state_.write ();
     state->work_center = Interval::IntervalType_MIN;
     state->preferred_update_size = Interval::IntervalType_MAX;
+    state->prio = 0;
 }
 
 
@@ -63,6 +66,24 @@ void TargetNeeds::
 }
 
 
+void TargetNeeds::
+        updateDeadline(const State::Deadline& deadline)
+{
+    state_.write ()->deadline = deadline;
+}
+
+
+boost::posix_time::ptime TargetNeeds::State::Deadline::
+        due(Signal::IntervalType s) const
+{
+    if (time.is_special () || samples_per_second <= 0 || s <= sample)
+        return time;
+
+    double seconds = (s - sample) / samples_per_second;
+    return time + boost::posix_time::microseconds((long long)(seconds*1e6));
+}
+
+
 void TargetNeeds::
         deprecateCache(const Intervals& invalidate) const
 {
@@ -324,6 +345,26 @@ void TargetNeeds::
             bed.sleep (2);
         }
     }
+
+    // It should describe when needed samples are due
+    {
+        using namespace boost::posix_time;
+        ptime now = microsec_clock::local_time ();
+
+        TargetNeeds::State::Deadline none;
+        EXCEPTION_ASSERT(none.due (100).is_not_a_date_time ());
+
+        TargetNeeds::State::Deadline frame;
+        frame.time = now;
+        EXCEPTION_ASSERT_EQUALS(frame.due (100), now);
+
+        TargetNeeds::State::Deadline playback;
+        playback.time = now;
+        playback.sample = 1000;
+        playback.samples_per_second = 1000;
+        EXCEPTION_ASSERT_EQUALS(playback.due (500), now);
+        EXCEPTION_ASSERT_EQUALS(playback.due (1500), now + milliseconds(500));
+    }
 }
 
 } // namespace Processing
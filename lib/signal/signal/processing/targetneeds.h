@@ -28,10 +28,25 @@ public:
             typedef shared_state_mutex_notimeout_noshared shared_state_mutex;
         };
 
+        /**
+         * @brief The Deadline struct describes when needed samples must be
+         * computed. 'sample' is due at 'time' and following samples are due
+         * 'samples_per_second' later, or all at once if samples_per_second
+         * is 0. There is no deadline if 'time' is not_a_date_time.
+         */
+        struct Deadline {
+            boost::posix_time::ptime time;
+            Signal::IntervalType sample = 0;
+            double samples_per_second = 0;
+
+            boost::posix_time::ptime due(Signal::IntervalType s) const;
+        };
+
         Signal::IntervalType work_center;
         Signal::IntervalType preferred_update_size;
         Signal::Intervals needed_samples;
         double prio;
+        Deadline deadline;
     };
 
     TargetNeeds(shared_state<Step>::weak_ptr step, INotifier::weak_ptr notifier);
@@ -55,6 +70,15 @@ public:
             Signal::IntervalType preferred_update_size=Signal::Interval::IntervalType_MAX,
             double prio=0 );
 
+    /**
+     * @brief updateDeadline tells TargetSchedule when the needed samples must
+     * be computed. Targets with a deadline are scheduled earliest deadline
+     * first, before targets without a deadline. Playback declares when the
+     * next sample will be played and rendering declares the next frame.
+     * A default constructed Deadline clears it, e.g when playback stops.
+     */
+    void updateDeadline(const State::Deadline& deadline);
+
     /**
      * @brief deprecateCache invalidates
      * @arg invalidate Samples to invalidate in the step cache.
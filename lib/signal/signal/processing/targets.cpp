@@ -43,6 +43,13 @@ Targets::TargetNeedsCollection Targets::
 }
 
 
+INotifier::weak_ptr Targets::
+        notifier() const
+{
+    return notifier_;
+}
+
+
 Targets::TargetNeedsCollection Targets::
         getTargets(const State& state) const
 {
@@ -40,6 +40,12 @@ public:
     TargetNeeds::ptr              addTarget(Step::ptr::weak_ptr step);
     TargetNeedsCollection         getTargets() const;
 
+    /**
+     * @brief notifier wakes up workers, for instance when an asynchronous
+     * task is finished.
+     */
+    INotifier::weak_ptr           notifier() const;
+
 private:
     struct State {
         typedef std::vector<std::weak_ptr<TargetNeeds>> Targets;
@@ -6,6 +6,8 @@
 #include "tasktimer.h"
 #include "log.h"
 
+#include <boost/date_time/posix_time/posix_time.hpp>
+
 //#define DEBUGINFO
 #define DEBUGINFO if(0)
 
@@ -15,12 +17,72 @@ namespace Signal {
 namespace Processing {
 
 
+/**
+ * @brief isNeeded checks if any target needs the samples 'I' of 'step', or
+ * the samples affected by 'I' in the steps that read from 'step'.
+ */
+static bool isNeeded(const Dag& dag, const Targets::TargetNeedsCollection& T, Step::ptr step, Signal::Intervals I)
+{
+    if (!I)
+        return false;
+
+    for (const TargetNeeds::ptr& t : T)
+        if (t->step ().lock () == step && (I & t->needed ()))
+            return true;
+
+    for (Step::ptr ts : dag.targetSteps (step))
+    {
+        Signal::Intervals A = I;
+        if (Signal::OperationDesc::ptr o = Step::operation_desc (ts))
+        {
+            auto od = o.read ();
+            A.clear ();
+            for (const Signal::Interval& i : I)
+                A |= od->affectedInterval (i);
+        }
+
+        if (isNeeded (dag, T, ts, A))
+            return true;
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief stillNeeded creates a predicate for a CancellationToken that is
+ * false when no target needs the expected output of a task anymore.
+ */
+static std::function<bool()> stillNeeded(Dag::ptr::weak_ptr wdag, std::weak_ptr<Targets> wtargets, Step::ptr::weak_ptr wstep, Signal::Interval expected_output)
+{
+    return [wdag, wtargets, wstep, expected_output]()
+    {
+        Dag::ptr dag = wdag.lock ();
+        Targets::ptr targets = wtargets.lock ();
+        Step::ptr step = wstep.lock ();
+        if (!dag || !targets || !step)
+            return false;
+
+        try
+          {
+            return isNeeded (*Dag::snapshot (dag), targets->getTargets (), step, expected_output);
+          }
+        catch (...)
+          {
+            // Keep on working if the chain is busy
+            return true;
+          }
+    };
+}
+
+
 TargetSchedule::
-        TargetSchedule(Dag::ptr g, IScheduleAlgorithm::ptr algorithm, Targets::ptr targets)
+        TargetSchedule(Dag::ptr g, IScheduleAlgorithm::ptr algorithm, Targets::ptr targets, Signal::IntervalType preemption_update_size)
     :
       targets(targets),
       g(g),
-      algorithm(std::move(algorithm))
+      algorithm(std::move(algorithm)),
+      preemption_update_size(preemption_update_size)
 {
     BOOST_ASSERT(g);
     BOOST_ASSERT(this->algorithm);
@@ -30,15 +92,14 @@ TargetSchedule::
 Task TargetSchedule::
         getTask(Signal::ComputingEngine::ptr engine) const
 {
-    // Lock this from writing during getTask
-    // Lock the graph from writing during getTask
-    auto dag = g.read();
-
+    // Targets are added after their steps, so take the snapshot of the graph
+    // afterwards to find all of them. The graph may be edited meanwhile.
     auto T = this->targets->getTargets();
+    Dag::Snapshot dag = Dag::snapshot (g);
 
     while (!T.empty())
     {
-        TargetState targetstate = prioritizedTarget(T);
+        TargetState targetstate = prioritizedTarget(T, preemption_update_size);
         TargetNeeds::State& state = targetstate.second;
         Step::ptr& step = targetstate.first;
         if (!step) {
@@ -48,16 +109,26 @@ Task TargetSchedule::
 
         DEBUGINFO TaskTimer tt(boost::format("targetschedule: getTask(%s, center: %g)") % state.needed_samples % state.work_center);
 
+        // A target that was removed after getTargets is done
         GraphVertex vertex = dag->getVertex(step);
-        EXCEPTION_ASSERT(vertex);
 
-        Task task = algorithm->getTask(
-                dag->g(),
-                vertex,
-                state.needed_samples,
-                state.work_center,
-                state.preferred_update_size,
-                engine);
+        // Placed workers keep to their own part of the target
+        Signal::IntervalType center = state.work_center;
+        if (const Signal::ComputingCpu* cpu = dynamic_cast<const Signal::ComputingCpu*>(engine.get ()))
+            if (cpu->placement ().partitions > 1)
+                for (const TargetNeeds::ptr& t : T)
+                    if (t->step ().lock () == step)
+                        center = partitionCenter (cpu->placement (), t->needed ().spannedInterval (), state.needed_samples, center);
+
+        Task task;
+        if (vertex)
+            task = algorithm->getTask(
+                    dag->g(),
+                    vertex,
+                    state.needed_samples,
+                    center,
+                    state.preferred_update_size,
+                    engine);
 
         if (!task) {
             for (auto i = T.begin(); i!=T.end();)
@@ -71,6 +142,12 @@ Task TargetSchedule::
         else
         {
             DEBUGINFO Log("targetschedule: task->expected_output() = %s") % task.expected_output();
+
+            // Stop working on the task if the targets move on before it is finished
+            task.cancellation (Signal::CancellationToken::ptr(new Signal::CancellationToken(
+                    stillNeeded(this->g, this->targets, task.step (), task.expected_output ()))));
+            task.notifier (this->targets->notifier ());
+            task.dag_version (dag->version ());
             return task;
         }
     }
@@ -79,12 +156,38 @@ Task TargetSchedule::
 }
 
 
+Signal::IntervalType TargetSchedule::
+        partitionCenter(const Signal::ComputingCpu::Placement& placement, Signal::Interval span,
+                        const Signal::Intervals& missing, Signal::IntervalType center)
+{
+    if (placement.partitions <= 1 || !span.count ())
+        return center;
+
+    // A target that needs everything has no parts
+    if (span.first == Signal::Interval::IntervalType_MIN || span.last == Signal::Interval::IntervalType_MAX)
+        return center;
+
+    Signal::IntervalType n = span.count ();
+    Signal::Interval part(span.first + n*placement.partition/placement.partitions,
+                          span.first + n*(placement.partition+1)/placement.partitions);
+
+    // Help out elsewhere when the own part is done
+    Signal::Intervals mine = missing & part;
+    if (!mine)
+        return center;
+
+    return mine.fetchFirstInterval ().first;
+}
+
+
 TargetSchedule::TargetState TargetSchedule::
-        prioritizedTarget(const Targets::TargetNeedsCollection& T)
+        prioritizedTarget(const Targets::TargetNeedsCollection& T, Signal::IntervalType preemption_update_size)
 {
     TargetState r;
 
     double most_urgent = 0;
+    ptime earliest_deadline(pos_infin);
+    bool any_deadline = false;
 
     for (const TargetNeeds::ptr& t: T)
     {
@@ -92,17 +195,41 @@ TargetSchedule::TargetState TargetSchedule::
         if (!step)
             continue;
 
+        TargetNeeds::State state = t->state ();
+        bool has_deadline = !state.deadline.time.is_special ();
+        if (has_deadline && t->out_of_date ())
+            any_deadline = true;
+
         Signal::Intervals not_started = step.read()->not_started();
         if (!not_started)
             continue;
 
-        TargetNeeds::State state = t->state ();
         //double needed = state.needed_samples.count ();
         state.needed_samples &= not_started;
         double missing = state.needed_samples.count ();
+        if (!missing)
+            continue;
+
+        DEBUGINFO Log("targetschedule: %s (prio %g, deadline %s) not_started %s, needs %s")
+                % Step::operation_desc (step)->toString().toStdString() % state.prio
+                % to_simple_string(state.deadline.time) % not_started % state.needed_samples;
 
-        DEBUGINFO Log("targetschedule: %s (prio %g) not_started %s, needs %s")
-                % Step::operation_desc (step)->toString().toStdString() % state.prio % not_started % state.needed_samples;
+        if (has_deadline)
+        {
+            // Earliest deadline first
+            Signal::Interval next = state.needed_samples.fetchInterval (1, state.work_center);
+            ptime due = state.deadline.due (next.first);
+            if (due < earliest_deadline)
+            {
+                earliest_deadline = due;
+                r.first = step;
+                r.second = state;
+            }
+            continue;
+        }
+
+        if (!earliest_deadline.is_pos_infinity ())
+            continue;
 
         double urgency = missing*exp(state.prio);
         if (urgency > most_urgent)
@@ -113,6 +240,10 @@ TargetSchedule::TargetState TargetSchedule::
         }
     }
 
+    // Don't keep workers busy for long when a deadline might come up
+    if (r.first && any_deadline && r.second.deadline.time.is_special ())
+        r.second.preferred_update_size = std::min(r.second.preferred_update_size, preemption_update_size);
+
     DEBUGINFO {
         if (r.first) Log("targetschedule: looking at %s") % Step::operation_desc (r.first)->toString().toStdString();
         else Log("targetschedule: nothing of interest");
@@ -125,10 +256,361 @@ TargetSchedule::TargetState TargetSchedule::
 } // namespace Signal
 
 #include "bedroomnotifier.h"
+#include "firstmissalgorithm.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 namespace Signal {
 namespace Processing {
 
+class ChunkAlgorithmMockup: public IScheduleAlgorithm
+{
+public:
+    virtual Task getTask(
+            const Graph&,
+            GraphVertex,
+            Signal::Intervals needed,
+            Signal::IntervalType center,
+            Signal::IntervalType preferred_size,
+            Signal::ComputingEngine::ptr) const
+    {
+        return Task(Step::ptr(new Step(Signal::OperationDesc::ptr())),
+                    std::vector<Step::const_ptr>(),
+                    Signal::Operation::ptr(),
+                    needed.fetchInterval (preferred_size, center),
+                    Signal::Interval());
+    }
+};
+
+
+/**
+ * @brief The SlowSourceDesc class should take a fixed time per sample and log
+ * when each chunk was finished. With 'check_cancellation' it stops between
+ * milliseconds of work if the result isn't needed anymore.
+ */
+class SlowSourceDesc: public Signal::OperationDesc
+{
+public:
+    struct FinishLog {
+        std::mutex lock;
+        std::vector<std::pair<Signal::Interval, ptime>> finished;
+    };
+
+    SlowSourceDesc(double seconds_per_sample, std::shared_ptr<FinishLog> log=std::shared_ptr<FinishLog>(), bool check_cancellation=false)
+        : seconds_per_sample(seconds_per_sample), log(log), check_cancellation(check_cancellation) {}
+
+    Signal::Interval requiredInterval( const Signal::Interval& I, Signal::Interval* expectedOutput ) const override {
+        if (expectedOutput)
+            *expectedOutput = I;
+        return I;
+    }
+
+    Signal::Interval affectedInterval( const Signal::Interval& I ) const override {
+        return I;
+    }
+
+    OperationDesc::ptr copy() const override {
+        return OperationDesc::ptr(new SlowSourceDesc(seconds_per_sample, log, check_cancellation));
+    }
+
+    Extent extent() const override {
+        Extent x;
+        x.sample_rate = 1000;
+        x.number_of_channels = 1;
+        return x;
+    }
+
+    Signal::Operation::ptr createOperation(Signal::ComputingEngine*) const override {
+        class SlowOperation: public Signal::Operation {
+        public:
+            SlowOperation(double seconds_per_sample, std::shared_ptr<FinishLog> log, bool check_cancellation)
+                : seconds_per_sample(seconds_per_sample), log(log), check_cancellation(check_cancellation) {}
+
+            Signal::pBuffer process(Signal::pBuffer b) override {
+                long long T = b->number_of_samples () * seconds_per_sample * 1e6;
+                while (check_cancellation && T > 1000)
+                {
+                    std::this_thread::sleep_for (std::chrono::microseconds(1000));
+                    Signal::CancellationToken::checkpoint ();
+                    T -= 1000;
+                }
+                std::this_thread::sleep_for (std::chrono::microseconds(T));
+                if (log)
+                {
+                    std::lock_guard<std::mutex> l(log->lock);
+                    log->finished.push_back (std::make_pair(b->getInterval (), microsec_clock::local_time ()));
+                }
+                return b;
+            }
+
+        private:
+            double seconds_per_sample;
+            std::shared_ptr<FinishLog> log;
+            bool check_cancellation;
+        };
+
+        return Signal::Operation::ptr(new SlowOperation(seconds_per_sample, log, check_cancellation));
+    }
+
+private:
+    double seconds_per_sample;
+    std::shared_ptr<FinishLog> log;
+    bool check_cancellation;
+};
+
+
+/**
+ * @brief The WaitingSourceDesc class should wait for data asynchronously,
+ * like a disc read, until the test opens its Gate.
+ */
+class WaitingSourceDesc: public Signal::OperationDesc
+{
+public:
+    struct Gate {
+        std::mutex lock;
+        std::condition_variable opened;
+        bool open = false;
+    };
+
+    explicit WaitingSourceDesc(std::shared_ptr<Gate> gate)
+        : gate(gate) {}
+
+    Signal::Interval requiredInterval( const Signal::Interval& I, Signal::Interval* expectedOutput ) const override {
+        if (expectedOutput)
+            *expectedOutput = I;
+        return I;
+    }
+
+    Signal::Interval affectedInterval( const Signal::Interval& I ) const override {
+        return I;
+    }
+
+    OperationDesc::ptr copy() const override {
+        return OperationDesc::ptr(new WaitingSourceDesc(gate));
+    }
+
+    Extent extent() const override {
+        Extent x;
+        x.sample_rate = 1000;
+        x.number_of_channels = 1;
+        return x;
+    }
+
+    Signal::Operation::ptr createOperation(Signal::ComputingEngine*) const override {
+        class WaitingOperation: public Signal::AsyncOperation {
+        public:
+            WaitingOperation(std::shared_ptr<Gate> gate) : gate(gate) {}
+
+            void processAsync(Signal::pBuffer b, Done done) override {
+                std::shared_ptr<Gate> gate = this->gate;
+                std::thread([b, done, gate]() {
+                    std::unique_lock<std::mutex> l(gate->lock);
+                    gate->opened.wait (l, [&gate]() { return gate->open; });
+                    l.unlock ();
+                    done (b, std::exception_ptr());
+                }).detach ();
+            }
+
+        private:
+            std::shared_ptr<Gate> gate;
+        };
+
+        return Signal::Operation::ptr(new WaitingOperation(gate));
+    }
+
+private:
+    std::shared_ptr<Gate> gate;
+};
+
+
+/**
+ * @brief playbackDeadlineMisses runs a playback target while an export
+ * saturates all workers and counts the chunks of playback that weren't
+ * finished when they were due.
+ */
+static int playbackDeadlineMisses(bool use_deadlines)
+{
+    const int workers = 4;
+    const Signal::IntervalType chunk = 100;
+    const Signal::Interval playback_samples(0, 2000);
+
+    auto log = std::make_shared<SlowSourceDesc::FinishLog>();
+    Step::ptr export_step(new Step(Signal::OperationDesc::ptr(new SlowSourceDesc(20e-6))));
+    Step::ptr playback_step(new Step(Signal::OperationDesc::ptr(new SlowSourceDesc(20e-6, log))));
+
+    Dag::ptr dag(new Dag);
+    dag.write ()->appendStep(export_step);
+    dag.write ()->appendStep(playback_step);
+
+    Bedroom::ptr bedroom(new Bedroom);
+    BedroomNotifier::ptr notifier(new BedroomNotifier(bedroom));
+    Targets::ptr targets(new Targets(notifier));
+    TargetSchedule schedule(dag, IScheduleAlgorithm::ptr(new FirstMissAlgorithm), targets);
+
+    TargetNeeds::ptr export_needs = targets->addTarget(export_step);
+    TargetNeeds::ptr playback_needs = targets->addTarget(playback_step);
+    export_needs->updateNeeds(Signal::Interval(0, 1000000), Signal::Interval::IntervalType_MIN, 500, 0);
+    playback_needs->updateNeeds(playback_samples, Signal::Interval::IntervalType_MIN, chunk, 1);
+
+    // The first sample is played in 50 ms and then 10 samples per ms
+    TargetNeeds::State::Deadline deadline;
+    deadline.time = microsec_clock::local_time () + milliseconds(50);
+    deadline.sample = playback_samples.first;
+    deadline.samples_per_second = 10000;
+    if (use_deadlines)
+        playback_needs->updateDeadline(deadline);
+
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> threads;
+    for (int i=0; i<workers; i++)
+        threads.push_back (std::thread([&]() {
+            Signal::ComputingEngine::ptr engine(new Signal::ComputingCpu);
+            while (!stop)
+            {
+                Task task = schedule.getTask (engine);
+                if (task)
+                    task.run ();
+                else
+                    std::this_thread::sleep_for (std::chrono::milliseconds(1));
+            }
+        }));
+
+    std::this_thread::sleep_until (std::chrono::steady_clock::now () + std::chrono::milliseconds(300));
+    stop = true;
+    for (std::thread& t : threads)
+        t.join ();
+
+    int misses = 0;
+    Signal::Intervals finished;
+    for (const auto& f : log->finished)
+    {
+        finished |= f.first;
+        if (f.second > deadline.due (f.first.first))
+            misses += (f.first.count () + chunk - 1) / chunk;
+    }
+
+    Signal::Intervals unfinished = Signal::Intervals(playback_samples) - finished;
+    misses += (unfinished.count () + chunk - 1) / chunk;
+
+    return misses;
+}
+
+
+/**
+ * @brief panningMetrics pans a view across a slow source faster than the
+ * workers can keep up with and measures the time spent on tasks that were
+ * computed in vain.
+ */
+static Task::Metrics panningMetrics(bool check_cancellation)
+{
+    const int workers = 2;
+    const Signal::IntervalType window = 200;
+
+    Step::ptr step(new Step(Signal::OperationDesc::ptr(
+            new SlowSourceDesc(1e-3, std::shared_ptr<SlowSourceDesc::FinishLog>(), check_cancellation))));
+
+    Dag::ptr dag(new Dag);
+    dag.write ()->appendStep(step);
+
+    Bedroom::ptr bedroom(new Bedroom);
+    BedroomNotifier::ptr notifier(new BedroomNotifier(bedroom));
+    Targets::ptr targets(new Targets(notifier));
+    TargetSchedule schedule(dag, IScheduleAlgorithm::ptr(new FirstMissAlgorithm), targets);
+    TargetNeeds::ptr needs = targets->addTarget(step);
+    needs->updateNeeds(Signal::Interval(0, window), Signal::Interval::IntervalType_MIN, 100, 0);
+
+    Task::reset_metrics ();
+
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> threads;
+    for (int i=0; i<workers; i++)
+        threads.push_back (std::thread([&]() {
+            Signal::ComputingEngine::ptr engine(new Signal::ComputingCpu);
+            while (!stop)
+            {
+                Task task = schedule.getTask (engine);
+                if (task)
+                    task.run ();
+                else
+                    std::this_thread::sleep_for (std::chrono::milliseconds(1));
+            }
+        }));
+
+    // Move the view every 20 ms while each chunk takes 100 ms to compute
+    for (Signal::IntervalType x = window; x < 15*window; x += window)
+    {
+        std::this_thread::sleep_for (std::chrono::milliseconds(20));
+        needs->updateNeeds(Signal::Interval(x, x + window), Signal::Interval::IntervalType_MIN, 100, 0);
+    }
+
+    stop = true;
+    for (std::thread& t : threads)
+        t.join ();
+
+    return Task::metrics ();
+}
+
+
+/**
+ * @brief busyWhileWaiting lets a single worker start a target that waits for
+ * data from a WaitingSourceDesc and then checks that the worker can compute
+ * all of another target before the data arrives.
+ */
+static void busyWhileWaiting()
+{
+    const Signal::Interval samples(0, 1000);
+
+    auto gate = std::make_shared<WaitingSourceDesc::Gate>();
+    Step::ptr waiting_step(new Step(Signal::OperationDesc::ptr(new WaitingSourceDesc(gate))));
+    Step::ptr busy_step(new Step(Signal::OperationDesc::ptr(new SlowSourceDesc(1e-6))));
+
+    Dag::ptr dag(new Dag);
+    dag.write ()->appendStep(waiting_step);
+    dag.write ()->appendStep(busy_step);
+
+    Bedroom::ptr bedroom(new Bedroom);
+    BedroomNotifier::ptr notifier(new BedroomNotifier(bedroom));
+    Targets::ptr targets(new Targets(notifier));
+    TargetSchedule schedule(dag, IScheduleAlgorithm::ptr(new FirstMissAlgorithm), targets);
+
+    // Start with the waiting target
+    TargetNeeds::ptr waiting_needs = targets->addTarget(waiting_step);
+    TargetNeeds::ptr busy_needs = targets->addTarget(busy_step);
+    waiting_needs->updateNeeds(samples, Signal::Interval::IntervalType_MIN, 100, 1);
+    busy_needs->updateNeeds(samples, Signal::Interval::IntervalType_MIN, 100, 0);
+
+    Signal::ComputingEngine::ptr engine(new Signal::ComputingCpu);
+    for (int i=0; i<100 && busy_needs->out_of_date (); i++)
+    {
+        Task task = schedule.getTask (engine);
+        EXCEPTION_ASSERT(task);
+        task.run ();
+    }
+
+    // Nothing has been read yet, but the worker has computed everything else
+    EXCEPTION_ASSERT(!busy_needs->out_of_date ());
+    EXCEPTION_ASSERT(waiting_needs->out_of_date ());
+    EXCEPTION_ASSERT(Step::cache (waiting_step).read ()->empty ());
+    EXCEPTION_ASSERT(!(waiting_step.read ()->not_started () & samples));
+
+    {
+        std::lock_guard<std::mutex> l(gate->lock);
+        gate->open = true;
+    }
+    gate->opened.notify_all ();
+
+    auto deadline = std::chrono::steady_clock::now () + std::chrono::seconds(10);
+    while (waiting_needs->out_of_date () && std::chrono::steady_clock::now () < deadline)
+        std::this_thread::sleep_for (std::chrono::milliseconds(1));
+
+    EXCEPTION_ASSERT(!waiting_needs->out_of_date ());
+    EXCEPTION_ASSERT_EQUALS(Step::cache (waiting_step).read ()->samplesDesc (), Signal::Intervals(samples));
+}
+
+
 class GetDagTaskAlgorithmMockup: public IScheduleAlgorithm
 {
 public:
@@ -211,6 +693,115 @@ void TargetSchedule::
         EXCEPTION_ASSERT(task);
         EXCEPTION_ASSERT_EQUALS(task.expected_output(), Signal::Interval(5,6));
     }
+
+    // It should work on the target with the earliest deadline first
+    {
+        Dag::ptr dag(new Dag);
+        Step::ptr step(new Step(Signal::OperationDesc::ptr()));
+        Step::ptr step2(new Step(Signal::OperationDesc::ptr()));
+        Step::ptr step3(new Step(Signal::OperationDesc::ptr()));
+        dag.write ()->appendStep(step);
+        dag.write ()->appendStep(step2);
+        dag.write ()->appendStep(step3);
+        Bedroom::ptr bedroom(new Bedroom);
+        BedroomNotifier::ptr notifier(new BedroomNotifier(bedroom));
+        Targets::ptr targets(new Targets(notifier));
+        Signal::ComputingEngine::ptr engine;
+
+        TargetNeeds::ptr batch ( targets->addTarget(step) );
+        TargetNeeds::ptr late ( targets->addTarget(step2) );
+        TargetNeeds::ptr early ( targets->addTarget(step3) );
+        batch->updateNeeds(Signal::Interval(0,100),0,10,10);
+        late->updateNeeds(Signal::Interval(100,110),0,10,0);
+        early->updateNeeds(Signal::Interval(200,210),0,10,0);
+
+        ptime now = microsec_clock::local_time ();
+        TargetNeeds::State::Deadline d;
+        d.time = now + milliseconds(20);
+        late->updateDeadline (d);
+        d.time = now + milliseconds(10);
+        early->updateDeadline (d);
+
+        TargetSchedule targetschedule(dag, IScheduleAlgorithm::ptr(new ChunkAlgorithmMockup), targets, 4);
+        Task task = targetschedule.getTask (engine);
+        EXCEPTION_ASSERT_EQUALS(task.expected_output(), Signal::Interval(200,210));
+
+        // And preempt targets without a deadline between short chunks while
+        // a target with a deadline is out of date
+        early->updateNeeds(Signal::Intervals());
+        late->updateNeeds(Signal::Intervals());
+        EXCEPTION_ASSERT_EQUALS(targetschedule.getTask (engine).expected_output(), Signal::Interval(0,10));
+
+        late->updateNeeds(Signal::Interval(100,110),0,10,0);
+        int taskid = Step::registerTask(step2.write (), Signal::Interval(100,110));
+        (void)taskid; // late is out of date, but has nothing left to start
+        EXCEPTION_ASSERT_EQUALS(targetschedule.getTask (engine).expected_output(), Signal::Interval(0,4));
+    }
+
+    // It should miss fewer playback deadlines than prio ordering while an
+    // export saturates all workers. The number of misses depends on timing,
+    // so it's only compared with prio ordering on the same machine. Prio
+    // ordering starves playback behind the larger export and misses nearly
+    // all chunks.
+    {
+        int misses_by_prio = playbackDeadlineMisses(false);
+        int misses = playbackDeadlineMisses(true);
+
+        TaskInfo(boost::format("targetschedule: %d playback deadline misses, "
+                               "%d without deadlines") % misses % misses_by_prio);
+
+        EXCEPTION_ASSERT_LESS(misses, misses_by_prio);
+    }
+
+    // It should stop tasks whose results are no longer needed by any target
+    {
+        Task::Metrics without = panningMetrics(false);
+        Task::Metrics with = panningMetrics(true);
+
+        TaskInfo(boost::format("targetschedule: panning wasted %s and used %s in %d "
+                               "cancelled tasks, wasted %s without checkpoints")
+                 % TaskTimer::timeToString (with.wasted)
+                 % TaskTimer::timeToString (with.useful)
+                 % with.cancelled
+                 % TaskTimer::timeToString (without.wasted));
+
+        EXCEPTION_ASSERT_LESS(0, with.cancelled);
+        EXCEPTION_ASSERT_LESS(with.wasted, without.wasted);
+    }
+
+    // It should let workers pick other tasks while an asynchronous operation
+    // waits for data
+    busyWhileWaiting();
+
+    // It should give placed workers adjacent time ranges of their own
+    {
+        Dag::ptr dag(new Dag);
+        Step::ptr step(new Step(Signal::OperationDesc::ptr()));
+        dag.write ()->appendStep(step);
+        IScheduleAlgorithm::ptr algorithm(new GetDagTaskAlgorithmMockup);
+        Bedroom::ptr bedroom(new Bedroom);
+        BedroomNotifier::ptr notifier(new BedroomNotifier(bedroom));
+        Targets::ptr targets(new Targets(notifier));
+
+        TargetNeeds::ptr targetneeds ( targets->addTarget(step) );
+        targetneeds->updateNeeds(Signal::Interval(0,100),0,10,0);
+
+        Signal::ComputingCpu::Placement p0{0, 0, 0, 2}, p1{1, 1, 1, 2};
+        Signal::ComputingEngine::ptr e0(new Signal::ComputingCpu(p0));
+        Signal::ComputingEngine::ptr e1(new Signal::ComputingCpu(p1));
+
+        TargetSchedule targetschedule(dag, std::move(algorithm), targets);
+        EXCEPTION_ASSERT_EQUALS(targetschedule.getTask (e0).expected_output(), Signal::Interval(0,10));
+        EXCEPTION_ASSERT_EQUALS(targetschedule.getTask (e1).expected_output(), Signal::Interval(50,60));
+        EXCEPTION_ASSERT_EQUALS(targetschedule.getTask (Signal::ComputingEngine::ptr(new Signal::ComputingCpu)).expected_output(), Signal::Interval(0,10));
+
+        // And help out elsewhere when the own part is done
+        Signal::Interval span(0,100);
+        EXCEPTION_ASSERT_EQUALS(partitionCenter (p1, span, Signal::Intervals(0,100), 0), 50);
+        EXCEPTION_ASSERT_EQUALS(partitionCenter (p1, span, Signal::Intervals(20,30) | Signal::Intervals(70,80), 0), 70);
+        EXCEPTION_ASSERT_EQUALS(partitionCenter (p1, span, Signal::Intervals(20,30), 7), 7);
+        EXCEPTION_ASSERT_EQUALS(partitionCenter (p1, Signal::Interval::Interval_ALL, Signal::Intervals(20,80), 7), 7);
+    }
 }
 
 
@@ -10,11 +10,26 @@ namespace Processing {
 
 /**
  * @brief The GetDagTask class should provide tasks to keep a Dag up-to-date with respect to all targets.
+ *
+ * Targets with a deadline, see TargetNeeds::updateDeadline, are scheduled
+ * earliest deadline first. Targets without a deadline are scheduled by
+ * TargetNeeds::State::prio and the number of missing samples when no target
+ * with a deadline has anything left to start.
+ *
+ * While a target with a deadline is out of date, tasks for targets without a
+ * deadline are limited to 'preemption_update_size' samples so that workers
+ * return to the schedule between short chunks instead of being busy with a
+ * long task when a deadline comes up.
+ *
+ * A ComputingCpu with a placement, see NumaTopology, works off its own
+ * partition of each target first so that it keeps processing adjacent time
+ * ranges.
  */
 class TargetSchedule: public ISchedule {
 public:
     // Requires workers and/or current worker
-    TargetSchedule(Dag::ptr g, IScheduleAlgorithm::ptr algorithm, Targets::ptr targets);
+    TargetSchedule(Dag::ptr g, IScheduleAlgorithm::ptr algorithm, Targets::ptr targets,
+                   Signal::IntervalType preemption_update_size=1<<15);
 
     virtual Task getTask(Signal::ComputingEngine::ptr engine) const;
 
@@ -23,9 +38,18 @@ private:
 
     Dag::ptr g;
     IScheduleAlgorithm::ptr algorithm;
+    Signal::IntervalType preemption_update_size;
+
+    /**
+     * @brief partitionCenter is the first sample in 'missing' in the
+     * partition of 'span' that belongs to 'placement', or 'center' if there
+     * is none.
+     */
+    static Signal::IntervalType partitionCenter(const Signal::ComputingCpu::Placement& placement, Signal::Interval span,
+                                                const Signal::Intervals& missing, Signal::IntervalType center);
 
     typedef std::pair<Step::ptr, TargetNeeds::State> TargetState;
-    static TargetState prioritizedTarget(const Targets::TargetNeedsCollection& T);
+    static TargetState prioritizedTarget(const Targets::TargetNeedsCollection& T, Signal::IntervalType preemption_update_size);
 
 public:
     static void test();
@@ -1,13 +1,17 @@
 #include "task.h"
 
 #include "tasktimer.h"
+#include "trace_scope.h"
 #include "demangle.h"
 #include "expectexception.h"
 #include "log.h"
+#include "timer.h"
 
 #include <boost/foreach.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 
 //#define TIME_TASK
 #define TIME_TASK if(0)
@@ -18,6 +22,11 @@
 namespace Signal {
 namespace Processing {
 
+static std::mutex metrics_lock;
+static Task::Metrics task_metrics;
+static std::atomic<int> running_tasks(0);
+
+
 Task::Task()
     :
         task_id_(0)
@@ -81,6 +90,9 @@ Task& Task::
     std::swap(operation_, b.operation_);
     std::swap(expected_output_, b.expected_output_);
     std::swap(required_input_, b.required_input_);
+    std::swap(cancellation_, b.cancellation_);
+    std::swap(notifier_, b.notifier_);
+    std::swap(dag_version_, b.dag_version_);
     return *this;
 }
 
@@ -98,9 +110,76 @@ Signal::Interval Task::
 }
 
 
+Step::ptr Task::
+        step() const
+{
+    return step_;
+}
+
+
+void Task::
+        cancellation(Signal::CancellationToken::ptr token)
+{
+    cancellation_ = token;
+}
+
+
+void Task::
+        notifier(INotifier::weak_ptr notifier)
+{
+    notifier_ = notifier;
+}
+
+
+void Task::
+        dag_version(unsigned long version)
+{
+    dag_version_ = version;
+}
+
+
+static void record_metrics(Signal::CancellationToken* token, bool cancelled, double T)
+{
+    bool useful = !cancelled && (!token || token->poll ());
+    std::lock_guard<std::mutex> l(metrics_lock);
+    (useful ? task_metrics.useful : task_metrics.wasted) += T;
+    task_metrics.cancelled += cancelled;
+}
+
+
+Task::Metrics Task::
+        metrics()
+{
+    std::lock_guard<std::mutex> l(metrics_lock);
+    return task_metrics;
+}
+
+
+void Task::
+        reset_metrics()
+{
+    std::lock_guard<std::mutex> l(metrics_lock);
+    task_metrics = Metrics();
+}
+
+
+int Task::
+        running()
+{
+    return running_tasks;
+}
+
+
 void Task::
         run()
 {
+    TRACE_SCOPE("Task::run");
+
+    struct Running {
+        Running() { running_tasks++; }
+        ~Running() { running_tasks--; }
+    } running;
+
     try
       {
         run_private();
@@ -112,9 +191,7 @@ void Task::
             << Task::crashed_expected_output(expected_output_);
 
         try {
-            Signal::Processing::IInvalidator::ptr i = step_.write ()->mark_as_crashed_and_get_invalidator();
-            if (i)
-                i->deprecateCache (Signal::Intervals::Intervals_ALL);
+            mark_as_crashed ();
         } catch(const std::exception& y) {
             x << unexpected_exception_info(boost::current_exception());
         }
@@ -142,6 +219,7 @@ void Task::
     Signal::pBuffer input_buffer, output_buffer;
 
     {
+        TRACE_SCOPE("Task::get_input");
         INFO_TASK_INTERVALS TaskTimer tt(boost::format("expect  %s")
                                % expected_output());
         input_buffer = get_input();
@@ -152,10 +230,30 @@ void Task::
         }
     }
 
+    if (Signal::AsyncOperation* a = dynamic_cast<Signal::AsyncOperation*>(o.get ()))
+    {
+        run_async (a, input_buffer);
+        return;
+    }
+
     {
         INFO_TASK_INTERVALS TaskTimer tt(boost::format("process %s")
                                % input_buffer->getInterval ());
-        output_buffer = o->process (input_buffer);
+        Timer t;
+        bool cancelled = false;
+        try
+          {
+            TRACE_SCOPE("Operation::process");
+            Signal::CancellationToken::Scope scope(cancellation_.get ());
+            output_buffer = o->process (input_buffer);
+          }
+        catch (const Signal::CancellationToken::Cancelled&)
+          {
+            cancelled = true;
+          }
+
+        record_metrics (cancellation_.get (), cancelled, t.elapsed ());
+
         if (!output_buffer)
         {
             cancel();
@@ -166,6 +264,78 @@ void Task::
 }
 
 
+void Task::
+        run_async(Signal::AsyncOperation* a, Signal::pBuffer input_buffer)
+{
+    // The task is finished by whoever completes the operation. This Task is
+    // left empty so that it isn't cancelled when it goes out of scope.
+    std::shared_ptr<Task> self(new Task(std::move(*this)));
+    Timer t;
+
+    try
+      {
+        TRACE_SCOPE("AsyncOperation::processAsync");
+        Signal::CancellationToken::Scope scope(self->cancellation_.get ());
+        a->processAsync (input_buffer, [self, t](Signal::pBuffer r, std::exception_ptr x)
+        {
+            self->finish_async (r, x, t.elapsed ());
+        });
+      }
+    catch (...)
+      {
+        // Let run handle the exception as if the operation was synchronous
+        *this = std::move(*self);
+        throw;
+      }
+}
+
+
+void Task::
+        finish_async(Signal::pBuffer b, std::exception_ptr x, double T)
+{
+    bool cancelled = false;
+    if (x)
+      {
+        b.reset ();
+
+        try
+          {
+            std::rethrow_exception (x);
+          }
+        catch (const Signal::CancellationToken::Cancelled&)
+          {
+            cancelled = true;
+          }
+        catch (...)
+          {
+            // Nobody can catch this in a worker, so just log it
+            TaskInfo(boost::format("Task %s failed\n%s")
+                     % expected_output_
+                     % boost::current_exception_diagnostic_information ());
+
+            try {
+                mark_as_crashed ();
+            } catch (...) {}
+          }
+      }
+
+    record_metrics (cancellation_.get (), cancelled, T);
+    finish (b);
+
+    if (INotifier::ptr n = notifier_.lock ())
+        n->wakeup ();
+}
+
+
+void Task::
+        mark_as_crashed()
+{
+    Signal::Processing::IInvalidator::ptr i = step_.write ()->mark_as_crashed_and_get_invalidator();
+    if (i)
+        i->deprecateCache (Signal::Intervals::Intervals_ALL);
+}
+
+
 Signal::pBuffer Task::
         get_input() const
 {
@@ -221,7 +391,7 @@ void Task::
 
     if (step_)
     {
-        Step::finishTask(step_, task_id_, b);
+        Step::finishTask(step_, task_id_, b, dag_version_);
         step_.reset();
     }
 }
@@ -5,9 +5,11 @@
 
 #include "signal/intervals.h"
 #include "signal/buffer.h"
+#include "signal/cancellationtoken.h"
 #include "signal/computingengine.h"
 #include "signal/operation.h"
 #include "step.h"
+#include "inotifier.h"
 
 namespace Signal {
 namespace Processing {
@@ -17,6 +19,16 @@ namespace Processing {
  *
  * If the Task fails, the section of the cache that was supposed to be filled
  * by this Task should be invalidated.
+ *
+ * If the Task has a CancellationToken it is current while the operation is
+ * processed. A cancelled Task is discarded like a Task with an invalidated
+ * input.
+ *
+ * If the operation is a Signal::AsyncOperation, run only starts it and
+ * returns. The Task is then finished by the thread that completes the
+ * operation, which wakes up workers through the notifier. A failed
+ * AsyncOperation marks the step as crashed, like run does, but can't throw
+ * the exception to the worker.
  */
 class Task
 {
@@ -46,9 +58,40 @@ public:
     operator bool() const;
 
     Signal::Interval        expected_output() const;
+    Step::ptr               step() const;
+    void                    cancellation(Signal::CancellationToken::ptr token);
+    void                    notifier(INotifier::weak_ptr notifier);
+
+    /**
+     * @brief dag_version is the Dag::version of the snapshot this task was
+     * scheduled from, see Step::finishTask.
+     */
+    void                    dag_version(unsigned long version);
 
     virtual void run();
 
+    /**
+     * @brief The Metrics struct sums up the time spent in Operation::process,
+     * or until an AsyncOperation is done.
+     * Time is 'wasted' if the task was cancelled, or if its result wasn't
+     * needed anymore when it was finished. Tasks without a CancellationToken
+     * are counted as 'useful'.
+     */
+    struct Metrics {
+        double useful = 0;
+        double wasted = 0;
+        int cancelled = 0;
+    };
+
+    static Metrics          metrics();
+    static void             reset_metrics();
+
+    /**
+     * @brief running is the number of tasks that are in Task::run right now,
+     * in any thread.
+     */
+    static int              running();
+
 private:
     int                     task_id_;
     Step::ptr               step_;
@@ -56,8 +99,14 @@ private:
     Signal::Operation::ptr  operation_;
     Signal::Interval        expected_output_;
     Signal::Interval        required_input_;
+    Signal::CancellationToken::ptr cancellation_;
+    INotifier::weak_ptr     notifier_;
+    unsigned long           dag_version_ = 0;
 
     void                    run_private();
+    void                    run_async(Signal::AsyncOperation* o, Signal::pBuffer input_buffer);
+    void                    finish_async(Signal::pBuffer b, std::exception_ptr x, double T);
+    void                    mark_as_crashed();
     Signal::pBuffer         get_input() const;
     void                    finish(Signal::pBuffer);
     void                    cancel();
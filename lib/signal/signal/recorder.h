@@ -9,6 +9,8 @@
 
 namespace Signal {
 
+class RecorderCapture;
+
 class Recorder
 {
 public:
@@ -75,6 +77,8 @@ protected:
     Timer _start_recording, _last_update;
     Signal::Processing::IInvalidator::ptr _invalidator;
     std::exception_ptr _exception;
+    // Moves captured samples to '_data' while recording
+    std::shared_ptr<RecorderCapture> _capture;
 
     virtual float time();
 
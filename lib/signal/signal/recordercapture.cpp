@@ -0,0 +1,343 @@
+#include "recordercapture.h"
+#include "signal/transpose.h"
+
+#include "cpumemorystorage.h"
+#include "exceptionassert.h"
+
+#include <cmath>
+
+using namespace std;
+
+namespace Signal {
+
+RecorderCapture::
+        RecorderCapture(shared_state<Recorder::Data> data,
+                        Processing::IInvalidator::ptr invalidator,
+                        IntervalType offset,
+                        IntervalType capacity,
+                        Prepare prepare,
+                        chrono::microseconds period)
+    :
+      data_(data),
+      invalidator_(invalidator),
+      prepare_(prepare),
+      num_channels_(data.raw ()->num_channels),
+      sample_rate_(data.raw ()->sample_rate),
+      period_(period),
+      ring_(capacity*num_channels_),
+      marks_(1024),
+      end_(offset),
+      dropped_frames_(0),
+      written_(offset),
+      interleaved_(capacity*num_channels_),
+      chunk_(max(1024u, num_channels_)),
+      has_pending_mark_(false),
+      quit_(false),
+      latency_sum_(0),
+      latency_sum2_(0),
+      latency_count_(0)
+{
+    thread_ = thread(&RecorderCapture::run, this);
+}
+
+
+RecorderCapture::
+        ~RecorderCapture()
+{
+    stop ();
+}
+
+
+bool RecorderCapture::
+        put(const float* interleaved, int frames)
+{
+    // Called from a real-time thread, don't allocate or lock anything
+    size_t n = frames*num_channels_;
+    if (ring_.write_available () < n)
+    {
+        dropped_frames_ += frames;
+        return false;
+    }
+
+    ring_.write (interleaved, n);
+    end_ += frames;
+    mark ();
+    return true;
+}
+
+
+bool RecorderCapture::
+        put(const float* const* channels, int frames)
+{
+    // Called from a real-time thread, don't allocate or lock anything
+    const unsigned C = num_channels_;
+    if (ring_.write_available () < frames*C)
+    {
+        dropped_frames_ += frames;
+        return false;
+    }
+
+    float* chunk = &chunk_[0];
+    const int chunk_frames = chunk_.size ()/C;
+    for (int f=0; f<frames; f+=chunk_frames)
+    {
+        int n = min(chunk_frames, frames - f);
+        for (int j=0; j<n; ++j)
+            for (unsigned c=0; c<C; ++c)
+                chunk[j*C + c] = channels[c][f + j];
+        ring_.write (chunk, n*C);
+    }
+
+    end_ += frames;
+    mark ();
+    return true;
+}
+
+
+void RecorderCapture::
+        stop()
+{
+    {
+        lock_guard<mutex> l(quit_lock_);
+        quit_ = true;
+    }
+
+    quit_wakeup_.notify_all ();
+
+    if (thread_.joinable ())
+        thread_.join ();
+}
+
+
+RecorderCapture::Statistics RecorderCapture::
+        statistics() const
+{
+    lock_guard<mutex> l(statistics_lock_);
+    Statistics s = statistics_;
+    s.dropped_frames = dropped_frames_;
+    if (0 < latency_count_)
+    {
+        s.latency_mean = latency_sum_ / latency_count_;
+        s.latency_jitter = sqrt (max(0.0, latency_sum2_ / latency_count_ - s.latency_mean*s.latency_mean));
+    }
+    return s;
+}
+
+
+void RecorderCapture::
+        mark()
+{
+    // If 'marks_' is full this push is left out of the statistics
+    Mark m { end_, chrono::steady_clock::now ().time_since_epoch () };
+    marks_.write (&m, 1);
+}
+
+
+void RecorderCapture::
+        run()
+{
+    unique_lock<mutex> l(quit_lock_);
+    while (!quit_)
+    {
+        quit_wakeup_.wait_for (l, period_);
+
+        l.unlock ();
+        flush ();
+        l.lock ();
+    }
+
+    // Samples put before stop was called
+    l.unlock ();
+    flush ();
+}
+
+
+void RecorderCapture::
+        flush()
+{
+    const unsigned C = num_channels_;
+    IntervalType frames = ring_.read_available () / C;
+
+    if (0 < frames)
+    {
+        ring_.read (&interleaved_[0], frames*C);
+
+        pBuffer b(new Buffer(written_, frames, sample_rate_, C));
+        vector<float*> channels(C);
+        for (unsigned c=0; c<C; ++c)
+            channels[c] = CpuMemoryStorage::WriteAll<1>( b->getChannel (c)->waveform_data() ).ptr ();
+        Signal::deinterleave (&channels[0], &interleaved_[0], C, frames);
+
+        if (prepare_)
+            prepare_(*b);
+
+        data_.write ()->samples.put (b);
+        written_ += frames;
+
+        if (invalidator_)
+            // Tell someone that there is new data available to read
+            invalidator_->deprecateCache (b->getInterval ());
+    }
+
+    auto now = chrono::steady_clock::now ().time_since_epoch ();
+    lock_guard<mutex> l(statistics_lock_);
+    if (0 < frames)
+    {
+        statistics_.batches++;
+        statistics_.frames += frames;
+    }
+
+    while (has_pending_mark_ || marks_.read (&pending_mark_, 1))
+    {
+        has_pending_mark_ = true;
+        if (written_ < pending_mark_.end)
+            break;
+
+        double latency = chrono::duration<double>(now - pending_mark_.t).count ();
+        latency_sum_ += latency;
+        latency_sum2_ += latency*latency;
+        latency_count_++;
+        statistics_.latency_max = max(statistics_.latency_max, latency);
+        has_pending_mark_ = false;
+    }
+}
+
+
+class CountingInvalidator: public Processing::IInvalidator
+{
+public:
+    CountingInvalidator() : data_(new Data) {}
+
+    struct Data {
+        int count = 0;
+        Intervals marked;
+    };
+
+    Data data() const { return *data_.read (); }
+
+    void deprecateCache(Signal::Intervals what) const override {
+        auto d = data_.write ();
+        d->count++;
+        d->marked |= what;
+    }
+
+private:
+    shared_state<Data> data_;
+};
+
+
+void RecorderCapture::
+        test()
+{
+    // It should move samples put by a real-time thread into the cache in
+    // batches, with a synthetic recorder emitting fixed-size frames at
+    // 96 kHz with 8 channels.
+    {
+        const float fs = 96000;
+        const unsigned C = 8;
+        const int frames = 256, N = 120*frames;
+        auto value = [](IntervalType k, unsigned c) { return ((k*C + c) % 1000)/1000.f; };
+
+        shared_state<Recorder::Data> data(new Recorder::Data(fs, C));
+        auto invalidator = make_shared<CountingInvalidator>();
+        RecorderCapture capture(data, invalidator, 0, fs/2);
+
+        vector<float> in(frames*C);
+        auto t = chrono::steady_clock::now ();
+        for (int i=0; i<N; i+=frames)
+        {
+            for (int j=0; j<frames; ++j)
+                for (unsigned c=0; c<C; ++c)
+                    in[j*C + c] = value(i + j, c);
+
+            EXCEPTION_ASSERT(capture.put (&in[0], frames));
+
+            t += chrono::microseconds((int)(1e6*frames/fs));
+            this_thread::sleep_until (t);
+        }
+
+        EXCEPTION_ASSERT_EQUALS(capture.end (), N);
+        capture.stop ();
+
+        Statistics s = capture.statistics ();
+        CountingInvalidator::Data d = invalidator->data ();
+        EXCEPTION_ASSERT_EQUALS(d.marked, Interval(0, N));
+        EXCEPTION_ASSERT_EQUALS(d.count, (int)s.batches);
+        EXCEPTION_ASSERT_LESS(s.batches, (unsigned)(N/frames));
+        EXCEPTION_ASSERT_EQUALS(s.frames, N);
+        EXCEPTION_ASSERT_EQUALS(s.dropped_frames, 0);
+        EXCEPTION_ASSERT_LESS(0, s.latency_mean);
+        EXCEPTION_ASSERT_LESS_OR_EQUAL(s.latency_mean, s.latency_max);
+        EXCEPTION_ASSERT_LESS(s.latency_max, 0.5);
+        EXCEPTION_ASSERT_LESS_OR_EQUAL(0, s.latency_jitter);
+
+        pBuffer b = data.read ()->samples.read (Interval(0, N));
+        bool same = true;
+        for (unsigned c=0; c<C; ++c)
+        {
+            float* p = CpuMemoryStorage::ReadOnly<1>( b->getChannel (c)->waveform_data() ).ptr ();
+            for (int k=0; k<N; ++k)
+                same &= p[k] == value(k, c);
+        }
+        EXCEPTION_ASSERT(same);
+    }
+
+    // It should drop frames instead of blocking when the ring buffer is full,
+    // and accept frames with one pointer per channel.
+    {
+        shared_state<Recorder::Data> data(new Recorder::Data(96000, 2));
+        RecorderCapture capture(data, Processing::IInvalidator::ptr(), 10, 256, Prepare(), chrono::hours(1));
+
+        float a[200], b[200];
+        for (int i=0; i<200; ++i)
+        {
+            a[i] = i;
+            b[i] = -i;
+        }
+        const float* channels[] = {a, b};
+
+        EXCEPTION_ASSERT(capture.put (channels, 200));
+        EXCEPTION_ASSERT(!capture.put (channels, 100));
+        EXCEPTION_ASSERT_EQUALS(capture.end (), 210);
+        capture.stop ();
+
+        EXCEPTION_ASSERT_EQUALS(capture.statistics ().dropped_frames, 100);
+        EXCEPTION_ASSERT_EQUALS(capture.statistics ().batches, 1u);
+
+        pBuffer r = data.read ()->samples.read (Interval(10, 210));
+        EXCEPTION_ASSERT_EQUALS(CpuMemoryStorage::ReadOnly<1>( r->getChannel (0)->waveform_data() ).ptr ()[199], 199.f);
+        EXCEPTION_ASSERT_EQUALS(CpuMemoryStorage::ReadOnly<1>( r->getChannel (1)->waveform_data() ).ptr ()[199], -199.f);
+    }
+
+    // It should accept frames with more channels than fit in 1024 floats.
+    {
+        const unsigned C = 1500;
+        const int frames = 40;
+        shared_state<Recorder::Data> data(new Recorder::Data(96000, C));
+        RecorderCapture capture(data, Processing::IInvalidator::ptr(), 0, 64, Prepare(), chrono::hours(1));
+
+        vector<vector<float>> in(C, vector<float>(frames));
+        vector<const float*> channels(C);
+        for (unsigned c=0; c<C; ++c)
+        {
+            for (int j=0; j<frames; ++j)
+                in[c][j] = c + j/100.f;
+            channels[c] = &in[c][0];
+        }
+
+        EXCEPTION_ASSERT(capture.put (&channels[0], frames));
+        capture.stop ();
+
+        pBuffer r = data.read ()->samples.read (Interval(0, frames));
+        bool same = true;
+        for (unsigned c=0; c<C; ++c)
+        {
+            float* p = CpuMemoryStorage::ReadOnly<1>( r->getChannel (c)->waveform_data() ).ptr ();
+            for (int j=0; j<frames; ++j)
+                same &= p[j] == in[c][j];
+        }
+        EXCEPTION_ASSERT(same);
+    }
+}
+
+} // namespace Signal
@@ -0,0 +1,139 @@
+#ifndef SIGNAL_RECORDERCAPTURE_H
+#define SIGNAL_RECORDERCAPTURE_H
+
+#include "signal/recorder.h"
+#include "spsc_ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Signal {
+
+/**
+ * @brief The RecorderCapture class should move captured samples from a
+ * real-time thread into Recorder::Data::samples without locking or allocating
+ * on the real-time thread.
+ *
+ * Samples are put into a preallocated ring buffer by one producer. A
+ * background thread moves them in batches into the cache and calls
+ * IInvalidator::deprecateCache once per batch.
+ */
+class RecorderCapture
+{
+public:
+    typedef std::shared_ptr<RecorderCapture> ptr;
+
+    /**
+     * @brief The Statistics struct describes the latency from when samples are
+     * put until they are available in the cache.
+     */
+    struct Statistics
+    {
+        unsigned batches = 0;
+        IntervalType frames = 0;
+        IntervalType dropped_frames = 0;
+        double latency_mean = 0;
+        double latency_max = 0;
+        double latency_jitter = 0; // standard deviation of the latency
+    };
+
+    /**
+     * @brief prepare is called on the background thread with each batch
+     * before it is put in the cache.
+     */
+    typedef std::function<void(Signal::Buffer&)> Prepare;
+
+    /**
+     * @brief RecorderCapture starts capturing samples to 'data' starting at
+     * sample 'offset'.
+     * @param capacity Number of frames that the ring buffer can hold.
+     * @param period How often the background thread moves samples to the cache.
+     */
+    RecorderCapture(shared_state<Recorder::Data> data,
+                    Processing::IInvalidator::ptr invalidator,
+                    IntervalType offset,
+                    IntervalType capacity,
+                    Prepare prepare = Prepare(),
+                    std::chrono::microseconds period = std::chrono::milliseconds(10));
+    RecorderCapture(const RecorderCapture&) = delete;
+    RecorderCapture& operator=(const RecorderCapture&) = delete;
+    ~RecorderCapture();
+
+    /**
+     * @brief put copies 'frames' frames of interleaved samples. Only one
+     * thread may call put.
+     * @return false if there wasn't room for all frames, they are then
+     * dropped.
+     */
+    bool put(const float* interleaved, int frames);
+
+    /**
+     * @brief put copies 'frames' frames with one pointer per channel. Only
+     * one thread may call put.
+     */
+    bool put(const float* const* channels, int frames);
+
+    /**
+     * @brief end is the sample after the last sample that has been put.
+     */
+    IntervalType end() const { return end_; }
+
+    /**
+     * @brief stop moves the remaining samples to the cache and stops the
+     * background thread. Must not be called while a producer may call put.
+     */
+    void stop();
+
+    Statistics statistics() const;
+
+private:
+    struct Mark
+    {
+        IntervalType end;
+        std::chrono::steady_clock::duration t;
+    };
+
+    void run();
+    void flush();
+    void mark();
+
+    shared_state<Recorder::Data>    data_;
+    Processing::IInvalidator::ptr   invalidator_;
+    Prepare                         prepare_;
+    const unsigned                  num_channels_;
+    const float                     sample_rate_;
+    const std::chrono::microseconds period_;
+
+    JustMisc::spsc_ring<float>      ring_;
+    JustMisc::spsc_ring<Mark>       marks_;
+    std::atomic<IntervalType>       end_;
+    std::atomic<IntervalType>       dropped_frames_;
+    IntervalType                    written_;
+    std::vector<float>              interleaved_;
+    std::vector<float>              chunk_; // for put, fits at least one frame
+    Mark                            pending_mark_;
+    bool                            has_pending_mark_;
+
+    std::mutex                      quit_lock_;
+    std::condition_variable         quit_wakeup_;
+    bool                            quit_;
+    std::thread                     thread_;
+
+    mutable std::mutex              statistics_lock_;
+    Statistics                      statistics_;
+    double                          latency_sum_;
+    double                          latency_sum2_;
+    unsigned                        latency_count_;
+
+public:
+    static void test();
+};
+
+} // namespace Signal
+
+#endif // SIGNAL_RECORDERCAPTURE_H
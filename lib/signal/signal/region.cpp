@@ -0,0 +1,145 @@
+#include "region.h"
+
+#include "exceptionassert.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace Signal {
+
+const float Region::nyquist = 0.5f;
+
+
+Region::
+        Region()
+    :
+      f1_(0),
+      f2_(nyquist)
+{
+}
+
+
+Region::
+        Region(const Intervals& samples)
+    :
+      samples_(samples),
+      f1_(0),
+      f2_(nyquist)
+{
+}
+
+
+Region::
+        Region(const Intervals& samples, float f1, float f2)
+    :
+      samples_(samples),
+      f1_(std::max(0.f, f1)),
+      f2_(std::min(nyquist, f2))
+{
+    EXCEPTION_ASSERT_LESS_OR_EQUAL(f1, f2);
+}
+
+
+bool Region::
+        allFrequencies() const
+{
+    return f1_ <= 0 && nyquist <= f2_;
+}
+
+
+bool Region::
+        intersectsFrequencies(float f1, float f2) const
+{
+    return f1 <= f2_ && f1_ <= f2;
+}
+
+
+bool Region::
+        empty() const
+{
+    return samples_.empty ();
+}
+
+
+Region& Region::
+        operator |= (const Region& b)
+{
+    if (b.empty ())
+        return *this;
+
+    if (empty ())
+        return *this = b;
+
+    samples_ |= b.samples_;
+    f1_ = std::min(f1_, b.f1_);
+    f2_ = std::max(f2_, b.f2_);
+    return *this;
+}
+
+
+bool Region::
+        operator == (const Region& b) const
+{
+    return samples_ == b.samples_ && f1_ == b.f1_ && f2_ == b.f2_;
+}
+
+
+std::string Region::
+        toString() const
+{
+    std::stringstream ss;
+    ss << samples_;
+    if (!allFrequencies ())
+        ss << " x [" << f1_ << ", " << f2_ << "]";
+    return ss.str ();
+}
+
+
+std::ostream& operator<< (std::ostream& o, const Region& R)
+{
+    return o << R.toString ();
+}
+
+
+void Region::
+        test()
+{
+    // It should describe a change that is limited in time and frequency
+    {
+        Region r(Interval(10,20), 0.1, 0.2);
+        EXCEPTION_ASSERT_EQUALS(r.samples (), Intervals(10,20));
+        EXCEPTION_ASSERT(!r.allFrequencies ());
+        EXCEPTION_ASSERT(r.intersectsFrequencies (0.15, 0.4));
+        EXCEPTION_ASSERT(r.intersectsFrequencies (0, 0.1));
+        EXCEPTION_ASSERT(!r.intersectsFrequencies (0.25, 0.4));
+        EXCEPTION_ASSERT_EQUALS(r.toString (), "[10, 20)10# x [0.1, 0.2]");
+
+        // Frequencies are clamped to [0, nyquist]
+        r = Region(Interval(10,20), -1, 2);
+        EXCEPTION_ASSERT(r.allFrequencies ());
+        EXCEPTION_ASSERT_EQUALS(r, Region(Intervals(10,20)));
+    }
+
+    // It should cover all frequencies when created from samples only
+    {
+        Region r(Intervals::Intervals_ALL);
+        EXCEPTION_ASSERT(r.allFrequencies ());
+        EXCEPTION_ASSERT(r.intersectsFrequencies (0.4, 0.45));
+        EXCEPTION_ASSERT(Region().empty ());
+        EXCEPTION_ASSERT(Region().allFrequencies ());
+    }
+
+    // It should merge regions into one band
+    {
+        Region r = Region(Interval(0,10), 0.1, 0.2) | Region(Interval(20,30), 0.3, 0.35);
+        EXCEPTION_ASSERT_EQUALS(r, Region(Intervals(0,10) | Intervals(20,30), 0.1, 0.35));
+
+        // An empty region doesn't cover any frequencies
+        r = Region() | Region(Interval(0,10), 0.1, 0.2);
+        EXCEPTION_ASSERT_EQUALS(r, Region(Interval(0,10), 0.1, 0.2));
+        r |= Region();
+        EXCEPTION_ASSERT_EQUALS(r, Region(Interval(0,10), 0.1, 0.2));
+    }
+}
+
+} // namespace Signal
@@ -0,0 +1,57 @@
+#ifndef SIGNAL_REGION_H
+#define SIGNAL_REGION_H
+
+#include "intervals.h"
+
+namespace Signal {
+
+/**
+ * @brief The Region class should describe a change of a signal that is
+ * limited in both time and frequency.
+ *
+ * Frequencies are normalized to the sample rate of 'samples', i.e the
+ * nyquist frequency is 0.5, so that a Region can be passed through
+ * operations without knowing the sample rate. A Region created from only
+ * Intervals covers all frequencies and means the same thing as the
+ * Intervals.
+ *
+ * See OperationDesc::affectedRegion and IInvalidator::deprecateRegion.
+ */
+class SignalDll Region
+{
+public:
+    static const float nyquist;
+
+    Region();
+    explicit Region(const Intervals& samples);
+    Region(const Intervals& samples, float f1, float f2);
+
+    const Intervals& samples() const { return samples_; }
+    float f1() const { return f1_; }
+    float f2() const { return f2_; }
+
+    bool allFrequencies() const;
+    bool intersectsFrequencies(float f1, float f2) const;
+    bool empty() const;
+
+    // The union of the samples and the smallest band covering both bands
+    Region  operator |  (const Region& b) const { return Region(*this)|=b; }
+    Region& operator |= (const Region& b);
+    bool    operator == (const Region& b) const;
+    bool    operator != (const Region& b) const { return !(*this == b); }
+
+    std::string toString() const;
+
+private:
+    Intervals samples_;
+    float f1_, f2_;
+
+public:
+    static void test();
+};
+
+SignalDll std::ostream& operator<< (std::ostream& o, const Region& R);
+
+} // namespace Signal
+
+#endif // SIGNAL_REGION_H
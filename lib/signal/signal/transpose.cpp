@@ -2,69 +2,436 @@
 #include "cpumemorystorage.h"
 
 #include <string.h> // memcpy
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSPOSE_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace Signal {
 
-void transpose(DataStorage<float>* dest, DataStorage<float>* src)
+// Number of frames processed per block. 256 frames of 8 channels is 8 kB of
+// source data, which leaves room in L1 for the 8 destination streams.
+static const int block_frames = 256;
+
+
+/**
+ * Scalar deinterleave with a compile-time channel count, lets the compiler
+ * unroll the inner loop and keep all destination pointers in registers.
+ */
+template<int C>
+static void deinterleave_scalar(float* const* dest, const float* src, int begin, int end)
 {
-    DataStorageSize sz = dest->size();
+    for (int i=begin; i<end; i++)
+        for (int c=0; c<C; c++)
+            dest[c][i] = src[i*C + c];
+}
 
-    EXCEPTION_ASSERT( dest->numberOfElements() == src->numberOfElements() );
-    EXCEPTION_ASSERT( sz.depth == 1 );
 
-    float* destp = CpuMemoryStorage::WriteAll<float,3>( dest ).ptr();
-    float* srcp = CpuMemoryStorage::ReadOnly<float,3>( src ).ptr();
+template<int C>
+static void interleave_scalar(float* dest, const float* const* src, int begin, int end)
+{
+    for (int i=begin; i<end; i++)
+        for (int c=0; c<C; c++)
+            dest[i*C + c] = src[c][i];
+}
+
+
+template<int C>
+static void deinterleave_block(float* const* dest, const float* src, int frames)
+{
+    deinterleave_scalar<C>(dest, src, 0, frames);
+}
+
+
+template<int C>
+static void interleave_block(float* dest, const float* const* src, int frames)
+{
+    interleave_scalar<C>(dest, src, 0, frames);
+}
+
 
-    switch(sz.height)
+#ifdef TRANSPOSE_SSE2
+template<>
+void deinterleave_block<2>(float* const* dest, const float* src, int frames)
+{
+    float* l = dest[0];
+    float* r = dest[1];
+    int i = 0;
+    for (; i+4<=frames; i+=4)
     {
-    case 1:
-        memcpy(destp, srcp, sizeof(float)*sz.width);
-        break;
-    case 2:
-        for (int i=0; i<sz.width; i++) {
-            float *t = destp + i;
-            float *d = srcp + i*2;
-            t[0] = d[0];
-            t[sz.width] = d[1];
+        __m128 a = _mm_loadu_ps(src + 2*i);
+        __m128 b = _mm_loadu_ps(src + 2*i + 4);
+        _mm_storeu_ps(l + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0)));
+        _mm_storeu_ps(r + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1)));
+    }
+    deinterleave_scalar<2>(dest, src, i, frames);
+}
+
+
+template<>
+void deinterleave_block<4>(float* const* dest, const float* src, int frames)
+{
+    int i = 0;
+    for (; i+4<=frames; i+=4)
+    {
+        __m128 a = _mm_loadu_ps(src + 4*i);
+        __m128 b = _mm_loadu_ps(src + 4*i + 4);
+        __m128 c = _mm_loadu_ps(src + 4*i + 8);
+        __m128 d = _mm_loadu_ps(src + 4*i + 12);
+        _MM_TRANSPOSE4_PS(a, b, c, d);
+        _mm_storeu_ps(dest[0] + i, a);
+        _mm_storeu_ps(dest[1] + i, b);
+        _mm_storeu_ps(dest[2] + i, c);
+        _mm_storeu_ps(dest[3] + i, d);
+    }
+    deinterleave_scalar<4>(dest, src, i, frames);
+}
+
+
+template<>
+void deinterleave_block<8>(float* const* dest, const float* src, int frames)
+{
+    int i = 0;
+    for (; i+4<=frames; i+=4)
+    {
+        const float* s = src + 8*i;
+        __m128 a0 = _mm_loadu_ps(s + 0),  a1 = _mm_loadu_ps(s + 4);
+        __m128 b0 = _mm_loadu_ps(s + 8),  b1 = _mm_loadu_ps(s + 12);
+        __m128 c0 = _mm_loadu_ps(s + 16), c1 = _mm_loadu_ps(s + 20);
+        __m128 d0 = _mm_loadu_ps(s + 24), d1 = _mm_loadu_ps(s + 28);
+        _MM_TRANSPOSE4_PS(a0, b0, c0, d0);
+        _MM_TRANSPOSE4_PS(a1, b1, c1, d1);
+        _mm_storeu_ps(dest[0] + i, a0);
+        _mm_storeu_ps(dest[1] + i, b0);
+        _mm_storeu_ps(dest[2] + i, c0);
+        _mm_storeu_ps(dest[3] + i, d0);
+        _mm_storeu_ps(dest[4] + i, a1);
+        _mm_storeu_ps(dest[5] + i, b1);
+        _mm_storeu_ps(dest[6] + i, c1);
+        _mm_storeu_ps(dest[7] + i, d1);
+    }
+    deinterleave_scalar<8>(dest, src, i, frames);
+}
+
+
+template<>
+void interleave_block<2>(float* dest, const float* const* src, int frames)
+{
+    const float* l = src[0];
+    const float* r = src[1];
+    int i = 0;
+    for (; i+4<=frames; i+=4)
+    {
+        __m128 a = _mm_loadu_ps(l + i);
+        __m128 b = _mm_loadu_ps(r + i);
+        _mm_storeu_ps(dest + 2*i, _mm_unpacklo_ps(a, b));
+        _mm_storeu_ps(dest + 2*i + 4, _mm_unpackhi_ps(a, b));
+    }
+    interleave_scalar<2>(dest, src, i, frames);
+}
+
+
+template<>
+void interleave_block<4>(float* dest, const float* const* src, int frames)
+{
+    int i = 0;
+    for (; i+4<=frames; i+=4)
+    {
+        __m128 a = _mm_loadu_ps(src[0] + i);
+        __m128 b = _mm_loadu_ps(src[1] + i);
+        __m128 c = _mm_loadu_ps(src[2] + i);
+        __m128 d = _mm_loadu_ps(src[3] + i);
+        _MM_TRANSPOSE4_PS(a, b, c, d);
+        _mm_storeu_ps(dest + 4*i, a);
+        _mm_storeu_ps(dest + 4*i + 4, b);
+        _mm_storeu_ps(dest + 4*i + 8, c);
+        _mm_storeu_ps(dest + 4*i + 12, d);
+    }
+    interleave_scalar<4>(dest, src, i, frames);
+}
+
+
+template<>
+void interleave_block<8>(float* dest, const float* const* src, int frames)
+{
+    int i = 0;
+    for (; i+4<=frames; i+=4)
+    {
+        __m128 a0 = _mm_loadu_ps(src[0] + i), a1 = _mm_loadu_ps(src[4] + i);
+        __m128 b0 = _mm_loadu_ps(src[1] + i), b1 = _mm_loadu_ps(src[5] + i);
+        __m128 c0 = _mm_loadu_ps(src[2] + i), c1 = _mm_loadu_ps(src[6] + i);
+        __m128 d0 = _mm_loadu_ps(src[3] + i), d1 = _mm_loadu_ps(src[7] + i);
+        _MM_TRANSPOSE4_PS(a0, b0, c0, d0);
+        _MM_TRANSPOSE4_PS(a1, b1, c1, d1);
+        float* t = dest + 8*i;
+        _mm_storeu_ps(t + 0, a0);  _mm_storeu_ps(t + 4, a1);
+        _mm_storeu_ps(t + 8, b0);  _mm_storeu_ps(t + 12, b1);
+        _mm_storeu_ps(t + 16, c0); _mm_storeu_ps(t + 20, c1);
+        _mm_storeu_ps(t + 24, d0); _mm_storeu_ps(t + 28, d1);
+    }
+    interleave_scalar<8>(dest, src, i, frames);
+}
+#endif
+
+
+/**
+ * Walks through 'frames' in blocks of block_frames with destination pointers
+ * advanced to the start of each block.
+ */
+template<int C>
+static void deinterleave_blocked(float* const* dest, const float* src, int frames)
+{
+    float* d[C];
+    for (int i=0; i<frames; i+=block_frames)
+    {
+        int n = std::min(block_frames, frames - i);
+        for (int c=0; c<C; c++)
+            d[c] = dest[c] + i;
+        deinterleave_block<C>(d, src + (size_t)i*C, n);
+    }
+}
+
+
+template<int C>
+static void interleave_blocked(float* dest, const float* const* src, int frames)
+{
+    const float* s[C];
+    for (int i=0; i<frames; i+=block_frames)
+    {
+        int n = std::min(block_frames, frames - i);
+        for (int c=0; c<C; c++)
+            s[c] = src[c] + i;
+        interleave_block<C>(dest + (size_t)i*C, s, n);
+    }
+}
+
+
+void deinterleave(float* const* dest, const float* src, int channels, int frames)
+{
+    switch(channels)
+    {
+    case 1: memcpy(dest[0], src, frames*sizeof(float)); break;
+    case 2: deinterleave_blocked<2>(dest, src, frames); break;
+    case 3: deinterleave_blocked<3>(dest, src, frames); break;
+    case 4: deinterleave_blocked<4>(dest, src, frames); break;
+    case 5: deinterleave_blocked<5>(dest, src, frames); break;
+    case 6: deinterleave_blocked<6>(dest, src, frames); break;
+    case 7: deinterleave_blocked<7>(dest, src, frames); break;
+    case 8: deinterleave_blocked<8>(dest, src, frames); break;
+    default:
+        // Each destination row is written sequentially one block at a time
+        for (int i=0; i<frames; i+=block_frames)
+        {
+            int n = std::min(block_frames, frames - i);
+            for (int c=0; c<channels; c++)
+            {
+                float* t = dest[c] + i;
+                const float* s = src + (size_t)i*channels + c;
+                for (int j=0; j<n; j++)
+                    t[j] = s[j*channels];
+            }
         }
         break;
+    }
+}
+
+
+#ifdef TRANSPOSE_SSE2
+static void int16_to_float(float* dest, const short* src, int n)
+{
+    const __m128 scale = _mm_set1_ps(1.f/32768.f);
+    int i = 0;
+    for (; i+8<=n; i+=8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        // Sign extend by placing each 16-bit value in the upper half of a
+        // 32-bit lane followed by an arithmetic shift
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    for (; i<n; i++)
+        dest[i] = src[i] * (1.f/32768.f);
+}
+#else
+static void int16_to_float(float* dest, const short* src, int n)
+{
+    for (int i=0; i<n; i++)
+        dest[i] = src[i] * (1.f/32768.f);
+}
+#endif
+
+
+static void int24_to_float(float* dest, const unsigned char* src, int n)
+{
+    for (int i=0; i<n; i++)
+    {
+        const unsigned char* s = src + 3*i;
+        // Place the 24 bits in the upper part of a 32-bit integer to get
+        // the sign right, 2^31 = 2^23 * 2^8.
+        int v = (int)(((unsigned)s[0] << 8) | ((unsigned)s[1] << 16) | ((unsigned)s[2] << 24));
+        dest[i] = v * (1.f/2147483648.f);
+    }
+}
+
+
+/**
+ * Converts one block at a time into an L1 resident scratch buffer and
+ * deinterleaves it from there, instead of converting everything up front.
+ * A block is at least one frame, so a frame with more channels than fits in
+ * the scratch buffer is converted into a buffer on the heap instead.
+ */
+template<typename T, typename Convert>
+static void deinterleave_converted(float* const* dest, const T* src, int channels, int frames, int bytes_per_sample, Convert convert)
+{
+    float stack_scratch[block_frames*8];
+    std::vector<float> heap_scratch;
+    float* scratch = stack_scratch;
+    if (channels > block_frames*8)
+    {
+        heap_scratch.resize (channels);
+        scratch = &heap_scratch[0];
+    }
+
+    float* d[8];
+    const unsigned char* s = (const unsigned char*)src;
+    int frames_per_block = channels <= 8 ? block_frames : std::max(1, block_frames*8/channels);
+
+    std::vector<float*> dv;
+    if (channels > 8)
+        dv.resize (channels);
+    float** dp = channels > 8 ? &dv[0] : d;
+
+    for (int i=0; i<frames; i+=frames_per_block)
+    {
+        int n = std::min(frames_per_block, frames - i);
+        convert(scratch, s + (size_t)i*channels*bytes_per_sample, n*channels);
+        for (int c=0; c<channels; c++)
+            dp[c] = dest[c] + i;
+        deinterleave(dp, scratch, channels, n);
+    }
+}
+
+
+void deinterleave(float* const* dest, const short* src, int channels, int frames)
+{
+    deinterleave_converted(dest, src, channels, frames, sizeof(short),
+        [](float* d, const unsigned char* s, int n) { int16_to_float(d, (const short*)s, n); });
+}
+
+
+void deinterleave_int24(float* const* dest, const unsigned char* src, int channels, int frames)
+{
+    deinterleave_converted(dest, src, channels, frames, 3, int24_to_float);
+}
+
+
+void interleave(float* dest, const float* const* src, int channels, int frames)
+{
+    switch(channels)
+    {
+    case 1: memcpy(dest, src[0], frames*sizeof(float)); break;
+    case 2: interleave_blocked<2>(dest, src, frames); break;
+    case 3: interleave_blocked<3>(dest, src, frames); break;
+    case 4: interleave_blocked<4>(dest, src, frames); break;
+    case 5: interleave_blocked<5>(dest, src, frames); break;
+    case 6: interleave_blocked<6>(dest, src, frames); break;
+    case 7: interleave_blocked<7>(dest, src, frames); break;
+    case 8: interleave_blocked<8>(dest, src, frames); break;
     default:
-        switch(sz.width)
+        for (int i=0; i<frames; i+=block_frames)
         {
-        case 1:
-            memcpy(destp, srcp, sizeof(float)*sz.height);
-            break;
-        case 2:
-            for (int i=0; i<sz.height; i++) {
-                float *t = destp + i*2;
-                float *d = srcp + i;
-                t[0] = d[0];
-                t[1] = d[sz.height];
-            }
-            break;
-        default:
-            if (sz.height < sz.width)
+            int n = std::min(block_frames, frames - i);
+            for (int c=0; c<channels; c++)
             {
-                for (int j=0; j<sz.height; j++) {
-                    float *t = destp + j*sz.width;
-                    float *d = srcp + j;
-                    for (int i=0; i<sz.width; i++) {
-                        t[i] = d[i*sz.height];
-                    }
-                }
-            } else {
-                for (int j=0; j<sz.width; j++) {
-                    float *t = destp + j;
-                    float *d = srcp + j*sz.height;
-                    for (int i=0; i<sz.height; i++) {
-                        t[i*sz.width] = d[i];
-                    }
-                }
+                float* t = dest + (size_t)i*channels + c;
+                const float* s = src[c] + i;
+                for (int j=0; j<n; j++)
+                    t[j*channels] = s[j];
             }
-            break;
         }
         break;
     }
 }
 
+
+void accumulate(float* dest, const float* src, size_t n)
+{
+    size_t i = 0;
+#ifdef TRANSPOSE_SSE2
+    for (; i+8<=n; i+=8)
+    {
+        __m128 a0 = _mm_loadu_ps(dest + i);
+        __m128 a1 = _mm_loadu_ps(dest + i + 4);
+        __m128 b0 = _mm_loadu_ps(src + i);
+        __m128 b1 = _mm_loadu_ps(src + i + 4);
+        _mm_storeu_ps(dest + i, _mm_add_ps(a0, b0));
+        _mm_storeu_ps(dest + i + 4, _mm_add_ps(a1, b1));
+    }
+#endif
+    for (; i<n; i++)
+        dest[i] += src[i];
+}
+
+
+/**
+ * Transposes a width x height matrix in square tiles so that both the rows
+ * read and the rows written stay in cache while a tile is processed.
+ */
+static void transpose_tiled(float* destp, const float* srcp, int W, int H)
+{
+    const int tile = 32;
+    for (int j0=0; j0<H; j0+=tile)
+    {
+        int j1 = std::min(j0 + tile, H);
+        for (int i0=0; i0<W; i0+=tile)
+        {
+            int i1 = std::min(i0 + tile, W);
+            for (int j=j0; j<j1; j++)
+            {
+                float* t = destp + (size_t)j*W;
+                const float* d = srcp + j;
+                for (int i=i0; i<i1; i++)
+                    t[i] = d[(size_t)i*H];
+            }
+        }
+    }
+}
+
+
+void transpose(DataStorage<float>* dest, DataStorage<float>* src)
+{
+    DataStorageSize sz = dest->size();
+
+    EXCEPTION_ASSERT( dest->numberOfElements() == src->numberOfElements() );
+    EXCEPTION_ASSERT( sz.depth == 1 );
+
+    float* destp = CpuMemoryStorage::WriteAll<float,3>( dest ).ptr();
+    float* srcp = CpuMemoryStorage::ReadOnly<float,3>( src ).ptr();
+
+    if (sz.height <= 8)
+    {
+        // 'src' is 'sz.height' interleaved channels, 'dest' has one row per channel
+        float* rows[8];
+        for (int j=0; j<sz.height; j++)
+            rows[j] = destp + (size_t)j*sz.width;
+        deinterleave(rows, srcp, sz.height, sz.width);
+    }
+    else if (sz.width <= 8)
+    {
+        const float* rows[8];
+        for (int j=0; j<sz.width; j++)
+            rows[j] = srcp + (size_t)j*sz.height;
+        interleave(destp, rows, sz.width, sz.height);
+    }
+    else
+    {
+        transpose_tiled(destp, srcp, sz.width, sz.height);
+    }
+}
+
 } // namespace Signal
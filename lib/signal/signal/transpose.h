@@ -5,8 +5,48 @@
 
 namespace Signal {
 
+    /**
+     * @brief transpose writes the transpose of 'src' into 'dest', i.e
+     * dest[j*width + i] = src[i*height + j] where width and height is the
+     * size of 'dest'.
+     *
+     * Equivalent to deinterleave if 'dest' has at most 8 rows and to
+     * interleave if 'dest' has at most 8 columns. Larger matrices are
+     * transposed in cache sized tiles.
+     */
     void transpose(DataStorage<float>* dest, DataStorage<float>* src);
 
+    /**
+     * @brief deinterleave copies 'frames' frames of 'channels' interleaved
+     * samples from 'src' into the 'channels' separate arrays in 'dest'.
+     *
+     * 1 to 8 channels have specialized implementations that use SSE2 when
+     * available. The source is processed in blocks small enough to stay in L1.
+     */
+    void deinterleave(float* const* dest, const float* src, int channels, int frames);
+
+    /**
+     * @brief deinterleave converts signed 16-bit PCM to float in [-1, 1) as
+     * part of deinterleaving, saving a separate pass over the data.
+     */
+    void deinterleave(float* const* dest, const short* src, int channels, int frames);
+
+    /**
+     * @brief deinterleave_int24 converts packed little-endian signed 24-bit
+     * PCM (3 bytes per sample) to float in [-1, 1) as part of deinterleaving.
+     */
+    void deinterleave_int24(float* const* dest, const unsigned char* src, int channels, int frames);
+
+    /**
+     * @brief interleave is the inverse of deinterleave.
+     */
+    void interleave(float* dest, const float* const* src, int channels, int frames);
+
+    /**
+     * @brief accumulate computes dest[i] += src[i] for 0 <= i < n.
+     */
+    void accumulate(float* dest, const float* src, size_t n);
+
 } // namespace Signal
 
 #endif // TRANSPOSE_H
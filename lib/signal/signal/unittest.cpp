@@ -3,11 +3,18 @@
 #include "signal/buffer.h"
 #include "signal/buffersource.h"
 #include "signal/cache.h"
+#include "signal/cancellationtoken.h"
+#include "signal/computingremote.h"
+#include "signal/decimate.h"
+#include "signal/numatopology.h"
+#include "signal/region.h"
+#include "signal/recordercapture.h"
 #include "signal/processing/bedroom.h"
 #include "signal/processing/chain.h"
 #include "signal/processing/dag.h"
 #include "signal/processing/firstmissalgorithm.h"
 #include "signal/processing/graphinvalidator.h"
+#include "signal/processing/resultstore.h"
 #include "signal/processing/step.h"
 #include "signal/processing/targetmarker.h"
 #include "signal/processing/targetneeds.h"
@@ -54,10 +61,17 @@ int UnitTest::
         RUNTEST(Signal::Buffer);
         RUNTEST(Signal::BufferSource);
         RUNTEST(Signal::Cache);
+        RUNTEST(Signal::CancellationToken);
+        RUNTEST(Signal::ComputingRemote);
+        RUNTEST(Signal::DecimateDesc);
+        RUNTEST(Signal::NumaTopology);
+        RUNTEST(Signal::Region);
+        RUNTEST(Signal::RecorderCapture);
         RUNTEST(Signal::Processing::Bedroom);
         RUNTEST(Signal::Processing::Dag);
         RUNTEST(Signal::Processing::FirstMissAlgorithm);
         RUNTEST(Signal::Processing::GraphInvalidator);
+        RUNTEST(Signal::Processing::ResultStore);
         RUNTEST(Signal::Processing::Step);
         RUNTEST(Signal::Processing::TargetMarker);
         RUNTEST(Signal::Processing::TargetNeeds);
@@ -0,0 +1,160 @@
+#include "transposebenchmark.h"
+#include "randombuffer.h"
+#include "signal/transpose.h"
+#include "signal/buffer.h"
+#include "cpumemorystorage.h"
+#include "trace_perf.h"
+#include "exceptionassert.h"
+
+#include <vector>
+#include <string.h> // memcmp
+
+#include <boost/format.hpp>
+
+using namespace std;
+using namespace Signal;
+
+namespace Test {
+
+// One second of 8 channels at 44.1 kHz, rounded up
+static const int N = 1<<19;
+
+
+void TransposeBenchmark::
+        test()
+{
+    // It should deinterleave and interleave 1 to 8 channels correctly and fast.
+    for (int C=1; C<=8; C++)
+    {
+        int frames = N/C;
+        vector<float> interleaved(C*frames), back(C*frames);
+        for (int i=0; i<C*frames; i++)
+            interleaved[i] = (float)i;
+
+        pBuffer b(new Buffer(Interval(0,frames), 1, C));
+        vector<float*> channels(C);
+        vector<const float*> cchannels(C);
+        for (int c=0; c<C; c++)
+            cchannels[c] = channels[c] = b->getChannel (c)->waveform_data ()->getCpuMemory ();
+
+        {
+            TRACE_PERF((boost::format("It should deinterleave %d channels") % C).str());
+            deinterleave(&channels[0], &interleaved[0], C, frames);
+        }
+
+        for (int c=0; c<C; c++)
+            for (int i=0; i<frames; i++)
+                EXCEPTION_ASSERT_EQUALS(channels[c][i], interleaved[i*C + c]);
+
+        {
+            TRACE_PERF((boost::format("It should interleave %d channels") % C).str());
+            interleave(&back[0], &cchannels[0], C, frames);
+        }
+
+        EXCEPTION_ASSERT(interleaved == back);
+
+        vector<short> pcm16(C*frames);
+        for (int i=0; i<C*frames; i++)
+            pcm16[i] = (short)(i*31 - 32768);
+
+        {
+            TRACE_PERF((boost::format("It should deinterleave %d channels of 16-bit PCM") % C).str());
+            deinterleave(&channels[0], &pcm16[0], C, frames);
+        }
+
+        for (int c=0; c<C; c++)
+            for (int i=0; i<frames; i++)
+                EXCEPTION_ASSERT_EQUALS(channels[c][i], pcm16[i*C + c]/32768.f);
+
+        vector<unsigned char> pcm24(3*C*frames);
+        for (int i=0; i<C*frames; i++)
+        {
+            int v = ((i*97) & 0xffffff) - (1<<23);
+            pcm24[3*i+0] = v & 0xff;
+            pcm24[3*i+1] = (v>>8) & 0xff;
+            pcm24[3*i+2] = (v>>16) & 0xff;
+        }
+
+        {
+            TRACE_PERF((boost::format("It should deinterleave %d channels of 24-bit PCM") % C).str());
+            deinterleave_int24(&channels[0], &pcm24[0], C, frames);
+        }
+
+        for (int c=0; c<C; c++)
+            for (int i=0; i<frames; i++)
+                EXCEPTION_ASSERT_EQUALS(channels[c][i], ((((i*C + c)*97) & 0xffffff) - (1<<23))/8388608.f);
+    }
+
+    // It should deinterleave frames with more channels than fit in a block.
+    {
+        int C = 3000, frames = 3;
+        vector<short> pcm16(C*frames);
+        for (int i=0; i<C*frames; i++)
+            pcm16[i] = (short)(i - C*frames/2);
+
+        vector<vector<float>> data(C, vector<float>(frames));
+        vector<float*> channels(C);
+        for (int c=0; c<C; c++)
+            channels[c] = &data[c][0];
+
+        deinterleave(&channels[0], &pcm16[0], C, frames);
+
+        for (int c=0; c<C; c++)
+            for (int i=0; i<frames; i++)
+                EXCEPTION_ASSERT_EQUALS(channels[c][i], pcm16[i*C + c]/32768.f);
+    }
+
+    // It should transpose matrices larger than 8x8.
+    {
+        int W = 1000, H = 300;
+        DataStorage<float> src(H, W), dest(W, H);
+        float* s = src.getCpuMemory ();
+        for (int i=0; i<W*H; i++)
+            s[i] = (float)i;
+
+        {
+            TRACE_PERF("It should transpose large matrices in tiles");
+            transpose(&dest, &src);
+        }
+
+        float* d = dest.getCpuMemory ();
+        for (int j=0; j<H; j++)
+            for (int i=0; i<W; i++)
+                EXCEPTION_ASSERT_EQUALS(d[j*W + i], s[i*H + j]);
+    }
+
+    // It should accumulate and overwrite buffers with partial overlap fast.
+    {
+        pBuffer a = RandomBuffer::randomBuffer(Interval(0,N), 1, 2, 1);
+        pBuffer b = RandomBuffer::randomBuffer(Interval(3,N+3), 1, 2, 2);
+        pBuffer expected = RandomBuffer::randomBuffer(Interval(0,N), 1, 2, 1);
+        for (int c=0; c<2; c++)
+        {
+            float* p = expected->getChannel (c)->waveform_data ()->getCpuMemory ();
+            float* q = b->getChannel (c)->waveform_data ()->getCpuMemory ();
+            for (int i=3; i<N; i++)
+                p[i] += q[i-3];
+        }
+
+        {
+            TRACE_PERF("It should accumulate 2 channels");
+            *a += *b;
+        }
+
+        EXCEPTION_ASSERT(*a == *expected);
+
+        {
+            TRACE_PERF("It should overwrite 2 channels");
+            *a |= *b;
+        }
+
+        for (int c=0; c<2; c++)
+        {
+            float* p = a->getChannel (c)->waveform_data ()->getCpuMemory ();
+            float* q = b->getChannel (c)->waveform_data ()->getCpuMemory ();
+            EXCEPTION_ASSERT(0 == memcmp(p+3, q, (N-3)*sizeof(float)));
+        }
+    }
+}
+
+} // namespace Test
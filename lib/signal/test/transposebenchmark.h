@@ -0,0 +1,20 @@
+#ifndef TEST_TRANSPOSEBENCHMARK_H
+#define TEST_TRANSPOSEBENCHMARK_H
+
+namespace Test {
+
+/**
+ * @brief The TransposeBenchmark class should measure the throughput of
+ * interleaving, deinterleaving, sample conversion and channel merging.
+ *
+ * Thresholds are defined in lib/signal/trace_perf/transposebenchmark.cpp.db
+ */
+class TransposeBenchmark
+{
+public:
+    static void test();
+};
+
+} // namespace Test
+
+#endif // TEST_TRANSPOSEBENCHMARK_H
@@ -23,7 +23,7 @@ HEADERS += \
 
 PCH_HEADERS = $$PWD/tfr/*.h
 
-INCLUDEPATH += ../backtrace ../gpumisc ../signal
+INCLUDEPATH += ../backtrace ../gpumisc ../justmisc ../signal
 win32: INCLUDEPATH += ../sonicawe-winlib
 
 macx:exists(/opt/local/include/): INCLUDEPATH += /opt/local/include/ # macports
@@ -12,6 +12,19 @@ Signal::OperationDesc::Extent ChunkFilterDesc::
 }
 
 
+Signal::Region ChunkFilterDesc::
+        affectedRegion(const Signal::Region& R) const
+{
+    return Signal::Region(R.samples ());
+}
+
+
+void ChunkFilterDesc::
+        deprecatedInput(const Signal::Region&) const
+{
+}
+
+
 void ChunkFilterDesc::
         transformDesc(pTransformDesc d)
 {
@@ -85,6 +85,38 @@ public:
     };
 
 
+    /**
+     * @brief The ChunkFilter::OwnInverseTag class describes that
+     * 'ChunkFilter::operator ()' may set ChunkAndInverse::inverse itself
+     * instead of leaving the transformed data to be inverted. No other filter
+     * can be applied to the same chunk afterwards.
+     *
+     *   class MyChunkFilter: public Tfr::ChunkFilter, public Tfr::ChunkFilter::OwnInverseTag
+     *   { ... };
+     */
+    class OwnInverseTag
+    {
+    public:
+        virtual ~OwnInverseTag() {}
+    };
+
+
+    /**
+     * @brief The ChunkFilter::ParallelChannelsTag class describes that
+     * separate instances from the same ChunkFilterDesc may filter different
+     * channels of a buffer concurrently, i.e 'ChunkFilter::operator ()' only
+     * depends on the chunk it is given.
+     *
+     *   class MyChunkFilter: public Tfr::ChunkFilter, public Tfr::ChunkFilter::ParallelChannelsTag
+     *   { ... };
+     */
+    class ParallelChannelsTag
+    {
+    public:
+        virtual ~ParallelChannelsTag() {}
+    };
+
+
     virtual ~ChunkFilter() {}
 
     /**
@@ -115,6 +147,22 @@ public:
 
     virtual pChunkFilter                    createChunkFilter(Signal::ComputingEngine* engine=0) const = 0;
     virtual Signal::OperationDesc::Extent   extent() const;
+
+    /**
+     * @brief affectedRegion is the region of a chunk that may change after
+     * filtering if the chunk changes within 'R', see
+     * TransformOperationDesc::affectedRegion.
+     *
+     * The default is all frequencies. A filter that only changes each element
+     * depending on elements at the same frequency should return 'R'.
+     */
+    virtual Signal::Region                  affectedRegion(const Signal::Region& R) const;
+
+    /**
+     * @brief deprecatedInput is called when chunks have changed within 'R',
+     * see TransformOperationDesc::deprecatedInput. Does nothing by default.
+     */
+    virtual void                            deprecatedInput(const Signal::Region& R) const;
     virtual void                            transformDesc(pTransformDesc d);
     virtual ChunkFilterDesc::ptr            copy() const;
     virtual QString                         toString() const;
@@ -0,0 +1,409 @@
+#include "chunksizetuner.h"
+#include "transform.h"
+
+#include "signal/buffer.h"
+
+#include "exceptionassert.h"
+#include "tasktimer.h"
+#include "timer.h"
+
+#include <boost/format.hpp>
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+using namespace std;
+
+namespace Tfr {
+
+static ChunkSizeTuner::ptr global_tuner;
+
+
+ChunkSizeTuner::
+        ChunkSizeTuner(std::string cache_file, unsigned max_size, Busy busy)
+    :
+      cache_file_(cache_file),
+      max_size_(max_size),
+      busy_(busy)
+{
+    load ();
+}
+
+
+ChunkSizeTuner::
+        ~ChunkSizeTuner()
+{
+    {
+        lock_guard<mutex> l(lock_);
+        quit_ = true;
+    }
+
+    wakeup_.notify_all ();
+
+    if (thread_.joinable ())
+        thread_.join ();
+}
+
+
+unsigned ChunkSizeTuner::
+        tune(const TransformDesc& t, float sample_rate)
+{
+    string k = key(t, sample_rate);
+
+    {
+        lock_guard<mutex> l(lock_);
+        auto i = results_.find (k);
+        if (i != results_.end ())
+            return i->second.size;
+    }
+
+    // Don't block size() while measuring
+    Result r = measure (t, sample_rate);
+    if (0 == r.size)
+        return 0;
+
+    lock_guard<mutex> l(lock_);
+    results_[k] = r;
+    save ();
+
+    TaskInfo(boost::format("%s: %u samples per chunk") % k % r.size);
+    return r.size;
+}
+
+
+void ChunkSizeTuner::
+        request(const TransformDesc& t, float sample_rate)
+{
+    string k = key(t, sample_rate);
+
+    {
+        lock_guard<mutex> l(lock_);
+        if (quit_ || results_.count (k) || !requested_.insert (k).second)
+            return;
+
+        queue_.push_back (make_pair(t.copy (), sample_rate));
+        if (!thread_.joinable ())
+            thread_ = std::thread(&ChunkSizeTuner::run, this);
+    }
+
+    wakeup_.notify_one ();
+}
+
+
+void ChunkSizeTuner::
+        run()
+{
+    unique_lock<mutex> l(lock_);
+    while (true)
+    {
+        wakeup_.wait (l, [this](){ return quit_ || !queue_.empty (); });
+        if (quit_)
+            return;
+
+        TransformDesc::ptr d = queue_.front ().first;
+        float sample_rate = queue_.front ().second;
+        queue_.pop_front ();
+        string k = key(*d, sample_rate);
+
+        l.unlock ();
+        try
+          {
+            tune (*d, sample_rate);
+          }
+        catch (const std::exception& x)
+          {
+            TaskInfo(boost::format("Couldn't tune %s: %s") % k % x.what ());
+          }
+        l.lock ();
+
+        requested_.erase (k);
+    }
+}
+
+
+bool ChunkSizeTuner::
+        wait_while_busy() const
+{
+    unique_lock<mutex> l(lock_);
+    while (!quit_ && busy_ && busy_ ())
+        wakeup_.wait_for (l, chrono::milliseconds(10));
+    return !quit_;
+}
+
+
+unsigned ChunkSizeTuner::
+        size(const TransformDesc& t, float sample_rate) const
+{
+    string k = key(t, sample_rate);
+
+    lock_guard<mutex> l(lock_);
+    auto i = results_.find (k);
+    return i == results_.end () ? 0 : i->second.size;
+}
+
+
+string ChunkSizeTuner::
+        report() const
+{
+    stringstream ss;
+
+    lock_guard<mutex> l(lock_);
+    for (const auto& v : results_)
+    {
+        ss << v.first << ": " << v.second.size << " samples per chunk" << endl;
+        for (const Candidate& c : v.second.candidates)
+            ss << boost::format("  %c %8u %10.3g samples/s")
+                  % (c.size == v.second.size ? '*' : ' ')
+                  % c.size
+                  % c.samples_per_second << endl;
+    }
+
+    return ss.str ();
+}
+
+
+string ChunkSizeTuner::
+        key(const TransformDesc& t, float sample_rate)
+{
+    return (boost::format("%s, %g Hz, %u cores") % t.toString () % sample_rate % thread::hardware_concurrency ()).str ();
+}
+
+
+ChunkSizeTuner::ptr ChunkSizeTuner::
+        global()
+{
+    return atomic_load(&global_tuner);
+}
+
+
+void ChunkSizeTuner::
+        global(ptr p)
+{
+    atomic_store(&global_tuner, p);
+}
+
+
+ChunkSizeTuner::Result ChunkSizeTuner::
+        measure(const TransformDesc& d, float sample_rate) const
+{
+    TaskTimer tt(boost::format("Tuning chunk size for %s") % d.toString ());
+
+    pTransform t = d.createTransform ();
+    Result r;
+    r.size = 0;
+    double best = 0;
+
+    for (unsigned L = d.next_good_size (0, sample_rate); L <= max_size_;)
+    {
+        Signal::Interval expected;
+        Signal::Interval I = d.requiredInterval (Signal::Interval(0, L), &expected);
+        unsigned n = expected.count ();
+        if (!r.candidates.empty () && n <= r.candidates.back ().size)
+            break;
+
+        try
+          {
+            Signal::pMonoBuffer b(new Signal::MonoBuffer(I, sample_rate));
+            float* p = b->waveform_data ()->getCpuMemory ();
+            for (int i=0; i<b->number_of_samples (); i++)
+                p[i] = 2.f*rand() / RAND_MAX - 1.f;
+
+            if (!(*t)( b )) // init
+                break;
+
+            // Best of a few runs, but spend at least 20 ms per candidate.
+            // Runs that overlap other work are discarded, wait until it's done.
+            double T = 0;
+            Timer total;
+            for (int i=0; i<3 || total.elapsed () < 0.02;)
+              {
+                if (!wait_while_busy ())
+                    return Result{0, {}};
+
+                Timer timer;
+                (*t)( b );
+                double e = timer.elapsed ();
+                if (busy_ && busy_ ())
+                  {
+                    total.restart ();
+                    continue;
+                  }
+
+                T = 0==i ? e : std::min(T, e);
+                i++;
+              }
+
+            Candidate c {n, n / std::max(T, 1e-9)};
+            r.candidates.push_back (c);
+
+            tt.info ("%u samples: %.3g samples/s", c.size, c.samples_per_second);
+
+            if (c.samples_per_second > best)
+              {
+                best = c.samples_per_second;
+                r.size = c.size;
+              }
+          }
+        catch (const std::bad_alloc&)
+          {
+            break;
+          }
+
+        unsigned next = d.next_good_size (L, sample_rate);
+        if (next <= L)
+            break;
+        L = next;
+    }
+
+    return r;
+}
+
+
+void ChunkSizeTuner::
+        load()
+{
+    if (cache_file_.empty ())
+        return;
+
+    // One line per transform: key, chosen size and size:throughput pairs
+    // separated by tabs
+    ifstream f(cache_file_.c_str ());
+    string line;
+    while (getline(f, line))
+    {
+        stringstream ss(line);
+        string k, size, c;
+        if (!getline(ss, k, '\t') || !getline(ss, size, '\t'))
+            continue;
+
+        Result r;
+        r.size = strtoul(size.c_str (), 0, 10);
+        while (getline(ss, c, '\t'))
+        {
+            Candidate x;
+            if (2 == sscanf(c.c_str (), "%u:%lg", &x.size, &x.samples_per_second))
+                r.candidates.push_back (x);
+        }
+
+        if (0 < r.size)
+            results_[k] = r;
+    }
+}
+
+
+void ChunkSizeTuner::
+        save() const
+{
+    if (cache_file_.empty ())
+        return;
+
+    ofstream f(cache_file_.c_str (), ios_base::trunc);
+    for (const auto& v : results_)
+    {
+        f << v.first << '\t' << v.second.size;
+        for (const Candidate& c : v.second.candidates)
+            f << '\t' << c.size << ':' << c.samples_per_second;
+        f << endl;
+    }
+
+    if (!f)
+        TaskInfo(boost::format("Couldn't write chunk sizes to %s") % cache_file_);
+}
+
+} // namespace Tfr
+
+#include "stftdesc.h"
+
+#include <QDir>
+
+namespace Tfr {
+
+void ChunkSizeTuner::
+        test()
+{
+    // It should pick the candidate with the highest throughput.
+    {
+        StftDesc d;
+        d.set_exact_chunk_size (256);
+
+        ChunkSizeTuner tuner("", 1<<16);
+        EXCEPTION_ASSERT_EQUALS(tuner.size (d, 44100), 0u);
+
+        unsigned L = tuner.tune (d, 44100);
+        EXCEPTION_ASSERT_LESS(0u, L);
+        EXCEPTION_ASSERT_EQUALS(tuner.size (d, 44100), L);
+        EXCEPTION_ASSERT(tuner.report ().find (key(d, 44100)) != std::string::npos);
+
+        // Results are kept apart by sample rate and transform
+        EXCEPTION_ASSERT_EQUALS(tuner.size (d, 8000), 0u);
+        d.set_exact_chunk_size (512);
+        EXCEPTION_ASSERT_EQUALS(tuner.size (d, 44100), 0u);
+    }
+
+    // It should measure requested transforms in the background.
+    {
+        StftDesc d;
+        d.set_exact_chunk_size (256);
+
+        ChunkSizeTuner::ptr tuner(new ChunkSizeTuner("", 1<<16));
+        tuner->request (d, 8000);
+        tuner->request (d, 8000);
+
+        Timer t;
+        while (0 == tuner->size (d, 8000) && t.elapsed () < 10)
+            std::this_thread::sleep_for (std::chrono::milliseconds(1));
+
+        EXCEPTION_ASSERT_LESS(0u, tuner->size (d, 8000));
+    }
+
+    // It should not measure while other work is busy, and stop measuring
+    // when it is destroyed.
+    {
+        StftDesc d;
+        d.set_exact_chunk_size (256);
+
+        std::shared_ptr<std::atomic<bool>> busy(new std::atomic<bool>(true));
+        ChunkSizeTuner::ptr tuner(new ChunkSizeTuner("", 1<<16, [busy](){ return (bool)*busy; }));
+        tuner->request (d, 8000);
+
+        std::this_thread::sleep_for (std::chrono::milliseconds(50));
+        EXCEPTION_ASSERT_EQUALS(tuner->size (d, 8000), 0u);
+
+        *busy = false;
+        Timer t;
+        while (0 == tuner->size (d, 8000) && t.elapsed () < 10)
+            std::this_thread::sleep_for (std::chrono::milliseconds(1));
+        EXCEPTION_ASSERT_LESS(0u, tuner->size (d, 8000));
+
+        *busy = true;
+        d.set_exact_chunk_size (512);
+        tuner->request (d, 8000);
+
+        Timer t2;
+        tuner.reset ();
+        EXCEPTION_ASSERT_LESS(t2.elapsed (), 1.0);
+    }
+
+    // It should reuse results from the cache file.
+    {
+        std::string filename = (QDir::tempPath () + "/chunksizetuner_test.txt").toStdString ();
+        remove(filename.c_str ());
+
+        StftDesc d;
+        d.set_exact_chunk_size (256);
+
+        unsigned L = ChunkSizeTuner(filename, 1<<16).tune (d, 44100);
+
+        ChunkSizeTuner tuner(filename, 1<<16);
+        EXCEPTION_ASSERT_EQUALS(tuner.size (d, 44100), L);
+        EXCEPTION_ASSERT_EQUALS(tuner.report (), ChunkSizeTuner(filename).report ());
+
+        remove(filename.c_str ());
+    }
+}
+
+} // namespace Tfr
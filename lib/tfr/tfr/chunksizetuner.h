@@ -0,0 +1,142 @@
+#ifndef TFR_CHUNKSIZETUNER_H
+#define TFR_CHUNKSIZETUNER_H
+
+#include <boost/shared_ptr.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Tfr {
+
+class TransformDesc;
+
+/**
+ * @brief The ChunkSizeTuner class should find the chunk size that gives the
+ * highest throughput for a transform on this machine.
+ *
+ * Example:
+ *    ChunkSizeTuner::global (ChunkSizeTuner::ptr(new ChunkSizeTuner("chunksizes.txt")));
+ *    ...
+ *    unsigned L = ChunkSizeTuner::global ()->tune (stftdesc, 44100);
+ *
+ * The first time a transform is tuned the candidate sizes given by
+ * TransformDesc::next_good_size are measured by transforming random data. The
+ * size with the most valid output samples per second wins. Results are keyed
+ * by TransformDesc::toString(), the sample rate and the number of cores and
+ * saved to 'cache_file', which is assumed to be local to this machine, so that
+ * each transform is only measured once.
+ *
+ * Measuring takes a while and is never done while holding a lock that other
+ * threads need. TransformOperationDesc requests tuning in the background when
+ * it processes a buffer and limits requiredInterval to the tuned size once
+ * there is one.
+ *
+ * Timings taken while the machine is 'busy' with other work are discarded
+ * and measured again when it is idle, so that a loaded machine isn't tuned
+ * for and saved to 'cache_file'.
+ */
+class ChunkSizeTuner
+{
+public:
+    typedef std::shared_ptr<ChunkSizeTuner> ptr;
+    typedef std::function<bool()> Busy;
+
+    struct Candidate
+    {
+        unsigned size;
+        double samples_per_second;
+    };
+
+    struct Result
+    {
+        unsigned size;
+        std::vector<Candidate> candidates;
+    };
+
+    /**
+     * @brief ChunkSizeTuner loads previous results from 'cache_file'. Results
+     * are not persisted if 'cache_file' is empty.
+     * @param max_size The largest chunk size to measure.
+     * @param busy Tells if other work is running, e.g.
+     * Signal::Processing::Task::running. Never busy if empty.
+     */
+    ChunkSizeTuner(std::string cache_file="", unsigned max_size=1<<20, Busy busy=Busy());
+    ChunkSizeTuner(const ChunkSizeTuner&) = delete;
+    ChunkSizeTuner& operator=(const ChunkSizeTuner&) = delete;
+
+    /**
+     * @brief ~ChunkSizeTuner stops measuring requested transforms and joins
+     * the background thread.
+     */
+    ~ChunkSizeTuner();
+
+    /**
+     * @brief tune returns the best chunk size for 't', measuring it in the
+     * calling thread first if it hasn't been tuned before. Other callers are
+     * not blocked while measuring. Use it at startup, not from a worker, as
+     * it waits while other work is busy.
+     * @return 0 if the tuner was destroyed while measuring.
+     */
+    unsigned tune(const TransformDesc& t, float sample_rate);
+
+    /**
+     * @brief request queues 't' to be measured on a background thread if it
+     * hasn't been tuned and isn't queued already. Returns immediately.
+     */
+    void request(const TransformDesc& t, float sample_rate);
+
+    /**
+     * @brief size returns the tuned chunk size for 't' or 0 if it hasn't been
+     * tuned. Doesn't measure anything.
+     */
+    unsigned size(const TransformDesc& t, float sample_rate) const;
+
+    /**
+     * @brief report lists the chosen size and the measured throughput of each
+     * candidate for every tuned transform.
+     */
+    std::string report() const;
+
+    const std::string& cache_file() const { return cache_file_; }
+
+    static std::string key(const TransformDesc& t, float sample_rate);
+
+    /**
+     * @brief global is used by TransformOperationDesc, null by default.
+     */
+    static ptr global();
+    static void global(ptr);
+
+private:
+    Result measure(const TransformDesc& t, float sample_rate) const;
+    bool wait_while_busy() const;
+    void run();
+    void load();
+    void save() const;
+
+    const std::string cache_file_;
+    const unsigned max_size_;
+    const Busy busy_;
+    mutable std::mutex lock_;
+    std::map<std::string, Result> results_;
+    std::set<std::string> requested_;
+    std::deque<std::pair<boost::shared_ptr<TransformDesc>, float>> queue_;
+    mutable std::condition_variable wakeup_;
+    bool quit_ = false;
+    std::thread thread_;
+
+public:
+    static void test();
+};
+
+} // namespace Tfr
+
+#endif // TFR_CHUNKSIZETUNER_H
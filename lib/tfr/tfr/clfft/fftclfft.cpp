@@ -9,6 +9,7 @@
 #include "cpumemorystorage.h"
 #include "openclmemorystorage.h"
 #include "tasktimer.h"
+#include "trace_scope.h"
 #include "computationkernel.h"
 #include "clfft/clfftkernelbuffer.h"
 
@@ -24,6 +25,7 @@ namespace Tfr {
 void FftClFft::
         compute( Tfr::ChunkData::Ptr input, Tfr::ChunkData::Ptr output, FftDirection direction )
 {
+    TRACE_SCOPE("FftClFft::compute");
     TIME_STFT TaskTimer tt("Fft ClFft");
 
     unsigned n = input->getNumberOfElements().width;
@@ -59,6 +61,7 @@ void FftClFft::
 void FftClFft::
         computeR2C( DataStorage<float>::Ptr input, Tfr::ChunkData::Ptr output )
 {
+    TRACE_SCOPE("FftClFft::computeR2C");
     unsigned denseWidth = output->size().width;
     unsigned redundantWidth = input->size().width;
 
@@ -88,6 +91,7 @@ void FftClFft::
 void FftClFft::
         computeC2R( Tfr::ChunkData::Ptr input, DataStorage<float>::Ptr output )
 {
+    TRACE_SCOPE("FftClFft::computeC2R");
     unsigned denseWidth = input->size().width;
     unsigned redundantWidth = output->size().width;
 
@@ -116,6 +120,7 @@ void FftClFft::
 void FftClFft::
         compute( Tfr::ChunkData::Ptr input, Tfr::ChunkData::Ptr output, DataStorageSize n, FftDirection direction )
 {
+    TRACE_SCOPE("FftClFft::compute batch");
     TaskTimer tt("Stft::computeWithClFft( matrix[%d, %d], %s )",
                  input->size().width,
                  input->size().height,
@@ -151,6 +156,7 @@ void FftClFft::
 void FftClFft::
         compute(DataStorage<float>::Ptr input, Tfr::ChunkData::Ptr output, DataStorageSize n )
 {
+    TRACE_SCOPE("FftClFft::compute batch R2C");
     unsigned denseWidth = n.width/2+1;
 
     EXCEPTION_ASSERT( output->numberOfElements()/denseWidth == n.height );
@@ -182,6 +188,7 @@ void FftClFft::
 void FftClFft::
         inverse(Tfr::ChunkData::Ptr input, DataStorage<float>::Ptr output, DataStorageSize n )
 {
+    TRACE_SCOPE("FftClFft::inverse batch C2R");
     unsigned denseWidth = n.width/2+1;
     unsigned redundantWidth = n.width;
     unsigned batchcount1 = output->numberOfElements()/redundantWidth,
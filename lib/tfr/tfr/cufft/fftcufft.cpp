@@ -9,6 +9,7 @@
 #include "CudaProperties.h"
 #include "cudaglobalstorage.h"
 #include "tasktimer.h"
+#include "trace_scope.h"
 #include "cuffthandlecontext.h"
 
 //#define TIME_STFT
@@ -21,6 +22,7 @@ namespace Tfr {
 void FftCufft::
         compute( Tfr::ChunkData::Ptr input, Tfr::ChunkData::Ptr output, FftDirection direction )
 {
+    TRACE_SCOPE("FftCufft::compute");
     TIME_STFT TaskTimer tt("FFt cufft");
 
     cufftComplex* d = (cufftComplex*)CudaGlobalStorage::WriteAll<1>( output ).device_ptr();
@@ -53,6 +55,7 @@ void FftCufft::
 void FftCufft::
         computeR2C( DataStorage<float>::Ptr input, Tfr::ChunkData::Ptr output )
 {
+    TRACE_SCOPE("FftCufft::computeR2C");
     cufftReal* i = CudaGlobalStorage::ReadOnly<1>( input ).device_ptr();
     cufftComplex* o = (cufftComplex*)CudaGlobalStorage::WriteAll<1>( output ).device_ptr();
 
@@ -67,6 +70,7 @@ void FftCufft::
 void FftCufft::
         computeC2R( Tfr::ChunkData::Ptr input, DataStorage<float>::Ptr output )
 {
+    TRACE_SCOPE("FftCufft::computeC2R");
     cufftComplex* i = (cufftComplex*)CudaGlobalStorage::ReadOnly<1>( input ).device_ptr();
     cufftReal* o = CudaGlobalStorage::WriteAll<1>( output ).device_ptr();
 
@@ -96,6 +100,7 @@ void FftCufft::
 void FftCufft::
         compute(Tfr::ChunkData::Ptr inputdata, Tfr::ChunkData::Ptr outputdata, DataStorageSize n, FftDirection direction )
 {
+    TRACE_SCOPE("FftCufft::compute batch");
     cufftComplex* input = (cufftComplex*)CudaGlobalStorage::ReadOnly<1>(inputdata).device_ptr();
     cufftComplex* output = (cufftComplex*)CudaGlobalStorage::WriteAll<1>(outputdata).device_ptr();
 
@@ -149,6 +154,7 @@ void FftCufft::
 void FftCufft::
         compute(DataStorage<float>::Ptr inputbuffer, Tfr::ChunkData::Ptr transform_data, DataStorageSize n)
 {
+    TRACE_SCOPE("FftCufft::compute batch R2C");
     DataStorageSize actualSize(n.width/2 + 1, n.height);
 
     int window_size = n.width;
@@ -233,6 +239,7 @@ void FftCufft::
 void FftCufft::
         inverse( Tfr::ChunkData::Ptr inputdata, DataStorage<float>::Ptr outputdata, DataStorageSize n )
 {
+    TRACE_SCOPE("FftCufft::inverse batch C2R");
     const int actualSize = n.width/2 + 1;
     cufftComplex* input = (cufftComplex*)CudaGlobalStorage::ReadOnly<1>( inputdata ).device_ptr();
     cufftReal* output = (cufftReal*)CudaGlobalStorage::WriteAll<1>( outputdata ).device_ptr();
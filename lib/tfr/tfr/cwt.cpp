@@ -5,6 +5,7 @@
 #include "supersample.h"
 
 #include "signal/buffersource.h"
+#include "signal/cancellationtoken.h"
 
 // gpumisc
 //#include <cufft.h>
@@ -192,6 +193,10 @@ pChunk Cwt::
                 continue;
         }
 
+        // Each chunk part is an fft and a wavelet transform of its own, stop
+        // here if the result isn't needed anymore
+        Signal::CancellationToken::checkpoint ();
+
         // If the biggest j required to be in this chunk is close to the end
         // 'n_j' then include all remaining scales in this chunk as well.
         if (2*(n_j - next_j) < n_j - prev_j || next_j+2>=n_j)
@@ -448,6 +453,16 @@ Signal::Interval Cwt::
     return Signal::Intervals(I).enlarge( n ).spannedInterval ();
 }
 
+
+void Cwt::
+        affectedFrequencies( float& f1, float& f2 ) const
+{
+    // A wavelet at 'f' covers the frequencies f/r to f*r, see find_bin
+    float r = 1.f + _wavelet_scale_suppport/(2*M_PI*sigma());
+    f1 /= r;
+    f2 *= r;
+}
+
 //Signal::Interval Cwt::
 //        validLength(Signal::pBuffer buffer)
 //{
@@ -1395,4 +1410,46 @@ float Cwt::
 
 
 
+} // namespace Tfr
+
+#include "test/randombuffer.h"
+#include "trace_perf.h"
+
+namespace Tfr {
+
+void Cwt::
+        test()
+{
+    // It should compute the continuous wavelet transform of a buffer.
+    {
+        Cwt cwt;
+        float fs = 1024;
+        cwt.set_wanted_min_hz (20, fs);
+
+        Signal::Interval expected;
+        Signal::Interval r = cwt.requiredInterval (Signal::Interval(0,4), &expected);
+        EXCEPTION_ASSERT(expected & Signal::Interval(0,1));
+
+        Signal::pMonoBuffer b = Test::RandomBuffer::randomBuffer (r, fs, 1)->getChannel (0);
+        pChunk c = cwt(b);
+        EXCEPTION_ASSERT_EQUALS(c->getCoveredInterval (), expected);
+    }
+
+    // It should transform a fraction of a second of audio quickly.
+    {
+        Cwt cwt;
+        float fs = 44100;
+        cwt.set_wanted_min_hz (200, fs);
+
+        Signal::Interval expected;
+        Signal::Interval r = cwt.requiredInterval (Signal::Interval(0,1<<14), &expected);
+        Signal::pMonoBuffer b = Test::RandomBuffer::randomBuffer (r, fs, 1)->getChannel (0);
+        cwt(b); // init
+
+        TRACE_PERF("Cwt should transform 16384 samples from 200 Hz at 20 scales per octave");
+        pChunk c = cwt(b);
+        EXCEPTION_ASSERT_EQUALS(c->getCoveredInterval (), expected);
+    }
+}
+
 } // namespace Tfr
@@ -49,6 +49,7 @@ public:
     //virtual Signal::Interval validLength(Signal::pBuffer buffer);
     Signal::Interval requiredInterval( const Signal::Interval& I, Signal::Interval* expectedOutput ) const override;
     Signal::Interval affectedInterval( const Signal::Interval& I ) const override;
+    void affectedFrequencies( float& f1, float& f2 ) const override;
     bool operator==(const TransformDesc& b) const override;
 
 
@@ -151,6 +152,9 @@ private:
     float _wavelet_def_time_suppport;
     float _wavelet_scale_suppport;
     float _jibberish_normalization;
+
+public:
+    static void test();
 };
 
 } // namespace Tfr
@@ -5,6 +5,7 @@
 #include "cpumemorystorage.h"
 #include "complexbuffer.h"
 #include "tasktimer.h"
+#include "trace_scope.h"
 #include "computationkernel.h"
 
 
@@ -38,6 +39,7 @@ namespace Tfr {
 void FftOoura::
         compute( Tfr::ChunkData::ptr input, Tfr::ChunkData::ptr output, FftDirection direction )
 {
+    TRACE_SCOPE("FftOoura::compute");
     EXCEPTION_ASSERT_EQUALS(input->size (), output->size ());
     *output = *input;
     computeOoura(output, direction);
@@ -88,6 +90,7 @@ void FftOoura::
 void FftOoura::
         computeR2C( DataStorage<float>::ptr input, Tfr::ChunkData::ptr output )
 {
+    TRACE_SCOPE("FftOoura::computeR2C");
     int denseWidth = output->size().width;
     int redundantWidth = input->size().width;
 
@@ -115,6 +118,7 @@ void FftOoura::
 void FftOoura::
         computeC2R( Tfr::ChunkData::ptr input, DataStorage<float>::ptr output )
 {
+    TRACE_SCOPE("FftOoura::computeC2R");
     int denseWidth = input->size().width;
     int redundantWidth = output->size().width;
 
@@ -142,6 +146,7 @@ void FftOoura::
 void FftOoura::
         compute( Tfr::ChunkData::ptr input, Tfr::ChunkData::ptr output, DataStorageSize n, FftDirection direction )
 {
+    TRACE_SCOPE("FftOoura::compute batch");
     EXCEPTION_ASSERT_EQUALS(output->size (), input->size ());
     *output = *input;
     computeOoura(output, n, direction);
@@ -180,6 +185,7 @@ void FftOoura::
 void FftOoura::
         compute(DataStorage<float>::ptr input, Tfr::ChunkData::ptr output, DataStorageSize n )
 {
+    TRACE_SCOPE("FftOoura::compute batch R2C");
     TIME_STFT TaskTimer tt("Stft Ooura R2C");
 
     DataStorageSize actualSize(n.width/2 + 1, n.height);
@@ -213,6 +219,7 @@ void FftOoura::
 void FftOoura::
         inverse(Tfr::ChunkData::ptr input, DataStorage<float>::ptr output, DataStorageSize n )
 {
+    TRACE_SCOPE("FftOoura::inverse batch C2R");
     TIME_STFT TaskTimer tt("Stft Ooura C2R");
 
     int denseWidth = n.width/2+1;
@@ -2,6 +2,7 @@
 #include "stftkernel.h"
 #include "complexbuffer.h"
 #include "signal/buffersource.h"
+#include "signal/cancellationtoken.h"
 #include "cpumemorystorage.h"
 #include "exceptionassert.h"
 
@@ -297,7 +298,79 @@ Tfr::pChunk Stft::
     else
         chunk = ComputeChunk(windowedInput);
 
+    return finishChunk(chunk, b);
+}
+
+
+std::vector<Tfr::pChunk> Stft::
+        transformBatch( const std::vector<Signal::pMonoBuffer>& B )
+{
+    // Only real transforms of buffers covering the same samples are batched
+    bool batch = !p.compute_redundant() && 1 < B.size();
+    for (const Signal::pMonoBuffer& b : B)
+        batch = batch && b->getInterval() == B[0]->getInterval();
+
+    if (!batch)
+        return Transform::transformBatch(B);
+
+    TIME_STFT TaskTimer ti("Stft::transformBatch, p.chunk_size() = %d, %u x %s",
+                           p.chunk_size(), (unsigned)B.size(), B[0]->getInterval().toString().c_str());
+
+    std::vector<DataStorage<float>::ptr> windowedInput(B.size());
+    for (size_t i=0; i<B.size(); i++)
+    {
+        Signal::CancellationToken::checkpoint ();
+        windowedInput[i] = applyWindow( B[i]->waveform_data() );
+        if (!windowedInput[i])
+        {
+            TaskInfo("stft: not enough data to transformBatch(b), p.chunk_size() = %d, b = %s",
+                                   p.chunk_size(), B[0]->getInterval().toString().c_str());
+            return std::vector<Tfr::pChunk>();
+        }
+    }
 
+    STFT_ASSERT( 0!=p.chunk_size() );
+
+    // Same layout as ComputeChunk but with the windows of all buffers after
+    // each other
+    int window_size = p.chunk_size();
+    int windows = windowedInput[0]->size().width / window_size;
+    int scales = window_size/2 + 1;
+    STFT_ASSERT (0!=windows); // not enough data
+
+    size_t W = windows*window_size;
+    size_t N = windows*scales;
+    DataStorage<float>::ptr input( new DataStorage<float>( W*B.size() ));
+    float* in = CpuMemoryStorage::WriteAll<1>( input ).ptr();
+    for (size_t i=0; i<B.size(); i++)
+    {
+        float* w = CpuMemoryStorage::ReadOnly<1>( windowedInput[i] ).ptr();
+        std::copy(w, w + W, in + i*W);
+    }
+
+    Tfr::ChunkData::ptr output( new Tfr::ChunkData( N*B.size() ));
+    Signal::CancellationToken::checkpoint ();
+    fft->compute( input, output, DataStorageSize(window_size, windows*B.size()) );
+
+    TIME_STFT ComputationSynchronize();
+
+    Tfr::ChunkElement* out = CpuMemoryStorage::ReadOnly<1>( output ).ptr();
+    std::vector<Tfr::pChunk> chunks;
+    for (size_t i=0; i<B.size(); i++)
+    {
+        Tfr::pChunk chunk( new Tfr::StftChunk(p.chunk_size(), p.windowType(), p.increment(), false) );
+        chunk->transform_data.reset( new Tfr::ChunkData( N ));
+        std::copy(out + i*N, out + (i+1)*N, CpuMemoryStorage::WriteAll<1>( chunk->transform_data ).ptr());
+        chunks.push_back (finishChunk(chunk, B[i]));
+    }
+
+    return chunks;
+}
+
+
+Tfr::pChunk Stft::
+        finishChunk(Tfr::pChunk chunk, Signal::pMonoBuffer b)
+{
     if (1 != p.averaging())
     {
         unsigned width = chunk->nScales();
@@ -910,4 +983,85 @@ Signal::Interval StftChunk::
 }
 
 
+} // namespace Tfr
+
+#include "test/randombuffer.h"
+#include "trace_perf.h"
+
+namespace Tfr {
+
+void Stft::
+        test()
+{
+    // It should compute the short-time Fourier transform of a buffer and
+    // restore the buffer with the inverse.
+    {
+        StftDesc d;
+        d.set_exact_chunk_size (256);
+        d.setWindow (StftDesc::WindowType_Rectangular, 0);
+
+        Signal::Interval expected;
+        Signal::Interval r = d.requiredInterval (Signal::Interval(0,1000), &expected);
+        Signal::pMonoBuffer b = Test::RandomBuffer::randomBuffer (r, 1000, 1)->getChannel (0);
+
+        Stft t(d);
+        pChunk c = t(b);
+        EXCEPTION_ASSERT_EQUALS( c->nScales (), 129u );
+
+        Signal::pMonoBuffer b2 = t.inverse (c);
+        EXCEPTION_ASSERT_EQUALS( b2->getInterval (), expected );
+
+        float *p = b->waveform_data ()->getCpuMemory ();
+        float *p2 = b2->waveform_data ()->getCpuMemory ();
+        for (Signal::IntervalType i=expected.first; i<expected.last; i++)
+            EXCEPTION_ASSERT_LESS( std::fabs(p[i - r.first] - p2[i - expected.first]), 1e-4f );
+    }
+
+    // It should transform a few seconds of audio in a few milliseconds.
+    {
+        StftDesc d;
+        d.set_exact_chunk_size (2048);
+        d.setWindow (StftDesc::WindowType_Hann, 0.5);
+        d.enable_inverse (false);
+
+        Signal::pMonoBuffer b = Test::RandomBuffer::randomBuffer (Signal::Interval(0, 1<<18), 44100, 1)->getChannel (0);
+        Stft t(d);
+        t(b); // init
+
+        TRACE_PERF("Stft should transform 262144 samples with 2048 sample windows and 50% overlap");
+        pChunk c = t(b);
+        EXCEPTION_ASSERT_EQUALS( c->nScales (), 1025u );
+    }
+
+    // It should transform several buffers in one batch with the same result
+    // as transforming them one by one.
+    {
+        StftDesc d;
+        d.set_exact_chunk_size (256);
+        d.setWindow (StftDesc::WindowType_Hann, 0.5);
+
+        Signal::pBuffer b = Test::RandomBuffer::randomBuffer (Signal::Interval(0, 4000), 1000, 3);
+        std::vector<Signal::pMonoBuffer> B;
+        for (int c=0; c<3; c++)
+            B.push_back (b->getChannel (c));
+
+        Stft t(d);
+        std::vector<pChunk> chunks = t.transformBatch (B);
+        EXCEPTION_ASSERT_EQUALS( chunks.size (), 3u );
+
+        for (int c=0; c<3; c++)
+        {
+            pChunk c1 = t(B[c]);
+            pChunk& c2 = chunks[c];
+            EXCEPTION_ASSERT_EQUALS( c1->getInterval (), c2->getInterval () );
+            EXCEPTION_ASSERT_EQUALS( c1->transform_data->numberOfElements (), c2->transform_data->numberOfElements () );
+
+            ChunkElement* p1 = c1->transform_data->getCpuMemory ();
+            ChunkElement* p2 = c2->transform_data->getCpuMemory ();
+            for (size_t i=0; i<c1->transform_data->numberOfElements (); i++)
+                EXCEPTION_ASSERT_EQUALS( p1[i], p2[i] );
+        }
+    }
+}
+
 } // namespace Tfr
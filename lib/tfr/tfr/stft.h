@@ -80,6 +80,11 @@ public:
       The contents of the input Signal::pBuffer is converted to complex values.
       */
     virtual pChunk operator()( Signal::pMonoBuffer );
+    /**
+      Buffers with the same interval are windowed into one buffer and
+      transformed with a single call to the fft implementation.
+      */
+    virtual std::vector<pChunk> transformBatch( const std::vector<Signal::pMonoBuffer>& );
     /// Stft::inverse does normalize the result (to the contrary of Fft::inverse)
     virtual Signal::pMonoBuffer inverse( pChunk );
 
@@ -95,6 +100,12 @@ private:
 
     Tfr::pChunk ComputeChunk(DataStorage<float>::ptr inputbuffer);
 
+    /**
+      Applies averaging and sets the sample rates and valid samples of a
+      chunk computed from 'b'.
+      */
+    Tfr::pChunk finishChunk(Tfr::pChunk chunk, Signal::pMonoBuffer b);
+
     /**
       @see compute_redundant()
       */
@@ -113,6 +124,9 @@ private:
     DataStorage<float>::ptr applyWindow( DataStorage<float>::ptr in );
     template<typename T>
     typename DataStorage<T>::ptr reduceWindow( boost::shared_ptr<DataStorage<T> > windowedSignal, const StftChunk* c );
+
+public:
+    static void test();
 };
 
 class StftChunk: public Chunk
@@ -160,6 +160,24 @@ Signal::Interval StftDesc::
 }
 
 
+void StftDesc::
+        affectedFrequencies( float& f1, float& f2 ) const
+{
+    // The sidelobes of a rectangular window leak into every bin
+    if (WindowType_Rectangular == _window_type)
+      {
+        TransformDesc::affectedFrequencies (f1, f2);
+        return;
+      }
+
+    // The main lobe of the other windows is at most 5 bins wide on each
+    // side (flat top), the sidelobes are negligible
+    float bins = 5.f/chunk_size ();
+    f1 -= bins;
+    f2 += bins;
+}
+
+
 unsigned oksz(unsigned x)
 {
     if (0 == x)
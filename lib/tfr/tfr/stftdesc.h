@@ -48,6 +48,7 @@ public:
     unsigned prev_good_size( unsigned current_valid_samples_per_chunk, float sample_rate ) const;
     Signal::Interval requiredInterval( const Signal::Interval& I, Signal::Interval* expectedOutput ) const;
     Signal::Interval affectedInterval( const Signal::Interval& I ) const;
+    void affectedFrequencies( float& f1, float& f2 ) const;
     std::string toString() const;
     bool operator==(const TransformDesc& b) const;
 
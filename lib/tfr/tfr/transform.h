@@ -3,10 +3,14 @@
 
 #include "freqaxis.h"
 #include "signal/intervals.h"
+#include "signal/region.h"
+#include "signal/cancellationtoken.h"
 #include "shared_state.h"
 
 #include <boost/shared_ptr.hpp>
 
+#include <vector>
+
 namespace Signal
 {
     class MonoBuffer;
@@ -67,6 +71,29 @@ public:
     virtual pChunk operator()( Signal::pMonoBuffer b ) = 0;
 
 
+    /**
+      Transforms several buffers at once, typically all channels of a
+      Signal::Buffer that are handled by the same thread. Returns one chunk
+      per buffer, or an empty vector if any of them couldn't be transformed.
+
+      A transform may override this to batch buffers of the same size into
+      fewer and larger computations. Stops between buffers if the current
+      Signal::CancellationToken is cancelled.
+      */
+    virtual std::vector<pChunk> transformBatch( const std::vector<Signal::pMonoBuffer>& b )
+    {
+        std::vector<pChunk> chunks;
+        for (const Signal::pMonoBuffer& m : b)
+        {
+            Signal::CancellationToken::checkpoint ();
+            chunks.push_back ((*this)( m ));
+            if (!chunks.back ())
+                return std::vector<pChunk>();
+        }
+        return chunks;
+    }
+
+
     /**
       Well, transform a chunk back into a buffer.
       */
@@ -172,6 +199,18 @@ public:
     virtual Signal::Interval affectedInterval( const Signal::Interval& I ) const = 0;
 
 
+    /**
+     * @brief affectedFrequencies should widen the band [f1, f2] to the
+     * frequencies of a chunk that change if the signal changes within
+     * [f1, f2]. The same widening applies to the signal returned by the
+     * inverse if a chunk changes within [f1, f2]. Frequencies are normalized
+     * to the sample rate, see Signal::Region.
+     *
+     * The default is all frequencies.
+     */
+    virtual void affectedFrequencies( float& f1, float& f2 ) const { f1 = 0; f2 = Signal::Region::nyquist; }
+
+
     /**
       Returns a string representation of this transform. Mainly used for debugging.
       */
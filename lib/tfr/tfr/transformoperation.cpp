@@ -2,80 +2,220 @@
 
 #include "demangle.h"
 
+#include "signal/cancellationtoken.h"
+#include "signal/computingengine.h"
 #include "tfr/chunk.h"
 #include "tfr/chunkfilter.h"
+#include "tfr/chunksizetuner.h"
 #include "tfr/transform.h"
 
+#include "blocking_queue.h"
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <future>
+#include <thread>
+
 using namespace Signal;
 using namespace boost;
 
 
 namespace Tfr {
 
+typedef JustMisc::blocking_queue<std::packaged_task<void()>> ChannelQueue;
+
+/**
+ * @brief channelPool runs channels for all TransformOperationOperations on
+ * one thread per core, shared by the process, instead of starting threads
+ * for each buffer. It is never destroyed so that its threads can't go away
+ * while a worker is waiting for them.
+ */
+static ChannelQueue& channelPool()
+{
+    static ChannelQueue* queue = []()
+    {
+        ChannelQueue* q = new ChannelQueue;
+        int N = std::max(1u, std::thread::hardware_concurrency ());
+        for (int i=0; i<N; i++)
+            std::thread([q]() { while (true) q->pop ()(); }).detach ();
+        return q;
+    }();
+
+    return *queue;
+}
+
+
 class TransformOperationOperation: public Operation
 {
 public:
-    TransformOperationOperation(pTransform t, pChunkFilter chunk_filter, bool no_inverse_tag);
+    /**
+     * transforms and chunk_filters has one instance per thread that may be
+     * used to process channels. chunk_filters[t] holds the filters that are
+     * applied in sequence to each chunk, more than one if the operation has
+     * been fused.
+     *
+     * The first instance is given. Instances for up to 'max_threads' threads
+     * are created with 'create_transform' and 'create_filters' when a buffer
+     * has enough channels for them. 'create_filters' returns an empty vector
+     * if the filters can't be created.
+     */
+    TransformOperationOperation(pTransform transform, std::vector<pChunkFilter> chunk_filters, bool no_inverse_tag,
+                                int max_threads,
+                                std::function<pTransform()> create_transform,
+                                std::function<std::vector<pChunkFilter>()> create_filters,
+                                std::function<void(float)> seen_sample_rate);
 
     // Operation
     pBuffer process(pBuffer b);
 
 private:
-    pTransform transform_;
-    pChunkFilter chunk_filter_;
+    std::vector<pTransform> transforms_;
+    std::vector<std::vector<pChunkFilter>> chunk_filters_;
     bool no_inverse_tag_;
+    int max_threads_;
+    std::function<pTransform()> create_transform_;
+    std::function<std::vector<pChunkFilter>()> create_filters_;
+    std::function<void(float)> seen_sample_rate_;
 };
 
 
 TransformOperationOperation::
-        TransformOperationOperation(Tfr::pTransform transform, pChunkFilter chunk_filter, bool no_inverse_tag)
+        TransformOperationOperation(pTransform transform, std::vector<pChunkFilter> chunk_filters, bool no_inverse_tag,
+                                    int max_threads,
+                                    std::function<pTransform()> create_transform,
+                                    std::function<std::vector<pChunkFilter>()> create_filters,
+                                    std::function<void(float)> seen_sample_rate)
     :
-      transform_(transform),
-      chunk_filter_(chunk_filter),
-      no_inverse_tag_(no_inverse_tag)
+      transforms_(1, transform),
+      chunk_filters_(1, chunk_filters),
+      no_inverse_tag_(no_inverse_tag),
+      max_threads_(max_threads),
+      create_transform_(create_transform),
+      create_filters_(create_filters),
+      seen_sample_rate_(seen_sample_rate)
 {
+    EXCEPTION_ASSERT_LESS(0u, chunk_filters_[0].size ());
 }
 
 
 Signal::pBuffer TransformOperationOperation::
         process(Signal::pBuffer b)
 {
-    chunk_filter_->set_number_of_channels(b->number_of_channels ());
+    const int C = b->number_of_channels ();
 
-    pBuffer r;
-    for (int c=0; c<b->number_of_channels (); ++c)
+    seen_sample_rate_ (b->sample_rate ());
+
+    while ((int)chunk_filters_.size () < std::min(C, max_threads_))
       {
-        ChunkAndInverse ci;
-        ci.channel = c;
-        ci.t = transform_;
-        ci.input = b->getChannel (c);
-        ci.chunk = (*ci.t)( ci.input );
-        if (!ci.chunk)
-            return pBuffer();
-
-        (*chunk_filter_)( ci );
-        if (ci.abort)
-            return pBuffer();
+        std::vector<pChunkFilter> F = create_filters_ ();
+        if (F.empty ())
+            break;
 
-        if (!no_inverse_tag_)
+        chunk_filters_.push_back (F);
+        transforms_.push_back (create_transform_ ());
+      }
+
+    const int T = std::max(1, std::min<int>(C, chunk_filters_.size ()));
+
+    for (const std::vector<pChunkFilter>& F : chunk_filters_)
+        for (const pChunkFilter& f : F)
+            f->set_number_of_channels(C);
+
+    // Thread t processes the consecutive channels [t*C/T, (t+1)*C/T) so that
+    // they can be transformed in one batch.
+    std::vector<ChunkAndInverse> ci(C);
+    std::vector<std::exception_ptr> errors(T);
+    std::atomic<bool> aborted {false};
+    CancellationToken* token = CancellationToken::current ();
+    auto worker = [&](int t)
+    {
+        CancellationToken::Scope scope(token);
+
+        try
           {
-            if (!ci.inverse)
-                ci.inverse = ci.t->inverse (ci.chunk);
+            int first = t*C/T, last = (t+1)*C/T;
+            std::vector<pMonoBuffer> inputs;
+            for (int c=first; c<last; ++c)
+                inputs.push_back (b->getChannel (c));
+
+            std::vector<pChunk> chunks = transforms_[t]->transformBatch (inputs);
+            if (chunks.size () != inputs.size ())
+              {
+                aborted = true;
+                return;
+              }
+
+            for (int c=first; c<last && !aborted; ++c)
+              {
+                CancellationToken::checkpoint ();
+
+                ChunkAndInverse& x = ci[c];
+                x.channel = c;
+                x.t = transforms_[t];
+                x.input = inputs[c - first];
+                x.chunk = chunks[c - first];
+
+                for (const pChunkFilter& f : chunk_filters_[t])
+                  {
+                    (*f)( x );
+                    if (x.abort)
+                      {
+                        aborted = true;
+                        return;
+                      }
+                  }
+
+                if (!no_inverse_tag_ && !x.inverse)
+                    x.inverse = x.t->inverse (x.chunk);
+              }
+          }
+        catch (...)
+          {
+            errors[t] = std::current_exception ();
+            aborted = true;
+          }
+    };
+
+    std::vector<std::future<void>> done;
+    for (int t=1; t<T; ++t)
+      {
+        std::packaged_task<void()> task([&worker, t]() { worker (t); });
+        done.push_back (task.get_future ());
+        channelPool ().push (std::move(task));
+      }
 
+    worker (0);
+
+    // worker doesn't throw, errors are rethrown below
+    for (std::future<void>& f : done)
+        f.wait ();
+
+    for (const std::exception_ptr& e : errors)
+        if (e)
+            std::rethrow_exception (e);
+
+    if (aborted)
+        return pBuffer();
+
+    pBuffer r;
+    for (int c=0; c<C; ++c)
+      {
+        if (!no_inverse_tag_)
+          {
             if (!r)
-                r.reset ( new Signal::Buffer(ci.inverse->getInterval (), ci.inverse->sample_rate (), b->number_of_channels ()));
+                r.reset ( new Signal::Buffer(ci[c].inverse->getInterval (), ci[c].inverse->sample_rate (), C));
 
-            *r->getChannel (c) |= *ci.inverse;
+            *r->getChannel (c) |= *ci[c].inverse;
           }
         else
           {
             // If chunk_filter_ has the NoInverseTag it shouldn't compute the inverse
-            EXCEPTION_ASSERTX( !ci.inverse, vartype(*chunk_filter_) );
+            EXCEPTION_ASSERTX( !ci[c].inverse, vartype(*chunk_filters_[0].back ()) );
 
             if (!r)
-                r.reset ( new Signal::Buffer(ci.chunk->getCoveredInterval (), b->sample_rate (), b->number_of_channels ()));
+                r.reset ( new Signal::Buffer(ci[c].chunk->getCoveredInterval (), b->sample_rate (), C));
           }
-
       }
 
     return r;
@@ -86,7 +226,9 @@ TransformOperationDesc::
         TransformOperationDesc(ChunkFilterDesc::ptr f)
     :
       chunk_filter_(f),
-      transformDesc_(f.read ()->transformDesc()->copy())
+      transformDesc_(f.read ()->transformDesc()->copy()),
+      channel_threads_(std::max(1u, std::thread::hardware_concurrency ())),
+      sample_rate_(new std::atomic<float>(0))
 {
 }
 
@@ -95,33 +237,94 @@ OperationDesc::ptr TransformOperationDesc::
         copy() const
 {
     //ChunkFilterDesc::Ptr chunk_filter = chunk_filter_.read ()->copy();
-    return OperationDesc::ptr (new TransformOperationDesc (chunk_filter_));
+    TransformOperationDesc* d = new TransformOperationDesc (chunk_filter_);
+    d->fused_ = fused_;
+    d->channel_threads_ = channel_threads_;
+    *d->sample_rate_ = sample_rate_->load ();
+    return OperationDesc::ptr (d);
 }
 
 
 Signal::Operation::ptr TransformOperationDesc::
         createOperation(Signal::ComputingEngine*engine) const
 {
-    Tfr::pTransform t = transformDesc_->createTransform ();
-    pChunkFilter f;
+    // Only fan out channels over threads on the cpu
+    bool parallel = !engine || dynamic_cast<Signal::ComputingCpu*>(engine);
+
+    std::vector<std::vector<pChunkFilter>> f(1);
+    for (const ChunkFilterDesc::ptr& d : fused_)
+      {
+        f[0].push_back (d.read ()->createChunkFilter (engine));
+        if (!f[0].back ())
+            return Signal::Operation::ptr();
+      }
+
     {
         auto c = chunk_filter_.write ();
         c->transformDesc (transformDesc_);
-        f = c->createChunkFilter (engine);
+        f[0].push_back (c->createChunkFilter (engine));
+
+        if (!f[0].back ())
+            return Signal::Operation::ptr();
     }
-    bool no_inverse_tag = 0!=dynamic_cast<ChunkFilter::NoInverseTag*>(f.get ());
 
-    if (!f)
-        return Signal::Operation::ptr();
+    for (const pChunkFilter& x : f[0])
+        parallel = parallel && dynamic_cast<ChunkFilter::ParallelChannelsTag*>(x.get ());
+
+    // More instances are only created if a buffer has more than one channel
+    std::vector<ChunkFilterDesc::ptr> fused = fused_;
+    ChunkFilterDesc::ptr chunk_filter = chunk_filter_;
+    auto create_filters = [fused, chunk_filter, engine]()
+    {
+        std::vector<pChunkFilter> F;
+        for (const ChunkFilterDesc::ptr& d : fused)
+            F.push_back (d.read ()->createChunkFilter (engine));
+        F.push_back (chunk_filter.read ()->createChunkFilter (engine));
+
+        for (const pChunkFilter& x : F)
+            if (!x)
+                return std::vector<pChunkFilter>();
+        return F;
+    };
+
+    boost::shared_ptr<TransformDesc> transform_desc = transformDesc_;
+    auto create_transform = [transform_desc]() { return transform_desc->createTransform (); };
+
+    // Measure the best chunk size for the buffers that are processed without
+    // blocking this worker, see requiredInterval
+    std::shared_ptr<std::atomic<float>> sample_rate = sample_rate_;
+    auto seen_sample_rate = [transform_desc, sample_rate](float fs)
+    {
+        if (*sample_rate != fs)
+            *sample_rate = fs;
+
+        if (ChunkSizeTuner::ptr tuner = ChunkSizeTuner::global ())
+            tuner->request (*transform_desc, fs);
+    };
 
-    return Signal::Operation::ptr (new TransformOperationOperation( t, f, no_inverse_tag ));
+    bool no_inverse_tag = 0!=dynamic_cast<ChunkFilter::NoInverseTag*>(f[0].back ().get ());
+
+    return Signal::Operation::ptr (new TransformOperationOperation(
+            create_transform (), f[0], no_inverse_tag,
+            parallel ? channel_threads_ : 1,
+            create_transform, create_filters, seen_sample_rate ));
 }
 
 
 Signal::Interval TransformOperationDesc::
         requiredInterval(const Signal::Interval& I, Signal::Interval* expectedOutput) const
 {
-    Signal::Interval J = transformDesc_->requiredInterval (I, expectedOutput);
+    Signal::Interval K = I;
+    float fs = *sample_rate_;
+    ChunkSizeTuner::ptr tuner = ChunkSizeTuner::global ();
+    if (tuner && 0 < fs)
+      {
+        unsigned L = tuner->size (*transformDesc_, fs);
+        if (0 < L && L < K.count ())
+            K.last = K.first + L;
+      }
+
+    Signal::Interval J = transformDesc_->requiredInterval (K, expectedOutput);
 //    TaskInfo ti(boost::format("In %s") % this->toString ().toStdString ());
 //    TaskInfo(boost::format("requiredInterval (%s, %s) -> %s") % I % (expectedOutput?*expectedOutput:Signal::Interval()) % J);
     return J;
@@ -135,6 +338,46 @@ Signal::Interval TransformOperationDesc::
 }
 
 
+Signal::Region TransformOperationDesc::
+        affectedRegion(const Signal::Region& R) const
+{
+    Signal::Region A = Signal::OperationDesc::affectedRegion (R);
+
+    // The frequencies of the chunk that change
+    float f1 = R.f1 (), f2 = R.f2 ();
+    transformDesc_->affectedFrequencies (f1, f2);
+    Signal::Region C(A.samples (), f1, f2);
+
+    for (const ChunkFilterDesc::ptr& d : fused_)
+        C = d.read ()->affectedRegion (C);
+    C = chunk_filter_.read ()->affectedRegion (C);
+
+    // and the frequencies of the inverse
+    f1 = C.f1 ();
+    f2 = C.f2 ();
+    transformDesc_->affectedFrequencies (f1, f2);
+    return Signal::Region(A.samples (), f1, f2);
+}
+
+
+void TransformOperationDesc::
+        deprecatedInput(const Signal::Region& R) const
+{
+    // The region of the chunks, as in affectedRegion
+    float f1 = R.f1 (), f2 = R.f2 ();
+    transformDesc_->affectedFrequencies (f1, f2);
+    Signal::Region C(Signal::OperationDesc::affectedRegion (R).samples (), f1, f2);
+
+    for (const ChunkFilterDesc::ptr& d : fused_)
+      {
+        auto r = d.read ();
+        r->deprecatedInput (C);
+        C = r->affectedRegion (C);
+      }
+    chunk_filter_.read ()->deprecatedInput (C);
+}
+
+
 TransformOperationDesc::Extent TransformOperationDesc::
         extent() const
 {
@@ -145,7 +388,39 @@ TransformOperationDesc::Extent TransformOperationDesc::
 QString TransformOperationDesc::
         toString() const
 {
-    return chunk_filter_.read ()->toString();
+    QString s;
+    for (const ChunkFilterDesc::ptr& d : fused_)
+        s += d.read ()->toString() + ", ";
+    return s + chunk_filter_.read ()->toString();
+}
+
+
+Signal::OperationDesc::ptr TransformOperationDesc::
+        fuse(const Signal::OperationDesc& previous) const
+{
+    const TransformOperationDesc* p = dynamic_cast<const TransformOperationDesc*>(&previous);
+    if (!p || *p->transformDesc_ != *transformDesc_)
+        return Signal::OperationDesc::ptr();
+
+    std::vector<ChunkFilterDesc::ptr> fused = p->fused_;
+    fused.push_back (p->chunk_filter_);
+
+    // Filters that don't leave the chunk to be inverted must come last
+    for (const ChunkFilterDesc::ptr& d : fused)
+      {
+        pChunkFilter f = d.read ()->createChunkFilter ();
+        if (!f || dynamic_cast<ChunkFilter::NoInverseTag*>(f.get ())
+               || dynamic_cast<ChunkFilter::OwnInverseTag*>(f.get ()))
+            return Signal::OperationDesc::ptr();
+      }
+
+    fused.insert (fused.end (), fused_.begin (), fused_.end ());
+
+    TransformOperationDesc* d = new TransformOperationDesc (chunk_filter_);
+    d->fused_ = fused;
+    d->channel_threads_ = channel_threads_;
+    *d->sample_rate_ = sample_rate_->load ();
+    return Signal::OperationDesc::ptr (d);
 }
 
 
@@ -191,10 +466,42 @@ shared_state<ChunkFilterDesc>::write_ptr TransformOperationDesc::
     return chunk_filter_.write ();
 }
 
+
+int TransformOperationDesc::
+        channel_threads() const
+{
+    return channel_threads_;
+}
+
+
+void TransformOperationDesc::
+        channel_threads(int v)
+{
+    EXCEPTION_ASSERT_LESS(0, v);
+    channel_threads_ = v;
+}
+
 } // namespace Tfr
 
+#include "cwt.h"
 #include "dummytransform.h"
+#include "signal/buffersource.h"
+#include "signal/decimate.h"
+#include "signal/numatopology.h"
+#include "signal/processing/chain.h"
+#include "signal/processing/workers.h"
+#include "stft.h"
+#include "test/operationmockups.h"
 #include "test/randombuffer.h"
+#include "tasktimer.h"
+#include "timer.h"
+#include "trace_perf.h"
+
+#include <boost/format.hpp>
+
+#include <cmath>
+#include <mutex>
+#include <set>
 
 namespace Tfr {
 
@@ -226,6 +533,152 @@ private:
     int* i;
 };
 
+class LocalChunkFilterDesc: public ChunkFilterDesc
+{
+public:
+    ChunkFilter::ptr createChunkFilter(Signal::ComputingEngine*) const {
+        return ChunkFilter::ptr();
+    }
+
+    Signal::Region affectedRegion(const Signal::Region& R) const {
+        return R;
+    }
+};
+
+class OrderChunkFilter: public ChunkFilter
+{
+public:
+    OrderChunkFilter(std::vector<int>* order, int id):order(order),id(id) {}
+
+    void operator()( ChunkAndInverse& ) {
+        order->push_back (id);
+    }
+
+private:
+    std::vector<int>* order;
+    int id;
+};
+
+class OrderChunkFilterDesc: public ChunkFilterDesc
+{
+public:
+    OrderChunkFilterDesc(std::vector<int>* order, int id):order(order),id(id) {}
+
+    ChunkFilter::ptr createChunkFilter(Signal::ComputingEngine*) const {
+        return ChunkFilter::ptr(new OrderChunkFilter(order, id));
+    }
+
+private:
+    std::vector<int>* order;
+    int id;
+};
+
+class ParallelChunkFilter: public ChunkFilter, public ChunkFilter::NoInverseTag, public ChunkFilter::ParallelChannelsTag
+{
+public:
+    ParallelChunkFilter(std::vector<int>* channels, std::set<std::thread::id>* threads, std::mutex* m)
+        : channels(channels), threads(threads), m(m) {}
+
+    void operator()( ChunkAndInverse& c ) {
+        std::lock_guard<std::mutex> l(*m);
+        (*channels)[c.channel]++;
+        threads->insert (std::this_thread::get_id ());
+    }
+
+private:
+    std::vector<int>* channels;
+    std::set<std::thread::id>* threads;
+    std::mutex* m;
+};
+
+class ParallelChunkFilterDesc: public ChunkFilterDesc
+{
+public:
+    ParallelChunkFilterDesc(std::vector<int>* channels=0, std::set<std::thread::id>* threads=0)
+        : channels(channels), threads(threads) {}
+
+    ChunkFilter::ptr createChunkFilter(Signal::ComputingEngine*) const {
+        created++;
+        if (!channels)
+            return ChunkFilter::ptr(new PassThroughChunkFilter);
+        return ChunkFilter::ptr(new ParallelChunkFilter(channels, threads, &m));
+    }
+
+private:
+    class PassThroughChunkFilter: public ChunkFilter, public ChunkFilter::ParallelChannelsTag
+    {
+    public:
+        void operator()( ChunkAndInverse& ) {}
+    };
+
+    std::vector<int>* channels;
+    std::set<std::thread::id>* threads;
+    mutable std::mutex m;
+
+public:
+    mutable std::atomic<int> created {0};
+};
+
+/**
+ * @brief transformAll transforms all of 'signal', optionally after
+ * decimating it.
+ * @return the number of transformed samples.
+ */
+static Signal::IntervalType transformAll(const TransformOperationDesc& tod, Signal::pBuffer signal, int decimation)
+{
+    Signal::DecimateDesc decimate(decimation);
+    Signal::BufferSource source(signal);
+    Signal::Operation::ptr t = tod.createOperation (0);
+    Signal::Operation::ptr d = decimate.createOperation (0);
+
+    Signal::Interval I = signal->getInterval ();
+    I = Signal::Interval(I.first >> decimation, I.last >> decimation);
+
+    Signal::IntervalType transformed = 0;
+    for (Signal::IntervalType x = I.first; x < I.last;)
+      {
+        Signal::Interval expected;
+        Signal::Interval J = tod.requiredInterval (Signal::Interval(x, I.last), &expected);
+        Signal::pBuffer b = source.readFixedLength (decimate.requiredInterval (J, 0));
+        b = t->process (d->process (b));
+        transformed += b->number_of_samples ();
+        x = expected.last;
+      }
+
+    return transformed;
+}
+
+
+/**
+ * @brief cwtChainPass computes the Cwt of all of 'signal' with the workers
+ * of a default chain, placed on the nodes of 'placement' if given.
+ * @return the elapsed time.
+ */
+static double cwtChainPass(Signal::pBuffer signal, const Signal::NumaTopology* placement)
+{
+    using namespace Signal::Processing;
+
+    Chain::ptr chain = Chain::createDefaultChain (placement);
+
+    Cwt* cwt = new Cwt;
+    cwt->set_wanted_min_hz (200, signal->sample_rate ());
+    ChunkFilterDesc::ptr cfd(new ParallelChunkFilterDesc);
+    cfd.write ()->transformDesc(pTransformDesc(cwt));
+
+    TargetMarker::ptr target = chain->addTarget (Signal::OperationDesc::ptr(new TransformOperationDesc(cfd)));
+    chain->addOperationAt (Signal::OperationDesc::ptr(new Signal::BufferSource(signal)), target);
+
+    Timer t;
+    target->target_needs ()->updateNeeds (signal->getInterval ());
+    EXCEPTION_ASSERT(target->target_needs ()->sleep (-1));
+    double T = t.elapsed ();
+
+    chain->workers ()->rethrow_any_worker_exception ();
+    chain->close ();
+    return T;
+}
+
+
 void TransformOperationDesc::
         test()
 {
@@ -249,6 +702,290 @@ void TransformOperationDesc::
         Signal::pBuffer b = o->process (Test::RandomBuffer::smallBuffer ());
         EXCEPTION_ASSERT_EQUALS(i, (int)b->number_of_channels ());
     }
+
+    // It should process the channels of a buffer concurrently if the
+    // ChunkFilter has the ParallelChannelsTag.
+    {
+        std::vector<int> channels(8);
+        std::set<std::thread::id> threads;
+        ChunkFilterDesc::ptr cfd(new ParallelChunkFilterDesc(&channels, &threads));
+        cfd.write ()->transformDesc(pTransformDesc(new Tfr::DummyTransformDesc));
+        TransformOperationDesc tod(cfd);
+        tod.channel_threads (4);
+
+        Signal::pBuffer b = Test::RandomBuffer::randomBuffer (Signal::Interval(0,100), 1, 8);
+        Signal::pBuffer r = tod.createOperation (0)->process (b);
+        EXCEPTION_ASSERT_EQUALS(r->number_of_channels (), 8);
+        // The shared threads may pick up more than one part each
+        EXCEPTION_ASSERT_LESS(1u, threads.size ());
+        EXCEPTION_ASSERT_LESS_OR_EQUAL(threads.size (), 4u);
+        for (int c : channels)
+            EXCEPTION_ASSERT_EQUALS(c, 1);
+    }
+
+    // It should only instantiate filters for as many threads as a buffer has
+    // channels.
+    {
+        std::vector<int> channels(8);
+        std::set<std::thread::id> threads;
+        ChunkFilterDesc::ptr cfd(new ParallelChunkFilterDesc(&channels, &threads));
+        cfd.write ()->transformDesc(pTransformDesc(new Tfr::DummyTransformDesc));
+        TransformOperationDesc tod(cfd);
+        tod.channel_threads (4);
+        auto created = [&cfd]() { return dynamic_cast<ParallelChunkFilterDesc*>(cfd.raw ())->created.load (); };
+
+        Signal::Operation::ptr o = tod.createOperation (0);
+        EXCEPTION_ASSERT_EQUALS(created (), 1);
+
+        o->process (Test::RandomBuffer::randomBuffer (Signal::Interval(0,100), 1, 1));
+        EXCEPTION_ASSERT_EQUALS(created (), 1);
+        EXCEPTION_ASSERT_EQUALS(threads.size (), 1u);
+
+        o->process (Test::RandomBuffer::randomBuffer (Signal::Interval(0,100), 1, 2));
+        EXCEPTION_ASSERT_EQUALS(created (), 2);
+
+        o->process (Test::RandomBuffer::randomBuffer (Signal::Interval(0,100), 1, 8));
+        EXCEPTION_ASSERT_EQUALS(created (), 4);
+    }
+
+    // It should scale with the number of channels.
+    {
+        StftDesc* d = new StftDesc;
+        d->set_exact_chunk_size (1024);
+        d->setWindow (StftDesc::WindowType_Hann, 0.5);
+
+        ChunkFilterDesc::ptr cfd(new ParallelChunkFilterDesc);
+        cfd.write ()->transformDesc(pTransformDesc(d));
+        TransformOperationDesc tod(cfd);
+
+        Signal::Interval expected;
+        Signal::Interval I = tod.requiredInterval (Signal::Interval(0, 1<<16), &expected);
+
+        for (int C : {1, 4, 16, 64})
+        {
+            Signal::pBuffer b = Test::RandomBuffer::randomBuffer (I, 44100, C);
+
+            tod.channel_threads (1);
+            Signal::Operation::ptr serial = tod.createOperation (0);
+            tod.channel_threads (std::max(1u, std::thread::hardware_concurrency ()));
+            Signal::Operation::ptr parallel = tod.createOperation (0);
+            parallel->process (b); // init
+
+            Signal::pBuffer r1, r2;
+            {
+                TRACE_PERF((boost::format("TransformOperationDesc should process %d channels serially") % C).str ());
+                r1 = serial->process (b);
+            }
+            {
+                TRACE_PERF((boost::format("TransformOperationDesc should process %d channels in parallel") % C).str ());
+                r2 = parallel->process (b);
+            }
+
+            EXCEPTION_ASSERT_EQUALS(r1->number_of_channels (), C);
+            EXCEPTION_ASSERT(*r1 == *r2);
+        }
+    }
+
+    // It should fuse operations with equal transforms into one operation that
+    // applies all chunk filters to the same chunk.
+    {
+        std::vector<int> order;
+        pTransformDesc td(new Tfr::DummyTransformDesc);
+        auto create = [&](int id) {
+            ChunkFilterDesc::ptr cfd(new OrderChunkFilterDesc(&order, id));
+            cfd.write ()->transformDesc(td);
+            return Signal::OperationDesc::ptr(new TransformOperationDesc(cfd));
+        };
+
+        Signal::OperationDesc::ptr a = create(1), b = create(2), c = create(3);
+        Signal::OperationDesc::ptr ab = b.read ()->fuse (*a.read ());
+        EXCEPTION_ASSERT(ab);
+        Signal::OperationDesc::ptr abc = c.read ()->fuse (*ab.read ());
+        EXCEPTION_ASSERT(abc);
+        Test::TransparentOperationDesc transparent;
+        EXCEPTION_ASSERT(!a.read ()->fuse (transparent));
+
+        Signal::pBuffer buffer = Test::RandomBuffer::smallBuffer ();
+        Signal::pBuffer r = abc.read ()->createOperation (0)->process (buffer);
+        EXCEPTION_ASSERT_EQUALS(r->getInterval (), buffer->getInterval ());
+
+        std::vector<int> expected {1, 2, 3, 1, 2, 3};
+        EXCEPTION_ASSERT(order == expected);
+
+        // It should not fuse different transforms
+        StftDesc* stft = new StftDesc;
+        ChunkFilterDesc::ptr cfd(new OrderChunkFilterDesc(&order, 4));
+        cfd.write ()->transformDesc(pTransformDesc(stft));
+        TransformOperationDesc d(cfd);
+        EXCEPTION_ASSERT(!d.fuse (*a.read ()));
+
+        // It should not apply any filters after a filter that doesn't invert
+        // its chunk
+        int i = 0;
+        ChunkFilterDesc::ptr noinverse(new DummyChunkFilterDesc(&i));
+        noinverse.write ()->transformDesc(td);
+        TransformOperationDesc e(noinverse);
+        EXCEPTION_ASSERT(!a.read ()->fuse (e));
+        EXCEPTION_ASSERT(e.fuse (*a.read ()));
+    }
+
+    // It should follow a change within a frequency band through the
+    // transform, the filters and the inverse.
+    {
+        Cwt* cwt = new Cwt;
+        pTransformDesc td(cwt);
+        ChunkFilterDesc::ptr local(new LocalChunkFilterDesc);
+        local.write ()->transformDesc(td);
+        TransformOperationDesc tod(local);
+
+        Signal::Region R(Signal::Interval(1000,2000), 0.1, 0.11);
+        Signal::Region A = tod.affectedRegion (R);
+        EXCEPTION_ASSERT_EQUALS(A.samples (), Signal::Intervals(tod.affectedInterval (Signal::Interval(1000,2000))));
+        EXCEPTION_ASSERT(!A.allFrequencies ());
+
+        // Widened by the support of a wavelet in the transform and again in
+        // the inverse
+        float r = 1 + cwt->wavelet_scale_support ()/(2*M_PI*cwt->sigma ());
+        EXCEPTION_ASSERT_LESS(std::fabs(A.f1 () - R.f1 ()/r/r), 1e-5);
+        EXCEPTION_ASSERT_LESS(std::fabs(A.f2 () - R.f2 ()*r*r), 1e-5);
+
+        // Filters that aren't local in frequency may change all frequencies
+        int i = 0;
+        ChunkFilterDesc::ptr other(new DummyChunkFilterDesc(&i));
+        other.write ()->transformDesc(td);
+        EXCEPTION_ASSERT(TransformOperationDesc(other).affectedRegion (R).allFrequencies ());
+
+        // and so may transforms that aren't
+        ChunkFilterDesc::ptr dummy(new LocalChunkFilterDesc);
+        dummy.write ()->transformDesc(pTransformDesc(new DummyTransformDesc));
+        EXCEPTION_ASSERT(TransformOperationDesc(dummy).affectedRegion (R).allFrequencies ());
+    }
+
+    // It should compute a chain of filters faster when fused.
+    {
+        float fs = 44100;
+        Cwt* cwt = new Cwt;
+        cwt->set_wanted_min_hz (200, fs);
+        pTransformDesc td(cwt);
+
+        std::vector<Signal::OperationDesc::ptr> chain;
+        Signal::OperationDesc::ptr fused;
+        for (int i=0; i<5; i++)
+          {
+            ChunkFilterDesc::ptr cfd(new ParallelChunkFilterDesc);
+            cfd.write ()->transformDesc(td);
+            chain.push_back (Signal::OperationDesc::ptr(new TransformOperationDesc(cfd)));
+            fused = fused ? chain.back ().read ()->fuse (*fused.read ()) : chain.back ();
+            EXCEPTION_ASSERT(fused);
+          }
+
+        Signal::Interval I(0, 1<<14);
+        std::vector<Signal::Interval> required(chain.size ());
+        Signal::Interval J = I;
+        for (int i=chain.size ()-1; i>=0; i--)
+            J = required[i] = chain[i].read ()->requiredInterval (J, 0);
+
+        Signal::pBuffer b = Test::RandomBuffer::randomBuffer (required[0], fs, 1);
+        std::vector<Signal::Operation::ptr> ops;
+        for (Signal::OperationDesc::ptr& o : chain)
+            ops.push_back (o.read ()->createOperation (0));
+        Signal::Operation::ptr f = fused.read ()->createOperation (0);
+
+        Signal::Interval expected;
+        Signal::Interval K = fused.read ()->requiredInterval (I, &expected);
+        Signal::pBuffer bf = Test::RandomBuffer::randomBuffer (K, fs, 1);
+        f->process (bf); // init
+
+        Signal::pBuffer r1 = b, r2;
+        {
+            TRACE_PERF("TransformOperationDesc should compute a chain of 5 Cwt filters");
+            for (size_t i=0; i<ops.size (); i++)
+                r1 = ops[i]->process (Signal::BufferSource(r1).readFixedLength (required[i]));
+        }
+        {
+            TRACE_PERF("TransformOperationDesc should compute 5 fused Cwt filters");
+            r2 = f->process (bf);
+        }
+
+        EXCEPTION_ASSERT(r1->getInterval () & I);
+        EXCEPTION_ASSERT_EQUALS(r2->getInterval (), expected);
+    }
+
+    // It should compute an overview of a long signal faster from a decimated
+    // signal, see Signal::DecimateDesc and Heightmap::Update::UpdateProducer.
+    {
+        float fs = 44100;
+        StftDesc* d = new StftDesc;
+        d->set_exact_chunk_size (1024);
+        d->setWindow (StftDesc::WindowType_Hann, 0.75);
+
+        ChunkFilterDesc::ptr cfd(new ParallelChunkFilterDesc);
+        cfd.write ()->transformDesc(pTransformDesc(d));
+        TransformOperationDesc tod(cfd);
+
+        Signal::pBuffer signal = Test::RandomBuffer::randomBuffer (Signal::Interval(0, 1<<21), fs, 1);
+        const int levels = 4;
+
+        double full, overview;
+        Signal::IntervalType full_samples, overview_samples;
+        {
+            TRACE_PERF("TransformOperationDesc should transform 48 s of audio");
+            Timer t;
+            full_samples = transformAll (tod, signal, 0);
+            full = t.elapsed ();
+        }
+        {
+            TRACE_PERF("TransformOperationDesc should transform 48 s of audio decimated by 16");
+            Timer t;
+            overview_samples = transformAll (tod, signal, levels);
+            overview = t.elapsed ();
+        }
+
+        TaskInfo(boost::format("transformoperation: overview in %s from a decimated signal, %s at full rate")
+                 % TaskTimer::timeToString (overview) % TaskTimer::timeToString (full));
+
+        EXCEPTION_ASSERT_LESS_OR_EQUAL((Signal::IntervalType)signal->number_of_samples (), full_samples);
+        EXCEPTION_ASSERT_LESS_OR_EQUAL((Signal::IntervalType)signal->number_of_samples () >> levels, overview_samples);
+        EXCEPTION_ASSERT_LESS(overview_samples, full_samples);
+        EXCEPTION_ASSERT_LESS(overview, full/4);
+    }
+
+    // It should compute a full file pass with workers placed on NUMA nodes,
+    // see Signal::NumaTopology. The nodes are simulated on a machine with a
+    // single node.
+    {
+        Signal::pBuffer signal = Test::RandomBuffer::randomBuffer (Signal::Interval(0, 1<<17), 44100, 1);
+        Signal::NumaTopology topology;
+        if (1 == topology.nodes ().size ())
+            topology = Signal::NumaTopology::simulated (2);
+
+        double unplaced, placed;
+        {
+            TRACE_PERF("TransformOperationDesc should compute a Cwt of 3 s of audio with a chain");
+            unplaced = cwtChainPass (signal, 0);
+        }
+
+        Signal::NumaTopology::reset_statistics ();
+        {
+            TRACE_PERF("TransformOperationDesc should compute a Cwt of 3 s of audio with placed workers");
+            placed = cwtChainPass (signal, &topology);
+        }
+
+        TaskInfo ti(boost::format("transformoperation: Cwt pass in %s with placed workers, %s without")
+                    % TaskTimer::timeToString (placed) % TaskTimer::timeToString (unplaced));
+
+        double samples = 0;
+        std::vector<Signal::NumaTopology::NodeStatistics> nodes = Signal::NumaTopology::statistics ();
+        for (size_t i=0; i<nodes.size (); i++)
+        {
+            TaskInfo(boost::format("node %d: %g samples in %d tasks, %s busy")
+                     % i % nodes[i].samples % nodes[i].tasks % TaskTimer::timeToString (nodes[i].seconds));
+            samples += nodes[i].samples;
+        }
+
+        EXCEPTION_ASSERT_LESS_OR_EQUAL(signal->number_of_samples (), samples);
+        Signal::NumaTopology::reset_statistics ();
+    }
 }
 
 } // namespace Tfr
@@ -3,6 +3,9 @@
 
 #include "signal/operation.h"
 
+#include <atomic>
+#include <memory>
+
 namespace Tfr {
 
 class ChunkFilterDesc;
@@ -12,6 +15,26 @@ class TransformDesc;
  * @brief The TransformOperationDesc class should wrap all generic functionality
  * in Signal::Operation and Tfr::Transform so that ChunkFilters can explicilty do
  * only the filtering.
+ *
+ * The channels of a buffer are transformed and filtered concurrently on up to
+ * channel_threads() threads if the ChunkFilter has the
+ * ChunkFilter::ParallelChannelsTag. Each thread transforms its channels in one
+ * call to Transform::transformBatch. The threads are shared by all operations
+ * and a transform and the filters are only instantiated for as many threads as
+ * a buffer has channels.
+ *
+ * If there is a global ChunkSizeTuner its operations request tuning in the
+ * background for the sample rate of the buffers they process, see
+ * ChunkSizeTuner::request, and requiredInterval doesn't ask for more than the
+ * tuned chunk size at once.
+ *
+ * Consecutive TransformOperationDescs with equal transforms can be fused into
+ * one that applies all ChunkFilters to the same chunk with a single forward
+ * and inverse transform, see OperationDesc::fuse.
+ *
+ * affectedRegion follows a change through the forward transform, the
+ * ChunkFilters and the inverse, see TransformDesc::affectedFrequencies and
+ * ChunkFilterDesc::affectedRegion.
  */
 class TransformOperationDesc final: public Signal::OperationDesc
 {
@@ -24,18 +47,31 @@ public:
     Signal::Operation::ptr createOperation(Signal::ComputingEngine* engine=0) const;
     Signal::Interval requiredInterval(const Signal::Interval&, Signal::Interval*) const;
     Signal::Interval affectedInterval(const Signal::Interval&) const;
+    Signal::Region affectedRegion(const Signal::Region&) const;
+    void deprecatedInput(const Signal::Region&) const;
     Extent extent() const;
     QString toString() const;
     bool operator==(const Signal::OperationDesc&d) const;
+    OperationDesc::ptr fuse(const Signal::OperationDesc& previous) const;
 
     boost::shared_ptr<TransformDesc>            transformDesc() const;
     void                                        transformDesc(boost::shared_ptr<TransformDesc>);
     shared_state<ChunkFilterDesc>::write_ptr    chunk_filter();
     shared_state<ChunkFilterDesc>::read_ptr     chunk_filter() const;
 
+    /**
+     * @brief channel_threads is the number of threads a single task may use
+     * to process the channels of a buffer on the cpu. Defaults to one per core.
+     */
+    int                                         channel_threads() const;
+    void                                        channel_threads(int);
+
 protected:
     shared_state<ChunkFilterDesc> chunk_filter_;
+    std::vector<shared_state<ChunkFilterDesc>> fused_; // applied before chunk_filter_
     boost::shared_ptr<TransformDesc> transformDesc_;
+    int channel_threads_;
+    std::shared_ptr<std::atomic<float>> sample_rate_; // as seen by operations
 
 public:
     static void test();
@@ -2,8 +2,11 @@
 
 #include "tfr/freqaxis.h"
 #include "tfr/stftdesc.h"
+#include "tfr/stft.h"
+#include "tfr/cwt.h"
 #include "tfr/dummytransform.h"
 #include "tfr/transformoperation.h"
+#include "tfr/chunksizetuner.h"
 
 // common backtrace tools
 #include "timer.h"
@@ -37,9 +40,12 @@ int UnitTest::
 
         RUNTEST(Tfr::FreqAxis);
         RUNTEST(Tfr::StftDesc);
+        RUNTEST(Tfr::Stft);
+        RUNTEST(Tfr::Cwt);
         RUNTEST(Tfr::DummyTransform);
         RUNTEST(Tfr::DummyTransformDesc);
         RUNTEST(Tfr::TransformOperationDesc);
+        RUNTEST(Tfr::ChunkSizeTuner);
 
     } catch (const ExceptionAssert& x) {
         if (rethrow_exceptions)
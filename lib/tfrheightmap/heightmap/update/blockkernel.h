@@ -153,4 +153,20 @@ void resampleStft( Tfr::ChunkData::ptr input,
                    float normalization_factor,
                    bool enable_subtexel_aggregation);
 
+namespace Heightmap {
+namespace Update {
+
+/**
+ * @brief The BlockKernel class should resample transform data into the
+ * texels of a block with blockResampleChunk.
+ */
+class BlockKernel
+{
+public:
+    static void test();
+};
+
+} // namespace Update
+} // namespace Heightmap
+
 #endif // HEIGHTMAPBLOCK_CU_H
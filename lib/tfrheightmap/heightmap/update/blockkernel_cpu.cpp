@@ -24,3 +24,49 @@ operator()( std::complex<float> w, DataPos const& /*dataPosition*/ )
 
 // that's it, blockkerneldef contains the definitions
 #endif // USE_CUDA
+
+
+#include "blockkernel.h"
+#include "exceptionassert.h"
+#include "trace_perf.h"
+
+#include <cmath>
+
+namespace Heightmap {
+namespace Update {
+
+void BlockKernel::
+        test()
+{
+    // It should resample a chunk into a block with a low overhead.
+    {
+        float fs = 44100;
+        int window_size = 2048, bins = window_size/2 + 1, windows = 256;
+        Tfr::ChunkData::ptr input(new Tfr::ChunkData(windows, bins));
+        std::complex<float>* in = input->getCpuMemory ();
+        for (int i=0; i<bins*windows; i++)
+            in[i] = std::complex<float>(1.f, 0.f);
+
+        BlockData::ptr output(new BlockData(256, 256));
+        Tfr::FreqAxis inputAxis; inputAxis.setLinear (fs, window_size/2);
+        Heightmap::FreqAxis outputAxis; outputAxis.setLinear (fs);
+
+        TRACE_PERF("blockResampleChunk should resample 256 windows of 1025 bins into 256x256 texels");
+
+        blockResampleChunk (input, output,
+                            ValidInterval(0, windows),
+                            ResampleArea(0, 0, 1, 1),
+                            ResampleArea(0, 0, 1, 1),
+                            Heightmap::ComplexInfo_Amplitude_Non_Weighted,
+                            inputAxis, outputAxis,
+                            Heightmap::AmplitudeAxis_Linear,
+                            1.f, true);
+
+        float v = output->getCpuMemory ()[128*256 + 128];
+        EXCEPTION_ASSERT_LESS(0.f, v);
+        EXCEPTION_ASSERT(std::isfinite (v));
+    }
+}
+
+} // namespace Update
+} // namespace Heightmap
@@ -2,6 +2,7 @@
 
 #include "heightmap/tfrmapping.h"
 #include "heightmap/update/updateproducer.h"
+#include "heightmap/update/blockkernel.h"
 #include "heightmap/tfrmappings/stftblockfilter.h"
 #include "heightmap/tfrmappings/cwtblockfilter.h"
 #include "heightmap/tfrmappings/waveformblockfilter.h"
@@ -41,6 +42,7 @@ int UnitTest::
         RUNTEST(Heightmap::TfrMapping);
         RUNTEST(Heightmap::Update::UpdateProducer);
         RUNTEST(Heightmap::Update::UpdateProducerDesc);
+        RUNTEST(Heightmap::Update::BlockKernel);
         RUNTEST(Heightmap::TfrMappings::StftBlockFilter);
         RUNTEST(Heightmap::TfrMappings::StftBlockFilterDesc);
         RUNTEST(Heightmap::TfrMappings::CwtBlockFilter);
@@ -8,6 +8,7 @@
 
 #include "tasktimer.h"
 #include "timer.h"
+#include "trace_scope.h"
 #include "log.h"
 #include "gl.h"
 #include "logtickfrequency.h"
@@ -91,6 +92,7 @@ public:
 
                 while (!jobqueue.empty ())
                 {
+                    TRACE_SCOPE("UpdateConsumer::processJobs");
                     size_t s = jobqueue.size ();
                     block_updater.processJobs (jobqueue);
                     waveform_updater.processJobs (jobqueue);
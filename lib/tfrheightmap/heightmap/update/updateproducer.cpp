@@ -4,6 +4,7 @@
 #include "heightmap/blockquery.h"
 
 #include "tfr/chunk.h"
+#include "tfr/cwtchunk.h"
 
 #include "cpumemorystorage.h"
 #include "demangle.h"
@@ -12,6 +13,9 @@
 
 #include <boost/foreach.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 
 //#define DEBUG_INFO
 #define DEBUG_INFO if(0)
@@ -21,12 +25,28 @@ using namespace boost;
 namespace Heightmap {
 namespace Update {
 
+/**
+ * @brief undecimate describes a chunk in samples of the heightmap rather than
+ * in samples of the decimated signal. The time and frequency of each element
+ * are unchanged.
+ */
+static void undecimate(Tfr::Chunk& chunk, int decimation)
+{
+    chunk.original_sample_rate = std::ldexp(chunk.original_sample_rate, decimation);
+
+    if (Tfr::CwtChunk* cwtchunk = dynamic_cast<Tfr::CwtChunk*>(&chunk))
+        for (const Tfr::pChunk& part : cwtchunk->chunks)
+            part->original_sample_rate = std::ldexp(part->original_sample_rate, decimation);
+}
+
+
 UpdateProducer::
-        UpdateProducer( UpdateQueue::ptr update_queue, Heightmap::TfrMapping::const_ptr tfrmap, MergeChunk::ptr merge_chunk )
+        UpdateProducer( UpdateQueue::ptr update_queue, Heightmap::TfrMapping::const_ptr tfrmap, MergeChunk::ptr merge_chunk, int decimation )
     :
       update_queue_(update_queue),
       tfrmap_(tfrmap),
-      merge_chunk_(merge_chunk)
+      merge_chunk_(merge_chunk),
+      decimation_(decimation)
 {
 }
 
@@ -41,14 +61,43 @@ void UpdateProducer::
     EXCEPTION_ASSERT_LESS(pchunk.channel, (int)C.size());
     EXCEPTION_ASSERT_LESS_OR_EQUAL(0, pchunk.channel);
 
+    if (decimation_)
+        undecimate (*pchunk.chunk, decimation_);
+
     BlockCache::ptr cache = Collection::cache (C[pchunk.channel]);
     Signal::Interval chunk_interval = pchunk.chunk->getCoveredInterval();
     std::vector<pBlock> intersecting_blocks = BlockQuery(cache).getIntersectingBlocks( chunk_interval, false, 0);
 
+    if (decimation_)
+    {
+        // Only blocks at least as coarse as the decimated signal
+        float max_block_fs = std::ldexp(pchunk.chunk->original_sample_rate, -decimation_);
+        intersecting_blocks.erase (
+                    std::remove_if(intersecting_blocks.begin (), intersecting_blocks.end (),
+                                   [max_block_fs](const pBlock& b) { return b->sample_rate () > max_block_fs; }),
+                    intersecting_blocks.end ());
+    }
+
+    // Blocks that only cover frequencies that haven't changed, see
+    // UpdateProducerDesc::deprecatedInput
+    intersecting_blocks.erase (
+                std::remove_if(intersecting_blocks.begin (), intersecting_blocks.end (),
+                               [&cache,&chunk_interval](const pBlock& b) {
+                                    Signal::Intervals unchanged = cache->unchangedSamples (b->reference ());
+                                    return unchanged && unchanged.contains (chunk_interval & b->getInterval ());
+                               }),
+                intersecting_blocks.end ());
+
+    // The chunk brings the blocks up to date with any pending change
+    for (const pBlock& b : intersecting_blocks)
+        cache->updated (b->reference (), chunk_interval & b->getInterval ());
+
     if (intersecting_blocks.empty ())
     {
-        Log("updateproducer: Discarding chunk since there are no longer any intersecting_blocks with %s")
-                 % chunk_interval;
+        // An overview commonly only has blocks that are too fine
+        if (!decimation_)
+            Log("updateproducer: Discarding chunk since there are no longer any intersecting_blocks with %s")
+                     % chunk_interval;
         return;
     }
 
@@ -119,13 +168,47 @@ Tfr::pChunkFilter UpdateProducerDesc::
     if (!merge_chunk)
         return Tfr::pChunkFilter();
 
-    return Tfr::pChunkFilter( new UpdateProducer(update_queue_, tfrmap_, merge_chunk));
+    return Tfr::pChunkFilter( new UpdateProducer(update_queue_, tfrmap_, merge_chunk, decimation_));
+}
+
+
+Signal::Region UpdateProducerDesc::
+        affectedRegion( const Signal::Region& R ) const
+{
+    return R;
+}
+
+
+void UpdateProducerDesc::
+        deprecatedInput( const Signal::Region& R ) const
+{
+    Signal::Intervals samples;
+    for (Signal::Interval i : R.samples ())
+    {
+        if (i.first != Signal::Interval::IntervalType_MIN)
+            i.first <<= decimation_;
+        if (i.last != Signal::Interval::IntervalType_MAX)
+            i.last <<= decimation_;
+        samples |= i;
+    }
+
+    // Unknown frequencies above the decimated nyquist frequency may also
+    // have changed
+    Signal::Region H(samples);
+    if (!R.allFrequencies ())
+        H = Signal::Region(samples, std::ldexp(R.f1 (), -decimation_), std::ldexp(R.f2 (), -decimation_));
+
+    Heightmap::TfrMapping::Collections C = tfrmap_.read ()->collections();
+    for (const Heightmap::Collection::ptr& c : C)
+        Collection::cache (c)->deprecateRegion (H);
 }
 
 
 QString UpdateProducerDesc::
         toString() const
 {
+    if (decimation_)
+        return ("Overview " + transformDesc()->toString ()).c_str();
     return ("View " + transformDesc()->toString ()).c_str();
 }
 
@@ -232,6 +315,50 @@ void UpdateProducer::
         EXCEPTION_ASSERT( j );
         EXCEPTION_ASSERT( dynamic_cast<UpdateJobMock*>(j.updatejob.get ()) );
     }
+
+    // It should update blocks that are at least as coarse as a decimated
+    // signal with chunks computed from the decimated signal
+    {
+        MergeChunkMock* merge_chunk_mock;
+        MergeChunk::ptr merge_chunk( merge_chunk_mock = new MergeChunkMock );
+        BlockLayout bl(4, 4, SampleRate(4));
+        Heightmap::TfrMapping::ptr tfrmap(new Heightmap::TfrMapping(bl, ChannelCount(1)));
+        tfrmap.write ()->lengthSamples( 8*bl.sample_rate () );
+        UpdateQueue::ptr update_queue(new UpdateQueue::ptr::element_type);
+        UpdateProducer cbf( update_queue, tfrmap, merge_chunk, 2 );
+
+        Tfr::StftDesc stftdesc;
+        stftdesc.enable_inverse (false);
+        Signal::Interval data = stftdesc.requiredInterval (Signal::Interval(0,4), 0);
+        Signal::pMonoBuffer buffer(new Signal::MonoBuffer(data, bl.sample_rate ()/4));
+
+        // The entire heightmap of 8 s spans at least 16 s with 4 texels, so
+        // its sample rate is below the decimated signal of 1 Hz
+        pBlock block;
+        {
+            auto c = tfrmap.read ()->collections()[0];
+            block = c->getBlock (c->entireHeightmap());
+        }
+        EXCEPTION_ASSERT_LESS_OR_EQUAL( block->sample_rate (), bl.sample_rate ()/4 );
+
+        Tfr::ChunkAndInverse cai;
+        cai.channel = 0;
+        cai.input = buffer;
+        cai.t = stftdesc.createTransform ();
+        cai.chunk = (*cai.t)( buffer );
+        Signal::Interval decimated = cai.chunk->getCoveredInterval ();
+
+        std::thread t([&](){cbf(cai);});
+        UpdateQueue::Job j = update_queue->pop ();
+        j.promise.set_value();
+        t.join();
+
+        EXCEPTION_ASSERT_EQUALS( cai.chunk->original_sample_rate, bl.sample_rate () );
+        EXCEPTION_ASSERT_EQUALS( cai.chunk->getCoveredInterval (), Signal::Interval(4*decimated.first, 4*decimated.last) );
+        EXCEPTION_ASSERT( merge_chunk_mock->called() );
+        EXCEPTION_ASSERT_EQUALS( j.intersecting_blocks.size (), 1u );
+        EXCEPTION_ASSERT_EQUALS( j.intersecting_blocks[0], block );
+    }
 }
 
 
@@ -12,11 +12,16 @@ namespace Update {
 /**
  * @brief The UpdateProducer class should use a MergeChunk to update all
  * blocks in a tfrmap that matches a given Tfr::Chunk.
+ *
+ * With 'decimation' > 0 the chunks are computed from a signal decimated by
+ * 2^decimation, see Signal::DecimateDesc. Such chunks only update blocks
+ * where a texel spans at least one decimated sample and only cover the
+ * frequencies below the decimated nyquist frequency.
  */
 class UpdateProducer: public Tfr::ChunkFilter, public Tfr::ChunkFilter::NoInverseTag
 {
 public:
-    UpdateProducer( UpdateQueue::ptr update_queue, Heightmap::TfrMapping::const_ptr tfrmap, MergeChunk::ptr merge_chunk );
+    UpdateProducer( UpdateQueue::ptr update_queue, Heightmap::TfrMapping::const_ptr tfrmap, MergeChunk::ptr merge_chunk, int decimation=0 );
 
     void operator()( Tfr::ChunkAndInverse& chunk );
 
@@ -26,6 +31,7 @@ private:
     UpdateQueue::ptr update_queue_;
     Heightmap::TfrMapping::const_ptr tfrmap_;
     MergeChunk::ptr merge_chunk_;
+    int decimation_;
 
 public:
     static void test();
@@ -40,6 +46,10 @@ public:
  * ReferenceInfo::spannedElementsInterval into account
  * and correspondigly ChunkToBlock should only update those texels that have
  * full support.
+ *
+ * deprecatedInput should tell the BlockCache of each collection which
+ * frequencies have changed so that UpdateProducer can skip blocks that
+ * don't cover any of them.
  */
 class UpdateProducerDesc: public Tfr::ChunkFilterDesc
 {
@@ -56,12 +66,32 @@ public:
 
 
     void setMergeChunkDesc( MergeChunkDesc::ptr mcdp ) { merge_chunk_desc_ = mcdp; }
+
+    /**
+     * @brief setDecimation describes that the input to this filter is
+     * decimated by 2^levels, see UpdateProducer.
+     */
+    void setDecimation( int levels ) { decimation_ = levels; }
+    int decimation() const { return decimation_; }
+
+    /**
+     * @brief affectedRegion doesn't change 'R'.
+     */
+    Signal::Region affectedRegion( const Signal::Region& R ) const override;
+
+    /**
+     * @brief deprecatedInput describes 'R' to BlockCache::deprecateRegion in
+     * samples of the heightmap.
+     */
+    void deprecatedInput( const Signal::Region& R ) const override;
+
     QString toString() const;
 
 private:
     UpdateQueue::ptr update_queue_;
     Heightmap::TfrMapping::const_ptr tfrmap_;
     MergeChunkDesc::ptr merge_chunk_desc_;
+    int decimation_ = 0;
 
 public:
     static void test();
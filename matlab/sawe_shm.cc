@@ -0,0 +1,277 @@
+// Exchanges data with Sonic AWE through shared memory instead of files, see
+// Adapters::MatlabSharedMemory. Used by sawe_shmwatcher.
+//
+// Build with
+//   mkoctfile sawe_shm.cc
+// (add -lrt with glibc older than 2.17)
+//
+// typical usage
+//   data = sawe_shm('wait', name, timeout)
+//   sawe_shm('reply', name, data)
+//
+// 'wait' blocks until Sonic AWE sends a chunk and returns it as a struct with
+// the same fields as sawe_loadstruct would. It returns [] after 'timeout'
+// seconds and 'quit' when Sonic AWE has closed the segment.
+//
+// 'reply' writes data.samples, data.offset, data.fs, data.overlap and
+// data.plot back to Sonic AWE.
+
+#include <octave/oct.h>
+#include <octave/ov-struct.h>
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <string>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Must match Adapters::MatlabSharedMemory::Header
+struct Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t segment_size;
+    uint64_t quit;
+
+    uint64_t sequence;
+    uint64_t num_channels;
+    uint64_t number_of_samples;
+    double sample_offset;
+    double sample_rate;
+    double overlap;
+
+    uint64_t reply_sequence;
+    int64_t reply_status;
+    uint64_t reply_channels;
+    uint64_t reply_samples;
+    double reply_offset;
+    double reply_sample_rate;
+    double reply_overlap;
+    uint64_t plot_rows;
+    uint64_t plot_columns;
+};
+
+static const uint32_t header_magic = 0x45574153;
+static const uint32_t header_version = 1;
+static const uint64_t data_offset = 256;
+
+static std::string attached;
+static int fd = -1;
+static char* map = 0;
+static size_t map_size = 0;
+static sem_t* request = SEM_FAILED;
+static sem_t* reply = SEM_FAILED;
+
+static Header* header() { return (Header*)map; }
+static float* data() { return (float*)(map + data_offset); }
+
+
+static void detach()
+{
+    if (map) munmap (map, map_size);
+    if (0 <= fd) close (fd);
+    if (SEM_FAILED != request) sem_close (request);
+    if (SEM_FAILED != reply) sem_close (reply);
+
+    map = 0;
+    map_size = 0;
+    fd = -1;
+    request = reply = SEM_FAILED;
+    attached.clear ();
+}
+
+
+static void attach(const std::string& name)
+{
+    if (attached == name)
+        return;
+
+    detach ();
+
+    fd = shm_open (name.c_str (), O_RDWR, 0);
+    if (fd < 0)
+        error ("sawe_shm: couldn't open '%s': %s", name.c_str (), strerror (errno));
+
+    struct stat st;
+    fstat (fd, &st);
+    map_size = st.st_size;
+    map = (char*)mmap (0, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    request = sem_open ((name + ".request").c_str (), 0);
+    reply = sem_open ((name + ".reply").c_str (), 0);
+
+    if (MAP_FAILED == map || SEM_FAILED == request || SEM_FAILED == reply)
+    {
+        if (MAP_FAILED == map) map = 0;
+        detach ();
+        error ("sawe_shm: couldn't attach to '%s'", name.c_str ());
+    }
+
+    if (header ()->magic != header_magic || header ()->version != header_version)
+    {
+        detach ();
+        error ("sawe_shm: '%s' is not a Sonic AWE segment of version %u", name.c_str (), header_version);
+    }
+
+    attached = name;
+}
+
+
+static void remap(uint64_t size)
+{
+    munmap (map, map_size);
+    map_size = size;
+    map = (char*)mmap (0, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == map)
+    {
+        map = 0;
+        detach ();
+        error ("sawe_shm: couldn't map %lu bytes", (unsigned long)size);
+    }
+}
+
+
+static bool wait_for_request(double timeout)
+{
+#ifdef __APPLE__
+    // sem_timedwait isn't available
+    for (double t=0; t<timeout; t+=0.001)
+    {
+        if (0 == sem_trywait (request))
+            return true;
+        usleep (1000);
+    }
+    return 0 == sem_trywait (request);
+#else
+    timespec abstime;
+    clock_gettime (CLOCK_REALTIME, &abstime);
+    double s = abstime.tv_nsec*1e-9 + timeout;
+    abstime.tv_sec += (time_t)s;
+    abstime.tv_nsec = (long)((s - (time_t)s)*1e9);
+
+    while (0 != sem_timedwait (request, &abstime))
+        if (EINTR != errno)
+            return false;
+    return true;
+#endif
+}
+
+
+static double field(const octave_scalar_map& m, const char* name, double fallback)
+{
+    if (!m.isfield (name) || m.getfield (name).isempty ())
+        return fallback;
+    return m.getfield (name).double_value ();
+}
+
+
+static octave_value wait_for_chunk(const std::string& name, double timeout)
+{
+    attach (name);
+
+    if (!wait_for_request (timeout))
+        return Matrix();
+
+    // Sonic AWE grows the segment if a chunk doesn't fit
+    if (header ()->segment_size > map_size)
+        remap (header ()->segment_size);
+
+    const Header* h = header ();
+    if (h->quit)
+    {
+        detach ();
+        return octave_value("quit");
+    }
+
+    const uint64_t C = h->num_channels, N = h->number_of_samples;
+    Matrix samples(N, C);
+    std::copy (data (), data () + C*N, samples.fortran_vec ());
+
+    octave_scalar_map m;
+    m.assign ("samples", samples);
+    m.assign ("offset", h->sample_offset);
+    m.assign ("fs", h->sample_rate);
+    m.assign ("overlap", h->overlap);
+    return m;
+}
+
+
+static void send_reply(const std::string& name, const octave_scalar_map& m)
+{
+    attach (name);
+
+    Header* h = header ();
+    h->reply_status = 1;
+    h->reply_channels = h->reply_samples = 0;
+    h->plot_rows = h->plot_columns = 0;
+    h->reply_offset = field (m, "offset", h->sample_offset);
+    h->reply_sample_rate = field (m, "fs", h->sample_rate);
+    h->reply_overlap = field (m, "overlap", h->overlap);
+
+    FloatMatrix samples, plot;
+    if (m.isfield ("samples"))
+        samples = m.getfield ("samples").float_matrix_value ();
+    if (m.isfield ("plot"))
+        plot = m.getfield ("plot").float_matrix_value ();
+
+    const uint64_t S = samples.numel (), P = plot.numel ();
+    const uint64_t bytes = data_offset + (S + P)*sizeof(float);
+    if (bytes > h->segment_size)
+    {
+        const uint64_t size = std::max(bytes, 2*h->segment_size);
+        if (0 != ftruncate (fd, size))
+            error ("sawe_shm: couldn't resize '%s': %s", name.c_str (), strerror (errno));
+        remap (size);
+        h = header ();
+        h->segment_size = size;
+    }
+
+    if (0 < S)
+    {
+        h->reply_status = 0;
+        h->reply_samples = samples.rows ();
+        h->reply_channels = samples.columns ();
+        std::copy (samples.data (), samples.data () + S, data ());
+    }
+
+    if (0 < P)
+    {
+        h->plot_rows = plot.rows ();
+        h->plot_columns = plot.columns ();
+        std::copy (plot.data (), plot.data () + P, data () + S);
+    }
+
+    h->reply_sequence = h->sequence;
+    sem_post (reply);
+}
+
+
+DEFUN_DLD (sawe_shm, args, ,
+           "data = sawe_shm('wait', name, timeout)\n"
+           "sawe_shm('reply', name, data)\n"
+           "\n"
+           "Exchanges data with Sonic AWE through shared memory.")
+{
+    if (args.length () < 2)
+        print_usage ();
+
+    std::string command = args(0).string_value ();
+    std::string name = args(1).string_value ();
+
+    if ("wait" == command)
+        return wait_for_chunk (name, 2 < args.length () ? args(2).double_value () : 1);
+
+    if ("reply" == command && 2 < args.length ())
+    {
+        send_reply (name, args(2).scalar_map_value ());
+        return octave_value_list();
+    }
+
+    print_usage ();
+    return octave_value_list();
+}
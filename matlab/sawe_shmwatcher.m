@@ -0,0 +1,67 @@
+% typical usage
+%   sawe_shmwatcher('/saweinterop.Ab12Cd', @work)
+% with work defined as
+%   function data=work(data)
+%
+% Like sawe_filewatcher but data is exchanged with Sonic AWE through the
+% shared memory segment 'name' by the helper sawe_shm (build it with
+% 'mkoctfile sawe_shm.cc'). Octave stays resident and blocks in sawe_shm until
+% Sonic AWE sends the next chunk, nothing is written to disk.
+%
+% sawe_shmwatcher exits when Sonic AWE closes the segment or exits.
+function sawe_shmwatcher(name, func, arguments)
+
+if nargin<2
+  error('syntax: sawe_shmwatcher(name, function, arguments). ''arguments'' defaults to []')
+end
+if nargin<3
+  arguments=cell(0);
+end
+
+if nargin(func2str(func))-1 ~= numel(arguments)
+  error(['Function ' func2str(func) ' takes ' num2str(nargin(func2str(func))-1) ' extra arguments but ' num2str(numel(arguments)) ' arguments was provided']);
+end
+
+global sawe_plot_data; %matrix for all lines to be plotted.
+
+parent = getppid();
+
+disp([ sawe_datestr(now, 'yyyy-mm-dd HH:MM:SS.FFF') ' Sonic AWE running script ''' func2str(func) ''' (shared memory ''' name ''')']);
+disp(['Working dir: ' pwd]);
+
+while 1
+  data = sawe_shm('wait', name, 1);
+
+  if ischar(data)
+    exit; % Sonic AWE closed the segment
+  end
+
+  if isempty(data)
+    if getppid() ~= parent
+      exit; % Sonic AWE is gone
+    end
+    continue;
+  end
+
+  sawe_plot_data = [];
+
+  if 0 == nargout(func2str(func))
+    if 1 == nargin(func2str(func))
+      func(data);
+    else
+      func(data, arguments{:});
+    end
+    data = sawe_discard(data);
+  else
+    if 1 == nargin(func2str(func))
+      data = func(data);
+    else
+      data = func(data, arguments{:});
+    end
+  end
+
+  data.plot = sawe_plot_data;
+  sawe_shm('reply', name, data);
+end
+
+%endfunction
@@ -1,10 +1,14 @@
 #include "audiofile.h"
+#include "flacreader.h"
+#include "sawe/projectfile.h"
 #include "Statistics.h" // to play around for debugging
 #include "signal/transpose.h"
+#include "trace_scope.h"
 #include "neat_math.h" // defines __int64_t which is expected by sndfile.h
 
 #include <sndfile.hh> // for reading various formats
 #include <math.h>
+#include <thread>
 #include <stdexcept>
 #include <iostream>
 #include <sstream>
@@ -179,6 +183,7 @@ bool Audiofile::
 Audiofile::
         Audiofile(std::string filename)
         :
+        _sndfile_position(-1),
         _tried_load(false),
         _sample_rate(0),
         _number_of_samples(0),
@@ -194,6 +199,39 @@ Audiofile::
 }
 
 
+Audiofile::
+        ~Audiofile()
+{
+    // Queued reads keep this Audiofile alive, so there are none left
+    if (_read_queue)
+        _read_queue->close ();
+}
+
+
+std::shared_ptr<Audiofile::ReadQueue> Audiofile::
+        readQueue()
+{
+    std::lock_guard<std::mutex> l(_read_queue_lock);
+    if (!_read_queue)
+    {
+        std::shared_ptr<ReadQueue> q(new ReadQueue);
+        // Detached so that a read can release the last reference to this
+        // Audiofile from the reader thread
+        std::thread([q]()
+        {
+            try {
+                while (true) {
+                    auto task = q->pop ();
+                    task();
+                }
+            } catch (const ReadQueue::abort_exception&) {}
+        }).detach ();
+        _read_queue = q;
+    }
+    return _read_queue;
+}
+
+
 std::string Audiofile::
         name()
 {
@@ -245,6 +283,7 @@ Audiofile:: // for deserialization
         Audiofile()
             :
             file(new QTemporaryFile()),
+            _sndfile_position(-1),
             _tried_load(false),
             _sample_rate(0),
             _number_of_samples(0),
@@ -282,6 +321,20 @@ bool Audiofile::
         _sample_rate = sndfile->samplerate();
         _number_of_samples = sndfile->frames();
         _number_of_channels = sndfile->channels();
+        _sndfile_position = 0;
+
+#ifdef USE_FLAC
+        if ((sndfile->format() & SF_FORMAT_TYPEMASK) == SF_FORMAT_FLAC) try
+        {
+            // Don't leave a seek index next to temporary files
+            bool persist_index = !dynamic_cast<QTemporaryFile*>(file.get());
+            flac.reset( new FlacReader(file->fileName().toStdString(), persist_index) );
+        }
+        catch (const std::exception& x)
+        {
+            TaskInfo("Audiofile: %s. Reading with libsndfile instead", x.what());
+        }
+#endif
     }
 
     return true;
@@ -291,6 +344,8 @@ bool Audiofile::
 Signal::pBuffer Audiofile::
         readRaw( const Signal::Interval& J )
 {
+    TRACE_SCOPE("Audiofile::readRaw");
+
     Signal::Interval I = readRawInterval(J);
 
     if (!(I & getInterval ()))
@@ -304,28 +359,59 @@ Signal::pBuffer Audiofile::
     VERBOSE_AUDIOFILE tt.reset(new TaskTimer("Loading %s from '%s' (this=%p)",
                  I.toString().c_str(), filename().c_str(), this));
 
-    DataStorage<float> partialfile(DataStorageSize( num_channels(), I.count(), 1));
-    sf_count_t sndfilepos;
-    TIME_AUDIOFILE_LINE( sndfilepos = sndfile->seek(I.first, SEEK_SET) );
-    if (sndfilepos < 0)
+    Signal::pBuffer waveform( new Signal::Buffer(I.first, I.count(), sample_rate(), num_channels()));
+    std::vector<float*> channels(num_channels());
+    for (unsigned c=0; c<num_channels(); c++)
+        channels[c] = CpuMemoryStorage::WriteAll<1>( waveform->getChannel (c)->waveform_data () ).ptr();
+
+    sf_count_t readframes;
+#ifdef USE_FLAC
+    if (flac)
     {
-        TaskInfo("%s", str(format("ERROR! Couldn't set read position to %d. An error occured (%d)") % I.first % sndfilepos).c_str());
-        return zeros( J );
+        // Seeks to the exact frame through the index and decodes in parallel
+        TIME_AUDIOFILE_LINE( readframes = flac->read(I, &channels[0]) );
     }
-    if (sndfilepos != I.first)
+    else
+#endif
     {
-        TaskInfo("%s", str(format("ERROR! Couldn't set read position to %d. sndfilepos was %d") % I.first % sndfilepos).c_str());
-        return zeros( J );
-    }
+        // Compressed formats decode from a seek point when seeking, so don't
+        // seek if the previous read ended where this one starts.
+        if (_sndfile_position != I.first)
+        {
+            _sndfile_position = -1;
 
-    float* data = CpuMemoryStorage::WriteAll<float,3>( &partialfile ).ptr();
-    sf_count_t readframes;
-    TIME_AUDIOFILE_LINE( readframes = sndfile->read(data, num_channels()*I.count())); // read float
+            sf_count_t sndfilepos;
+            TIME_AUDIOFILE_LINE( sndfilepos = sndfile->seek(I.first, SEEK_SET) );
+            if (sndfilepos < 0)
+            {
+                TaskInfo("%s", str(format("ERROR! Couldn't set read position to %d. An error occured (%d)") % I.first % sndfilepos).c_str());
+                return zeros( J );
+            }
+            if (sndfilepos != I.first)
+            {
+                TaskInfo("%s", str(format("ERROR! Couldn't set read position to %d. sndfilepos was %d") % I.first % sndfilepos).c_str());
+                return zeros( J );
+            }
+        }
 
-    Signal::pBuffer waveform( new Signal::Buffer(I.first, I.count(), sample_rate(), num_channels()));
-    Signal::pTimeSeriesData mergedata = waveform->mergeChannelData ();
-    TIME_AUDIOFILE_LINE( Signal::transpose( mergedata.get(), &partialfile ) );
-    waveform.reset (new Signal::Buffer(I.first, mergedata, sample_rate()));
+        // Deinterleave straight into the channels of 'waveform'. 16-bit files are
+        // read as shorts to halve the amount of interleaved data and converted
+        // while deinterleaving.
+        if ((sndfile->format() & SF_FORMAT_SUBMASK) == SF_FORMAT_PCM_16)
+        {
+            std::vector<short> data(num_channels()*I.count());
+            TIME_AUDIOFILE_LINE( readframes = sndfile->readf(&data[0], I.count()) ); // read short
+            TIME_AUDIOFILE_LINE( Signal::deinterleave(&channels[0], &data[0], num_channels(), readframes) );
+        }
+        else
+        {
+            std::vector<float> data(num_channels()*I.count());
+            TIME_AUDIOFILE_LINE( readframes = sndfile->readf(&data[0], I.count()) ); // read float
+            TIME_AUDIOFILE_LINE( Signal::deinterleave(&channels[0], &data[0], num_channels(), readframes) );
+        }
+
+        _sndfile_position = I.first + readframes;
+    }
 
     if ((sf_count_t)I.count() > readframes)
     {
@@ -425,15 +511,82 @@ void Audiofile::
 }
 
 
+unsigned Audiofile::
+        writeRawFileSection()
+{
+    TaskInfo ti("Audiofile::writeRawFileSection(%s)",
+                file->fileName().toStdString().c_str());
+
+    Sawe::ProjectFile::Writer* w = Sawe::ProjectFile::Writer::current();
+    EXCEPTION_ASSERTX( w, "Audiofile must be saved to a Sawe::ProjectFile" );
+
+    CloseAfterScope cas(file);
+    if (!file->open(QIODevice::ReadOnly))
+        throw std::ios_base::failure("Couldn't get raw data from " + file->fileName().toStdString() + " (original name '" + filename() + "')");
+
+    qint64 N = file->size();
+    if (0 == N)
+        return w->addSection( 0, 0 );
+
+    uchar* p = file->map(0, N);
+    if (!p)
+        throw std::ios_base::failure("Couldn't map " + file->fileName().toStdString() + " (original name '" + filename() + "')");
+
+    unsigned section = w->addSection( p, N );
+    file->unmap(p);
+    return section;
+}
+
+
+void Audiofile::
+        readRawFileSection(unsigned section)
+{
+    Sawe::ProjectFile* f = Sawe::ProjectFile::current();
+    EXCEPTION_ASSERTX( f, "Audiofile must be loaded from a Sawe::ProjectFile" );
+
+    Sawe::ProjectFile::Section s = f->section(section);
+
+    TaskInfo ti("Audiofile::readRawFileSection(%u bytes)", (unsigned)s.size);
+
+    // file is a QTemporaryFile during deserialization, libsndfile reads it
+    // from disk
+    CloseAfterScope cas(file);
+
+    if (!file->open(QIODevice::WriteOnly))
+        throw std::ios_base::failure("Couldn't create raw data in " + file->fileName().toStdString() + " (original name '" + filename() + "')");
+
+    if ((qint64)s.size != file->write(s.data, s.size))
+        throw std::ios_base::failure("Couldn't write raw data to " + file->fileName().toStdString() + " (original name '" + filename() + "')");
+}
+
+
 AudiofileOperation::
         AudiofileOperation(Audiofile::ptr audiofile) : audiofile_(audiofile)
 {}
 
 
+void AudiofileOperation::
+        processAsync(Signal::pBuffer b, Done done)
+{
+    Audiofile::ptr audiofile = audiofile_;
+    audiofile->readQueue ()->push (std::packaged_task<void()>([audiofile, b, done]()
+    {
+        Signal::pBuffer r;
+        try {
+            r = read (*audiofile, b);
+        } catch (...) {
+            done (Signal::pBuffer(), std::current_exception ());
+            return;
+        }
+        done (r, std::exception_ptr());
+    }));
+}
+
+
 Signal::pBuffer AudiofileOperation::
-        process(Signal::pBuffer b)
+        read(Audiofile& audiofile, Signal::pBuffer b)
 {
-    Signal::pBuffer p = audiofile_->readRaw(b->getInterval ());
+    Signal::pBuffer p = audiofile.readRaw(b->getInterval ());
     if (p->getInterval () == b->getInterval ())
         return p;
     else
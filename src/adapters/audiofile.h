@@ -245,6 +245,14 @@
 // gpumisc
 #include "cpumemorystorage.h"
 
+// justmisc
+#include "blocking_queue.h"
+
+// std
+#include <future>
+#include <memory>
+#include <mutex>
+
 // Qt
 #include <QByteArray>
 #include <QFile>
@@ -256,6 +264,8 @@ class SndfileHandle;
 namespace Adapters
 {
 
+class FlacReader;
+
 class SaweDll Audiofile: public Signal::SourceBase
 {
 private:
@@ -324,7 +334,16 @@ public:
     static std::string getFileFormatsQtFilter( bool split );
     static bool hasExpectedSuffix( const std::string& suffix );
 
+    typedef JustMisc::blocking_queue<std::packaged_task<void()>> ReadQueue;
+
     Audiofile(std::string filename);
+    ~Audiofile();
+
+    /**
+     * @brief readQueue is served by a reader thread of this file, see
+     * AudiofileOperation. The thread ends when the Audiofile is destroyed.
+     */
+    std::shared_ptr<ReadQueue> readQueue();
 
     virtual std::string name();
     virtual Signal::IntervalType number_of_samples();
@@ -347,6 +366,10 @@ private:
     /// file can be a QTemporaryFile that deletes itself upon destruction
     boost::shared_ptr<QFile> file;
     boost::shared_ptr<SndfileHandle> sndfile;
+    /// Reads FLAC files through a seek index instead of sndfile, if available
+    boost::shared_ptr<FlacReader> flac;
+    /// Where the previous read from sndfile ended, -1 if unknown
+    Signal::IntervalType _sndfile_position;
 
     std::string _original_relative_filename;
     std::string _original_absolute_filename;
@@ -355,9 +378,16 @@ private:
     Signal::IntervalType _number_of_samples;
     unsigned _number_of_channels;
 
+    std::mutex _read_queue_lock;
+    std::shared_ptr<ReadQueue> _read_queue;
+
     std::vector<char> getRawFileData(unsigned i, unsigned bytes_per_chunk);
     void appendToTempfile(std::vector<char> rawFileData, unsigned i, unsigned bytes_per_chunk);
 
+    // Store the raw file data as a section in Sawe::ProjectFile
+    unsigned writeRawFileSection();
+    void readRawFileSection(unsigned section);
+
     friend class boost::serialization::access;
     template<class archive> void serialize(archive& ar, const unsigned int version) {
         using boost::serialization::make_nvp;
@@ -366,7 +396,18 @@ private:
 
         unsigned bytes_per_chunk = 1<<18;
 
-        for (unsigned i=0; true; ++i)
+        if (version >= 4)
+        {
+            unsigned section = 0;
+            if (typename archive::is_saving())
+                section = writeRawFileSection();
+
+            ar & make_nvp("Raw_data_section", section);
+
+            if (typename archive::is_loading())
+                readRawFileSection( section );
+        }
+        else for (unsigned i=0; true; ++i)
         {
             std::vector<char> rawdata;
             if (typename archive::is_saving())
@@ -430,14 +471,24 @@ private:
 };
 
 
-class SaweDll AudiofileOperation: public Signal::Operation
+/**
+ * @brief The AudiofileOperation class should read from an Audiofile without
+ * blocking the worker.
+ *
+ * Reads from a file are done by its reader thread, see Audiofile::readQueue,
+ * in the order they were started so that the disc isn't seeking back and
+ * forth within the file. Different files are read in parallel.
+ */
+class SaweDll AudiofileOperation: public Signal::AsyncOperation
 {
 public:
     AudiofileOperation(Audiofile::ptr audiofile);
 
-    virtual Signal::pBuffer process(Signal::pBuffer b);
+    void processAsync(Signal::pBuffer b, Done done) override;
 private:
     Audiofile::ptr audiofile_;
+
+    static Signal::pBuffer read(Audiofile& audiofile, Signal::pBuffer b);
 };
 
 
@@ -459,6 +510,6 @@ private:
 
 } // namespace Adapters
 
-BOOST_CLASS_VERSION(Adapters::Audiofile, 3)
+BOOST_CLASS_VERSION(Adapters::Audiofile, 4)
 
 #endif // ADAPTERS_AUDIOFILE_H
@@ -0,0 +1,526 @@
+#include "chunkexport.h"
+#include "hdf5adapter.h"
+
+#include "tfr/cwtchunk.h"
+#include "signal/computingengine.h"
+
+#include "tasktimer.h"
+#include "exceptionassert.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+//#define LOG_EXPORT
+#define LOG_EXPORT if(0)
+
+using namespace std;
+
+namespace Adapters {
+
+ChunkExport::
+        ChunkExport(unique_ptr<Format> format, Signal::Interval I, float sample_rate, int channels, size_t queue_capacity)
+    :
+      format_(move(format)),
+      I_(I),
+      sample_rate_(sample_rate),
+      channels_(channels),
+      queue_(queue_capacity)
+{
+    writer_ = thread([this](){ writer (); });
+}
+
+
+ChunkExport::
+        ~ChunkExport()
+{
+    try {
+        finish ();
+    } catch (const exception& x) {
+        TaskInfo("ChunkExport failed: %s", x.what ());
+    }
+}
+
+
+unique_ptr<ChunkExport::Format> ChunkExport::
+        formatFromFilename(string filename, int compression)
+{
+    string suffix = ".npy";
+    if (filename.size () >= suffix.size () && 0 == filename.compare (filename.size () - suffix.size (), suffix.size (), suffix))
+        return unique_ptr<Format>(new NpyFormat(filename));
+    return unique_ptr<Format>(new Hdf5Format(filename, compression));
+}
+
+
+void ChunkExport::
+        put(Tfr::Chunk& chunk, int part, int channel)
+{
+    rethrow ();
+
+    // Columns of this part, relative to the start of the interval
+    double column_rate = chunk.sample_rate;
+    double start = I_.first * column_rate / sample_rate_;
+    int columns_in_part = (int)ceil (I_.count () * column_rate / sample_rate_);
+    int first = (int)floor (chunk.chunk_offset.asFloat () + chunk.first_valid_sample - start + 0.5);
+
+    int begin = max(0, -first);
+    int end = min(chunk.n_valid_samples, columns_in_part - first);
+    if (end <= begin)
+        return;
+
+    int samples = chunk.nSamples ();
+    int scales = chunk.nScales ();
+    bool row_major = chunk.order == Tfr::Chunk::Order_row_major;
+    const complex<float>* p = chunk.transform_data->getCpuMemory ();
+
+    shared_ptr<Block> b(new Block);
+    b->part = part;
+    b->channel = channel;
+    b->columns_in_part = columns_in_part;
+    b->first_column = first + begin;
+    b->columns = end - begin;
+    b->scales = scales;
+    b->column_rate = column_rate;
+    b->data.resize (b->columns * scales);
+
+    // Transpose to [column][scale] so that a block is contiguous in the file
+    complex<float>* q = &b->data[0];
+    for (int x=begin; x<end; x++)
+    {
+        int sample = chunk.first_valid_sample + x;
+        for (int f=0; f<scales; f++)
+            *q++ = row_major ? p[sample + f*samples] : p[sample*scales + f];
+    }
+
+    queue_.push (move(b));
+}
+
+
+void ChunkExport::
+        finish()
+{
+    if (writer_.joinable ())
+    {
+        // An empty block ends the writer
+        queue_.push (shared_ptr<Block>());
+        writer_.join ();
+    }
+
+    rethrow ();
+}
+
+
+void ChunkExport::
+        writer()
+{
+    vector<bool> created;
+
+    try
+    {
+        while (shared_ptr<Block> b = queue_.pop ())
+        {
+            if ((int)created.size () <= b->part)
+                created.resize (b->part + 1, false);
+
+            if (!created[b->part])
+            {
+                LOG_EXPORT TaskInfo("ChunkExport part %d: %d columns, %d scales, %g columns/s",
+                                    b->part, b->columns_in_part, b->scales, b->column_rate);
+                format_->create (b->part, channels_, b->columns_in_part, b->scales, b->column_rate, I_.first / sample_rate_);
+                created[b->part] = true;
+            }
+
+            format_->write (b->part, b->channel, b->first_column, b->columns, b->scales, &b->data[0]);
+        }
+
+        format_->close ();
+    }
+    catch (const JustMisc::blocking_queue<shared_ptr<Block> >::abort_exception&)
+    {
+    }
+    catch (...)
+    {
+        {
+            lock_guard<mutex> l(error_mutex_);
+            error_ = current_exception ();
+        }
+
+        // Release blocked producers, later blocks are discarded
+        queue_.close ();
+    }
+}
+
+
+void ChunkExport::
+        rethrow()
+{
+    exception_ptr e;
+    {
+        lock_guard<mutex> l(error_mutex_);
+        e = error_;
+    }
+
+    if (e)
+        rethrow_exception (e);
+}
+
+
+NpyFormat::
+        NpyFormat(string filename)
+    :
+      filename_(filename)
+{
+}
+
+
+NpyFormat::
+        ~NpyFormat()
+{
+}
+
+
+string NpyFormat::
+        partFilename(string filename, int part)
+{
+    if (0 == part)
+        return filename;
+
+    stringstream ss;
+    size_t dot = filename.find_last_of ('.');
+    if (dot == string::npos || filename.find_first_of ("/\\", dot) != string::npos)
+        ss << filename << "-" << part;
+    else
+        ss << filename.substr (0, dot) << "-" << part << filename.substr (dot);
+    return ss.str ();
+}
+
+
+void NpyFormat::
+        create(int part, int channels, int columns, int scales, float, double)
+{
+    if ((int)files_.size () <= part)
+        files_.resize (part + 1);
+
+    File& file = files_[part];
+    string filename = partFilename (filename_, part);
+    file.f.reset (new ofstream(filename.c_str (), ios::binary | ios::trunc));
+    if (!*file.f)
+        throw runtime_error("Could not create file '" + filename + "'");
+
+    // The header is padded with spaces and ends with a newline such that the
+    // data is 64 byte aligned
+    stringstream ss;
+    ss << "{'descr': '<c8', 'fortran_order': False, 'shape': ("
+       << channels << ", " << columns << ", " << scales << "), }";
+    string header = ss.str ();
+    size_t preamble = 10;
+    header.append (63 - (preamble + header.size ()) % 64, ' ');
+    header.push_back ('\n');
+
+    char magic[10] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0,
+                      char(header.size () & 0xff), char(header.size () >> 8)};
+    file.f->write (magic, sizeof(magic));
+    file.f->write (header.data (), header.size ());
+
+    file.header_size = preamble + header.size ();
+    file.columns = columns;
+    file.scales = scales;
+
+    // Allocate the whole file, columns that are never written are zero
+    streamoff size = file.header_size + streamoff(channels) * columns * scales * sizeof(complex<float>);
+    file.f->seekp (size - 1);
+    file.f->put (0);
+
+    if (!*file.f)
+        throw runtime_error("Could not write file '" + filename + "'");
+}
+
+
+void NpyFormat::
+        write(int part, int channel, int first_column, int columns, int scales, const complex<float>* data)
+{
+    File& file = files_[part];
+    EXCEPTION_ASSERT_EQUALS(scales, file.scales);
+    EXCEPTION_ASSERT_LESS_OR_EQUAL(first_column + columns, file.columns);
+
+    streamoff offset = file.header_size + (streamoff(channel) * file.columns + first_column) * scales * sizeof(complex<float>);
+    file.f->seekp (offset);
+    file.f->write ((const char*)data, streamsize(columns) * scales * sizeof(complex<float>));
+
+    if (!*file.f)
+        throw runtime_error("Could not write file '" + partFilename (filename_, part) + "'");
+}
+
+
+void NpyFormat::
+        close()
+{
+    for (File& file : files_)
+        if (file.f)
+            file.f->close ();
+}
+
+
+struct Hdf5Format::Private
+{
+    Private(string filename, int compression)
+        :
+          h5(filename),
+          compression(compression)
+    {
+        type = H5Tcreate( H5T_COMPOUND, 8 );
+        H5Tinsert( type, "real", 0, H5T_NATIVE_FLOAT );
+        H5Tinsert( type, "imag", 4, H5T_NATIVE_FLOAT );
+    }
+
+    ~Private()
+    {
+        for (hid_t d : datasets)
+            if (0 <= d)
+                H5Dclose (d);
+        H5Tclose (type);
+    }
+
+    Hdf5Output h5;
+    int compression;
+    hid_t type;
+    vector<hid_t> datasets;
+};
+
+
+Hdf5Format::
+        Hdf5Format(string filename, int compression)
+    :
+      p_(new Private(filename, compression))
+{
+}
+
+
+Hdf5Format::
+        ~Hdf5Format()
+{
+}
+
+
+static string partName(string name, int part)
+{
+    if (0 == part)
+        return name;
+
+    stringstream ss;
+    ss << name << part;
+    return ss.str ();
+}
+
+
+void Hdf5Format::
+        create(int part, int channels, int columns, int scales, float column_rate, double start_time)
+{
+    if ((int)p_->datasets.size () <= part)
+        p_->datasets.resize (part + 1, -1);
+
+    string name = partName ("chunk", part);
+    hsize_t dims[3] = {hsize_t(channels), hsize_t(columns), hsize_t(scales)};
+
+    // About 1 MB per HDF5 chunk
+    hsize_t chunk_columns = max(1, min(columns, (1<<20) / int(scales*sizeof(complex<float>))));
+    hsize_t chunk_dims[3] = {1, chunk_columns, hsize_t(scales)};
+
+    hid_t space = H5Screate_simple (3, dims, 0);
+    hid_t plist = H5Pcreate (H5P_DATASET_CREATE);
+    H5Pset_chunk (plist, 3, chunk_dims);
+    if (0 < p_->compression)
+        H5Pset_deflate (plist, p_->compression);
+
+    hid_t d = H5Dcreate2 (p_->h5.file_id (), name.c_str (), p_->type, space, H5P_DEFAULT, plist, H5P_DEFAULT);
+    H5Pclose (plist);
+    H5Sclose (space);
+    if (0>d) throw Hdf5Error(Hdf5Error::Type_HdfFailure, "Could not create a H5T_COMPOUND type dataset named '" + name + "'");
+
+    p_->datasets[part] = d;
+    p_->h5.add<double>( partName ("samplerate", part), column_rate );
+    p_->h5.add<double>( partName ("offset", part), start_time );
+}
+
+
+void Hdf5Format::
+        write(int part, int channel, int first_column, int columns, int scales, const complex<float>* data)
+{
+    hid_t d = p_->datasets[part];
+    hsize_t start[3] = {hsize_t(channel), hsize_t(first_column), 0};
+    hsize_t count[3] = {1, hsize_t(columns), hsize_t(scales)};
+
+    hid_t filespace = H5Dget_space (d);
+    H5Sselect_hyperslab (filespace, H5S_SELECT_SET, start, 0, count, 0);
+    hid_t memspace = H5Screate_simple (3, count, 0);
+
+    herr_t status = H5Dwrite (d, p_->type, memspace, filespace, H5P_DEFAULT, data);
+    H5Sclose (memspace);
+    H5Sclose (filespace);
+    if (0>status) throw Hdf5Error(Hdf5Error::Type_HdfFailure, "Could not write to dataset '" + partName ("chunk", part) + "'");
+}
+
+
+void Hdf5Format::
+        close()
+{
+    p_.reset ();
+}
+
+
+void ChunkExportFilter::
+        operator()( Tfr::ChunkAndInverse& chunk )
+{
+    Tfr::CwtChunk* cwt = dynamic_cast<Tfr::CwtChunk*>(chunk.chunk.get ());
+
+    if (cwt)
+    {
+        for (size_t i=0; i<cwt->chunks.size (); i++)
+            export_->put (*cwt->chunks[i], i, chunk.channel);
+    }
+    else
+        export_->put (*chunk.chunk, 0, chunk.channel);
+}
+
+
+Tfr::pChunkFilter ChunkExportDesc::
+        createChunkFilter(Signal::ComputingEngine* engine) const
+{
+    if (engine==0 || dynamic_cast<Signal::ComputingCpu*>(engine))
+        return Tfr::pChunkFilter(new ChunkExportFilter(export_));
+    return Tfr::pChunkFilter();
+}
+
+
+Tfr::ChunkFilterDesc::ptr ChunkExportDesc::
+        copy() const
+{
+    return ChunkFilterDesc::ptr(new ChunkExportDesc(export_));
+}
+
+} // namespace Adapters
+
+#include <QDir>
+
+namespace Adapters {
+
+namespace {
+
+Tfr::pChunk testChunk(Signal::IntervalType offset, int samples, int scales, float sample_rate)
+{
+    Tfr::pChunk c(new Tfr::CwtChunkPart);
+    c->transform_data.reset (new Tfr::ChunkData(samples, scales, 1));
+    c->chunk_offset = offset;
+    c->first_valid_sample = 1;
+    c->n_valid_samples = samples - 2;
+    c->sample_rate = sample_rate;
+    c->original_sample_rate = 100;
+
+    // Row major, the value encodes its position in time and scale
+    complex<float>* p = c->transform_data->getCpuMemory ();
+    for (int f=0; f<scales; f++)
+        for (int x=0; x<samples; x++)
+            p[x + f*samples] = complex<float>(offset + x, f);
+    return c;
+}
+
+
+class FailingFormat: public ChunkExport::Format
+{
+public:
+    void create(int, int, int, int, float, double) override {}
+    void write(int, int, int, int, int, const complex<float>*) override { throw runtime_error("disk full"); }
+};
+
+} // namespace
+
+
+void ChunkExport::
+        test()
+{
+    // It should write chunks put in any order to one .npy file per part.
+    {
+        string filename = QDir::tempPath ().toStdString () + "/sonicawe-chunkexport-test.npy";
+
+        {
+            ChunkExport e(formatFromFilename (filename), Signal::Interval(0,100), 100, 2, 2);
+
+            // Valid samples [1,9) and [9,17) of part 0 and [1,5) of part 1
+            e.put (*testChunk (8, 10, 3, 100), 0, 1);
+            e.put (*testChunk (0, 10, 3, 100), 0, 0);
+            e.put (*testChunk (0, 6, 2, 50), 1, 0);
+            e.finish ();
+        }
+
+        ifstream f(filename.c_str (), ios::binary);
+        string content((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+
+        EXCEPTION_ASSERT_EQUALS(content.substr (1, 5), "NUMPY");
+        size_t header_size = 10 + (unsigned char)content[8] + 256*(unsigned char)content[9];
+        EXCEPTION_ASSERT_EQUALS(header_size % 64, 0u);
+        EXCEPTION_ASSERT(string::npos != content.find ("'shape': (2, 100, 3)"));
+        EXCEPTION_ASSERT_EQUALS(content.size (), header_size + 2*100*3*sizeof(complex<float>));
+
+        const complex<float>* p = (const complex<float>*)&content[header_size];
+        EXCEPTION_ASSERT_EQUALS(p[0*3 + 0], complex<float>(0, 0)); // not valid, not written
+        EXCEPTION_ASSERT_EQUALS(p[1*3 + 0], complex<float>(1, 0));
+        EXCEPTION_ASSERT_EQUALS(p[8*3 + 2], complex<float>(8, 2));
+        EXCEPTION_ASSERT_EQUALS(p[9*3 + 0], complex<float>(0, 0));
+        EXCEPTION_ASSERT_EQUALS(p[(100 + 9)*3 + 1], complex<float>(9, 1));
+        EXCEPTION_ASSERT_EQUALS(p[(100 + 16)*3 + 2], complex<float>(16, 2));
+        EXCEPTION_ASSERT_EQUALS(p[(100 + 17)*3 + 0], complex<float>(0, 0));
+
+        string filename1 = NpyFormat::partFilename (filename, 1);
+        EXCEPTION_ASSERT_EQUALS(filename1, QDir::tempPath ().toStdString () + "/sonicawe-chunkexport-test-1.npy");
+        ifstream f1(filename1.c_str (), ios::binary);
+        string content1((istreambuf_iterator<char>(f1)), istreambuf_iterator<char>());
+        EXCEPTION_ASSERT(string::npos != content1.find ("'shape': (2, 50, 2)"));
+
+        const complex<float>* p1 = (const complex<float>*)&content1[header_size];
+        EXCEPTION_ASSERT_EQUALS(p1[4*2 + 1], complex<float>(4, 1));
+
+        remove (filename.c_str ());
+        remove (filename1.c_str ());
+    }
+
+    // It should only write the samples within the interval.
+    {
+        string filename = QDir::tempPath ().toStdString () + "/sonicawe-chunkexport-test.npy";
+
+        {
+            ChunkExport e(formatFromFilename (filename), Signal::Interval(5,10), 100, 1);
+            e.put (*testChunk (0, 10, 1, 100), 0, 0);
+            e.put (*testChunk (8, 10, 1, 100), 0, 0);
+        }
+
+        ifstream f(filename.c_str (), ios::binary);
+        string content((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+        size_t header_size = 10 + (unsigned char)content[8] + 256*(unsigned char)content[9];
+        EXCEPTION_ASSERT_EQUALS(content.size (), header_size + 5*sizeof(complex<float>));
+
+        const complex<float>* p = (const complex<float>*)&content[header_size];
+        EXCEPTION_ASSERT_EQUALS(p[0], complex<float>(5, 0));
+        EXCEPTION_ASSERT_EQUALS(p[4], complex<float>(9, 0));
+
+        remove (filename.c_str ());
+    }
+
+    // It should report errors from the writer to the producer.
+    {
+        ChunkExport e(unique_ptr<Format>(new FailingFormat), Signal::Interval(0,100), 100, 1, 1);
+
+        bool failed = false;
+        try {
+            for (int i=0; i<10; i++)
+                e.put (*testChunk (i*8, 10, 1, 100), 0, 0);
+            e.finish ();
+        } catch (const runtime_error& x) {
+            failed = true;
+            EXCEPTION_ASSERT_EQUALS(string(x.what ()), "disk full");
+        }
+
+        EXCEPTION_ASSERT(failed);
+    }
+}
+
+} // namespace Adapters
@@ -0,0 +1,210 @@
+#ifndef ADAPTERS_CHUNKEXPORT_H
+#define ADAPTERS_CHUNKEXPORT_H
+
+#include "tfr/cwtfilter.h"
+#include "blocking_queue.h"
+
+#include <complex>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Adapters {
+
+/**
+ * @brief The ChunkExport class should write all chunks of an interval into
+ * one file while the chunks are being computed.
+ *
+ * Each part of a chunk (Tfr::CwtChunk has one part per octave band with its
+ * own sample rate and scales, other transforms have one part) is written to a
+ * dataset of its own with the shape [channels][columns][scales], where a
+ * column is a transform sample. Chunks may be put in any order, each block of
+ * columns is written at its position in time. Only valid samples are written.
+ *
+ * put copies the valid samples and hands them to a writer thread through a
+ * bounded queue. When the writer falls behind put blocks, which bounds the
+ * memory used by pending blocks. Errors from the writer are rethrown by the
+ * next put or by finish.
+ */
+class ChunkExport
+{
+public:
+    /**
+     * @brief The Format class writes blocks of complex values to a file. All
+     * calls are made from the writer thread.
+     */
+    class Format
+    {
+    public:
+        virtual ~Format() {}
+
+        /**
+         * @brief create is called once per part before the first block of
+         * that part is written. 'column_rate' is the number of columns per
+         * second.
+         */
+        virtual void create(int part, int channels, int columns, int scales, float column_rate, double start_time) = 0;
+
+        /**
+         * @brief write writes [columns][scales] values at 'first_column'.
+         */
+        virtual void write(int part, int channel, int first_column, int columns, int scales, const std::complex<float>* data) = 0;
+
+        /**
+         * @brief close is called once when all blocks have been written.
+         */
+        virtual void close() {}
+    };
+
+    /**
+     * @brief ChunkExport exports 'I', in samples of 'sample_rate', to 'format'.
+     * At most 'queue_capacity' blocks are pending at once.
+     */
+    ChunkExport(std::unique_ptr<Format> format, Signal::Interval I, float sample_rate, int channels, size_t queue_capacity=16);
+    ~ChunkExport();
+
+    /**
+     * @brief formatFromFilename returns a NpyFormat for names ending with
+     * ".npy" and a Hdf5Format otherwise. 'compression' is the deflate level
+     * for HDF5, 0 disables compression.
+     */
+    static std::unique_ptr<Format> formatFromFilename(std::string filename, int compression=0);
+
+    /**
+     * @brief put queues the valid samples of 'chunk'. 'part' is the index of
+     * the chunk in its Tfr::CwtChunk, or 0.
+     */
+    void put(Tfr::Chunk& chunk, int part, int channel);
+
+    /**
+     * @brief finish waits for all queued blocks to be written and closes the
+     * file. Throws if the writer failed.
+     */
+    void finish();
+
+private:
+    struct Block
+    {
+        int part;
+        int channel;
+        int columns_in_part;
+        int first_column;
+        int columns;
+        int scales;
+        float column_rate;
+        std::vector<std::complex<float> > data;
+    };
+
+    void writer();
+    void rethrow();
+
+    std::unique_ptr<Format> format_;
+    Signal::Interval I_;
+    float sample_rate_;
+    int channels_;
+    JustMisc::blocking_queue<std::shared_ptr<Block> > queue_;
+    std::mutex error_mutex_;
+    std::exception_ptr error_;
+    std::thread writer_;
+
+public:
+    static void test();
+};
+
+
+/**
+ * @brief The NpyFormat class writes each part to a NumPy .npy file (version
+ * 1.0, dtype complex64). Part 0 is written to 'filename' and part k to
+ * 'filename' with "-k" inserted before the suffix.
+ *
+ * The files are preallocated and blocks are written at their offset.
+ */
+class NpyFormat: public ChunkExport::Format
+{
+public:
+    NpyFormat(std::string filename);
+    ~NpyFormat();
+
+    void create(int part, int channels, int columns, int scales, float column_rate, double start_time) override;
+    void write(int part, int channel, int first_column, int columns, int scales, const std::complex<float>* data) override;
+    void close() override;
+
+    static std::string partFilename(std::string filename, int part);
+
+private:
+    struct File
+    {
+        std::shared_ptr<std::ofstream> f;
+        std::streamoff header_size;
+        int columns;
+        int scales;
+    };
+
+    std::string filename_;
+    std::vector<File> files_;
+};
+
+
+/**
+ * @brief The Hdf5Format class writes each part to the dataset "chunk" or
+ * "chunk<k>" in a HDF5 file, with the same compound type of "real" and "imag"
+ * as Hdf5Chunk but in single precision. The datasets are chunked with one
+ * HDF5 chunk per column range and optionally deflate compressed. The column
+ * rate and start time of each part are written to "samplerate<k>" and
+ * "offset<k>".
+ *
+ * Throws Hdf5Error on errors.
+ */
+class Hdf5Format: public ChunkExport::Format
+{
+public:
+    Hdf5Format(std::string filename, int compression=0);
+    ~Hdf5Format();
+
+    void create(int part, int channels, int columns, int scales, float column_rate, double start_time) override;
+    void write(int part, int channel, int first_column, int columns, int scales, const std::complex<float>* data) override;
+    void close() override;
+
+private:
+    struct Private;
+    std::unique_ptr<Private> p_;
+};
+
+
+/**
+ * @brief The ChunkExportFilter class puts each chunk in a ChunkExport.
+ */
+class ChunkExportFilter: public Tfr::ChunkFilter, public Tfr::ChunkFilter::NoInverseTag
+{
+public:
+    ChunkExportFilter(std::shared_ptr<ChunkExport> e) : export_(e) {}
+
+    void operator()( Tfr::ChunkAndInverse& chunk );
+
+private:
+    std::shared_ptr<ChunkExport> export_;
+};
+
+
+class ChunkExportDesc: public Tfr::CwtChunkFilterDesc {
+public:
+    ChunkExportDesc(std::shared_ptr<ChunkExport> e)
+        :
+          export_(e)
+    {}
+
+    // ChunkFilterDesc
+    Tfr::pChunkFilter       createChunkFilter(Signal::ComputingEngine* engine=0) const;
+    ChunkFilterDesc::ptr    copy() const;
+
+private:
+    std::shared_ptr<ChunkExport> export_;
+};
+
+} // namespace Adapters
+
+#endif // ADAPTERS_CHUNKEXPORT_H
@@ -0,0 +1,79 @@
+#ifndef ADAPTERS_CSVREADER_H
+#define ADAPTERS_CSVREADER_H
+
+#include "signal/buffer.h"
+
+#include <functional>
+#include <vector>
+
+namespace Adapters {
+
+/**
+ * @brief The CsvReader class should parse rows of delimiter separated values
+ * into a Signal::Buffer with one channel per column.
+ *
+ * Values are separated by blanks and at most one of ',', ';', ':' or '\t'.
+ * Lines end with "\n", "\r\n" or "\r". Lines that don't start with a number,
+ * such as headers, are skipped. The rest of a row is ignored after something
+ * that is not a number. Rows with fewer values than the widest row are padded
+ * with zeros.
+ *
+ * The text is split into newline aligned ranges of about 'range_bytes' that
+ * are parsed concurrently, first to count rows and columns and then to write
+ * values directly into the buffers. Numbers are parsed without locales or
+ * streams.
+ *
+ * The text is not copied and must remain valid during the lifetime of
+ * CsvReader, it is typically a memory mapped file.
+ */
+class CsvReader
+{
+public:
+    /**
+     * @brief CsvReader counts the rows and columns in [begin, end). 'threads'
+     * defaults to one per core.
+     */
+    CsvReader(const char* begin, const char* end, int threads=0, size_t range_bytes=1<<22);
+
+    Signal::IntervalType number_of_rows() const { return rows_; }
+    int number_of_channels() const { return channels_; }
+
+    /**
+     * @brief read parses all rows into a single buffer.
+     */
+    Signal::pBuffer read(float sample_rate) const;
+
+    /**
+     * @brief read parses the rows in consecutive buffers of about
+     * 'range_bytes' of text each and passes the buffers to 'sink' in order.
+     * At most 'threads' buffers are allocated at once which keeps the memory
+     * bounded regardless of the size of the text.
+     */
+    void read(float sample_rate, std::function<void(Signal::pBuffer)> sink) const;
+
+private:
+    struct range
+    {
+        const char* begin;
+        const char* end;
+        Signal::IntervalType first_row;
+        Signal::IntervalType rows;
+        int columns;
+    };
+
+    // Writes the rows of 'r' to out[channel][row - first_row]
+    void parse(const range& r, const std::vector<float*>& out, Signal::IntervalType first_row) const;
+    static std::vector<float*> channel_data(Signal::Buffer& b);
+
+    int threads_;
+    std::vector<range> ranges_;
+    Signal::IntervalType rows_;
+    int channels_;
+
+public:
+    static void test();
+};
+
+} // namespace Adapters
+
+#endif // ADAPTERS_CSVREADER_H
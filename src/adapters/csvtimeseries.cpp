@@ -1,10 +1,9 @@
 #include "csvtimeseries.h"
-#include "signal/sinksource.h"
+#include "csvreader.h"
 #include "tfr/cwt.h"
 
 #include "tasktimer.h"
 
-#include <fstream>
 #include <sstream>
 
 // Qt
@@ -13,7 +12,6 @@
 #include <QVector>
 #include <QFile>
 #include <QByteArray>
-#include <QTemporaryFile>
 
 using namespace std;
 using namespace Signal;
@@ -77,82 +75,34 @@ void CsvTimeseries::
 {
     TaskTimer tt("Loading '%s' (this=%p)", filename.c_str(), this);
 
-    std::ifstream ifs(filename.c_str(), ios_base::in);
-    if (!ifs.is_open())
+    QFile file(QString::fromLocal8Bit( filename.c_str() ));
+    if (!file.open(QIODevice::ReadOnly))
         throw std::ios_base::failure("Couldn't open file: " + filename);
 
-    float sample_rate = 1;
-    //ifs >> sample_rate >> std::endl;
-
-    SinkSource ssc(0);
-    int chunk = 1 << 18;
-    Signal::pBuffer chunkBuffers;
-    std::vector<float*> p;
-
-    for (int bufferCount, channel, line=0; ifs.good();)
+    // Parse straight from the page cache if the file can be mapped
+    const char* data = 0 < file.size () ? (const char*)file.map (0, file.size ()) : 0;
+    if (data)
     {
-        for (bufferCount = 0; bufferCount < chunk; ++bufferCount, ++line )
-        {
-            for (channel=0; ; ++channel)
-            {
-                if (channel >= (int)ssc.num_channels ())
-                {
-                    ssc = SinkSource( channel + 1 );
-                    Signal::pBuffer nb(new Signal::Buffer(Signal::Interval(0, chunk), sample_rate, channel+1));
-                    for (int i=0;i<channel; i++)
-                        *nb->getChannel (i) |= *chunkBuffers->getChannel (i);
-
-                    chunkBuffers = nb;
-
-                    p.resize( channel + 1 );
-                    p.back() = chunkBuffers->getChannel (channel)->waveform_data()->getCpuMemory();
-                }
-
-                ifs >> p[channel][bufferCount];
-
-                // Eat whitespace
-                while (ifs.peek () == ' ')
-                    ifs.get ();
-
-                int n = ifs.get ();
-                if (n == ',' || n == ';' || n == ':' || n == '\t')
-                    n = ifs.get (); // Eat delimiter if any
-
-                if (n == '\n')
-                    break; // Continue on new row
-                if (n == '\r')
-                {
-                    if (ifs.peek() == '\n')
-                        ifs.get();
-                    break; // Continue on new row
-                }
-                if (!ifs.good())
-                    break; // Couldn't read further
-
-                ifs.putback (n);
-
-                // Continue to read same row
-            }
-
-            // Couldn't read further
-            if (!ifs.good()) {
-                // Did read something on last row?
-                if (channel>0) {
-                    bufferCount++;
-                    line++;
-                }
-                break;
-            }
-        }
-
-        if (0 < bufferCount)
-            ssc.put (BufferSource(chunkBuffers).readFixedLength (Interval(line-bufferCount,line)));
+        load(data, data + file.size (), filename);
+        return;
     }
 
-    if (ssc.empty())
-        throw std::ios_base::failure("Couldn't read any CSV data from '" + filename + "'");
+    QByteArray bytes = file.readAll();
+    load(bytes.constData (), bytes.constData () + bytes.size (), filename);
+}
 
-    setBuffer( ssc.readFixedLength( ssc.getInterval() ) );
+
+void CsvTimeseries::
+        load(const char* begin, const char* end, std::string name)
+{
+    float sample_rate = 1;
+    //ifs >> sample_rate >> std::endl;
+
+    CsvReader reader(begin, end);
+    if (0 == reader.number_of_rows ())
+        throw std::ios_base::failure("Couldn't read any CSV data from '" + name + "'");
+
+    setBuffer( reader.read (sample_rate) );
 
     // TODO adjust default wanted min hz to sample rate of opened signal
     //Tfr::Cwt::Singleton().set_wanted_min_hz( sample_rate/1000 );
@@ -180,19 +130,11 @@ std::vector<char> CsvTimeseries::
 
 
 void CsvTimeseries::
-        load( std::vector<char>rawFileData)
+        load(const std::vector<char>& rawFileData)
 {
-    TaskInfo ti("Audiofile::load(rawFile)");
+    TaskInfo ti("CsvTimeseries::load(rawFile)");
 
-    QTemporaryFile file;
-    if (!file.open())
-        throw std::ios_base::failure("Couldn't create raw data");
-
-    std::string filename = file.fileName().toStdString();
-    file.write(QByteArray::fromRawData(&rawFileData[0], rawFileData.size()));
-    file.close();
-
-    load(filename);
+    load(rawFileData.data (), rawFileData.data () + rawFileData.size (), _original_relative_filename);
 }
 
 } // namespace Adapters
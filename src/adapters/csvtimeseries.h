@@ -60,7 +60,8 @@ private:
 
     std::vector<char> rawdata;
     static std::vector<char> getRawFileData(std::string filename);
-    void load(std::vector<char> rawFileData);
+    void load(const std::vector<char>& rawFileData);
+    void load(const char* begin, const char* end, std::string name);
 
     friend class boost::serialization::access;
     template<class archive> void serialize(archive& ar, const unsigned int /*version*/) {
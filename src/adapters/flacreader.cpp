@@ -0,0 +1,673 @@
+#include "flacreader.h"
+
+#ifdef USE_FLAC
+
+#include "exceptionassert.h"
+#include "tasktimer.h"
+
+#include <FLAC/stream_decoder.h>
+
+#include <QDateTime>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <ios>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+using namespace std;
+using namespace Signal;
+
+namespace Adapters {
+
+namespace {
+
+const char index_magic[8] = {'S','A','W','E','F','L','I','X'};
+const uint32_t index_version = 1;
+
+
+struct IndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t file_size;
+    int64_t file_modified;
+    uint64_t number_of_samples;
+    uint64_t frame_count;
+};
+
+
+uint8_t crc8(const unsigned char* p, size_t n)
+{
+    // x^8 + x^2 + x + 1
+    uint8_t crc = 0;
+    for (size_t i=0; i<n; ++i)
+    {
+        crc ^= p[i];
+        for (int b=0; b<8; ++b)
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+
+const uint16_t* crc16_table()
+{
+    // x^16 + x^15 + x^2 + 1
+    static struct Table
+    {
+        Table()
+        {
+            for (unsigned i=0; i<256; ++i)
+            {
+                uint16_t crc = i << 8;
+                for (int b=0; b<8; ++b)
+                    crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x8005) : (uint16_t)(crc << 1);
+                v[i] = crc;
+            }
+        }
+
+        uint16_t v[256];
+    } table;
+
+    return table.v;
+}
+
+
+struct FrameHeader
+{
+    uint64_t number; // frame number, or sample number if 'variable'
+    bool variable;
+    unsigned blocksize;
+};
+
+
+/**
+ * Parses the frame header at 'p'. Returns false if it isn't a frame header
+ * with a matching CRC-8.
+ */
+bool parseFrameHeader(const unsigned char* p, const unsigned char* end, FrameHeader& h)
+{
+    if (end - p < 6 || 0xFF != p[0] || 0xF8 != (p[1] & 0xFE))
+        return false;
+
+    h.variable = p[1] & 1;
+    unsigned blocksize_code = p[2] >> 4;
+    unsigned sample_rate_code = p[2] & 0xF;
+    unsigned channel_code = p[3] >> 4;
+    unsigned sample_size_code = (p[3] >> 1) & 7;
+
+    if (0 == blocksize_code || 15 == sample_rate_code || 10 < channel_code || 3 == sample_size_code || (p[3] & 1))
+        return false;
+
+    // UTF-8 coded frame or sample number
+    const unsigned char* q = p + 4;
+    unsigned extra;
+    if (!(*q & 0x80))             { h.number = *q;        extra = 0; }
+    else if (0xC0 == (*q & 0xE0)) { h.number = *q & 0x1F; extra = 1; }
+    else if (0xE0 == (*q & 0xF0)) { h.number = *q & 0x0F; extra = 2; }
+    else if (0xF0 == (*q & 0xF8)) { h.number = *q & 0x07; extra = 3; }
+    else if (0xF8 == (*q & 0xFC)) { h.number = *q & 0x03; extra = 4; }
+    else if (0xFC == (*q & 0xFE)) { h.number = *q & 0x01; extra = 5; }
+    else if (0xFE == *q)          { h.number = 0;         extra = 6; }
+    else return false;
+
+    if (end - q < (ptrdiff_t)extra + 4)
+        return false;
+
+    for (++q; extra; --extra, ++q)
+    {
+        if (0x80 != (*q & 0xC0))
+            return false;
+        h.number = (h.number << 6) | (*q & 0x3F);
+    }
+
+    switch (blocksize_code)
+    {
+    case 1: h.blocksize = 192; break;
+    case 6: h.blocksize = q[0] + 1; q += 1; break;
+    case 7: h.blocksize = (q[0] << 8 | q[1]) + 1; q += 2; break;
+    default:
+        h.blocksize = blocksize_code < 6
+                ? 576 << (blocksize_code - 2)
+                : 256 << (blocksize_code - 8);
+    }
+
+    if (12 == sample_rate_code)
+        q += 1;
+    else if (13 == sample_rate_code || 14 == sample_rate_code)
+        q += 2;
+
+    return q < end && crc8 (p, q - p) == *q;
+}
+
+} // namespace
+
+
+/**
+ * @brief The Decoder struct should decode runs of frames from the mapped
+ * file with libFLAC.
+ */
+struct FlacReader::Decoder
+{
+    Decoder(const unsigned char* data, uint64_t size, unsigned num_channels, unsigned bits_per_sample)
+        :
+          decoder(FLAC__stream_decoder_new ()),
+          data(data),
+          size(size),
+          pos(0),
+          channels(0),
+          num_channels(num_channels),
+          scale(1.f / (1u << (bits_per_sample - 1))),
+          sample(0),
+          written(false),
+          failed(false)
+    {
+        EXCEPTION_ASSERT(decoder);
+        FLAC__stream_decoder_set_md5_checking (decoder, false);
+
+        FLAC__StreamDecoderInitStatus status = FLAC__stream_decoder_init_stream (
+                    decoder, &Decoder::read_callback, 0, 0, 0, 0,
+                    &Decoder::write_callback, 0, &Decoder::error_callback, this);
+        EXCEPTION_ASSERT_EQUALS(status, FLAC__STREAM_DECODER_INIT_STATUS_OK);
+
+        // Read STREAMINFO once, frames are then decoded from any offset
+        failed = !FLAC__stream_decoder_process_until_end_of_metadata (decoder);
+    }
+
+    ~Decoder()
+    {
+        FLAC__stream_decoder_delete (decoder);
+    }
+
+    /**
+     * Decodes frames[first, last) and writes the samples within 'I'.
+     */
+    bool decode(const vector<Frame>& frames, size_t first, size_t last, const Interval& I, float* const* out)
+    {
+        target = I;
+        channels = out;
+        pos = frames[first].offset;
+
+        if (failed || !FLAC__stream_decoder_flush (decoder))
+            return false;
+
+        for (size_t k=first; k<last; ++k)
+        {
+            sample = frames[k].first_sample;
+            written = false;
+            if (!FLAC__stream_decoder_process_single (decoder) || !written || failed)
+            {
+                failed = true;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static FLAC__StreamDecoderReadStatus read_callback(const FLAC__StreamDecoder*, FLAC__byte buffer[], size_t* bytes, void* client_data)
+    {
+        Decoder* d = (Decoder*)client_data;
+        size_t n = (size_t)min<uint64_t>(*bytes, d->size - d->pos);
+        memcpy (buffer, d->data + d->pos, n);
+        d->pos += n;
+        *bytes = n;
+        return 0 == n ? FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM : FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+    }
+
+    static FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder*, const FLAC__Frame* frame, const FLAC__int32* const buffer[], void* client_data)
+    {
+        Decoder* d = (Decoder*)client_data;
+        if (frame->header.channels != d->num_channels)
+            return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+
+        // The decoder is always flushed before a run of frames, so frames come
+        // in the order of the index
+        Interval F(d->sample, d->sample + frame->header.blocksize);
+        Interval J = F & d->target;
+        for (unsigned c=0; c<d->num_channels; ++c)
+        {
+            const FLAC__int32* in = buffer[c] + (J.first - F.first);
+            float* out = d->channels[c] + (J.first - d->target.first);
+            for (IntervalType i=0; i<(IntervalType)J.count (); ++i)
+                out[i] = in[i] * d->scale;
+        }
+
+        d->written = true;
+        return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+    }
+
+    static void error_callback(const FLAC__StreamDecoder*, FLAC__StreamDecoderErrorStatus status, void* client_data)
+    {
+        Decoder* d = (Decoder*)client_data;
+        TaskInfo("FlacReader: %s at byte %llu", FLAC__StreamDecoderErrorStatusString[status], (unsigned long long)d->pos);
+        d->failed = true;
+    }
+
+    FLAC__StreamDecoder* decoder;
+    const unsigned char* data;
+    uint64_t size;
+    uint64_t pos;
+
+    Interval target;
+    float* const* channels;
+    unsigned num_channels;
+    float scale;
+    uint64_t sample;
+    bool written;
+    bool failed;
+};
+
+
+FlacReader::
+        FlacReader(string filename, bool persist_index, int threads)
+    :
+      file_(filename.c_str ()),
+      data_(0),
+      size_(0),
+      first_frame_(0),
+      min_blocksize_(0),
+      num_channels_(0),
+      bits_per_sample_(0),
+      sample_rate_(0),
+      number_of_samples_(0),
+      threads_(0 < threads ? threads : max(1u, thread::hardware_concurrency ()))
+{
+    if (!file_.open (QIODevice::ReadOnly))
+        throw ios_base::failure("Couldn't open '" + filename + "'");
+
+    size_ = file_.size ();
+    data_ = file_.map (0, size_);
+    if (!data_)
+        throw ios_base::failure("Couldn't map '" + filename + "'");
+
+    readStreamInfo ();
+
+    string indexfile = indexFilename (filename);
+    if (!loadIndex (indexfile))
+    {
+        buildIndex ();
+        if (persist_index)
+            saveIndex (indexfile);
+    }
+}
+
+
+FlacReader::
+        ~FlacReader()
+{
+    decoders_.clear ();
+}
+
+
+string FlacReader::
+        indexFilename(string filename)
+{
+    return filename + ".seekindex";
+}
+
+
+IntervalType FlacReader::
+        read(const Interval& I, float* const* channels)
+{
+    if (I.first < 0 || number_of_samples_ <= I.first || frames_.empty ())
+        return 0;
+
+    Interval J = I & Interval(0, number_of_samples_);
+    size_t first = frameAt (J.first);
+    size_t last = frameAt (J.last - 1) + 1;
+    size_t n = last - first;
+
+    // A few runs per thread keeps the threads busy if some frames take longer
+    size_t runs = min(n, (size_t)threads_*4);
+    int threads = (int)min(runs, (size_t)threads_);
+    auto run_begin = [first, n, runs](size_t r) { return first + r*n/runs; };
+
+    lock_guard<mutex> l(decoders_lock_);
+    for (unsigned k=0; k<decoders_.size (); ++k)
+        if (decoders_[k]->failed)
+            decoders_[k].reset (new Decoder(data_, size_, num_channels_, bits_per_sample_));
+    while ((int)decoders_.size () < threads)
+        decoders_.emplace_back (new Decoder(data_, size_, num_channels_, bits_per_sample_));
+
+    vector<char> ok(runs, 0);
+    atomic<size_t> next {0};
+    auto worker = [&](int k)
+    {
+        for (size_t r; (r = next++) < runs;)
+            ok[r] = decoders_[k]->decode (frames_, run_begin (r), run_begin (r+1), J, channels);
+    };
+
+    vector<thread> t;
+    for (int k=1; k<threads; k++)
+        t.push_back (thread(worker, k));
+
+    worker (0);
+
+    for (thread& k : t)
+        k.join ();
+
+    for (size_t r=0; r<runs; ++r)
+        if (!ok[r])
+            return max<IntervalType>(0, frames_[run_begin (r)].first_sample - I.first);
+
+    return J.last - I.first;
+}
+
+
+void FlacReader::
+        readStreamInfo()
+{
+    const unsigned char* p = data_;
+    uint64_t i = 0;
+    string filename = file_.fileName ().toStdString ();
+
+    // Skip an ID3v2 tag
+    if (10 <= size_ && 0 == memcmp (p, "ID3", 3))
+        i = 10 + ((p[5] & 0x10) ? 10 : 0) + (p[6] << 21 | p[7] << 14 | p[8] << 7 | p[9]);
+
+    if (size_ < i + 4 || 0 != memcmp (p + i, "fLaC", 4))
+        throw ios_base::failure("'" + filename + "' is not a FLAC file");
+    i += 4;
+
+    bool has_streaminfo = false;
+    for (bool last = false; !last;)
+    {
+        if (size_ < i + 4)
+            throw ios_base::failure("'" + filename + "' ends within the metadata");
+
+        last = p[i] & 0x80;
+        unsigned type = p[i] & 0x7F;
+        uint64_t length = p[i+1] << 16 | p[i+2] << 8 | p[i+3];
+        i += 4;
+
+        if (size_ < i + length)
+            throw ios_base::failure("'" + filename + "' ends within the metadata");
+
+        if (0 == type && 34 <= length)
+        {
+            const unsigned char* s = p + i;
+            min_blocksize_ = s[0] << 8 | s[1];
+            sample_rate_ = s[10] << 12 | s[11] << 4 | s[12] >> 4;
+            num_channels_ = ((s[12] >> 1) & 7) + 1;
+            bits_per_sample_ = ((s[12] & 1) << 4 | s[13] >> 4) + 1;
+            number_of_samples_ = (IntervalType)((uint64_t)(s[13] & 0xF) << 32 |
+                                                (uint64_t)s[14] << 24 | s[15] << 16 | s[16] << 8 | s[17]);
+            has_streaminfo = true;
+        }
+
+        i += length;
+    }
+
+    if (!has_streaminfo || 0 == sample_rate_)
+        throw ios_base::failure("'" + filename + "' doesn't have any STREAMINFO");
+
+    first_frame_ = i;
+}
+
+
+void FlacReader::
+        buildIndex()
+{
+    TaskTimer tt("FlacReader: indexing '%s'", file_.fileName ().toStdString ().c_str ());
+
+    const unsigned char* p = data_;
+    const unsigned char* end = data_ + size_;
+    const uint16_t* table = crc16_table ();
+
+    frames_.clear ();
+
+    FrameHeader h;
+    if (!parseFrameHeader (p + first_frame_, end, h) || 0 != h.number)
+        throw ios_base::failure("'" + file_.fileName ().toStdString () + "' doesn't start with a FLAC frame");
+
+    frames_.push_back (Frame{0, first_frame_});
+    uint64_t sample = h.blocksize;
+
+    // A frame ends with the CRC-16 of the frame, so the CRC-16 of all bytes
+    // since the start of the frame is zero right after it. Only check for a
+    // frame header at such positions, and require the next frame number.
+    uint16_t crc = 0;
+    for (uint64_t i=first_frame_; i<size_; ++i)
+    {
+        if (0 == crc && frames_.back ().offset + 1 < i && 0xFF == p[i] && parseFrameHeader (p + i, end, h))
+        {
+            bool expected = h.variable ? h.number == sample : h.number == frames_.size ();
+            if (expected)
+            {
+                frames_.push_back (Frame{sample, i});
+                sample += h.blocksize;
+            }
+        }
+
+        crc = (uint16_t)(crc << 8) ^ table[(crc >> 8) ^ p[i]];
+    }
+
+    if (0 == number_of_samples_)
+        number_of_samples_ = sample;
+
+    tt.info("%llu frames, %llu samples", (unsigned long long)frames_.size (), (unsigned long long)sample);
+}
+
+
+bool FlacReader::
+        loadIndex(const string& indexfile)
+{
+    ifstream f(indexfile.c_str (), ios_base::binary);
+    if (!f)
+        return false;
+
+    IndexHeader h;
+    if (!f.read ((char*)&h, sizeof(h)))
+        return false;
+
+    QFileInfo fi(file_);
+    if (0 != memcmp (h.magic, index_magic, sizeof(index_magic)) ||
+        h.version != index_version ||
+        h.file_size != size_ ||
+        h.file_modified != fi.lastModified ().toMSecsSinceEpoch () ||
+        0 == h.frame_count)
+    {
+        return false;
+    }
+
+    vector<Frame> frames(h.frame_count);
+    if (!f.read ((char*)&frames[0], frames.size ()*sizeof(Frame)))
+        return false;
+
+    if (frames[0].offset != first_frame_ || size_ <= frames.back ().offset)
+        return false;
+
+    frames_.swap (frames);
+    number_of_samples_ = h.number_of_samples;
+    return true;
+}
+
+
+void FlacReader::
+        saveIndex(const string& indexfile) const
+{
+    IndexHeader h;
+    memcpy (h.magic, index_magic, sizeof(index_magic));
+    h.version = index_version;
+    h.reserved = 0;
+    h.file_size = size_;
+    h.file_modified = QFileInfo(file_).lastModified ().toMSecsSinceEpoch ();
+    h.number_of_samples = number_of_samples_;
+    h.frame_count = frames_.size ();
+
+    ofstream f(indexfile.c_str (), ios_base::binary | ios_base::trunc);
+    f.write ((const char*)&h, sizeof(h));
+    f.write ((const char*)&frames_[0], frames_.size ()*sizeof(Frame));
+
+    if (!f)
+    {
+        // Probably a read-only directory, the index is rebuilt next time
+        TaskInfo("FlacReader: couldn't save '%s'", indexfile.c_str ());
+        f.close ();
+        ::remove (indexfile.c_str ());
+    }
+}
+
+
+size_t FlacReader::
+        frameAt(uint64_t sample) const
+{
+    auto i = upper_bound (frames_.begin (), frames_.end (), sample,
+                          [](uint64_t s, const Frame& f) { return s < f.first_sample; });
+    return max<ptrdiff_t>(0, (i - frames_.begin ()) - 1);
+}
+
+} // namespace Adapters
+
+#include "neat_math.h" // defines __int64_t which is expected by sndfile.h
+#include "trace_perf.h"
+
+#include <sndfile.hh>
+
+#include <QDir>
+
+#include <cmath>
+#include <random>
+
+namespace Adapters {
+
+void FlacReader::
+        test()
+{
+    // It should read any interval of a FLAC file with the same result as
+    // libsndfile, with a seek index built on first open.
+    {
+        const int fs = 44100, C = 2, N = 5*60*fs;
+        string filename = (QDir::tempPath () + "/flacreadertest.flac").toStdString ();
+        ::remove (filename.c_str ());
+        ::remove (indexFilename (filename).c_str ());
+
+        {
+            SndfileHandle w(filename, SFM_WRITE, SF_FORMAT_FLAC | SF_FORMAT_PCM_16, C, fs);
+            EXCEPTION_ASSERT(w);
+
+            mt19937 rnd(1);
+            normal_distribution<float> noise(0, 0.01f);
+            vector<float> block(C*fs);
+            for (int i=0; i<N; i+=fs)
+            {
+                for (int j=0; j<fs; ++j)
+                    for (int c=0; c<C; ++c)
+                        block[j*C + c] = 0.5f*sin((i+j)*(c+1)*0.01f) + noise(rnd);
+                w.writef (&block[0], fs);
+            }
+        }
+
+        unique_ptr<FlacReader> r;
+        {
+            TRACE_PERF("FlacReader should index a 5 minute FLAC file");
+            r.reset (new FlacReader(filename));
+        }
+
+        EXCEPTION_ASSERT_EQUALS(r->number_of_samples (), N);
+        EXCEPTION_ASSERT_EQUALS(r->num_channels (), (unsigned)C);
+        EXCEPTION_ASSERT_EQUALS(r->sample_rate (), fs);
+        EXCEPTION_ASSERT(QFileInfo(indexFilename (filename).c_str ()).exists ());
+
+        {
+            TRACE_PERF("FlacReader should open an indexed FLAC file");
+            FlacReader r2(filename);
+            EXCEPTION_ASSERT_EQUALS(r2.frames ().size (), r->frames ().size ());
+            EXCEPTION_ASSERT_EQUALS(r2.frames ().back ().offset, r->frames ().back ().offset);
+        }
+
+        SndfileHandle s(filename);
+        mt19937 rnd(2);
+        uniform_int_distribution<int> position(-1000, N);
+        const int L = 4096;
+        vector<float> a(C*L), interleaved(C*L);
+        float* channels[] = {&a[0], &a[L]};
+
+        for (int k=0; k<20; ++k)
+        {
+            int first = max(0, position (rnd));
+            IntervalType n = r->read (Interval(first, first + L), channels);
+            EXCEPTION_ASSERT_EQUALS(n, min(L, N - first));
+
+            s.seek (first, SEEK_SET);
+            EXCEPTION_ASSERT_EQUALS(s.readf (&interleaved[0], n), n);
+            float d = 0;
+            for (int j=0; j<n; ++j)
+                for (int c=0; c<C; ++c)
+                    d = max(d, fabs(channels[c][j] - interleaved[j*C + c]));
+            EXCEPTION_ASSERT_LESS(d, 1e-6f);
+        }
+
+        // Random seeks
+        {
+            TRACE_PERF("FlacReader should read 100 random positions");
+
+            for (int k=0; k<100; ++k)
+            {
+                int first = max(0, position (rnd));
+                r->read (Interval(first, first + L), channels);
+            }
+
+            trace_perf_.reset ("libsndfile should read 100 random positions");
+
+            for (int k=0; k<100; ++k)
+            {
+                int first = max(0, position (rnd));
+                s.seek (first, SEEK_SET);
+                s.readf (&interleaved[0], L);
+            }
+        }
+
+        // Sequential decoding
+        {
+            const int M = 1<<20;
+            vector<float> c0(M), c1(M), all(C*M);
+            float* out[] = {&c0[0], &c1[0]};
+
+            TRACE_PERF("FlacReader should decode a 5 minute FLAC file");
+
+            for (int i=0; i<N; i+=M)
+                r->read (Interval(i, i + M), out);
+
+            trace_perf_.reset ("libsndfile should decode a 5 minute FLAC file");
+
+            s.seek (0, SEEK_SET);
+            for (int i=0; i<N; i+=M)
+                s.readf (&all[0], M);
+        }
+
+        r.reset ();
+        ::remove (filename.c_str ());
+        ::remove (indexFilename (filename).c_str ());
+    }
+
+    // It should throw if the file isn't a FLAC file.
+    {
+        string filename = (QDir::tempPath () + "/flacreadertest.wav").toStdString ();
+        {
+            SndfileHandle w(filename, SFM_WRITE, SF_FORMAT_WAV | SF_FORMAT_PCM_16, 1, 44100);
+            float x[100] = {0};
+            w.writef (x, 100);
+        }
+
+        bool threw = false;
+        try {
+            FlacReader r(filename, false);
+        } catch (const ios_base::failure&) {
+            threw = true;
+        }
+        EXCEPTION_ASSERT(threw);
+
+        ::remove (filename.c_str ());
+    }
+}
+
+} // namespace Adapters
+
+#endif // USE_FLAC
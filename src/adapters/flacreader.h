@@ -0,0 +1,99 @@
+#ifndef ADAPTERS_FLACREADER_H
+#define ADAPTERS_FLACREADER_H
+
+#ifdef USE_FLAC
+
+#include "signal/intervals.h"
+
+#include <QFile>
+
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Adapters {
+
+/**
+ * @brief The FlacReader class should read any interval of a FLAC file
+ * without decoding anything before it.
+ *
+ * The file is memory-mapped and scanned for frame headers when opened. Each
+ * frame is verified with its CRCs. The resulting seek index, the first sample
+ * and byte offset of every frame, is saved next to the file as
+ * '<filename>.seekindex' and reused as long as the file size and
+ * modification time match.
+ *
+ * Frames are independent, read decodes consecutive runs of frames on up to
+ * 'threads' threads with one libFLAC decoder each.
+ */
+class FlacReader
+{
+public:
+    struct Frame
+    {
+        uint64_t first_sample;
+        uint64_t offset;
+    };
+
+    /**
+     * @brief FlacReader opens 'filename'. Throws std::ios_base::failure if it
+     * isn't a FLAC file. The seek index is only saved if 'persist_index' is
+     * true.
+     * @param threads Defaults to one per core.
+     */
+    FlacReader(std::string filename, bool persist_index=true, int threads=0);
+    FlacReader(const FlacReader&) = delete;
+    FlacReader& operator=(const FlacReader&) = delete;
+    ~FlacReader();
+
+    Signal::IntervalType number_of_samples() const { return number_of_samples_; }
+    unsigned num_channels() const { return num_channels_; }
+    float sample_rate() const { return sample_rate_; }
+    const std::vector<Frame>& frames() const { return frames_; }
+
+    /**
+     * @brief read decodes the samples in 'I' to channels[c][i - I.first].
+     * @return the number of samples read from I.first, fewer than I.count()
+     * if the file ends or can't be decoded.
+     */
+    Signal::IntervalType read(const Signal::Interval& I, float* const* channels);
+
+    static std::string indexFilename(std::string filename);
+
+private:
+    struct Decoder;
+
+    void readStreamInfo();
+    void buildIndex();
+    bool loadIndex(const std::string& indexfile);
+    void saveIndex(const std::string& indexfile) const;
+    size_t frameAt(uint64_t sample) const;
+
+    QFile file_;
+    const unsigned char* data_;
+    uint64_t size_;
+    uint64_t first_frame_;
+
+    unsigned min_blocksize_;
+    unsigned num_channels_;
+    unsigned bits_per_sample_;
+    float sample_rate_;
+    Signal::IntervalType number_of_samples_;
+
+    std::vector<Frame> frames_;
+
+    int threads_;
+    std::mutex decoders_lock_;
+    std::vector<std::unique_ptr<Decoder>> decoders_;
+
+public:
+    static void test();
+};
+
+} // namespace Adapters
+
+#endif // USE_FLAC
+
+#endif // ADAPTERS_FLACREADER_H
@@ -1,7 +1,9 @@
 #include "matlabfunction.h"
+#include "matlabsharedmemory.h"
 
 // gpumisc
 #include "tasktimer.h"
+#include "exceptionassert.h"
 
 // qt
 #include <QtCore> // QSettings, QDir, QTemporaryFile, QFileInfo
@@ -141,7 +143,7 @@ bool startProcess(QProcess* pid, const QStringList& names, const QStringList& ar
 
 
 MatlabFunction::
-        MatlabFunction( string f, float timeout, MatlabFunctionSettings* settings )
+        MatlabFunction( string f, float timeout, MatlabFunctionSettings* settings, Interop interop )
 :   _pid(0),
     _hasCrashed(false),
     _timeout( timeout )
@@ -149,7 +151,7 @@ MatlabFunction::
     _matlab_filename = QFileInfo(f.c_str()).fileName().toStdString();
     _matlab_function = QFileInfo(f.c_str()).baseName().toStdString();
 
-    init(f, settings);
+    init(f, settings, false, true, interop);
 }
 
 
@@ -169,7 +171,7 @@ MatlabFunction::
 
 
 void MatlabFunction::
-        init(string fullpath, MatlabFunctionSettings* settings, bool justtest, bool sendoutput)
+        init(string fullpath, MatlabFunctionSettings* settings, bool justtest, bool sendoutput, Interop interop)
 {
     { // Set filenames
         QTemporaryFile tempFile(QDir::tempPath() + QDir::separator() + "saweinterop.XXXXXX");
@@ -220,6 +222,21 @@ void MatlabFunction::
             QErrorMessage::qtHandler()->showMessage("Couldn't locate required Sonic AWE scripts");
         }
 
+        if (Interop_SharedMemory == interop && sendoutput && !justtest && !fullpath.empty() &&
+            MatlabSharedMemory::isSupported() &&
+            QFileInfo(QString::fromStdString(scriptpath) + "/sawe_shm.oct").exists())
+        {
+            try
+            {
+                // Only Octave can load sawe_shm.oct, matlab uses files
+                _shm.reset( new MatlabSharedMemory("/" + QFileInfo(_interopName).fileName().toStdString()) );
+            }
+            catch (const std::runtime_error& x)
+            {
+                TaskInfo("MatlabFunction: %s. Using files instead", x.what());
+            }
+        }
+
         if (fullpath.empty())
         {
 
@@ -254,8 +271,11 @@ void MatlabFunction::
                     << "source('" << filename << "');"
                     << "addpath('" << path << "');"
                     << "f=@" << _matlab_function << ";"
-                    << "catch;exit;end;"
-                    << "sawe_filewatcher('" << _dataFile << "',f";
+                    << "catch;exit;end;";
+            if (_shm)
+                octave_command << "sawe_shmwatcher('" << _shm->name() << "',f";
+            else
+                octave_command << "sawe_filewatcher('" << _dataFile << "',f";
 
             string arguments = settings ? settings->arguments() : "";
 
@@ -311,7 +331,10 @@ void MatlabFunction::
                     matlab_names.push_back(matlabpath);
                     matlab_names.push_back("matlab");
                     if (startProcess(_pid, matlab_names, matlab_args))
+                    {
+                        _shm.reset();
                         return;
+                    }
 
                     TaskInfo("Couldn't start MATLAB");
                 }
@@ -339,7 +362,10 @@ void MatlabFunction::
             matlab_paths.push_back("C:\\Program Files (x86)\\MATLAB\\R2008b\\bin\\matlab.exe");
 
             if (startProcess(_pid, matlab_paths, matlab_args))
+            {
+                _shm.reset();
                 return;
+            }
 
             TaskInfo("Couldn't start Matlab");
         }
@@ -362,6 +388,7 @@ void MatlabFunction::
 #endif
         delete _pid;
         _pid = 0;
+        _shm.reset();
     }
 }
 
@@ -416,9 +443,28 @@ void MatlabFunction::
 }
 
 
+void MatlabFunction::
+        invoke( const Signal::Buffer& b, double overlap )
+{
+    if (0==_pid)
+    {
+        TIME_MatlabFunction TaskTimer tt("Matlab/octave failed, ignoring.");
+        return;
+    }
+
+    TIME_MatlabFunction TaskInfo("Invoking octave through shared memory.");
+
+    EXCEPTION_ASSERT(_shm);
+    _shm->send(b, overlap);
+}
+
+
 bool MatlabFunction::
         isWaiting()
 {
+    if (_shm)
+        return 0==_pid || _shm->isWaiting();
+
     struct stat dummy;
     return 0==_pid || (isReady().empty() && 0==stat( _dataFile.c_str(),&dummy));
 }
@@ -427,6 +473,9 @@ bool MatlabFunction::
 string MatlabFunction::
         isReady()
 {
+    if (_shm)
+        return 0!=_pid && _shm->isReady() ? _shm->name() : "";
+
     struct stat dummy;
     if ( 0!=_pid && 0==stat( _resultFile.c_str(),&dummy) )
     {
@@ -444,6 +493,14 @@ string MatlabFunction::
     boost::scoped_ptr<TaskTimer> tt;
     TIME_MatlabFunction tt.reset( new TaskTimer("Waiting for matlab/octave."));
 
+    if (_shm)
+    {
+        // Blocks on the reply semaphore instead of polling
+        if (0==_pid || !_shm->waitForReady(_timeout))
+            abort(); // throws
+        return _shm->name();
+    }
+
     // Wait for result to be written
     time_duration timeout(0, 0, _timeout,fmod(_timeout,1.f));
     ptime start = second_clock::local_time();
@@ -470,6 +527,13 @@ string MatlabFunction::
 }
 
 
+MatlabSharedMemory* MatlabFunction::
+        sharedMemory()
+{
+    return _shm.get();
+}
+
+
 bool MatlabFunction::
         hasProcessEnded()
 {
@@ -6,14 +6,20 @@
 
 // boost
 #include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 
 // qt
 #include <QProcess>
 #include <QScopedPointer>
 
+namespace Signal {
+    class Buffer;
+}
+
 namespace Adapters {
 
 class MatlabOperation;
+class MatlabSharedMemory;
 
 class MatlabFunctionSettings
 {
@@ -95,15 +101,26 @@ private:
 
   One instance of octave or matlab will be created for each instance of
   MatlabFunction. Each instance is then killed in each destructor.
+
+  With Interop_SharedMemory buffers are instead exchanged through a
+  MatlabSharedMemory segment named after the interop file, and
+  sawe_shmwatcher.m is used instead of filewatcher.m. This requires Octave and
+  the helper sawe_shm.oct next to the scripts, otherwise files are used.
   */
 class MatlabFunction: public QObject, private boost::noncopyable
 {
     Q_OBJECT
 public:
+    enum Interop
+    {
+        Interop_Files,
+        Interop_SharedMemory
+    };
+
     /**
       Name of a matlab function and timeout measuerd in seconds.
       */
-    MatlabFunction( std::string matlabFunction, float timeout, MatlabFunctionSettings* settings );
+    MatlabFunction( std::string matlabFunction, float timeout, MatlabFunctionSettings* settings, Interop interop = Interop_Files );
     MatlabFunction( QString f, QString subname, float timeout, MatlabFunctionSettings* settings, bool justtest );
     ~MatlabFunction();
 
@@ -114,6 +131,11 @@ public:
       octave and matlab can read with the command a=load('source');
       */
     void invoke( std::string source );
+
+    /**
+      Sends 'b' through shared memory, requires sharedMemory().
+      */
+    void invoke( const Signal::Buffer& b, double overlap );
     bool isWaiting();
 
     /**
@@ -127,6 +149,12 @@ public:
       */
     std::string waitForReady();
 
+    /**
+      Null unless buffers are exchanged through shared memory. The result
+      is then read with sharedMemory()->receive when isReady.
+      */
+    MatlabSharedMemory* sharedMemory();
+
     bool hasProcessEnded();
     bool hasProcessCrashed();
     void endProcess();
@@ -140,13 +168,14 @@ private slots:
     void finished ( int exitCode, QProcess::ExitStatus exitStatus );
 
 private:
-    void init(std::string path, MatlabFunctionSettings* settings, bool justtest = false, bool sendoutput = true);
+    void init(std::string path, MatlabFunctionSettings* settings, bool justtest = false, bool sendoutput = true, Interop interop = Interop_Files);
     //void kill();
     void abort();
 
     QProcess* _pid;
     std::string _dataFile;
     std::string _resultFile;
+    boost::scoped_ptr<MatlabSharedMemory> _shm;
     std::string _matlab_function;
     std::string _matlab_filename;
     bool _hasCrashed;
@@ -1,4 +1,5 @@
 #include "matlaboperation.h"
+#include "matlabsharedmemory.h"
 #include "hdf5adapter.h"
 #include "tools/support/plotlines.h"
 
@@ -106,22 +107,29 @@ bool MatlabOperation::
         double redundancy=0;
         pBuffer plot_pts;
 
-        try
+        if (MatlabSharedMemory* shm = _matlab->sharedMemory())
         {
-            ready_data = Hdf5Buffer::loadBuffer( file, &redundancy, &plot_pts );
+            ready_data = shm->receive( &redundancy, &plot_pts );
         }
-        catch (const Hdf5Error& e)
+        else
         {
-            if (Hdf5Error::Type_OpenFailed == e.type() && e.data() == file)
+            try
             {
-                // Couldn't open it for reading yet, wait
-                return false;
+                ready_data = Hdf5Buffer::loadBuffer( file, &redundancy, &plot_pts );
             }
+            catch (const Hdf5Error& e)
+            {
+                if (Hdf5Error::Type_OpenFailed == e.type() && e.data() == file)
+                {
+                    // Couldn't open it for reading yet, wait
+                    return false;
+                }
 
-            throw e;
-        }
+                throw e;
+            }
 
-        ::remove( file.c_str());
+            ::remove( file.c_str());
+        }
 
         if (_settings->chunksize() < 0)
             redundancy = 0;
@@ -362,13 +370,19 @@ pBuffer MatlabOperation::
             // sent_data = source()->readFixedLength( K );
             sent_data = src;
 
-            string file = _matlab->getTempName();
-
             IntervalType overlap = _settings->overlap();
-            Hdf5Buffer::saveBuffer( file, *sent_data, overlap );
 
             TaskInfo("Sending %s to Matlab/Octave", sent_data->getInterval().toString().c_str() );
-            _matlab->invoke( file );
+            if (_matlab->sharedMemory())
+            {
+                _matlab->invoke( *sent_data, overlap );
+            }
+            else
+            {
+                string file = _matlab->getTempName();
+                Hdf5Buffer::saveBuffer( file, *sent_data, overlap );
+                _matlab->invoke( file );
+            }
         }
         else
         {
@@ -393,7 +407,7 @@ void MatlabOperation::
 
     if (_settings)
     {
-        _matlab.reset( new MatlabFunction( _settings->scriptname(), 4, _settings ));
+        _matlab.reset( new MatlabFunction( _settings->scriptname(), 4, _settings, MatlabFunction::Interop_SharedMemory ));
 
         //DeprecatedOperation::invalidate_samples( Signal::Intervals::Intervals_ALL );
     }
@@ -0,0 +1,457 @@
+#include "matlabsharedmemory.h"
+
+// gpumisc
+#include "cpumemorystorage.h"
+#include "exceptionassert.h"
+#include "tasktimer.h"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+
+#ifndef _WIN32
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <semaphore.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace Adapters {
+
+#ifndef _WIN32
+/**
+ * @brief The Semaphore class owns a named semaphore and removes it when
+ * destroyed.
+ */
+class MatlabSharedMemory::Semaphore
+{
+public:
+    explicit Semaphore(string name)
+        :
+          name_(name)
+    {
+        // Remove leftovers from a crashed instance with the same name
+        sem_unlink (name_.c_str ());
+        s_ = sem_open (name_.c_str (), O_CREAT | O_EXCL, 0600, 0);
+        if (SEM_FAILED == s_)
+            throw runtime_error("Couldn't create semaphore '" + name_ + "': " + strerror(errno));
+    }
+
+    ~Semaphore()
+    {
+        sem_close (s_);
+        sem_unlink (name_.c_str ());
+    }
+
+    void post()
+    {
+        sem_post (s_);
+    }
+
+    bool tryWait()
+    {
+        return 0 == sem_trywait (s_);
+    }
+
+    bool timedWait(double timeout)
+    {
+#ifdef __APPLE__
+        // sem_timedwait isn't available
+        for (double t=0; t<timeout; t+=0.001)
+        {
+            if (tryWait ())
+                return true;
+            usleep (1000);
+        }
+        return tryWait ();
+#else
+        timespec abstime;
+        clock_gettime (CLOCK_REALTIME, &abstime);
+        double s = abstime.tv_nsec*1e-9 + timeout;
+        abstime.tv_sec += (time_t)s;
+        abstime.tv_nsec = (long)((s - (time_t)s)*1e9);
+
+        while (0 != sem_timedwait (s_, &abstime))
+            if (EINTR != errno)
+                return false;
+        return true;
+#endif
+    }
+
+private:
+    string name_;
+    sem_t* s_;
+};
+#else
+class MatlabSharedMemory::Semaphore
+{
+public:
+    void post() {}
+    bool tryWait() { return false; }
+    bool timedWait(double) { return false; }
+};
+#endif
+
+
+bool MatlabSharedMemory::
+        isSupported()
+{
+#ifndef _WIN32
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+MatlabSharedMemory::
+        MatlabSharedMemory(string name)
+    :
+      name_(name),
+      fd_(-1),
+      map_(0),
+      map_size_(0),
+      waiting_(false),
+      ready_(false)
+{
+#ifndef _WIN32
+    const uint64_t initial_size = 1 << 20;
+
+    shm_unlink (name_.c_str ());
+    fd_ = shm_open (name_.c_str (), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd_ < 0)
+        throw runtime_error("Couldn't create shared memory '" + name_ + "': " + strerror(errno));
+
+    if (0 != ftruncate (fd_, initial_size))
+    {
+        close (fd_);
+        shm_unlink (name_.c_str ());
+        throw runtime_error("Couldn't resize shared memory '" + name_ + "': " + strerror(errno));
+    }
+
+    map_ = mmap (0, initial_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    EXCEPTION_ASSERT_NOTEQUALS(map_, MAP_FAILED);
+    map_size_ = initial_size;
+
+    memset (map_, 0, data_offset);
+    header ()->magic = header_magic;
+    header ()->version = header_version;
+    header ()->segment_size = initial_size;
+
+    request_.reset (new Semaphore(name_ + ".request"));
+    reply_.reset (new Semaphore(name_ + ".reply"));
+#else
+    throw runtime_error("Shared memory interop is not supported on this platform");
+#endif
+}
+
+
+MatlabSharedMemory::
+        ~MatlabSharedMemory()
+{
+#ifndef _WIN32
+    if (request_)
+    {
+        header ()->quit = 1;
+        request_->post ();
+    }
+
+    request_.reset ();
+    reply_.reset ();
+
+    munmap (map_, map_size_);
+    close (fd_);
+    shm_unlink (name_.c_str ());
+#endif
+}
+
+
+void MatlabSharedMemory::
+        send(const Signal::Buffer& b, double overlap)
+{
+    EXCEPTION_ASSERT(!waiting_);
+
+    const uint64_t C = b.number_of_channels ();
+    const uint64_t N = b.number_of_samples ();
+
+    remap ();
+    reserve (data_offset + C*N*sizeof(float));
+
+    Header* h = header ();
+    h->sequence++;
+    h->num_channels = C;
+    h->number_of_samples = N;
+    h->sample_offset = b.sample_offset ().asFloat ();
+    h->sample_rate = b.sample_rate ();
+    h->overlap = overlap;
+
+    // One column per channel, as Octave reads a matrix
+    float* p = data ();
+    for (uint64_t c=0; c<C; ++c)
+        memcpy (p + c*N, CpuMemoryStorage::ReadOnly<1>( b.getChannel (c)->waveform_data() ).ptr (), N*sizeof(float));
+
+    ready_ = false;
+    waiting_ = true;
+    request_->post ();
+}
+
+
+bool MatlabSharedMemory::
+        isReady()
+{
+    if (waiting_ && reply_->tryWait ())
+    {
+        waiting_ = false;
+        ready_ = true;
+    }
+
+    return ready_;
+}
+
+
+bool MatlabSharedMemory::
+        waitForReady(double timeout)
+{
+    if (waiting_ && reply_->timedWait (timeout))
+    {
+        waiting_ = false;
+        ready_ = true;
+    }
+
+    return ready_;
+}
+
+
+Signal::pBuffer MatlabSharedMemory::
+        receive(double* overlap, Signal::pBuffer* plot)
+{
+    EXCEPTION_ASSERT(ready_);
+    ready_ = false;
+
+    remap ();
+
+    const Header* h = header ();
+    EXCEPTION_ASSERT_EQUALS(h->reply_sequence, h->sequence);
+
+    *overlap = h->reply_overlap;
+    if (0 != h->reply_status)
+        return Signal::pBuffer();
+
+    const uint64_t C = h->reply_channels;
+    const uint64_t N = h->reply_samples;
+    const float* p = data ();
+
+    Signal::pTimeSeriesData samples( new Signal::TimeSeriesData(N, C) );
+    memcpy (CpuMemoryStorage::WriteAll<1>( samples ).ptr (), p, C*N*sizeof(float));
+    Signal::pBuffer b( new Signal::Buffer(0, samples, h->reply_sample_rate) );
+    b->set_sample_offset (h->reply_offset);
+
+    if (0 < h->plot_rows*h->plot_columns)
+    {
+        Signal::pTimeSeriesData pts( new Signal::TimeSeriesData(h->plot_rows, h->plot_columns) );
+        memcpy (CpuMemoryStorage::WriteAll<1>( pts ).ptr (), p + C*N, h->plot_rows*h->plot_columns*sizeof(float));
+        plot->reset( new Signal::Buffer(0, pts, 44100) );
+    }
+
+    return b;
+}
+
+
+void MatlabSharedMemory::
+        reserve(uint64_t bytes)
+{
+#ifndef _WIN32
+    uint64_t size = header ()->segment_size;
+    if (bytes <= size)
+        return;
+
+    size = max(bytes, 2*size);
+    EXCEPTION_ASSERT_EQUALS(0, ftruncate (fd_, size));
+
+    munmap (map_, map_size_);
+    map_ = mmap (0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    EXCEPTION_ASSERT_NOTEQUALS(map_, MAP_FAILED);
+    map_size_ = size;
+
+    header ()->segment_size = size;
+#endif
+}
+
+
+void MatlabSharedMemory::
+        remap()
+{
+#ifndef _WIN32
+    // The helper grows the segment if the reply doesn't fit
+    uint64_t size = header ()->segment_size;
+    if (size <= map_size_)
+        return;
+
+    munmap (map_, map_size_);
+    map_ = mmap (0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    EXCEPTION_ASSERT_NOTEQUALS(map_, MAP_FAILED);
+    map_size_ = size;
+#endif
+}
+
+} // namespace Adapters
+
+#include "hdf5adapter.h"
+#include "trace_perf.h"
+
+#include <QDir>
+
+#include <thread>
+
+namespace Adapters {
+
+#ifndef _WIN32
+// Does what matlab/sawe_shm.cc and sawe_shmwatcher.m does for a script that
+// returns 'data.samples*2'
+static void doublingHelper(string name)
+{
+    typedef MatlabSharedMemory::Header Header;
+
+    int fd = shm_open (name.c_str (), O_RDWR, 0);
+    sem_t* request = sem_open ((name + ".request").c_str (), 0);
+    sem_t* reply = sem_open ((name + ".reply").c_str (), 0);
+    struct stat st;
+    fstat (fd, &st);
+    size_t size = st.st_size;
+    char* map = (char*)mmap (0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    while (0 == sem_wait (request))
+    {
+        if (((Header*)map)->segment_size > size)
+        {
+            size_t new_size = ((Header*)map)->segment_size;
+            munmap (map, size);
+            size = new_size;
+            map = (char*)mmap (0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+
+        Header* h = (Header*)map;
+        if (h->quit)
+            break;
+
+        float* p = (float*)(map + MatlabSharedMemory::data_offset);
+        for (uint64_t i=0; i<h->num_channels*h->number_of_samples; ++i)
+            p[i] *= 2;
+
+        h->reply_status = 0;
+        h->reply_channels = h->num_channels;
+        h->reply_samples = h->number_of_samples;
+        h->reply_offset = h->sample_offset;
+        h->reply_sample_rate = h->sample_rate;
+        h->reply_overlap = h->overlap;
+        h->plot_rows = h->plot_columns = 0;
+        h->reply_sequence = h->sequence;
+        sem_post (reply);
+    }
+
+    munmap (map, size);
+    sem_close (request);
+    sem_close (reply);
+    close (fd);
+}
+#endif
+
+
+void MatlabSharedMemory::
+        test()
+{
+#ifndef _WIN32
+    string name = "/sawetest." + to_string(getpid ());
+
+    // It should send a buffer to a resident helper and read back its reply.
+    {
+        unique_ptr<MatlabSharedMemory> shm(new MatlabSharedMemory(name));
+        thread helper(doublingHelper, name);
+
+        Signal::Buffer b(Signal::Interval(100, 1100), 44100, 2);
+        for (unsigned c=0; c<2; ++c)
+        {
+            float* p = CpuMemoryStorage::WriteAll<1>( b.getChannel (c)->waveform_data() ).ptr ();
+            for (int i=0; i<1000; ++i)
+                p[i] = c ? -i : i;
+        }
+
+        EXCEPTION_ASSERT(!shm->isWaiting ());
+        shm->send (b, 5);
+        EXCEPTION_ASSERT(shm->isWaiting ());
+        EXCEPTION_ASSERT(shm->waitForReady (1));
+        EXCEPTION_ASSERT(!shm->isWaiting ());
+
+        double overlap = 0;
+        Signal::pBuffer plot;
+        Signal::pBuffer r = shm->receive (&overlap, &plot);
+        EXCEPTION_ASSERT_EQUALS(overlap, 5);
+        EXCEPTION_ASSERT(!plot);
+        EXCEPTION_ASSERT_EQUALS(r->getInterval (), Signal::Interval(100, 1100));
+        EXCEPTION_ASSERT_EQUALS(r->sample_rate (), 44100);
+        EXCEPTION_ASSERT_EQUALS(r->number_of_channels (), 2u);
+        EXCEPTION_ASSERT_EQUALS(CpuMemoryStorage::ReadOnly<1>( r->getChannel (0)->waveform_data() ).ptr ()[999], 1998.f);
+        EXCEPTION_ASSERT_EQUALS(CpuMemoryStorage::ReadOnly<1>( r->getChannel (1)->waveform_data() ).ptr ()[999], -1998.f);
+
+        // It should grow the segment for buffers that don't fit
+        Signal::Buffer large(Signal::Interval(0, 300000), 44100, 2);
+        CpuMemoryStorage::WriteAll<1>( large.getChannel (1)->waveform_data() ).ptr ()[299999] = 3;
+        shm->send (large, 0);
+        EXCEPTION_ASSERT(shm->waitForReady (1));
+        r = shm->receive (&overlap, &plot);
+        EXCEPTION_ASSERT_EQUALS(CpuMemoryStorage::ReadOnly<1>( r->getChannel (1)->waveform_data() ).ptr ()[299999], 6.f);
+
+        // The destructor tells the helper to quit
+        shm.reset ();
+        helper.join ();
+    }
+
+    // It should round-trip chunks faster than writing and reading hdf5 files.
+    {
+        const int chunks = 200;
+        Signal::Buffer b(Signal::Interval(0, 4096), 44100, 2);
+        double overlap = 0;
+        Signal::pBuffer plot;
+
+        unique_ptr<MatlabSharedMemory> shm(new MatlabSharedMemory(name));
+        thread helper(doublingHelper, name);
+
+        {
+            TRACE_PERF("MatlabSharedMemory should round-trip 200 chunks through shared memory");
+
+            for (int i=0; i<chunks; ++i)
+            {
+                shm->send (b, 0);
+                EXCEPTION_ASSERT(shm->waitForReady (1));
+                shm->receive (&overlap, &plot);
+            }
+
+            trace_perf_.reset ("MatlabSharedMemory should round-trip 200 chunks through hdf5 files");
+
+            // The same exchange with files, without the polling delay in
+            // sawe_filewatcher and MatlabFunction::waitForReady
+            string file = (QDir::tempPath () + "/sawetest.h5").toStdString ();
+            for (int i=0; i<chunks; ++i)
+            {
+                Hdf5Buffer::saveBuffer (file, b, 0);
+                Signal::pBuffer r = Hdf5Buffer::loadBuffer (file, &overlap, &plot);
+                ::remove (file.c_str ());
+                Hdf5Buffer::saveBuffer (file, *r, overlap);
+                Hdf5Buffer::loadBuffer (file, &overlap, &plot);
+                ::remove (file.c_str ());
+            }
+        }
+
+        shm.reset ();
+        helper.join ();
+    }
+#endif
+}
+
+} // namespace Adapters
@@ -0,0 +1,135 @@
+#ifndef ADAPTERS_MATLABSHAREDMEMORY_H
+#define ADAPTERS_MATLABSHAREDMEMORY_H
+
+#include "signal/buffer.h"
+
+// boost
+#include <boost/noncopyable.hpp>
+
+// std
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+namespace Adapters {
+
+/**
+ * @brief The MatlabSharedMemory class should exchange Signal::Buffer data
+ * with a resident Octave process without touching disk.
+ *
+ * A POSIX shared memory segment holds a Header followed by the samples. Two
+ * named semaphores make up the handshake: send posts '<name>.request' and the
+ * Octave helper matlab/sawe_shm.cc posts '<name>.reply' when it has written
+ * the result to the same segment. Whichever side needs more room grows the
+ * segment and updates Header::segment_size, the other side then remaps it.
+ *
+ * Not supported on Windows, MatlabFunction uses files there.
+ */
+class MatlabSharedMemory: private boost::noncopyable
+{
+public:
+    /**
+     * @brief The Header struct must match the struct in matlab/sawe_shm.cc.
+     */
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t segment_size;
+        uint64_t quit;
+
+        // Written by send
+        uint64_t sequence;
+        uint64_t num_channels;
+        uint64_t number_of_samples;
+        double sample_offset;
+        double sample_rate;
+        double overlap;
+
+        // Written by the helper, 'reply_status' is nonzero if the script
+        // didn't return any samples
+        uint64_t reply_sequence;
+        int64_t reply_status;
+        uint64_t reply_channels;
+        uint64_t reply_samples;
+        double reply_offset;
+        double reply_sample_rate;
+        double reply_overlap;
+        uint64_t plot_rows;
+        uint64_t plot_columns;
+    };
+
+    static const uint32_t header_magic = 0x45574153; // "SAWE"
+    static const uint32_t header_version = 1;
+    static const uint64_t data_offset = 256;
+
+    static bool isSupported();
+
+    /**
+     * @brief MatlabSharedMemory creates a segment and semaphores called
+     * 'name', which must start with '/' and not contain any other '/'.
+     * Throws std::runtime_error if they can't be created.
+     */
+    explicit MatlabSharedMemory(std::string name);
+
+    /**
+     * @brief ~MatlabSharedMemory tells a resident helper to quit and removes
+     * the segment and semaphores.
+     */
+    ~MatlabSharedMemory();
+
+    std::string name() const { return name_; }
+
+    /**
+     * @brief send copies 'b' to the segment and wakes up the helper. Must not
+     * be called while isWaiting.
+     */
+    void send(const Signal::Buffer& b, double overlap);
+
+    /**
+     * @brief isWaiting is true from send until isReady or waitForReady has
+     * seen the reply.
+     */
+    bool isWaiting() const { return waiting_; }
+
+    /**
+     * @brief isReady checks for a reply without blocking.
+     */
+    bool isReady();
+
+    /**
+     * @brief waitForReady blocks until there is a reply or 'timeout' seconds
+     * have passed.
+     */
+    bool waitForReady(double timeout);
+
+    /**
+     * @brief receive reads the reply. Returns null if the script didn't
+     * return any samples.
+     */
+    Signal::pBuffer receive(double* overlap, Signal::pBuffer* plot);
+
+private:
+    class Semaphore;
+
+    Header* header() { return (Header*)map_; }
+    float* data() { return (float*)((char*)map_ + data_offset); }
+    void reserve(uint64_t bytes);
+    void remap();
+
+    std::string name_;
+    int fd_;
+    void* map_;
+    uint64_t map_size_;
+    std::unique_ptr<Semaphore> request_;
+    std::unique_ptr<Semaphore> reply_;
+    bool waiting_;
+    bool ready_;
+
+public:
+    static void test();
+};
+
+} // namespace Adapters
+
+#endif // ADAPTERS_MATLABSHAREDMEMORY_H
@@ -1,5 +1,6 @@
 #include "microphonerecorder.h"
 #include "playback.h"
+#include "signal/recordercapture.h"
 #include "sawe/configuration.h"
 
 #include "tasktimer.h"
@@ -106,10 +107,6 @@ void MicrophoneRecorder::
                                          % device.defaultHighInputLatency()
                                          % device.defaultLowInputLatency ());
 
-        _rolling_mean.resize(num_channels);
-        for (unsigned i=0; i<num_channels; ++i)
-            _rolling_mean[i] = 0;
-
         for (int interleaved=0; interleaved<2; ++interleaved)
         {
             _is_interleaved = interleaved!=0;
@@ -171,6 +168,10 @@ MicrophoneRecorder::~MicrophoneRecorder()
 {
     stopRecording();
 
+    // Let the capture thread finish before releasing the recorded data
+    if (stopping.valid ())
+        stopping.wait ();
+
     auto d = _data.write ();
     auto& samples = d->samples;
     if (0<samples.spannedInterval ().count ()) {
@@ -187,6 +188,10 @@ void MicrophoneRecorder::startRecording()
         return;
 
     TIME_MICROPHONERECORDER TaskInfo ti("MicrophoneRecorder::startRecording()");
+
+    // The previous stream must not call writeBuffer when '_capture' is replaced
+    stopping.wait ();
+
     init();
 
     if (!canRecord())
@@ -199,6 +204,33 @@ void MicrophoneRecorder::startRecording()
     // length() uses {number_of_samples - time() - _offset} while recording.
     _offset = length();
 
+    // Filter samples on the capture thread instead of in writeBuffer
+    std::vector<float> rolling_mean(num_channels(), 0.f);
+    auto prepare = [rolling_mean](Signal::Buffer& b) mutable
+    {
+        for (int i=0; i<b.number_of_channels (); ++i)
+        {
+            float* p = CpuMemoryStorage::WriteAll<1>(b.getChannel (i)->waveform_data()).ptr ();
+            int N = b.number_of_samples ();
+
+            // Not really a rolling mean, rather an IIR. It is anyway an approximated high-pass
+            // filter at a few Hz, the microphone is not expected to such low frequencies
+            float mean = rolling_mean[i];
+            for (int j=0; j<N; ++j)
+            {
+                float v = p[j];
+                p[j] = v - mean;
+                mean = mean*0.99999f + v*0.00001f;
+            }
+            rolling_mean[i] = mean;
+        }
+    };
+
+    // Room for one second of samples
+    _capture.reset (new Signal::RecorderCapture(
+                        _data, _invalidator, actual_number_of_samples(),
+                        sample_rate (), prepare));
+
     try
     {
         _stream_record->start();
@@ -230,7 +262,7 @@ void MicrophoneRecorder::stopRecording()
         sr.swap (_stream_record);
 
         stopping = std::async (std::launch::async,
-            [](decltype(_stream_record) sr, std::string deviceName)
+            [](decltype(_stream_record) sr, decltype(_capture) capture, std::string deviceName)
             {
                 try
                 {
@@ -245,6 +277,10 @@ void MicrophoneRecorder::stopRecording()
 
                 sr->close();
                 sr.reset();
+
+                // Move the last captured samples to the cache
+                if (capture)
+                    capture->stop ();
                 }
                 catch (const portaudio::PaException& x)
                 {
@@ -256,7 +292,7 @@ void MicrophoneRecorder::stopRecording()
                     TaskInfo("stopRecording error: %s (%d)\nMessage: %s",
                              vartype(x).c_str(), x.specifier(), x.what());
                 }
-            }, std::move(sr), deviceName());
+            }, std::move(sr), _capture, deviceName());
     }
 }
 
@@ -322,64 +358,18 @@ int MicrophoneRecorder::
                  const PaStreamCallbackTimeInfo * /*timeInfo*/,
                  PaStreamCallbackFlags /*statusFlags*/)
 {
+    // This is called from a real-time thread, don't allocate or lock anything.
+    // '_capture' moves the samples to the cache and notifies '_invalidator'.
     try {
-    Signal::IntervalType offset = actual_number_of_samples();
-
-    float fs = _data.raw ()->sample_rate;
-    int nc = _data.raw ()->num_channels;
+    TIME_MICROPHONERECORDER_WRITEBUFFER TaskTimer tt(boost::format("MicrophoneRecorder: writeBuffer %u frames at %d")
+                                        % framesPerBuffer % _capture->end ());
 
     _last_update.restart ();
 
-    if (!_receive_buffer || _receive_buffer->number_of_samples ()!=(int)framesPerBuffer || _receive_buffer->number_of_channels ()!=nc)
-        _receive_buffer = Signal::pBuffer( new Signal::Buffer(0, framesPerBuffer, 1, nc ) );
-
-    _receive_buffer->set_sample_offset (offset);
-    _receive_buffer->set_sample_rate (fs);
-
-    Signal::Interval I = _receive_buffer->getInterval ();
-    TIME_MICROPHONERECORDER_WRITEBUFFER TaskTimer tt(boost::format("MicrophoneRecorder: writeBuffer %s, [%g, %g) s")
-                                        % I % (I.first/fs) % (I.last/fs));
-
-    for (int i=0; i<nc; ++i)
-    {
-        Signal::pMonoBuffer b = _receive_buffer->getChannel (i);
-        float* p = CpuMemoryStorage::WriteAll<1>(b->waveform_data()).ptr ();
-        unsigned in_num_channels = _rolling_mean.size ();
-        unsigned in_i = i;
-        if (in_i >= in_num_channels)
-            in_i = in_num_channels - 1;
-
-        if (_is_interleaved)
-        {
-            const float *in = (const float *)inputBuffer;
-            for (unsigned j=0; j<framesPerBuffer; ++j)
-                p[j] = in[j*in_num_channels + i];
-        }
-        else
-        {
-            const float **in = (const float **)inputBuffer;
-            const float *buffer = in[in_i];
-            for (unsigned j=0; j<framesPerBuffer; ++j)
-                p[j] = buffer[j];
-        }
-
-        // Not really a rolling mean, rather an IIR. It is anyway an approximated high-pass
-        // filter at a few Hz, the microphone is not expected to such low frequencies
-        float mean = _rolling_mean[in_i];
-        for (unsigned j=0; j<framesPerBuffer; ++j)
-        {
-            float v = p[j];
-            p[j] = v - mean;
-            mean = mean*0.99999f + v*0.00001f;
-        }
-        _rolling_mean[in_i] = mean;
-    }
-
-    _data.write ()->samples.put( _receive_buffer );
-
-    if (_invalidator)
-        // Tell someone that there is new data available to read
-        _invalidator->deprecateCache ( _receive_buffer->getInterval () );
+    if (_is_interleaved)
+        _capture->put ((const float *)inputBuffer, framesPerBuffer);
+    else
+        _capture->put ((const float * const*)inputBuffer, framesPerBuffer);
 
     } catch (...) {
         _exception = std::current_exception ();
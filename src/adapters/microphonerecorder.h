@@ -49,8 +49,6 @@ private:
     int input_device_;
     bool _is_interleaved;
     bool _has_input_device;
-    std::vector<float> _rolling_mean;
-    Signal::pBuffer _receive_buffer;
 
     portaudio::AutoSystem _autoSys;
     std::shared_ptr<portaudio::MemFunCallbackStream<MicrophoneRecorder> > _stream_record;
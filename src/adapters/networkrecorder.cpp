@@ -4,6 +4,7 @@
 #include <QTcpSocket>
 #include <QErrorMessage>
 
+#include "signal/recordercapture.h"
 #include "tasktimer.h"
 
 namespace Adapters {
@@ -44,6 +45,11 @@ void NetworkRecorder::
     _offset = actual_number_of_samples()/sample_rate();
     _start_recording.restart ();
 
+    // Room for one second of samples
+    _capture.reset (new Signal::RecorderCapture(
+                        _data, _invalidator, actual_number_of_samples(),
+                        sample_rate ()));
+
     tcpSocket.connectToHost(url.host(),url.port(12345),QTcpSocket::ReadOnly);
 }
 
@@ -53,6 +59,9 @@ void NetworkRecorder::
 {
     // TODO implement
     tcpSocket.disconnectFromHost();
+
+    // Move the last received samples to the cache
+    _capture.reset ();
 }
 
 
@@ -109,27 +118,28 @@ int NetworkRecorder::
     const short* shortdata = (const short*)voiddata;
     int sampleCount = byteCount/sizeof(short);
 
-    if (0 == sampleCount)
+    if (0 == sampleCount || !_capture)
         return 0;
 
-    Signal::IntervalType offset = actual_number_of_samples();
-    shared_state<Data> data = _data;
-
-    // convert shortdata to normalized floats
-    Signal::pBuffer b( new Signal::Buffer(offset, sampleCount, data.raw ()->sample_rate, data.raw ()->num_channels ) );
-    float* p = b->getChannel (0)->waveform_data()->getCpuMemory();
-    for (int i=0; i<sampleCount; ++i)
-        p[i] = shortdata[i]/(float)SHRT_MAX;
+    // convert shortdata to normalized floats and let '_capture' add them to
+    // the cache and notify listeners
+    float p[1024];
+    int i = 0;
+    while (i < sampleCount)
+    {
+        int n = std::min(sampleCount - i, 1024);
+        for (int j=0; j<n; ++j)
+            p[j] = shortdata[i + j]/(float)SHRT_MAX;
 
-    // add data
-    _last_update.restart ();
-    data.write ()->samples.put( b );
+        if (!_capture->put (p, n))
+            break;
+        i += n;
+    }
 
-    // notify listeners that we've got new data
-    if (_invalidator)
-        _invalidator->deprecateCache( Signal::Interval( offset, offset + sampleCount ) );
+    if (0 < i)
+        _last_update.restart ();
 
-    return sampleCount*sizeof(short);
+    return i*sizeof(short);
 }
 
 
@@ -150,10 +160,14 @@ void NetworkRecorder::
     do
     {
         byteArray = tcpSocket.read(samplerate);
-        int readData = receivedData(byteArray.data_ptr(), byteArray.size());
+        int readData = receivedData(byteArray.constData(), byteArray.size());
 
         for (int i=byteArray.size()-1; i>=readData; --i)
             tcpSocket.ungetChar(byteArray[i]);
+
+        // Wait for more data or for the capture buffer to be emptied
+        if (readData < byteArray.size())
+            break;
     } while (!byteArray.isEmpty());
 }
 
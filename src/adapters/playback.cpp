@@ -1,8 +1,11 @@
 #include "playback.h"
 
 #include "cpumemorystorage.h"
+#include "signal/transpose.h"
 #include "tasktimer.h"
 
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <stdexcept>
 #include <QMessageBox>
@@ -18,10 +21,22 @@ namespace Adapters {
 
 bool Playback_logging = true;
 
+// Number of frames that the ring buffer for the audio callback can hold at
+// most, about 3 seconds at 44.1 kHz.
+const Signal::IntervalType ring_frames = 1<<17;
+
 Playback::
         Playback( int outputDevice )
 :   _data(),
     _first_buffer_size(0),
+    _max_found(1),
+    _min_found(-1),
+    _feeder_quit(false),
+    _ring_channels(0),
+    _ring_written(0),
+    _ring_position(0),
+    _ring_end(0),
+    _underruns(0),
     _playback_itr(0),
     _output_device(-1),
     _output_channels(0),
@@ -90,6 +105,8 @@ Playback::
         if (streamPlayback->isOpen())
             streamPlayback->close();
     }
+
+    stopFeeding();
 }
 
 
@@ -243,7 +260,7 @@ void Playback::
     // it can't access the GPU memory)
     buffer->release_extra_resources ();
 
-    _data.put( buffer );
+    putData( buffer );
     _output_channels = buffer->number_of_channels ();
 
     if (streamPlayback)
@@ -263,8 +280,20 @@ void Playback::
 void Playback::
         setExpectedSamples(const Signal::Interval &I, int C)
 {
-    _expected = I;
+    {
+        std::lock_guard<std::mutex> l(_data_lock);
+        _expected = I;
+    }
+
     invalidate_samples (_expected, C);
+
+    // Preallocate the ring buffer, it can't be reallocated while the audio
+    // callback is running
+    if (!streamPlayback || streamPlayback->isStopped())
+    {
+        stopFeeding();
+        _ring.reset( C * std::min(ring_frames, (Signal::IntervalType)I.count()) );
+    }
 }
 
 
@@ -278,6 +307,8 @@ void Playback::
             streamPlayback->stop();
     }
 
+    stopFeeding();
+
     _playback_itr = _data.spannedInterval ().last;
     _max_found = 1;
     _min_found = -1;
@@ -317,6 +348,8 @@ void Playback::
                         _playback_itr,
                         Signal::Interval::IntervalType_MAX);
 
+    std::lock_guard<std::mutex> l(_data_lock);
+
     if (C != _data.num_channels ())
         _data.clear ();
 
@@ -410,7 +443,9 @@ void Playback::
                     &Playback::readBuffer) );
 
             _playback_itr = _data.spannedInterval ().first;
+            startFeeding();
 
+            _startPlay_timestamp = microsec_clock::local_time();
             streamPlayback->start();
             break;
         }
@@ -523,6 +558,8 @@ void Playback::
 
         if (streamPlayback->isActive() && !streamPlayback->isStopped())
             streamPlayback->stop();
+
+        stopFeeding();
     }
     else
     {
@@ -532,6 +569,7 @@ void Playback::
         _startPlay_timestamp = microsec_clock::local_time();
         _startPlay_timestamp -= time_duration(0, 0, 0, (_playback_itr - _data.spannedInterval ().first)/sample_rate()*time_duration::ticks_per_second() );
 
+        startFeeding();
         streamPlayback->start();
     }
 }
@@ -566,6 +604,108 @@ void Playback::
 }
 
 
+void Playback::
+        putData( Signal::pBuffer buffer )
+{
+    {
+        std::lock_guard<std::mutex> l(_data_lock);
+        _data.put( buffer );
+    }
+
+    _feed_wakeup.notify_one();
+}
+
+
+void Playback::
+        startFeeding()
+{
+    // Must not be called while the audio callback is running
+    stopFeeding();
+
+    _ring_channels = _output_channels;
+    _callback_chunk.resize( std::max(1024u, _ring_channels) );
+    if (0 == _ring.capacity())
+        _ring.reset( _ring_channels * ring_frames );
+    _ring.clear();
+
+    _ring_written = _ring_position = _playback_itr;
+    _feeder_quit = false;
+
+    {
+        std::lock_guard<std::mutex> l(_data_lock);
+        feed();
+    }
+
+    _feeder = std::thread(&Playback::feeder, this);
+}
+
+
+void Playback::
+        stopFeeding()
+{
+    {
+        std::lock_guard<std::mutex> l(_data_lock);
+        _feeder_quit = true;
+    }
+
+    _feed_wakeup.notify_all();
+
+    if (_feeder.joinable())
+        _feeder.join();
+}
+
+
+void Playback::
+        feeder()
+{
+    std::unique_lock<std::mutex> l(_data_lock);
+
+    while (!_feeder_quit)
+    {
+        feed();
+
+        // putData wakes this up when new data arrives. The callback doesn't,
+        // room that it has made is noticed when this times out.
+        _feed_wakeup.wait_for(l, std::chrono::milliseconds(10));
+    }
+}
+
+
+void Playback::
+        feed()
+{
+    // Called with _data_lock held by the only producer of _ring
+    unsigned C = _ring_channels;
+    _ring_end = _expected ? _expected.last : _data.spannedInterval ().last;
+
+    while (0 < C)
+    {
+        // Samples are written to the ring in order, stop at the first
+        // sample that hasn't been computed yet
+        Signal::Interval I = (_data.samplesDesc() & Signal::Interval(_ring_written, _ring_end)).fetchFirstInterval();
+        if (I.first != _ring_written)
+            break;
+
+        I.last = std::min(I.last, I.first + (Signal::IntervalType)(_ring.write_available() / C));
+        if (!I)
+            break;
+
+        Signal::pBuffer b = _data.read( I );
+        std::vector<const float*> channels(C);
+        for (unsigned c=0; c<C; ++c)
+            channels[c] = CpuMemoryStorage::ReadOnly<1>( b->getChannel (c)->waveform_data() ).ptr();
+
+        unsigned N = I.count()*C;
+        _interleaved.resize( N );
+        Signal::interleave( &_interleaved[0], &channels[0], C, I.count() );
+        normalize( &_interleaved[0], N );
+
+        _ring.write( &_interleaved[0], N );
+        _ring_written = I.last;
+    }
+}
+
+
 int Playback::
         readBuffer(const void * /*inputBuffer*/,
                  void *outputBuffer,
@@ -573,6 +713,7 @@ int Playback::
                  const PaStreamCallbackTimeInfo * /*timeInfo*/,
                  PaStreamCallbackFlags /*statusFlags*/)
 {
+    // This is called from a real-time thread, don't allocate or lock anything
     float FS;
     TIME_PLAYBACK FS = _data.sample_rate();
     TIME_PLAYBACK TaskTimer("Playback::readBuffer Reading [%d, %d)%u# from %d. [%g, %g)%g s",
@@ -581,47 +722,64 @@ int Playback::
                            _playback_itr/ FS, (_playback_itr + framesPerBuffer)/ FS,
                            framesPerBuffer/ FS);
 
-    if (!_data.empty() && _playback_itr == _data.spannedInterval ().first) {
-        _startPlay_timestamp = microsec_clock::local_time();
-    }
+    unsigned C = _ring_channels;
+    Signal::IntervalType itr = _playback_itr;
+    Signal::IntervalType end = _ring_end;
+
+    // Drop samples that arrived after they should have been played
+    if (_ring_position < itr)
+        _ring_position += _ring.discard( (itr - _ring_position)*C ) / C;
 
-    unsigned nchannels = _output_channels;
-    Signal::pBuffer mb = _data.read( Signal::Interval(_playback_itr, _playback_itr+framesPerBuffer) );
-    for (unsigned c=0; c<nchannels; ++c)
+    unsigned long frames = 0;
+    if (_ring_position == itr && 0 < C)
     {
-        Signal::pMonoBuffer b = mb->getChannel (c);
-        float *p = CpuMemoryStorage::ReadOnly<1>( b->waveform_data() ).ptr();
         if (_is_interleaved)
         {
-            float *out = (float *)outputBuffer;
-            float *buffer = out;
-            for (unsigned j=0; j<framesPerBuffer; ++j)
-                buffer[j*nchannels + c] = p[j];
+            frames = _ring.read( (float *)outputBuffer, framesPerBuffer*C ) / C;
         }
         else
         {
             float **out = static_cast<float **>(outputBuffer);
-            float *buffer = out[c];
-            ::memcpy( buffer, p, framesPerBuffer*sizeof(float) );
-            normalize( buffer, framesPerBuffer );
+            float *chunk = &_callback_chunk[0];
+            unsigned long chunk_frames = _callback_chunk.size() / C;
+            while (frames < framesPerBuffer)
+            {
+                unsigned long n = _ring.read( chunk, std::min(chunk_frames, framesPerBuffer - frames)*C ) / C;
+                if (0 == n)
+                    break;
+
+                for (unsigned c=0; c<C; ++c)
+                    for (unsigned long j=0; j<n; ++j)
+                        out[c][frames + j] = chunk[j*C + c];
+                frames += n;
+            }
         }
+
+        _ring_position += frames;
     }
 
+    // Play silence for samples that aren't available
     if (_is_interleaved)
-        normalize( (float *)outputBuffer, framesPerBuffer*nchannels );
+    {
+        float *out = (float *)outputBuffer;
+        std::fill( out + frames*C, out + framesPerBuffer*C, 0.f );
+    }
+    else
+    {
+        float **out = static_cast<float **>(outputBuffer);
+        for (unsigned c=0; c<C; ++c)
+            std::fill( out[c] + frames, out[c] + framesPerBuffer, 0.f );
+    }
+
+    if (frames < framesPerBuffer && itr + (Signal::IntervalType)frames < end)
+        _underruns++;
 
-    _playback_itr += framesPerBuffer;
+    _playback_itr = itr + framesPerBuffer;
 
     int ret = paContinue;
-    if (_data.spannedInterval ().last + (Signal::IntervalType)framesPerBuffer < _playback_itr ) {
-        TaskInfo("DONE");
+    if (end + (Signal::IntervalType)framesPerBuffer < _playback_itr ) {
+        TIME_PLAYBACK TaskInfo("DONE");
         ret = paComplete;
-    } else {
-        if (_data.spannedInterval ().last < _playback_itr ) {
-            TaskInfo("PAST END");
-            // TODO if !_data.invalid_samples().empty() should pause playback here and continue when data is made available
-        } else {
-        }
     }
 
     return ret;
@@ -674,6 +832,133 @@ void Playback::
         EXCEPTION_ASSERT (!pb.isStopped () && !pb.isPaused ());
     }
 
+    // It should deinterleave frames with more channels than fit in 1024
+    // floats for a device that isn't interleaved.
+    {
+        const unsigned C = 1500;
+        const int N = 64;
+        auto value = [](unsigned c, int k) { return ((c + 7*k)%1000)/1000.f*2-1; };
+
+        Playback pb(-1);
+        pb.setExpectedSamples (Signal::Interval(0,N), C);
+        pb._output_channels = C;
+        pb._is_interleaved = false;
+
+        Signal::pBuffer b(new Signal::Buffer(0, N, 44100, C));
+        for (unsigned c=0; c<C; c++)
+        {
+            float* p = CpuMemoryStorage::WriteAll<1>( b->getChannel (c)->waveform_data () ).ptr ();
+            for (int k=0; k<N; k++)
+                p[k] = value(c, k);
+        }
+        pb.putData (b);
+
+        pb._playback_itr = 0;
+        pb.startFeeding ();
+
+        std::vector<std::vector<float>> data(C, std::vector<float>(N, 2.f));
+        std::vector<float*> out(C);
+        for (unsigned c=0; c<C; c++)
+            out[c] = &data[c][0];
+        pb.readBuffer (0, &out[0], N, 0, 0);
+        pb.stopFeeding ();
+
+        EXCEPTION_ASSERT_EQUALS(pb.underruns (), 0u);
+        for (unsigned c=0; c<C; c++)
+            for (int k=0; k<N; k++)
+                EXCEPTION_ASSERT_LESS(std::fabs (data[c][k] - value(c, k)), 1e-5f);
+    }
+
+    // It should feed the audio callback through a lock-free ring buffer and
+    // count underruns when samples are computed too late, also when the CPU is
+    // saturated.
+    for (int late=0; late<2; late++)
+    {
+        const float fs = 44100;
+        const int N = 1<<14, put_size = 512, frames = 256;
+        auto value = [](Signal::IntervalType k) { return (k%1000)/1000.f*2-1; };
+
+        Playback pb(-1);
+        pb.setExpectedSamples (Signal::Interval(0,N), 1);
+        pb._output_channels = 1;
+        pb._is_interleaved = true;
+        // Smaller than the signal so that the feeder has to refill it
+        pb._ring.reset (16*frames);
+
+        auto put = [&pb, &value, fs, put_size](int i) {
+            Signal::pBuffer b(new Signal::Buffer(i, put_size, fs, 1));
+            float* p = CpuMemoryStorage::WriteAll<1>( b->getChannel (0)->waveform_data () ).ptr ();
+            for (int j=0; j<put_size; j++)
+                p[j] = value(i+j);
+            pb.putData (b);
+        };
+
+        if (!late)
+            for (int i=0; i<N; i+=put_size)
+                put (i);
+
+        pb._playback_itr = 0;
+        pb.startFeeding ();
+
+        std::atomic<bool> stop_workers {false};
+        std::vector<std::thread> workers;
+        for (unsigned i=0; i<std::max(2u, std::thread::hardware_concurrency ()); i++)
+            workers.push_back (std::thread([&stop_workers]() {
+                volatile double x = 0;
+                while (!stop_workers)
+                    x = x + 1;
+            }));
+
+        // Slower than real-time
+        std::thread producer;
+        if (late)
+            producer = std::thread([&put, N, put_size, fs]() {
+                for (int i=0; i<N; i+=put_size)
+                {
+                    std::this_thread::sleep_for (std::chrono::microseconds((int)(2e6*put_size/fs)));
+                    put (i);
+                }
+            });
+
+        // Simulated audio callback
+        std::vector<float> out(N + frames, 2.f);
+        auto t = std::chrono::steady_clock::now ();
+        while (pb._playback_itr < N)
+        {
+            t += std::chrono::microseconds((int)(1e6*frames/fs));
+            std::this_thread::sleep_until (t);
+            pb.readBuffer (0, &out[pb._playback_itr], frames, 0, 0);
+        }
+
+        if (producer.joinable ())
+            producer.join ();
+        stop_workers = true;
+        for (std::thread& w : workers)
+            w.join ();
+        pb.stopFeeding ();
+
+        // Every sample is either silence or the sample at that position
+        bool aligned = true;
+        int played = 0;
+        for (int k=0; k<N; k++)
+        {
+            aligned &= out[k] == 0.f || std::fabs (out[k] - value(k)) < 1e-5f;
+            played += out[k] != 0.f;
+        }
+
+        EXCEPTION_ASSERT(aligned);
+        if (late)
+        {
+            EXCEPTION_ASSERT_LESS(0u, pb.underruns ());
+            EXCEPTION_ASSERT_LESS(0, played);
+        }
+        else
+        {
+            EXCEPTION_ASSERT_EQUALS(pb.underruns (), 0u);
+            EXCEPTION_ASSERT_LESS(N*99/100, played);
+        }
+    }
+
     Playback_logging = true;
 }
 
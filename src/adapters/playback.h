@@ -2,7 +2,12 @@
 #define ADAPTERS_PLAYBACK_H
 
 #include "signal/cache.h"
+#include "spsc_ring.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <time.h>
 #include <portaudiocpp/PortAudioCpp.hxx>
@@ -52,6 +57,12 @@ public:
     void        pausePlayback(bool pause);
     float       sample_rate() { return _data.sample_rate(); }
 
+    /**
+     * @brief underruns counts how many times the audio callback ran out of
+     * expected samples that hadn't been computed yet.
+     */
+    unsigned    underruns() const { return _underruns; }
+
     void        restart_playback();
 
     static void test();
@@ -69,6 +80,30 @@ private:
 
     void normalize( float* p, unsigned N );
 
+    // The audio callback only reads from '_ring'. A feeder thread fills it
+    // with interleaved and normalized samples from '_data' so that the
+    // callback never allocates or waits for a lock.
+    void putData( Signal::pBuffer );
+    void startFeeding();
+    void stopFeeding();
+    void feeder();
+    void feed();
+
+    std::mutex _data_lock;
+    std::condition_variable _feed_wakeup;
+    std::thread _feeder;
+    bool _feeder_quit;
+    JustMisc::spsc_ring<float> _ring;
+    std::vector<float> _interleaved;
+    // Scratch for the callback to deinterleave from '_ring', allocated by
+    // startFeeding to fit at least one frame
+    std::vector<float> _callback_chunk;
+    unsigned _ring_channels;
+    Signal::IntervalType _ring_written;
+    Signal::IntervalType _ring_position;
+    std::atomic<Signal::IntervalType> _ring_end;
+    std::atomic<unsigned> _underruns;
+
     int readBuffer(const void * /*inputBuffer*/,
                      void *outputBuffer,
                      unsigned long framesPerBuffer,
@@ -78,7 +113,7 @@ private:
     portaudio::AutoSystem _autoSys;
     boost::scoped_ptr<portaudio::MemFunCallbackStream<Playback> > streamPlayback;
 
-    Signal::IntervalType _playback_itr;
+    std::atomic<Signal::IntervalType> _playback_itr;
     int _output_device;
     unsigned _output_channels;
     bool _is_interleaved;
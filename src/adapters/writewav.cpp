@@ -158,7 +158,15 @@ void WriteWav::
     EXCEPTION_ASSERT( *_sndfile );
 
     DataStorage<float> interleaved_data(b->number_of_channels (), b->number_of_samples());
-    TIME_WRITEWAV_LINE(Signal::transpose( &interleaved_data, b->mergeChannelData().get() ));
+    {
+        // Interleave from the channels directly instead of merging them first
+        std::vector<const float*> channels(b->number_of_channels ());
+        for (int c=0; c<b->number_of_channels (); ++c)
+            channels[c] = CpuMemoryStorage::ReadOnly<1>( b->getChannel (c)->waveform_data () ).ptr();
+
+        float* q = CpuMemoryStorage::WriteAll<float,2>( &interleaved_data ).ptr();
+        TIME_WRITEWAV_LINE(Signal::interleave( q, &channels[0], b->number_of_channels (), b->number_of_samples() ));
+    }
 
     double sum = 0;
     float high = _high;
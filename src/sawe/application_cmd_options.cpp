@@ -7,10 +7,15 @@
 #include "heightmap/collection.h"
 
 // tfr
+#include "tfr/chunksizetuner.h"
 #include "tfr/cwt.h"
 #include "tfr/transformoperation.h"
 
+// signal
+#include "signal/processing/task.h"
+
 // adapters
+#include "adapters/chunkexport.h"
 #include "adapters/csv.h"
 #include "adapters/hdf5adapter.h"
 #include "adapters/playback.h"
@@ -18,10 +23,15 @@
 // gpumisc
 #include "redirectstdout.h"
 
+// backtrace
+#include "trace_scope.h"
+#include "shared_state_profiler.h"
+
 // boost
 #include <boost/foreach.hpp>
 
 // Qt
+#include <QDir>
 #include <QGLContext>
 #include <QMessageBox>
 #include <QErrorMessage>
@@ -29,12 +39,35 @@
 // std
 #include <string>
 #include <stdio.h>
+#include <stdlib.h> // atexit
 
 using namespace std;
 
 namespace Sawe {
 
 
+static void dump_trace_file()
+{
+    string filename = Sawe::Configuration::trace_file();
+    if (!trace_scope::dump_chrome_json (filename))
+        cerr << "Couldn't write trace events to " << filename << endl;
+}
+
+
+static void report_chunk_sizes()
+{
+    if (Tfr::ChunkSizeTuner::ptr tuner = Tfr::ChunkSizeTuner::global ())
+    {
+        string report = tuner->report ();
+        if (!report.empty ())
+            cout << "Tuned chunk sizes (" << tuner->cache_file () << ")" << endl << report;
+    }
+
+    // Join the tuning thread before static objects are destroyed
+    Tfr::ChunkSizeTuner::global (Tfr::ChunkSizeTuner::ptr());
+}
+
+
 void Application::
         execute_command_line_options()
 {
@@ -55,6 +88,29 @@ void Application::
     }
 
 
+    if (!Sawe::Configuration::trace_file().empty())
+    {
+        trace_scope::enable (true);
+        atexit (dump_trace_file);
+    }
+
+    if (0 < Sawe::Configuration::lock_report())
+    {
+        shared_state_profiler::enable (true);
+        shared_state_profiler::report_every (Sawe::Configuration::lock_report());
+    }
+
+    if (Sawe::Configuration::autotune_chunk_size())
+    {
+        QString dir = Sawe::Application::log_directory();
+        QDir().mkpath(dir);
+        string cache_file = (dir + QDir::separator() + "chunksizes.txt").toStdString();
+        // Only measure while no task is processing, see Tfr::ChunkSizeTuner
+        auto busy = [](){ return 0 < Signal::Processing::Task::running (); };
+        Tfr::ChunkSizeTuner::global (Tfr::ChunkSizeTuner::ptr(new Tfr::ChunkSizeTuner(cache_file, 1<<20, busy)));
+        atexit (report_chunk_sizes);
+    }
+
     Sawe::pProject p; // p will be owned by Application and released before a.exec()
 
     if (!Sawe::Configuration::input_file().empty())
@@ -118,6 +174,35 @@ void Application::
         sawe_exit = true;
     }
 
+    std::string export_file = Sawe::Configuration::export_file();
+    if (!export_file.empty ()) {
+        if (0==number_of_samples) {
+            Sawe::Application::display_fatal_exception(std::invalid_argument("Can't export chunks without input file."));
+            ::exit(6);
+        }
+
+        Signal::Interval I = extent.interval.get_value_or (Signal::Interval());
+        int number_of_channels = extent.number_of_channels.get_value_or (1);
+        TaskTimer tt("Exporting %s to %s", I.toString ().c_str (), export_file.c_str ());
+
+        std::shared_ptr<Adapters::ChunkExport> e(new Adapters::ChunkExport(
+                Adapters::ChunkExport::formatFromFilename (export_file, Sawe::Configuration::export_compression ()),
+                I, sample_rate, number_of_channels));
+
+        // All chunks are computed by a single target and written as they are
+        // computed by the background writer of ChunkExport
+        Tfr::ChunkFilterDesc::ptr cfd(new Adapters::ChunkExportDesc(e));
+        Signal::OperationDesc::ptr o(new Tfr::TransformOperationDesc(cfd));
+        Signal::Processing::TargetMarker::ptr t = p->processing_chain ()->addTargetBefore(o, p->default_target ());
+        Signal::Processing::TargetNeeds::ptr needs = t->target_needs ();
+
+        needs->updateNeeds (I);
+        needs->sleep(-1);
+        e->finish ();
+
+        sawe_exit = true;
+    }
+
     if (Sawe::Configuration::get_chunk_count()) {
         TaskInfo("number of samples = %u", number_of_samples);
         TaskInfo("samples per chunk = %u", total_samples_per_chunk);
@@ -83,6 +83,11 @@ public:
     static unsigned get_hdf();
     static unsigned get_csv();
     static bool get_chunk_count();
+    static std::string export_file();
+    static int export_compression();
+    static std::string trace_file();
+    static float lock_report();
+    static bool autotune_chunk_size();
 
     static float scales_per_octave();
     static float wavelet_time_support();
@@ -123,6 +128,11 @@ private:
     unsigned get_hdf_;
     unsigned get_csv_;
     bool get_chunk_count_;
+    std::string export_file_;
+    int export_compression_;
+    std::string trace_file_;
+    float lock_report_;
+    bool autotune_chunk_size_;
     std::string selectionfile_;
     std::string soundfile_;
 
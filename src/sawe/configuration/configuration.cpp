@@ -50,6 +50,11 @@ Configuration::
             get_hdf_( (unsigned)-1 ),
             get_csv_( (unsigned)-1 ),
             get_chunk_count_( false ),
+            export_file_( "" ),
+            export_compression_( 0 ),
+            trace_file_( "" ),
+            lock_report_( 0 ),
+            autotune_chunk_size_( true ),
             selectionfile_( "selection.wav" ),
             soundfile_( "" )
 {
@@ -355,6 +360,13 @@ static const char _sawe_usage_string[] =
     "    --mono=1            Makes Sonic AWE only process the first channel\n"
     "    --use_saved_state=0 Disables restoring old user interface states\n"
     "    --skip_update_check=1 Disables checking for new versions\n"
+    "    --trace_file=filename Records timing of tasks, transforms and file reads\n"
+    "                        and writes them as Chrome trace-event JSON on exit.\n"
+    "    --lock_report=seconds Measures lock contention and logs the most contended\n"
+    "                        locks at the given interval.\n"
+    "    --autotune_chunk_size=0 Disables measuring the fastest chunk size of each\n"
+    "                        transform. Measured sizes are kept in chunksizes.txt\n"
+    "                        in the log directory and reported on exit.\n"
     "\n"
     "Ways of extracting data from a Continious Gabor Wavelet Transform (CWT)\n"
     "    --get_csv=number    Saves the given chunk number into sawe.csv which \n"
@@ -363,6 +375,11 @@ static const char _sawe_usage_string[] =
     "                        then can be read by matlab or octave.\n"
     "    --get_chunk_count=1 outpus the number of chunks that can be fetched by \n"
     "                        the --get_* options\n"
+    "    --export_file=filename Saves all chunks of the input file into one file.\n"
+    "                        Names ending with .npy are saved as NumPy arrays,\n"
+    "                        one per octave band, other names as HDF5 datasets.\n"
+    "    --export_compression=level Compresses HDF5 datasets with deflate at the\n"
+    "                        given level (1-9).\n"
     "\n"
     "Settings for computing CWT\n"
     "    --samples_per_chunk_hint\n"
@@ -476,9 +493,14 @@ int Configuration::
         else if (readarg(&cmd, channel));
         else if (readarg(&cmd, get_hdf));
         else if (readarg(&cmd, get_csv));
+        else if (readarg(&cmd, export_file));
+        else if (readarg(&cmd, export_compression));
         else if (readarg(&cmd, version));
         else if (readarg(&cmd, use_saved_state));
         else if (readarg(&cmd, skip_update_check));
+        else if (readarg(&cmd, trace_file));
+        else if (readarg(&cmd, lock_report));
+        else if (readarg(&cmd, autotune_chunk_size));
         else if (readarg(&cmd, skipfeature))
         {
             vector<string>::iterator featureitr = find(features_.begin(), features_.end(), skipfeature_);
@@ -631,6 +653,41 @@ bool Configuration::
 }
 
 
+string Configuration::
+        export_file()
+{
+    return Singleton().export_file_;
+}
+
+
+int Configuration::
+        export_compression()
+{
+    return Singleton().export_compression_;
+}
+
+
+string Configuration::
+        trace_file()
+{
+    return Singleton().trace_file_;
+}
+
+
+float Configuration::
+        lock_report()
+{
+    return Singleton().lock_report_;
+}
+
+
+bool Configuration::
+        autotune_chunk_size()
+{
+    return Singleton().autotune_chunk_size_;
+}
+
+
 float Configuration::
         scales_per_octave()
 {
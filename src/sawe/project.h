@@ -194,6 +194,7 @@ private:
     static boost::shared_ptr<Project> openWatched(std::string project_file);
     static boost::shared_ptr<Project> openOperation(Signal::OperationDesc::ptr operation, std::string name="");
     static boost::shared_ptr<Project> openProject(std::string project_file);
+    static Project* openXmlProject(std::string project_file);
 
     friend class boost::serialization::access;
     template<class Archive> void save(Archive& ar, const unsigned int /*version*/) const {
@@ -1,5 +1,6 @@
 // class header
 #include "project.h"
+#include "projectfile.h"
 
 // Serializable Sonic AWE classes 
 #include "adapters/audiofile.h"
@@ -22,6 +23,7 @@
 
 // Std
 #include <fstream>
+#include <sstream>
 
 // Boost
 #include <boost/archive/xml_oarchive.hpp>
@@ -115,12 +117,18 @@ bool Project::
     {
         TaskTimer tt("Saving project to '%s'", project_filename_.c_str());
 
-        std::ofstream ofs(project_filename_.c_str(), ios_base::out | ios_base::trunc);
-        boost::archive::xml_oarchive xml(ofs);
-
+        // Bulky data is written to sections in 'file' during serialization
+        ProjectFile::Writer file(project_filename_);
+        std::ostringstream metadata;
         Project* p = this;
-        runSerialization(xml, p, project_filename_.c_str());
 
+        {
+            ProjectFile::Writer::Scope scope(&file);
+            boost::archive::xml_oarchive xml(metadata);
+            runSerialization(xml, p, project_filename_.c_str());
+        }
+
+        file.close (metadata.str ());
         p->is_modified_ = false;
     }
     catch (const std::exception& x)
@@ -138,6 +146,37 @@ bool Project::
 
 pProject Project::
         openProject(std::string project_file)
+{
+    Project* new_project = 0;
+
+    if (ProjectFile::isProjectFile(project_file))
+    {
+        // Sections are mapped and read from disk when they are used
+        ProjectFile::ptr file = ProjectFile::open(project_file);
+        ProjectFile::Scope scope(file.get ());
+        std::istringstream metadata(file->metadata ());
+        boost::archive::xml_iarchive xml(metadata);
+
+        runSerialization(xml, new_project, project_file.c_str());
+    }
+    else
+    {
+        // Projects saved before ProjectFile are plain xml archives
+        new_project = openXmlProject(project_file);
+    }
+
+    new_project->project_filename_ = project_file;
+    new_project->updateWindowTitle();
+    new_project->is_modified_ = false;
+
+    pProject project( new_project );
+
+    return project;
+}
+
+
+Project* Project::
+        openXmlProject(std::string project_file)
 {
     std::ifstream ifs(project_file.c_str(), ios_base::in);
 
@@ -158,13 +197,7 @@ pProject Project::
     Project* new_project = 0;
 	runSerialization(xml, new_project, project_file.c_str());
 
-    new_project->project_filename_ = project_file;
-    new_project->updateWindowTitle();
-    new_project->is_modified_ = false;
-
-    pProject project( new_project );
-
-    return project;
+    return new_project;
 }
 
 } // namespace Sawe
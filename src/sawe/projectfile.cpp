@@ -0,0 +1,457 @@
+#include "projectfile.h"
+
+#include "tasktimer.h"
+
+#include <string.h>
+#include <ios>
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define PROJECTFILE_THREAD_LOCAL __declspec(thread)
+#else
+#define PROJECTFILE_THREAD_LOCAL thread_local
+#endif
+
+using namespace std;
+
+namespace Sawe {
+
+namespace {
+
+const char magic[8] = {'S','A','W','E','P','R','O','J'};
+const uint32_t format_version = 1;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t section_count;
+    uint64_t table_offset;
+    uint32_t metadata_section;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(Header) == 32, "Header must not be padded");
+
+PROJECTFILE_THREAD_LOCAL ProjectFile::Writer* current_writer = 0;
+PROJECTFILE_THREAD_LOCAL ProjectFile* current_file = 0;
+
+} // namespace
+
+
+ProjectFile::Writer::
+        Writer(string filename)
+    :
+      file_(QString::fromLocal8Bit (filename.c_str ()))
+{
+    if (!file_.open (QIODevice::WriteOnly))
+        throw ios_base::failure("Couldn't create " + file_.fileName ().toStdString ());
+
+    // Written by close
+    Header h;
+    memset(&h, 0, sizeof(h));
+    file_.write ((const char*)&h, sizeof(h));
+}
+
+
+unsigned ProjectFile::Writer::
+        addSection(const void* data, uint64_t size)
+{
+    EXCEPTION_ASSERT(file_.isOpen ());
+
+    pad (alignment);
+    table_.push_back (file_.pos ());
+    table_.push_back (size);
+
+    if (0 < size && (qint64)size != file_.write ((const char*)data, size))
+        throw ios_base::failure("Couldn't write to " + file_.fileName ().toStdString ());
+
+    return table_.size ()/2 - 1;
+}
+
+
+void ProjectFile::Writer::
+        close(const string& metadata)
+{
+    Header h;
+    memcpy(h.magic, magic, sizeof(magic));
+    h.version = format_version;
+    h.metadata_section = addSection (metadata.data (), metadata.size ());
+    h.section_count = table_.size ()/2;
+    h.reserved = 0;
+
+    pad (sizeof(uint64_t));
+    h.table_offset = file_.pos ();
+
+    qint64 table_bytes = table_.size ()*sizeof(uint64_t);
+    if (table_bytes != file_.write ((const char*)&table_[0], table_bytes) ||
+        !file_.seek (0) ||
+        (qint64)sizeof(h) != file_.write ((const char*)&h, sizeof(h)))
+    {
+        throw ios_base::failure("Couldn't write to " + file_.fileName ().toStdString ());
+    }
+
+    if (!file_.commit ())
+        throw ios_base::failure("Couldn't replace " + file_.fileName ().toStdString ());
+}
+
+
+ProjectFile::Writer* ProjectFile::Writer::
+        current()
+{
+    return current_writer;
+}
+
+
+ProjectFile::Writer::Scope::
+        Scope(Writer* w)
+    :
+      previous_(current_writer)
+{
+    current_writer = w;
+}
+
+
+ProjectFile::Writer::Scope::
+        ~Scope()
+{
+    current_writer = previous_;
+}
+
+
+void ProjectFile::Writer::
+        pad(uint64_t a)
+{
+    static const char zeros[ProjectFile::alignment] = {0};
+    uint64_t n = (a - file_.pos () % a) % a;
+    file_.write (zeros, n);
+}
+
+
+ProjectFile::
+        ProjectFile(string filename)
+    :
+      file_(QString::fromLocal8Bit (filename.c_str ())),
+      map_(0),
+      size_(0),
+      metadata_section_(0)
+{
+    if (!file_.open (QIODevice::ReadOnly))
+        throw ios_base::failure("Couldn't open " + filename);
+
+    size_ = file_.size ();
+    if (size_ < sizeof(Header))
+        throw ios_base::failure("Not a Sonic AWE project file " + filename);
+
+#ifdef _WIN32
+    // Windows can't replace a file that is mapped, read it instead so that a
+    // project can be saved over the file it was opened from
+    data_ = file_.readAll ();
+    file_.close ();
+    if ((uint64_t)data_.size () != size_)
+        throw ios_base::failure("Couldn't read " + filename);
+    map_ = (uchar*)data_.data ();
+#else
+    // A private mapping lets sections be modified in memory, such as a brush
+    // image that is painted on, without changing the file
+    map_ = file_.map (0, size_, QFileDevice::MapPrivateOption);
+    if (!map_)
+        throw ios_base::failure("Couldn't map " + filename);
+#endif
+
+    Header h;
+    memcpy(&h, map_, sizeof(h));
+    if (0 != memcmp(h.magic, magic, sizeof(magic)))
+        throw ios_base::failure("Not a Sonic AWE project file " + filename);
+    if (h.version > format_version)
+        throw ios_base::failure("Project file " + filename + " was saved by a newer version");
+    if (h.table_offset > size_ || h.section_count > (size_ - h.table_offset)/(2*sizeof(uint64_t)))
+        throw ios_base::failure("Corrupt project file " + filename);
+
+    table_.resize (2*h.section_count);
+    if (!table_.empty ())
+        memcpy(&table_[0], map_ + h.table_offset, table_.size ()*sizeof(uint64_t));
+
+    for (unsigned i=0; i<h.section_count; i++)
+    {
+        uint64_t offset = table_[2*i], size = table_[2*i+1];
+        if (offset > size_ || size > size_ - offset)
+            throw ios_base::failure("Corrupt project file " + filename);
+    }
+
+    if (h.metadata_section >= h.section_count)
+        throw ios_base::failure("Corrupt project file " + filename);
+    metadata_section_ = h.metadata_section;
+}
+
+
+ProjectFile::
+        ~ProjectFile()
+{
+    if (map_ && file_.isOpen ())
+        file_.unmap (map_);
+}
+
+
+ProjectFile::ptr ProjectFile::
+        open(string filename)
+{
+    TaskTimer tt("Mapping project file '%s'", filename.c_str());
+    return ptr(new ProjectFile(filename));
+}
+
+
+bool ProjectFile::
+        isProjectFile(string filename)
+{
+    QFile f(QString::fromLocal8Bit (filename.c_str ()));
+    if (!f.open (QIODevice::ReadOnly))
+        return false;
+
+    char m[sizeof(magic)];
+    return sizeof(m) == f.read (m, sizeof(m)) && 0 == memcmp(m, magic, sizeof(magic));
+}
+
+
+unsigned ProjectFile::
+        sectionCount() const
+{
+    return table_.size ()/2;
+}
+
+
+ProjectFile::Section ProjectFile::
+        section(unsigned i)
+{
+    EXCEPTION_ASSERT_LESS(i, sectionCount ());
+
+    Section s;
+    s.file = shared_from_this ();
+    s.data = (char*)map_ + table_[2*i];
+    s.size = table_[2*i+1];
+    return s;
+}
+
+
+string ProjectFile::
+        metadata()
+{
+    Section s = section (metadata_section_);
+    return string(s.data, s.size);
+}
+
+
+ProjectFile* ProjectFile::
+        current()
+{
+    return current_file;
+}
+
+
+ProjectFile::Scope::
+        Scope(ProjectFile* f)
+    :
+      previous_(current_file)
+{
+    current_file = f;
+}
+
+
+ProjectFile::Scope::
+        ~Scope()
+{
+    current_file = previous_;
+}
+
+} // namespace Sawe
+
+#include "trace_perf.h"
+
+#include <QDir>
+#include <QByteArray>
+
+#include <boost/archive/xml_oarchive.hpp>
+#include <boost/archive/xml_iarchive.hpp>
+#include <boost/serialization/nvp.hpp>
+
+#include <cmath>
+#include <sstream>
+
+namespace Sawe {
+
+void ProjectFile::
+        test()
+{
+    string filename = (QDir::tempPath () + "/projectfile_test.sonicawe").toStdString ();
+
+    // It should store sections aligned to page boundaries and map them when
+    // the file is opened.
+    {
+        vector<char> a(5000), b(3);
+        for (size_t i=0; i<a.size (); i++)
+            a[i] = i;
+        b[0] = 'x';
+
+        {
+            Writer w(filename);
+            EXCEPTION_ASSERT_EQUALS(w.addSection (&a[0], a.size ()), 0u);
+            EXCEPTION_ASSERT_EQUALS(w.addSection (&b[0], b.size ()), 1u);
+            EXCEPTION_ASSERT_EQUALS(w.addSection (0, 0), 2u);
+            w.close ("<xml/>");
+        }
+
+        EXCEPTION_ASSERT(isProjectFile (filename));
+
+        ProjectFile::ptr f = open (filename);
+        EXCEPTION_ASSERT_EQUALS(f->sectionCount (), 4u);
+        EXCEPTION_ASSERT_EQUALS(f->metadata (), "<xml/>");
+
+        Section s0 = f->section (0), s1 = f->section (1);
+        EXCEPTION_ASSERT_EQUALS(s0.size, a.size ());
+        EXCEPTION_ASSERT_EQUALS(s1.size, b.size ());
+        EXCEPTION_ASSERT_EQUALS(f->section (2).size, 0u);
+        EXCEPTION_ASSERT_EQUALS((s0.data - (char*)f->map_) % alignment, 0u);
+        EXCEPTION_ASSERT_EQUALS((s1.data - (char*)f->map_) % alignment, 0u);
+        EXCEPTION_ASSERT(0 == memcmp(s0.data, &a[0], a.size ()));
+        EXCEPTION_ASSERT_EQUALS(s1.data[0], 'x');
+
+        // Modifying a section doesn't modify the file
+        s1.data[0] = 'y';
+        EXCEPTION_ASSERT_EQUALS(open (filename)->section (1).data[0], 'x');
+
+        // A borrowed DataStorage keeps the file mapped
+        DataStorage<float>::ptr ds = f->section (0).borrow<float>(DataStorageSize(1250));
+        f.reset ();
+        s0 = s1 = Section();
+        EXCEPTION_ASSERT(0 == memcmp(CpuMemoryStorage::ReadOnly<1>(ds).ptr (), &a[0], a.size ()));
+    }
+
+    // It should leave an existing file untouched if writing fails, and
+    // refuse to open files that aren't project files.
+    {
+        {
+            Writer w(filename);
+            w.addSection ("abc", 3);
+        }
+
+        EXCEPTION_ASSERT_EQUALS(open (filename)->metadata (), "<xml/>");
+        QStringList files = QDir::temp ().entryList (QStringList("projectfile_test.sonicawe*"), QDir::Files);
+        EXCEPTION_ASSERT_EQUALS(files.size (), 1);
+
+        // A project can be saved over the file it was opened from
+        {
+            ProjectFile::ptr f = open (filename);
+            Section s0 = f->section (0);
+
+            Writer w(filename);
+            w.addSection (s0.data, s0.size);
+            w.close ("<xml2/>");
+
+            EXCEPTION_ASSERT_EQUALS(f->metadata (), "<xml/>");
+            ProjectFile::ptr f2 = open (filename);
+            EXCEPTION_ASSERT_EQUALS(f2->metadata (), "<xml2/>");
+            EXCEPTION_ASSERT(0 == memcmp(f2->section (0).data, s0.data, s0.size));
+        }
+
+        {
+            QFile f(QString::fromStdString (filename));
+            f.open (QIODevice::WriteOnly | QIODevice::Truncate);
+            f.write ("<?xml version=\"1.0\"?>");
+        }
+
+        EXCEPTION_ASSERT(!isProjectFile (filename));
+        bool threw = false;
+        try { open (filename); } catch (const ios_base::failure&) { threw = true; }
+        EXCEPTION_ASSERT(threw);
+    }
+
+    // It should save and open a project with hundreds of brush images faster
+    // than compressing them into the XML archive.
+    {
+        const int N = 300;
+        const DataStorageSize sz(256, 256);
+        vector<DataStorage<float>::ptr> images(N);
+        for (int i=0; i<N; i++)
+        {
+            images[i].reset (new DataStorage<float>(sz));
+            float* p = CpuMemoryStorage::WriteAll<1>(images[i]).ptr ();
+            for (int j=0; j<sz.width*sz.height; j++)
+                p[j] = 1.f + 0.5f*std::sin (0.001f*j + i);
+        }
+        size_t bytes = images[0]->numberOfBytes ();
+
+        string xmltext;
+        {
+            TRACE_PERF("ProjectFile should save 300 brush images compressed in XML");
+
+            ostringstream ss;
+            {
+                boost::archive::xml_oarchive xml(ss);
+                for (int i=0; i<N; i++)
+                {
+                    QByteArray zlibCompressed = qCompress(QByteArray::fromRawData ((char*)images[i]->getCpuMemory (), bytes));
+                    unsigned compressedN = zlibCompressed.size ();
+                    xml & BOOST_SERIALIZATION_NVP(compressedN);
+                    xml.save_binary (zlibCompressed.constData (), compressedN);
+                }
+            }
+            xmltext = ss.str ();
+
+            trace_perf_.reset ("ProjectFile should save 300 brush images in sections");
+
+            Writer w(filename);
+            ostringstream meta;
+            {
+                Writer::Scope scope(&w);
+                boost::archive::xml_oarchive xml(meta);
+                for (int i=0; i<N; i++)
+                {
+                    unsigned section = Writer::current ()->addSection (images[i]->getCpuMemory (), bytes);
+                    xml & BOOST_SERIALIZATION_NVP(section);
+                }
+            }
+            w.close (meta.str ());
+        }
+
+        vector<DataStorage<float>::ptr> compressed(N), mapped(N);
+        {
+            TRACE_PERF("ProjectFile should open 300 brush images compressed in XML");
+
+            istringstream ss(xmltext);
+            boost::archive::xml_iarchive xml(ss);
+            for (int i=0; i<N; i++)
+            {
+                unsigned compressedN = 0;
+                xml & BOOST_SERIALIZATION_NVP(compressedN);
+                QByteArray zlibCompressed;
+                zlibCompressed.resize (compressedN);
+                xml.load_binary (zlibCompressed.data (), compressedN);
+                QByteArray zlibUncompressed = qUncompress(zlibCompressed);
+                compressed[i].reset (new DataStorage<float>(sz));
+                memcpy(compressed[i]->getCpuMemory (), zlibUncompressed.constData (), bytes);
+            }
+
+            trace_perf_.reset ("ProjectFile should open 300 brush images in sections");
+
+            ProjectFile::ptr f = ProjectFile::open (filename);
+            Scope scope(f.get ());
+            istringstream meta(f->metadata ());
+            boost::archive::xml_iarchive xml(meta);
+            for (int i=0; i<N; i++)
+            {
+                unsigned section = 0;
+                xml & BOOST_SERIALIZATION_NVP(section);
+                mapped[i] = current ()->section (section).borrow<float>(sz);
+            }
+        }
+
+        for (int i=0; i<N; i+=37)
+        {
+            EXCEPTION_ASSERT(0 == memcmp(compressed[i]->getCpuMemory (), images[i]->getCpuMemory (), bytes));
+            EXCEPTION_ASSERT(0 == memcmp(mapped[i]->getCpuMemory (), images[i]->getCpuMemory (), bytes));
+        }
+    }
+
+    QFile::remove (QString::fromStdString (filename));
+}
+
+} // namespace Sawe
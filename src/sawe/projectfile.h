@@ -0,0 +1,182 @@
+#ifndef SAWE_PROJECTFILE_H
+#define SAWE_PROJECTFILE_H
+
+#include "sawedll.h"
+#include "cpumemorystorage.h"
+#include "exceptionassert.h"
+
+#include <QFile>
+#include <QSaveFile>
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Sawe {
+
+/**
+ * @brief The ProjectFile class should read a project file where bulky data,
+ * such as brush images and recorded audio, is stored as raw sections next to
+ * the XML archive instead of being compressed and base64 encoded inside it.
+ *
+ * The file is memory-mapped when opened and sections are only paged in when
+ * they are used. The mapping is private, a section can be modified in memory
+ * without changing the file.
+ *
+ * Layout:
+ *   Header         magic, format version, section count, table offset and
+ *                  the index of the section with the XML archive
+ *   Sections       raw data, each section starts at a multiple of 'alignment'
+ *   Section table  offset and size of each section
+ *
+ * Serialization code accesses the file being read or written through
+ * ProjectFile::current() and ProjectFile::Writer::current().
+ */
+class SaweDll ProjectFile: public std::enable_shared_from_this<ProjectFile>
+{
+public:
+    typedef std::shared_ptr<ProjectFile> ptr;
+
+    static const uint64_t alignment = 4096;
+
+    /**
+     * @brief The Section struct refers to mapped data. 'file' keeps the
+     * mapping valid.
+     */
+    struct Section
+    {
+        ProjectFile::ptr file;
+        char* data;
+        uint64_t size;
+
+        /**
+         * @brief borrow creates a DataStorage that refers to the section
+         * without copying it. The section stays mapped until the DataStorage
+         * is released.
+         */
+        template<typename T>
+        typename DataStorage<T>::ptr borrow(DataStorageSize sz) const
+        {
+            EXCEPTION_ASSERT_EQUALS(sz.width*sz.height*sz.depth*sizeof(T), size);
+
+            ProjectFile::ptr f = file;
+            typename DataStorage<T>::ptr ds(
+                        new DataStorage<T>(sz),
+                        [f](DataStorage<T>* p) { delete p; });
+            new CpuMemoryStorage( ds.get(), data, false ); // Memory managed by DataStorage
+            return ds;
+        }
+    };
+
+    /**
+     * @brief The Writer class should write a project file.
+     *
+     * Sections are written to a temporary file as they are added. close
+     * atomically replaces 'filename' with the temporary file, see QSaveFile.
+     * The temporary file is removed if the writer is destroyed before close
+     * or if close fails, and 'filename' is then left untouched.
+     */
+    class SaweDll Writer
+    {
+    public:
+        explicit Writer(std::string filename);
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        /**
+         * @brief addSection writes 'size' bytes as a new section.
+         * @return the index of the new section.
+         */
+        unsigned addSection(const void* data, uint64_t size);
+
+        /**
+         * @brief close writes 'metadata' and the section table.
+         */
+        void close(const std::string& metadata);
+
+        /**
+         * @brief current is the writer of the innermost Scope on this thread,
+         * or null.
+         */
+        static Writer* current();
+
+        class Scope
+        {
+        public:
+            explicit Scope(Writer* w);
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+            ~Scope();
+
+        private:
+            Writer* previous_;
+        };
+
+    private:
+        void pad(uint64_t a);
+
+        QSaveFile file_;
+        std::vector<uint64_t> table_;
+    };
+
+    /**
+     * @brief open maps 'filename'. Throws std::ios_base::failure if it isn't
+     * a valid project file.
+     */
+    static ptr open(std::string filename);
+
+    /**
+     * @brief isProjectFile checks the magic bytes of 'filename'.
+     */
+    static bool isProjectFile(std::string filename);
+
+    ProjectFile(const ProjectFile&) = delete;
+    ProjectFile& operator=(const ProjectFile&) = delete;
+    ~ProjectFile();
+
+    unsigned sectionCount() const;
+    Section section(unsigned i);
+
+    /**
+     * @brief metadata is the XML archive.
+     */
+    std::string metadata();
+
+    /**
+     * @brief current is the file of the innermost Scope on this thread, or
+     * null.
+     */
+    static ProjectFile* current();
+
+    class Scope
+    {
+    public:
+        explicit Scope(ProjectFile* f);
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope();
+
+    private:
+        ProjectFile* previous_;
+    };
+
+private:
+    explicit ProjectFile(std::string filename);
+
+    QFile file_;
+#ifdef _WIN32
+    QByteArray data_;
+#endif
+    uchar* map_;
+    uint64_t size_;
+    std::vector<uint64_t> table_;
+    unsigned metadata_section_;
+
+public:
+    static void test();
+};
+
+} // namespace Sawe
+
+#endif // SAWE_PROJECTFILE_H
@@ -137,6 +137,7 @@ CONFIG += otherfilesvs
 # Build settings
 CONFIG += sawelibs
 CONFIG += freetype-gl
+CONFIG += flac
 #DEFINES += CUDA_MEMCHECK_TEST
 
 ####################
@@ -13,6 +13,7 @@
 #include "test/tasktimertiming.h"
 #include "test/randombuffer.h"
 #include "test/printbuffer.h"
+#include "test/transposebenchmark.h"
 #include "tools/support/brushpaintkernel.h"
 #include "filters/selection.h"
 #include "filters/envelope.h"
@@ -34,7 +35,12 @@
 #include "tools/recordmodel.h"
 #include "tools/applicationerrorlogcontroller.h"
 #include "adapters/playback.h"
+#include "adapters/chunkexport.h"
+#include "adapters/csvreader.h"
+#include "adapters/flacreader.h"
+#include "adapters/matlabsharedmemory.h"
 #include "adapters/microphonerecorder.h"
+#include "sawe/projectfile.h"
 #include "filters/absolutevalue.h"
 
 // common backtrace tools
@@ -70,7 +76,9 @@ int UnitTest::
         trace_perf::add_database_path("../lib/backtrace/trace_perf");
         trace_perf::add_database_path("../lib/gpumisc/trace_perf");
         trace_perf::add_database_path("../lib/heightmap/trace_perf");
+        trace_perf::add_database_path("../lib/signal/trace_perf");
         trace_perf::add_database_path("../lib/tfr/trace_perf");
+        trace_perf::add_database_path("../lib/tfrheightmap/trace_perf");
 
         RUNTEST(BacktraceTest::UnitTest);
         RUNTEST(JustMisc::UnitTest);
@@ -84,6 +92,7 @@ int UnitTest::
         RUNTEST(Test::TaskTimerTiming);
         RUNTEST(Test::RandomBuffer);
         RUNTEST(Test::PrintBuffer);
+        RUNTEST(Test::TransposeBenchmark);
         RUNTEST(Tfr::FreqAxis);
         RUNTEST(Gauss);
         // PortAudio complains if testing Microphone in the end
@@ -97,6 +106,12 @@ int UnitTest::
         RUNTEST(Tools::OpenWatchedFileController);
         RUNTEST(Tools::RecordModel);
         RUNTEST(Tools::Support::AudiofileOpener);
+        RUNTEST(Adapters::ChunkExport);
+        RUNTEST(Adapters::CsvReader);
+#ifdef USE_FLAC
+        RUNTEST(Adapters::FlacReader);
+#endif
+        RUNTEST(Adapters::MatlabSharedMemory);
         RUNTEST(Tools::Support::CsvfileOpener);
         RUNTEST(Tools::Support::ChainInfo);
         RUNTEST(Tools::Support::OperationCrop);
@@ -109,6 +124,7 @@ int UnitTest::
         RUNTEST(Tools::ApplicationErrorLogController);
         RUNTEST(Adapters::Playback);
         RUNTEST(Filters::AbsoluteValueDesc);
+        RUNTEST(Sawe::ProjectFile);
 
     } catch (const ExceptionAssert& x) {
         char const * const * f = boost::get_error_info<boost::throw_file>(x);
@@ -211,6 +211,14 @@ void PlaybackController::
                     Signal::Interval::IntervalType_MAX,
                     1 );
 
+        // Playback starts as soon as the first samples are available,
+        // PlaybackView updates the deadline while playing
+        Signal::Processing::TargetNeeds::State::Deadline deadline;
+        deadline.time = boost::posix_time::microsec_clock::local_time ();
+        deadline.sample = expected_data.spannedInterval ().first;
+        deadline.samples_per_second = x.sample_rate.get_value_or (0);
+        model()->target_marker->target_needs ()->updateDeadline (deadline);
+
         if (!expected_data)
             stop();
     }
@@ -232,6 +240,11 @@ void PlaybackController::
         playback->pausePlayback( active );
     }
 
+    // Nothing is due while paused, PlaybackView sets a new deadline when
+    // playback continues
+    if (active && model()->target_marker)
+        model()->target_marker->target_needs ()->updateDeadline (Signal::Processing::TargetNeeds::State::Deadline());
+
     _view->update();
 }
 
@@ -266,6 +279,10 @@ void PlaybackController::
         playback->stop();
     }
 
+    // Don't let a stopped playback keep preempting other targets
+    if (model()->target_marker)
+        model()->target_marker->target_needs ()->updateDeadline (Signal::Processing::TargetNeeds::State::Deadline());
+
     model()->target_marker.reset();
     model()->adapter_playback.reset();
 
@@ -12,6 +12,8 @@
 // Qt
 #include <QTimer>
 
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
 namespace Tools
 {
 
@@ -108,6 +110,18 @@ void PlaybackView::
     if (_playbackMarker<=0)
         _playbackMarker = -1;
 
+    // Tell the scheduler when the next samples will be played, they need to
+    // be ready 'outputLatency' before that
+    if (!is_paused && 0<_playbackMarker && model->target_marker)
+    {
+        using namespace boost::posix_time;
+        Signal::Processing::TargetNeeds::State::Deadline deadline;
+        deadline.time = microsec_clock::local_time () - microseconds((long long)(playback->outputLatency ()*1e6));
+        deadline.sample = _playbackMarker*playback->sample_rate ();
+        deadline.samples_per_second = playback->sample_rate ();
+        model->target_marker->target_needs ()->updateDeadline (deadline);
+    }
+
     if (follow_play_marker && 0<_playbackMarker)
     {
         Tools::RenderView& r = *_render_view;
@@ -27,6 +27,7 @@
 #include "graphicsscene.h"
 #include "sawe/application.h"
 #include "signal/buffersource.h"
+#include "signal/decimate.h"
 #include "signal/reroutechannels.h"
 #include "filters/support/operation-composite.h"
 #include "tools/support/renderoperation.h"
@@ -56,6 +57,9 @@
 using namespace Ui;
 using namespace boost;
 
+// Levels of decimation for the overview, 16 times fewer samples to transform
+static const int overview_levels = 4;
+
 #ifdef min
 #undef min
 #endif
@@ -437,6 +441,9 @@ void RenderController::
     }
 
     model()->set_transform_desc (t);
+
+    if (overview_target)
+        setupOverview (t);
 }
 
 
@@ -450,6 +457,51 @@ void RenderController::
     cbfd->setMergeChunkDesc( mcdp );
     kernel.write ()->transformDesc(transform_desc);
     setBlockFilter( kernel );
+
+    overview_merge_chunk_desc = mcdp;
+    setupOverview( transform_desc );
+}
+
+
+/**
+ * With the feature 'overview_pyramid' coarse blocks are computed from a
+ * decimated copy of the signal by a separate target with a higher priority
+ * than the view. That gives a complete overview of the lower frequencies
+ * without transforming every sample at the full rate first. The view then
+ * refines all blocks at the full rate as usual.
+ */
+void RenderController::
+        setupOverview(Tfr::TransformDesc::ptr transform_desc)
+{
+    delete overview_publisher;
+    overview_target.reset ();
+
+    if (!Sawe::Configuration::feature("overview_pyramid") || !overview_merge_chunk_desc)
+        return;
+
+    // Waveforms and cepstra of a decimated signal don't resemble the original
+    if (!dynamic_cast<const Tfr::StftDesc*>(transform_desc.get ()) && !dynamic_cast<const Tfr::Cwt*>(transform_desc.get ()))
+        return;
+
+    Heightmap::Update::UpdateProducerDesc* cbfd;
+    Tfr::ChunkFilterDesc::ptr kernel(cbfd
+            = new Heightmap::Update::UpdateProducerDesc(update_queue, model()->tfr_mapping ()));
+    cbfd->setMergeChunkDesc( overview_merge_chunk_desc );
+    cbfd->setDecimation( overview_levels );
+    kernel.write ()->transformDesc(transform_desc->copy ());
+
+    Signal::Processing::Chain::ptr chain = project->processing_chain ();
+    overview_target = chain->addTarget(Signal::OperationDesc::ptr(new Tfr::TransformOperationDesc(kernel)));
+    chain->addOperationAt(Signal::OperationDesc::ptr(new Signal::DecimateDesc(overview_levels)), overview_target);
+
+    overview_publisher = new Support::HeightmapProcessingPublisher(
+                overview_target,
+                model()->tfr_mapping (),
+                model()->camera,
+                1,
+                this);
+    overview_publisher->setDecimation (overview_levels);
+    connect(view, SIGNAL(painting()), overview_publisher, SLOT(update()));
 }
 
 
@@ -1100,6 +1152,9 @@ void RenderController::
 void RenderController::
         deleteTarget()
 {
+    delete overview_publisher;
+    overview_target.reset ();
+
 //    model()->block_update_queue.reset ();
 //    model()->renderer.reset();
 //    clearCaches();
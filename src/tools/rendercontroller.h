@@ -20,6 +20,7 @@ namespace Tools
 {
     class GraphicsView;
     namespace Widgets { class ValueSlider; }
+    namespace Support { class HeightmapProcessingPublisher; }
 
     class SaweDll RenderController: public QObject
     {
@@ -111,6 +112,7 @@ namespace Tools
     private:
         void setCurrentFilterTransform(Tfr::TransformDesc::ptr);
         void setBlockFilter(Tfr::ChunkFilterDesc::ptr kernel);
+        void setupOverview(Tfr::TransformDesc::ptr);
         //Tfr::Filter* currentFilter();
         Tfr::TransformDesc::ptr currentTransform();
         float headSampleRate();
@@ -137,6 +139,11 @@ namespace Tools
 
         Heightmap::Update::UpdateQueue::ptr update_queue;
 
+        // Computes coarse blocks from a decimated signal, see setupOverview
+        Heightmap::MergeChunkDesc::ptr overview_merge_chunk_desc;
+        Signal::Processing::TargetMarker::ptr overview_target;
+        QPointer<Support::HeightmapProcessingPublisher> overview_publisher;
+
         void setupGui();
         void windowLostFocus();
         void windowGotFocus();
@@ -8,7 +8,7 @@
 
 namespace Tools { namespace Selections { namespace Support {
 
-class SplineFilter: public Tfr::ChunkFilter
+class SplineFilter: public Tfr::ChunkFilter, public Tfr::ChunkFilter::ParallelChannelsTag
 {
 public:
     struct SplineVertex
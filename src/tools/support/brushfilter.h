@@ -4,6 +4,7 @@
 #include "tfr/cwtfilter.h"
 #include "heightmap/reference_hash.h"
 #include "heightmap/tfrmapping.h"
+#include "sawe/projectfile.h"
 
 // boost
 #include <boost/serialization/shared_ptr.hpp>
@@ -85,6 +86,14 @@ private:
                 boost::serialization::binary_object Data( bv.second->getCpuMemory(), bv.second->numberOfBytes() );
                 ar & BOOST_SERIALIZATION_NVP(Data);
             }
+            else if (version>=2)
+            {
+                // The image is stored raw in the project file, outside of the archive
+                Sawe::ProjectFile::Writer* w = Sawe::ProjectFile::Writer::current();
+                EXCEPTION_ASSERTX( w, "MultiplyBrush must be saved to a Sawe::ProjectFile" );
+                unsigned section = w->addSection( bv.second->getCpuMemory(), bv.second->numberOfBytes() );
+                ar & BOOST_SERIALIZATION_NVP(section);
+            }
             else
             {
                 QByteArray zlibUncompressed = QByteArray::fromRawData( (char*)bv.second->getCpuMemory(), bv.second->numberOfBytes() );
@@ -109,14 +118,26 @@ private:
             ar & BOOST_SERIALIZATION_NVP(sz.height);
             sz.depth = 1;
 
-            BrushImageDataP img(new DataStorage<float>(sz));
+            BrushImageDataP img;
             if (version<=0)
             {
+                img.reset(new DataStorage<float>(sz));
                 boost::serialization::binary_object Data( img->getCpuMemory(), img->numberOfBytes() );
                 ar & BOOST_SERIALIZATION_NVP(Data);
             }
+            else if (version>=2)
+            {
+                // Refer to the mapped project file, the image is only read
+                // from disk when it is used
+                Sawe::ProjectFile* f = Sawe::ProjectFile::current();
+                EXCEPTION_ASSERTX( f, "MultiplyBrush must be loaded from a Sawe::ProjectFile" );
+                unsigned section = 0;
+                ar & BOOST_SERIALIZATION_NVP(section);
+                img = f->section(section).borrow<float>(sz);
+            }
             else
             {
+                img.reset(new DataStorage<float>(sz));
                 unsigned compressedN = 0;
                 ar & BOOST_SERIALIZATION_NVP(compressedN);
                 QByteArray zlibCompressed;
@@ -167,5 +188,6 @@ private:
 } // namespace Tools
 
 BOOST_CLASS_VERSION(Tools::Support::BrushFilter, 1)
+BOOST_CLASS_VERSION(Tools::Support::MultiplyBrush, 2)
 
 #endif // BRUSHFILTER_H